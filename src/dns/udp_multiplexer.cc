@@ -0,0 +1,735 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/dns/udp_multiplexer.hh"
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace Dns {
+
+namespace {
+
+constexpr std::uint16_t dns_port = 53;
+constexpr std::size_t header_length = 12;
+constexpr std::size_t ids_per_socket = 0x10000;
+//random IDs are found quickly while at most half of them are in use
+constexpr std::size_t max_ids_in_use_per_socket = ids_per_socket / 2;
+constexpr std::uint32_t no_slot = 0;
+constexpr auto retry_sending_after = std::chrono::milliseconds{1};
+constexpr int receive_buffer_size = 4 << 20;
+
+[[noreturn]] void throw_system_error(const char* operation)
+{
+    const int c_errno = errno;
+    throw std::runtime_error(std::string{operation} + " failed: " + std::strerror(c_errno));
+}
+
+::socklen_t to_sockaddr(const boost::asio::ip::address& address, ::sockaddr_storage& result)
+{
+    std::memset(&result, 0, sizeof(result));
+    if (address.is_v4())
+    {
+        auto& sin = reinterpret_cast<::sockaddr_in&>(result);
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(dns_port);
+        const auto bytes = address.to_v4().to_bytes();
+        std::memcpy(&sin.sin_addr, bytes.data(), bytes.size());
+        return sizeof(sin);
+    }
+    auto& sin6 = reinterpret_cast<::sockaddr_in6&>(result);
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port = htons(dns_port);
+    const auto bytes = address.to_v6().to_bytes();
+    std::memcpy(&sin6.sin6_addr, bytes.data(), bytes.size());
+    return sizeof(sin6);
+}
+
+bool is_same_source(const ::sockaddr_storage& lhs, const ::sockaddr_storage& rhs)
+{
+    if (lhs.ss_family != rhs.ss_family)
+    {
+        return false;
+    }
+    if (lhs.ss_family == AF_INET)
+    {
+        const auto& lhs_sin = reinterpret_cast<const ::sockaddr_in&>(lhs);
+        const auto& rhs_sin = reinterpret_cast<const ::sockaddr_in&>(rhs);
+        return (lhs_sin.sin_port == rhs_sin.sin_port) &&
+               (std::memcmp(&lhs_sin.sin_addr, &rhs_sin.sin_addr, sizeof(lhs_sin.sin_addr)) == 0);
+    }
+    const auto& lhs_sin6 = reinterpret_cast<const ::sockaddr_in6&>(lhs);
+    const auto& rhs_sin6 = reinterpret_cast<const ::sockaddr_in6&>(rhs);
+    return (lhs_sin6.sin6_port == rhs_sin6.sin6_port) &&
+           (std::memcmp(&lhs_sin6.sin6_addr, &rhs_sin6.sin6_addr, sizeof(lhs_sin6.sin6_addr)) == 0);
+}
+
+bool is_temporary_error(int error)
+{
+    return (error == EAGAIN) || (error == EWOULDBLOCK) || (error == ENOBUFS) || (error == EINTR);
+}
+
+}//namespace Dns::{anonymous}
+
+UdpMultiplexer::UdpMultiplexer(
+        Event::Base& event_base,
+        const std::list<boost::asio::ip::address>& resolvers,
+        const Settings& settings)
+    : event_base_{event_base},
+      settings_{settings},
+      resolvers_{},
+      sockets_{},
+      sockets_per_family_{std::max<std::size_t>(1, settings.number_of_sockets)},
+      slot_by_id_{},
+      slots_{},
+      free_slots_{},
+      finished_slots_{},
+      expirations_{},
+      number_of_unresolved_requests_{0},
+      next_resolver_{0},
+      next_socket_{0},
+      random_{std::random_device{}()},
+      flush_event_{nullptr},
+      flush_scheduled_{false},
+      timer_event_{nullptr},
+      retry_sending_{false},
+      receive_buffers_{},
+      receive_addresses_{},
+      iovecs_{},
+      headers_{},
+      statistics_{0, 0, 0, 0, 0, 0, 0}
+{
+    if (resolvers.empty())
+    {
+        throw std::runtime_error("no resolver to send queries to");
+    }
+    settings_.batch_size = std::max<std::size_t>(1, settings_.batch_size);
+    settings_.udp_payload_size = std::max<std::uint16_t>(512, settings_.udp_payload_size);
+    try
+    {
+        //sockets of one address family are created together for the first resolver of this family
+        for (const auto& address : resolvers)
+        {
+            Resolver resolver;
+            resolver.address_length = to_sockaddr(address, resolver.address);
+            const auto same_family = std::find_if(resolvers_.begin(), resolvers_.end(), [&](const Resolver& other)
+            {
+                return other.address.ss_family == resolver.address.ss_family;
+            });
+            if (same_family != resolvers_.end())
+            {
+                resolver.first_socket = same_family->first_socket;
+                resolvers_.push_back(resolver);
+                continue;
+            }
+            resolver.first_socket = sockets_.size();
+            for (std::size_t idx = 0; idx < sockets_per_family_; ++idx)
+            {
+                const int fd = ::socket(resolver.address.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (fd < 0)
+                {
+                    throw_system_error("socket");
+                }
+                sockets_.push_back(Socket{fd, nullptr, 0, {}});
+                //answers of a whole batch may come before the socket is read, the kernel caps the size anyway
+                ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+            }
+            resolvers_.push_back(resolver);
+        }
+        for (std::size_t idx = 0; idx < sockets_.size(); ++idx)
+        {
+            sockets_[idx].read_event = ::event_new(event_base_, sockets_[idx].fd, EV_READ | EV_PERSIST, on_read_event, this);
+            if ((sockets_[idx].read_event == nullptr) || (::event_add(sockets_[idx].read_event, nullptr) != 0))
+            {
+                throw std::runtime_error("event_add failed");
+            }
+        }
+        flush_event_ = ::event_new(event_base_, -1, 0, on_flush_event, this);
+        timer_event_ = ::event_new(event_base_, -1, 0, on_timer_event, this);
+        if ((flush_event_ == nullptr) || (timer_event_ == nullptr))
+        {
+            throw std::runtime_error("event_new failed");
+        }
+    }
+    catch (...)
+    {
+        this->close();
+        throw;
+    }
+    slot_by_id_.resize(sockets_.size() * ids_per_socket, no_slot);
+    receive_buffers_.resize(settings_.batch_size * settings_.udp_payload_size);
+    receive_addresses_.resize(settings_.batch_size);
+    iovecs_.resize(settings_.batch_size);
+    headers_.resize(settings_.batch_size);
+}
+
+UdpMultiplexer::~UdpMultiplexer()
+{
+    this->close();
+}
+
+void UdpMultiplexer::close() noexcept
+{
+    for (auto&& slot : slots_)
+    {
+        this->close_tcp(slot);
+    }
+    for (auto&& socket : sockets_)
+    {
+        if (socket.read_event != nullptr)
+        {
+            ::event_del(socket.read_event);
+            ::event_free(socket.read_event);
+            socket.read_event = nullptr;
+        }
+        ::close(socket.fd);
+    }
+    sockets_.clear();
+    for (auto* const event_ptr : {&flush_event_, &timer_event_})
+    {
+        if (*event_ptr != nullptr)
+        {
+            ::event_del(*event_ptr);
+            ::event_free(*event_ptr);
+            *event_ptr = nullptr;
+        }
+    }
+}
+
+UdpMultiplexer& UdpMultiplexer::send(Token token, const char* name, std::uint16_t type)
+{
+    const std::size_t index = this->acquire_slot();
+    Slot& slot = slots_[index];
+    try
+    {
+        slot.token = token;
+        slot.resolver = next_resolver_;
+        next_resolver_ = (next_resolver_ + 1) % resolvers_.size();
+        this->assign_id(slot);
+        slot.query.clear();
+        append_query(slot.query, slot.id, name, type, QueryOptions{true, settings_.udp_payload_size, false});
+    }
+    catch (...)
+    {
+        this->release_id(slot);
+        this->release_slot(index);
+        throw;
+    }
+    slot.state = State::queued;
+    ++number_of_unresolved_requests_;
+    Socket& socket = sockets_[slot.socket];
+    socket.outgoing.push_back(index);
+    if (settings_.batch_size <= socket.outgoing.size())
+    {
+        this->flush(socket);
+    }
+    else if (!flush_scheduled_)
+    {
+        //the rest of the batch goes out once the current round of callbacks is over
+        ::event_active(flush_event_, 0, 0);
+        flush_scheduled_ = true;
+    }
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::do_one_step()
+{
+    switch (event_base_(Event::Loop::Once{}))
+    {
+        case Event::Base::Result::success:
+        case Event::Base::Result::no_events:
+            return *this;
+    }
+    throw std::runtime_error("event_base_loop returned unexpected value");
+}
+
+std::size_t UdpMultiplexer::get_number_of_unresolved_requests() const noexcept
+{
+    return number_of_unresolved_requests_;
+}
+
+std::size_t UdpMultiplexer::get_capacity() const noexcept
+{
+    return sockets_per_family_ * max_ids_in_use_per_socket;
+}
+
+Event::Base& UdpMultiplexer::get_event_base()
+{
+    return event_base_;
+}
+
+const UdpMultiplexer::Statistics& UdpMultiplexer::get_statistics() const noexcept
+{
+    return statistics_;
+}
+
+std::size_t UdpMultiplexer::acquire_slot()
+{
+    if (free_slots_.empty())
+    {
+        slots_.push_back(Slot{this, slots_.size(), 0, State::free, 0, 0, 0, 0, TimeUnit::Uptime::zero(), {}, {}, Outcome::failed, -1, nullptr, 0});
+        return slots_.size() - 1;
+    }
+    const std::size_t index = free_slots_.back();
+    free_slots_.pop_back();
+    return index;
+}
+
+UdpMultiplexer& UdpMultiplexer::release_slot(std::size_t index)
+{
+    Slot& slot = slots_[index];
+    ++slot.generation;
+    slot.state = State::free;
+    slot.answer.clear();
+    free_slots_.push_back(index);
+    return *this;
+}
+
+//the least loaded socket of the family of the resolver, a random unused ID of this socket
+UdpMultiplexer& UdpMultiplexer::assign_id(Slot& slot)
+{
+    const Resolver& resolver = resolvers_[slot.resolver];
+    std::size_t socket_index = resolver.first_socket + (next_socket_++ % sockets_per_family_);
+    for (std::size_t idx = 0; idx < sockets_per_family_; ++idx)
+    {
+        const std::size_t candidate = resolver.first_socket + idx;
+        if (sockets_[candidate].number_of_ids_in_use < sockets_[socket_index].number_of_ids_in_use)
+        {
+            socket_index = candidate;
+        }
+    }
+    Socket& socket = sockets_[socket_index];
+    if (max_ids_in_use_per_socket <= socket.number_of_ids_in_use)
+    {
+        throw std::runtime_error("no free query ID");
+    }
+    std::uniform_int_distribution<std::uint32_t> random_id{0, ids_per_socket - 1};
+    std::uint32_t id = random_id(random_);
+    while (slot_by_id_[socket_index * ids_per_socket + id] != no_slot)
+    {
+        id = random_id(random_);
+    }
+    slot_by_id_[socket_index * ids_per_socket + id] = slot.index + 1;
+    ++socket.number_of_ids_in_use;
+    slot.socket = socket_index;
+    slot.id = id;
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::release_id(Slot& slot)
+{
+    auto& entry = slot_by_id_[slot.socket * ids_per_socket + slot.id];
+    if (entry == slot.index + 1)
+    {
+        entry = no_slot;
+        --sockets_[slot.socket].number_of_ids_in_use;
+    }
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::flush(Socket& socket)
+{
+    std::size_t sent = 0;
+    while (sent < socket.outgoing.size())
+    {
+        const std::size_t batch_size = std::min(settings_.batch_size, socket.outgoing.size() - sent);
+        for (std::size_t idx = 0; idx < batch_size; ++idx)
+        {
+            Slot& slot = slots_[socket.outgoing[sent + idx]];
+            Resolver& resolver = resolvers_[slot.resolver];
+            iovecs_[idx].iov_base = slot.query.data();
+            iovecs_[idx].iov_len = slot.query.size();
+            std::memset(&headers_[idx], 0, sizeof(headers_[idx]));
+            headers_[idx].msg_hdr.msg_name = &resolver.address;
+            headers_[idx].msg_hdr.msg_namelen = resolver.address_length;
+            headers_[idx].msg_hdr.msg_iov = &iovecs_[idx];
+            headers_[idx].msg_hdr.msg_iovlen = 1;
+        }
+        ++statistics_.send_calls;
+        const int result = ::sendmmsg(socket.fd, headers_.data(), batch_size, 0);
+        if (result < 0)
+        {
+            if (is_temporary_error(errno))
+            {
+                retry_sending_ = true;
+                break;
+            }
+            //the first datagram of the batch can not be sent (e.g. unreachable network)
+            this->finish(slots_[socket.outgoing[sent]], Outcome::failed);
+            ++sent;
+            continue;
+        }
+        const auto deadline = TimeUnit::Uptime{TimeUnit::get_uptime().get() + settings_.timeout};
+        for (int idx = 0; idx < result; ++idx)
+        {
+            Slot& slot = slots_[socket.outgoing[sent + idx]];
+            slot.state = State::sent;
+            slot.deadline = deadline;
+            expirations_.push_back(Expiration{deadline, slot.index, slot.generation});
+        }
+        statistics_.datagrams_sent += result;
+        sent += result;
+    }
+    socket.outgoing.erase(socket.outgoing.begin(), socket.outgoing.begin() + sent);
+    return this->schedule_timer();
+}
+
+UdpMultiplexer& UdpMultiplexer::flush_all()
+{
+    flush_scheduled_ = false;
+    retry_sending_ = false;
+    for (auto&& socket : sockets_)
+    {
+        if (!socket.outgoing.empty())
+        {
+            this->flush(socket);
+        }
+    }
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::receive(std::size_t socket_index)
+{
+    const std::size_t buffer_size = settings_.udp_payload_size;
+    while (true)
+    {
+        for (std::size_t idx = 0; idx < settings_.batch_size; ++idx)
+        {
+            iovecs_[idx].iov_base = receive_buffers_.data() + idx * buffer_size;
+            iovecs_[idx].iov_len = buffer_size;
+            std::memset(&headers_[idx], 0, sizeof(headers_[idx]));
+            headers_[idx].msg_hdr.msg_name = &receive_addresses_[idx];
+            headers_[idx].msg_hdr.msg_namelen = sizeof(receive_addresses_[idx]);
+            headers_[idx].msg_hdr.msg_iov = &iovecs_[idx];
+            headers_[idx].msg_hdr.msg_iovlen = 1;
+        }
+        ++statistics_.receive_calls;
+        const int result = ::recvmmsg(sockets_[socket_index].fd, headers_.data(), settings_.batch_size, MSG_DONTWAIT, nullptr);
+        if (result <= 0)
+        {
+            return *this;
+        }
+        statistics_.datagrams_received += result;
+        for (int idx = 0; idx < result; ++idx)
+        {
+            this->on_datagram(
+                    socket_index,
+                    receive_buffers_.data() + idx * buffer_size,
+                    headers_[idx].msg_len,
+                    receive_addresses_[idx]);
+        }
+        if (static_cast<std::size_t>(result) < settings_.batch_size)
+        {
+            return *this;
+        }
+    }
+}
+
+UdpMultiplexer& UdpMultiplexer::on_datagram(
+        std::size_t socket_index,
+        const std::uint8_t* data,
+        std::size_t size,
+        const ::sockaddr_storage& source)
+{
+    if (size < header_length)
+    {
+        ++statistics_.unexpected_datagrams;
+        return *this;
+    }
+    const std::uint16_t id = (std::uint16_t{data[0]} << 8) | data[1];
+    const auto slot_number = slot_by_id_[socket_index * ids_per_socket + id];
+    if (slot_number == no_slot)
+    {
+        ++statistics_.unexpected_datagrams;
+        return *this;
+    }
+    Slot& slot = slots_[slot_number - 1];
+    if ((slot.state != State::sent) ||
+        !is_same_source(source, resolvers_[slot.resolver].address) ||
+        !this->is_answer_of(slot, data, size))
+    {
+        ++statistics_.unexpected_datagrams;
+        return *this;
+    }
+    if (Message{data, size}.get_header().is_truncated())
+    {
+        return this->start_tcp(slot);
+    }
+    slot.answer.assign(data, data + size);
+    return this->finish(slot, Outcome::answered);
+}
+
+//the answer repeats the question of the query
+bool UdpMultiplexer::is_answer_of(const Slot& slot, const std::uint8_t* data, std::size_t size) const
+{
+    try
+    {
+        const Message answer{data, size};
+        const Header& header = answer.get_header();
+        if (!header.is_response() || (header.id != slot.id) || (header.number_of_questions != 1))
+        {
+            return false;
+        }
+    }
+    catch (const MalformedMessage&)
+    {
+        return false;
+    }
+    //no records follow the question in the query except the OPT record
+    const std::size_t question_end = Message{slot.query.data(), slot.query.size()}.get_end_of_questions();
+    return (question_end <= size) &&
+           std::equal(slot.query.begin() + header_length, slot.query.begin() + question_end, data + header_length);
+}
+
+UdpMultiplexer& UdpMultiplexer::start_tcp(Slot& slot)
+{
+    ++statistics_.tcp_fallbacks;
+    const Resolver& resolver = resolvers_[slot.resolver];
+    slot.tcp_fd = ::socket(resolver.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (slot.tcp_fd < 0)
+    {
+        return this->finish(slot, Outcome::failed);
+    }
+    const bool connected = ::connect(slot.tcp_fd, reinterpret_cast<const ::sockaddr*>(&resolver.address), resolver.address_length) == 0;
+    if (!connected && (errno != EINPROGRESS))
+    {
+        return this->finish(slot, Outcome::failed);
+    }
+    //the query goes out prefixed by its length, the answer comes back the same way
+    const auto length = slot.query.size();
+    slot.query.insert(slot.query.begin(), {static_cast<std::uint8_t>(length >> 8), static_cast<std::uint8_t>(length & 0xff)});
+    slot.tcp_done = 0;
+    slot.tcp_event = ::event_new(event_base_, slot.tcp_fd, EV_WRITE | EV_PERSIST, on_tcp_event, &slot);
+    if ((slot.tcp_event == nullptr) || (::event_add(slot.tcp_event, nullptr) != 0))
+    {
+        return this->finish(slot, Outcome::failed);
+    }
+    slot.state = State::tcp;
+    slot.deadline = TimeUnit::Uptime{TimeUnit::get_uptime().get() + settings_.timeout};
+    expirations_.push_back(Expiration{slot.deadline, slot.index, slot.generation});
+    return this->schedule_timer();
+}
+
+UdpMultiplexer& UdpMultiplexer::on_tcp_event(Slot& slot)
+{
+    const bool is_writing = slot.tcp_done < slot.query.size();
+    if (is_writing)
+    {
+        const auto result = ::send(slot.tcp_fd, slot.query.data() + slot.tcp_done, slot.query.size() - slot.tcp_done, MSG_NOSIGNAL);
+        if (result < 0)
+        {
+            return is_temporary_error(errno) ? *this : this->finish(slot, Outcome::failed);
+        }
+        slot.tcp_done += result;
+        if (slot.tcp_done < slot.query.size())
+        {
+            return *this;
+        }
+        ::event_del(slot.tcp_event);
+        ::event_free(slot.tcp_event);
+        slot.tcp_event = ::event_new(event_base_, slot.tcp_fd, EV_READ | EV_PERSIST, on_tcp_event, &slot);
+        if ((slot.tcp_event == nullptr) || (::event_add(slot.tcp_event, nullptr) != 0))
+        {
+            return this->finish(slot, Outcome::failed);
+        }
+        return *this;
+    }
+    std::uint8_t buffer[4096];
+    const auto result = ::recv(slot.tcp_fd, buffer, sizeof(buffer), 0);
+    if (result < 0)
+    {
+        return is_temporary_error(errno) ? *this : this->finish(slot, Outcome::failed);
+    }
+    if (result == 0)
+    {
+        return this->finish(slot, Outcome::failed);
+    }
+    slot.answer.insert(slot.answer.end(), buffer, buffer + result);
+    if (slot.answer.size() < 2)
+    {
+        return *this;
+    }
+    const std::size_t length = (std::size_t{slot.answer[0]} << 8) | slot.answer[1];
+    if (slot.answer.size() < 2 + length)
+    {
+        return *this;
+    }
+    slot.answer.erase(slot.answer.begin(), slot.answer.begin() + 2);
+    slot.answer.resize(length);
+    slot.query.erase(slot.query.begin(), slot.query.begin() + 2);
+    const bool is_answer = this->is_answer_of(slot, slot.answer.data(), slot.answer.size());
+    return this->finish(slot, is_answer ? Outcome::answered : Outcome::failed);
+}
+
+UdpMultiplexer& UdpMultiplexer::close_tcp(Slot& slot)
+{
+    if (slot.tcp_event != nullptr)
+    {
+        ::event_del(slot.tcp_event);
+        ::event_free(slot.tcp_event);
+        slot.tcp_event = nullptr;
+    }
+    if (0 <= slot.tcp_fd)
+    {
+        ::close(slot.tcp_fd);
+        slot.tcp_fd = -1;
+    }
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::finish(Slot& slot, Outcome outcome)
+{
+    this->close_tcp(slot);
+    this->release_id(slot);
+    slot.state = State::finished;
+    slot.outcome = outcome;
+    if (outcome != Outcome::answered)
+    {
+        slot.answer.clear();
+    }
+    --number_of_unresolved_requests_;
+    finished_slots_.push_back(slot.index);
+    return *this;
+}
+
+//deadlines are pushed in ascending order as all queries share one timeout
+UdpMultiplexer& UdpMultiplexer::expire()
+{
+    const auto now = TimeUnit::get_uptime();
+    while (!expirations_.empty() && (expirations_.front().deadline <= now))
+    {
+        const Expiration expiration = expirations_.front();
+        expirations_.pop_front();
+        Slot& slot = slots_[expiration.slot];
+        const bool is_waiting = (slot.state == State::sent) || (slot.state == State::tcp);
+        //the deadline of the UDP query does not apply to its TCP fallback
+        const bool is_current = (slot.generation == expiration.generation) && (slot.deadline == expiration.deadline);
+        if (is_current && is_waiting)
+        {
+            ++statistics_.timeouts;
+            this->finish(slot, Outcome::timed_out);
+        }
+    }
+    return *this;
+}
+
+UdpMultiplexer& UdpMultiplexer::schedule_timer()
+{
+    ::event_del(timer_event_);
+    if (expirations_.empty() && !retry_sending_)
+    {
+        return *this;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            expirations_.empty() ? std::chrono::nanoseconds{retry_sending_after}
+                                 : expirations_.front().deadline.get() - TimeUnit::get_uptime().get());
+    if (retry_sending_)
+    {
+        wait = std::min<std::chrono::microseconds>(wait, retry_sending_after);
+    }
+    wait = std::max(wait, std::chrono::microseconds{0});
+    struct ::timeval timeout;
+    timeout.tv_sec = wait.count() / 1000000;
+    timeout.tv_usec = wait.count() % 1000000;
+    if (::event_add(timer_event_, &timeout) != 0)
+    {
+        throw std::runtime_error("event_add failed");
+    }
+    return *this;
+}
+
+void UdpMultiplexer::on_flush_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        static_cast<UdpMultiplexer*>(user_data)->flush_all();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UdpMultiplexer::flush failed: " << e.what() << std::endl;
+    }
+}
+
+void UdpMultiplexer::on_timer_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        auto* const multiplexer = static_cast<UdpMultiplexer*>(user_data);
+        if (multiplexer->retry_sending_)
+        {
+            multiplexer->flush_all();
+        }
+        multiplexer->expire().schedule_timer();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UdpMultiplexer::expire failed: " << e.what() << std::endl;
+    }
+}
+
+void UdpMultiplexer::on_read_event(evutil_socket_t fd, short, void* user_data)
+{
+    try
+    {
+        auto* const multiplexer = static_cast<UdpMultiplexer*>(user_data);
+        const auto socket = std::find_if(multiplexer->sockets_.begin(), multiplexer->sockets_.end(), [&](const Socket& socket)
+        {
+            return socket.fd == fd;
+        });
+        if (socket != multiplexer->sockets_.end())
+        {
+            multiplexer->receive(socket - multiplexer->sockets_.begin());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UdpMultiplexer::receive failed: " << e.what() << std::endl;
+    }
+}
+
+void UdpMultiplexer::on_tcp_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        auto* const slot = static_cast<Slot*>(user_data);
+        slot->multiplexer->on_tcp_event(*slot);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UdpMultiplexer::on_tcp_event failed: " << e.what() << std::endl;
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, const UdpMultiplexer::Statistics& statistics)
+{
+    return out << statistics.datagrams_sent << " datagrams sent by " << statistics.send_calls << " calls, "
+               << statistics.datagrams_received << " received by " << statistics.receive_calls << " calls, "
+               << statistics.unexpected_datagrams << " unexpected, "
+               << statistics.tcp_fallbacks << " truncated answers asked over TCP, "
+               << statistics.timeouts << " timeouts";
+}
+
+}//namespace Dns
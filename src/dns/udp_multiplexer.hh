@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UDP_MULTIPLEXER_HH_D4458FC709F69AB6913BDC69C1C67424//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define UDP_MULTIPLEXER_HH_D4458FC709F69AB6913BDC69C1C67424
+
+#include "src/dns/wire.hh"
+
+#include "src/event/base.hh"
+
+#include "src/time_unit.hh"
+
+#include <boost/asio/ip/address.hpp>
+
+#include <event2/event.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Dns {
+
+//queries to recursive resolvers share a few UDP sockets and go out and come in by batches of sendmmsg/recvmmsg,
+//so neither descriptors nor syscalls grow with the number of queries in flight; answers are matched by ID,
+//question and source, truncated answers are asked again over TCP
+class UdpMultiplexer
+{
+public:
+    struct Settings
+    {
+        //per address family
+        std::size_t number_of_sockets;
+        //max number of datagrams per sendmmsg/recvmmsg
+        std::size_t batch_size;
+        std::chrono::nanoseconds timeout;
+        std::uint16_t udp_payload_size;
+    };
+    enum class Outcome
+    {
+        answered,
+        timed_out,
+        failed
+    };
+    struct Statistics
+    {
+        std::size_t send_calls;
+        std::size_t datagrams_sent;
+        std::size_t receive_calls;
+        std::size_t datagrams_received;
+        //late, spoofed or garbled datagrams
+        std::size_t unexpected_datagrams;
+        std::size_t tcp_fallbacks;
+        std::size_t timeouts;
+        friend std::ostream& operator<<(std::ostream& out, const Statistics& statistics);
+    };
+    using Token = std::size_t;
+    UdpMultiplexer(Event::Base& event_base, const std::list<boost::asio::ip::address>& resolvers, const Settings& settings);
+    UdpMultiplexer(const UdpMultiplexer&) = delete;
+    ~UdpMultiplexer();
+    UdpMultiplexer& operator=(const UdpMultiplexer&) = delete;
+    //the query goes out with the next batch, resolvers take turns
+    UdpMultiplexer& send(Token token, const char* name, std::uint16_t type);
+    UdpMultiplexer& do_one_step();
+    std::size_t get_number_of_unresolved_requests() const noexcept;
+    //number of queries in flight the query IDs of the sockets are able to tell apart
+    std::size_t get_capacity() const noexcept;
+    //calls handle(Token, Outcome, const Message*) for each query finished since the previous call, the message is
+    //nullptr unless the query was answered and it is valid during the call only
+    template <typename Handler>
+    UdpMultiplexer& for_each_finished_request(Handler handle);
+    Event::Base& get_event_base();
+    const Statistics& get_statistics() const noexcept;
+private:
+    enum class State
+    {
+        free,
+        queued,
+        sent,
+        tcp,
+        finished
+    };
+    struct Resolver
+    {
+        ::sockaddr_storage address;
+        ::socklen_t address_length;
+        std::size_t first_socket;
+    };
+    struct Socket
+    {
+        int fd;
+        ::event* read_event;
+        std::size_t number_of_ids_in_use;
+        std::vector<std::size_t> outgoing;
+    };
+    struct Slot
+    {
+        UdpMultiplexer* multiplexer;
+        std::size_t index;
+        std::uint32_t generation;
+        State state;
+        Token token;
+        std::size_t resolver;
+        std::size_t socket;
+        std::uint16_t id;
+        TimeUnit::Uptime deadline;
+        std::vector<std::uint8_t> query;
+        std::vector<std::uint8_t> answer;
+        Outcome outcome;
+        //TCP exchange after a truncated answer
+        int tcp_fd;
+        ::event* tcp_event;
+        std::size_t tcp_done;
+    };
+    struct Expiration
+    {
+        TimeUnit::Uptime deadline;
+        std::size_t slot;
+        std::uint32_t generation;
+    };
+    void close() noexcept;
+    std::size_t acquire_slot();
+    UdpMultiplexer& release_slot(std::size_t index);
+    UdpMultiplexer& assign_id(Slot& slot);
+    UdpMultiplexer& release_id(Slot& slot);
+    UdpMultiplexer& flush(Socket& socket);
+    UdpMultiplexer& flush_all();
+    UdpMultiplexer& receive(std::size_t socket_index);
+    UdpMultiplexer& on_datagram(std::size_t socket_index, const std::uint8_t* data, std::size_t size, const ::sockaddr_storage& source);
+    bool is_answer_of(const Slot& slot, const std::uint8_t* data, std::size_t size) const;
+    UdpMultiplexer& start_tcp(Slot& slot);
+    UdpMultiplexer& on_tcp_event(Slot& slot);
+    UdpMultiplexer& close_tcp(Slot& slot);
+    UdpMultiplexer& finish(Slot& slot, Outcome outcome);
+    UdpMultiplexer& expire();
+    UdpMultiplexer& schedule_timer();
+    static void on_flush_event(evutil_socket_t, short, void* user_data);
+    static void on_timer_event(evutil_socket_t, short, void* user_data);
+    static void on_read_event(evutil_socket_t fd, short, void* user_data);
+    static void on_tcp_event(evutil_socket_t, short, void* user_data);
+    Event::Base& event_base_;
+    Settings settings_;
+    std::vector<Resolver> resolvers_;
+    std::vector<Socket> sockets_;
+    std::size_t sockets_per_family_;
+    std::vector<std::uint32_t> slot_by_id_;
+    std::deque<Slot> slots_;
+    std::vector<std::size_t> free_slots_;
+    std::vector<std::size_t> finished_slots_;
+    std::deque<Expiration> expirations_;
+    std::size_t number_of_unresolved_requests_;
+    std::size_t next_resolver_;
+    std::size_t next_socket_;
+    std::mt19937 random_;
+    ::event* flush_event_;
+    bool flush_scheduled_;
+    ::event* timer_event_;
+    bool retry_sending_;
+    std::vector<std::uint8_t> receive_buffers_;
+    std::vector<::sockaddr_storage> receive_addresses_;
+    std::vector<::iovec> iovecs_;
+    std::vector<::mmsghdr> headers_;
+    Statistics statistics_;
+};
+
+template <typename Handler>
+UdpMultiplexer& UdpMultiplexer::for_each_finished_request(Handler handle)
+{
+    for (std::size_t position = 0; position < finished_slots_.size(); ++position)
+    {
+        const std::size_t index = finished_slots_[position];
+        Slot& slot = slots_[index];
+        try
+        {
+            if (slot.outcome == Outcome::answered)
+            {
+                const Message answer{slot.answer.data(), slot.answer.size()};
+                handle(slot.token, slot.outcome, &answer);
+            }
+            else
+            {
+                handle(slot.token, slot.outcome, static_cast<const Message*>(nullptr));
+            }
+        }
+        catch (...)
+        {
+            this->release_slot(index);
+            finished_slots_.erase(finished_slots_.begin(), finished_slots_.begin() + position + 1);
+            throw;
+        }
+        this->release_slot(index);
+    }
+    finished_slots_.clear();
+    return *this;
+}
+
+}//namespace Dns
+
+#endif//UDP_MULTIPLEXER_HH_D4458FC709F69AB6913BDC69C1C67424
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/dns/uring.hh"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Dns {
+
+namespace {
+
+[[noreturn]] void throw_system_error(const char* operation)
+{
+    const int c_errno = errno;
+    throw std::runtime_error(std::string{operation} + " failed: " + std::strerror(c_errno));
+}
+
+int enter(int fd, unsigned to_submit, unsigned flags)
+{
+    return ::syscall(__NR_io_uring_enter, fd, to_submit, 0, flags, nullptr, 0);
+}
+
+void* map(int fd, std::size_t size, ::off_t offset)
+{
+    void* const result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (result == MAP_FAILED)
+    {
+        throw_system_error("mmap");
+    }
+    return result;
+}
+
+template <typename T>
+T* at(void* ring, unsigned offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}//namespace Dns::{anonymous}
+
+Uring::Uring(unsigned number_of_entries, unsigned number_of_completions)
+    : fd_{-1},
+      sq_ring_{nullptr},
+      sq_ring_size_{0},
+      cq_ring_{nullptr},
+      cq_ring_size_{0},
+      sqes_{nullptr},
+      sqes_size_{0},
+      sq_head_{nullptr},
+      sq_tail_{nullptr},
+      sq_flags_{nullptr},
+      sq_mask_{0},
+      sq_entries_{0},
+      cq_head_{nullptr},
+      cq_tail_{nullptr},
+      cq_mask_{0},
+      cqes_{nullptr},
+      sqe_head_{0},
+      sqe_tail_{0}
+{
+    ::io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = std::max(number_of_completions, 2 * number_of_entries);
+    fd_ = ::syscall(__NR_io_uring_setup, number_of_entries, &params);
+    if (fd_ < 0)
+    {
+        throw_system_error("io_uring_setup");
+    }
+    try
+    {
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        sq_ring_ = map(fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+        cq_ring_ = map(fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(::io_uring_sqe);
+        sqes_ = static_cast<::io_uring_sqe*>(map(fd_, sqes_size_, IORING_OFF_SQES));
+    }
+    catch (...)
+    {
+        this->close();
+        throw;
+    }
+    sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_flags_ = at<unsigned>(sq_ring_, params.sq_off.flags);
+    sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = at<::io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+    //entries are used in order, each position of the ring refers to the entry of the same index
+    unsigned* const array = at<unsigned>(sq_ring_, params.sq_off.array);
+    for (unsigned idx = 0; idx < sq_entries_; ++idx)
+    {
+        array[idx] = idx;
+    }
+    sqe_head_ = *sq_tail_;
+    sqe_tail_ = sqe_head_;
+}
+
+Uring::~Uring()
+{
+    this->close();
+}
+
+void Uring::close() noexcept
+{
+    if (sqes_ != nullptr)
+    {
+        ::munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (cq_ring_ != nullptr)
+    {
+        ::munmap(cq_ring_, cq_ring_size_);
+        cq_ring_ = nullptr;
+    }
+    if (sq_ring_ != nullptr)
+    {
+        ::munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = nullptr;
+    }
+    if (0 <= fd_)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+int Uring::get_fd() const noexcept
+{
+    return fd_;
+}
+
+::io_uring_sqe* Uring::get_sqe() noexcept
+{
+    const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_entries_ <= (sqe_tail_ - head))
+    {
+        return nullptr;
+    }
+    ::io_uring_sqe* const sqe = &sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+std::size_t Uring::get_number_of_unsubmitted() const noexcept
+{
+    return sqe_tail_ - sqe_head_;
+}
+
+std::size_t Uring::submit()
+{
+    const unsigned to_submit = sqe_tail_ - sqe_head_;
+    if (to_submit == 0)
+    {
+        return 0;
+    }
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    while (true)
+    {
+        const int result = enter(fd_, to_submit, 0);
+        if (0 <= result)
+        {
+            sqe_head_ += result;
+            return result;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        //the completion queue is overflown, entries stay in the ring
+        if ((errno == EAGAIN) || (errno == EBUSY))
+        {
+            return 0;
+        }
+        throw_system_error("io_uring_enter");
+    }
+}
+
+std::size_t Uring::reap(std::vector<::io_uring_cqe>& completions)
+{
+    std::size_t number_of_completions = 0;
+    while (true)
+    {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            completions.push_back(cqes_[head & cq_mask_]);
+            ++number_of_completions;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        //completions which did not fit into the ring wait in the kernel until it is asked for them
+        const bool overflown = (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) != 0;
+        if (!overflown)
+        {
+            return number_of_completions;
+        }
+        if ((enter(fd_, 0, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+        {
+            throw_system_error("io_uring_enter");
+        }
+        if (__atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) == head)
+        {
+            return number_of_completions;
+        }
+    }
+}
+
+}//namespace Dns
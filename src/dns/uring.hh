@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef URING_HH_F092C588D6D8FD591066482AEAAE5FCB//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define URING_HH_F092C588D6D8FD591066482AEAAE5FCB
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace Dns {
+
+//io_uring instance driven by raw syscalls: operations are queued by get_sqe() and handed over to the kernel
+//by one submit(), their completions are taken from the shared ring without any syscall
+class Uring
+{
+public:
+    //the completion queue is larger so that completions of many connections fit in between two reaps
+    Uring(unsigned number_of_entries, unsigned number_of_completions);
+    Uring(const Uring&) = delete;
+    ~Uring();
+    Uring& operator=(const Uring&) = delete;
+    //becomes readable when completions are waiting
+    int get_fd() const noexcept;
+    //zeroed entry, nullptr if the submission queue is full
+    ::io_uring_sqe* get_sqe() noexcept;
+    std::size_t get_number_of_unsubmitted() const noexcept;
+    //returns number of entries taken by the kernel, 0 if it is busy and the entries wait for the next call
+    std::size_t submit();
+    //appends all completions waiting in the ring, returns their number
+    std::size_t reap(std::vector<::io_uring_cqe>& completions);
+private:
+    void close() noexcept;
+    int fd_;
+    void* sq_ring_;
+    std::size_t sq_ring_size_;
+    void* cq_ring_;
+    std::size_t cq_ring_size_;
+    ::io_uring_sqe* sqes_;
+    std::size_t sqes_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_flags_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    ::io_uring_cqe* cqes_;
+    //entries up to sqe_tail_ are queued, entries up to sqe_head_ are taken by the kernel
+    unsigned sqe_head_;
+    unsigned sqe_tail_;
+};
+
+}//namespace Dns
+
+#endif//URING_HH_F092C588D6D8FD591066482AEAAE5FCB
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef URING_SOLVER_HH_91CA809FC40D5035CC925B02A18ECC34//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define URING_SOLVER_HH_91CA809FC40D5035CC925B02A18ECC34
+
+#include "src/dns/uring_tcp_client.hh"
+#include "src/dns/wire.hh"
+
+#include "src/event/base.hh"
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace Dns {
+
+//counterpart of GetDns::Solver whose queries go over TCP through io_uring; query.start_exchange(client, token)
+//sends the query, its outcome comes by on_answer(const Message&), on_timeout(token) or on_error(token)
+template <typename Query>
+class UringSolver
+{
+public:
+    using Token = UringTcpClient::Token;
+    UringSolver(Event::Base& event_base, std::size_t number_of_entries);
+    Token add_request(Query query);
+    UringSolver& do_one_step();
+    std::size_t get_number_of_unresolved_requests() const noexcept;
+    //calls handle(Query&) for each query finished since the previous call, the query is dropped afterwards;
+    //handle may add new requests
+    template <typename Handler>
+    UringSolver& for_each_finished_request(Handler handle);
+    Event::Base& get_event_base();
+    UringTcpClient& get_client();
+private:
+    UringSolver& release(Token token);
+    UringTcpClient client_;
+    std::deque<boost::optional<Query>> queries_;
+    std::vector<Token> free_tokens_;
+};
+
+template <typename Query>
+UringSolver<Query>::UringSolver(Event::Base& event_base, std::size_t number_of_entries)
+    : client_{event_base, number_of_entries},
+      queries_{},
+      free_tokens_{}
+{ }
+
+template <typename Query>
+typename UringSolver<Query>::Token UringSolver<Query>::add_request(Query query)
+{
+    Token token = queries_.size();
+    if (free_tokens_.empty())
+    {
+        queries_.emplace_back(std::move(query));
+    }
+    else
+    {
+        token = free_tokens_.back();
+        free_tokens_.pop_back();
+        queries_[token] = std::move(query);
+    }
+    try
+    {
+        queries_[token]->start_exchange(client_, token);
+    }
+    catch (...)
+    {
+        this->release(token);
+        throw;
+    }
+    return token;
+}
+
+template <typename Query>
+UringSolver<Query>& UringSolver<Query>::do_one_step()
+{
+    client_.do_one_step();
+    return *this;
+}
+
+template <typename Query>
+std::size_t UringSolver<Query>::get_number_of_unresolved_requests() const noexcept
+{
+    return client_.get_number_of_unresolved_requests();
+}
+
+template <typename Query>
+template <typename Handler>
+UringSolver<Query>& UringSolver<Query>::for_each_finished_request(Handler handle)
+{
+    client_.for_each_finished_request([&](Token token, UringTcpClient::Outcome outcome, const Message* answer)
+    {
+        Query& query = *queries_[token];
+        try
+        {
+            switch (outcome)
+            {
+                case UringTcpClient::Outcome::answered:
+                    query.on_answer(*answer);
+                    break;
+                case UringTcpClient::Outcome::timed_out:
+                    query.on_timeout(token);
+                    break;
+                case UringTcpClient::Outcome::failed:
+                    query.on_error(token);
+                    break;
+            }
+            handle(query);
+        }
+        catch (...)
+        {
+            this->release(token);
+            throw;
+        }
+        this->release(token);
+    });
+    return *this;
+}
+
+template <typename Query>
+Event::Base& UringSolver<Query>::get_event_base()
+{
+    return client_.get_event_base();
+}
+
+template <typename Query>
+UringTcpClient& UringSolver<Query>::get_client()
+{
+    return client_;
+}
+
+template <typename Query>
+UringSolver<Query>& UringSolver<Query>::release(Token token)
+{
+    queries_[token] = boost::none;
+    free_tokens_.push_back(token);
+    return *this;
+}
+
+}//namespace Dns
+
+#endif//URING_SOLVER_HH_91CA809FC40D5035CC925B02A18ECC34
@@ -0,0 +1,750 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/dns/uring_tcp_client.hh"
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace Dns {
+
+namespace {
+
+constexpr std::uint16_t dns_port = 53;
+constexpr std::size_t header_length = 12;
+constexpr std::size_t length_prefix = 2;
+constexpr unsigned min_number_of_completions = 16384;
+constexpr std::uint64_t operation_bits = 3;
+constexpr std::uint64_t operation_mask = (1 << operation_bits) - 1;
+constexpr std::size_t initial_receive_buffer_size = 4096;
+constexpr std::uint16_t edns_payload_size = 1232;
+constexpr auto retry_submit_after = std::chrono::milliseconds{1};
+
+[[noreturn]] void throw_system_error(const char* operation)
+{
+    const int c_errno = errno;
+    throw std::runtime_error(std::string{operation} + " failed: " + std::strerror(c_errno));
+}
+
+::socklen_t to_sockaddr(const boost::asio::ip::address& address, ::sockaddr_storage& result)
+{
+    std::memset(&result, 0, sizeof(result));
+    if (address.is_v4())
+    {
+        auto& sin = reinterpret_cast<::sockaddr_in&>(result);
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(dns_port);
+        const auto bytes = address.to_v4().to_bytes();
+        std::memcpy(&sin.sin_addr, bytes.data(), bytes.size());
+        return sizeof(sin);
+    }
+    auto& sin6 = reinterpret_cast<::sockaddr_in6&>(result);
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port = htons(dns_port);
+    const auto bytes = address.to_v6().to_bytes();
+    std::memcpy(&sin6.sin6_addr, bytes.data(), bytes.size());
+    return sizeof(sin6);
+}
+
+std::size_t get_length_at(const std::vector<std::uint8_t>& data, std::size_t offset)
+{
+    return (std::size_t{data[offset]} << 8) | data[offset + 1];
+}
+
+}//namespace Dns::{anonymous}
+
+UringTcpClient::UringTcpClient(Event::Base& event_base, std::size_t number_of_entries)
+    : event_base_{event_base},
+      max_queries_per_connection_{1},
+      max_connections_per_address_{1},
+      slots_{},
+      free_slots_{},
+      finished_slots_{},
+      connections_{},
+      free_connections_{},
+      connections_by_address_{},
+      expirations_{},
+      number_of_unresolved_requests_{0},
+      random_{std::random_device{}()},
+      ring_event_{nullptr},
+      submit_event_{nullptr},
+      submit_scheduled_{false},
+      timer_event_{nullptr},
+      completions_{},
+      statistics_{0, 0, 0, 0, 0, 0, 0, 0},
+      ring_{static_cast<unsigned>(std::max<std::size_t>(1, number_of_entries)), min_number_of_completions}
+{
+    try
+    {
+        //completions are reaped by the event loop shared with getdns
+        ring_event_ = ::event_new(event_base_, ring_.get_fd(), EV_READ | EV_PERSIST, on_ring_event, this);
+        if ((ring_event_ == nullptr) || (::event_add(ring_event_, nullptr) != 0))
+        {
+            throw std::runtime_error("event_add failed");
+        }
+        submit_event_ = ::event_new(event_base_, -1, 0, on_submit_event, this);
+        timer_event_ = ::event_new(event_base_, -1, 0, on_timer_event, this);
+        if ((submit_event_ == nullptr) || (timer_event_ == nullptr))
+        {
+            throw std::runtime_error("event_new failed");
+        }
+    }
+    catch (...)
+    {
+        this->close();
+        throw;
+    }
+}
+
+UringTcpClient::~UringTcpClient()
+{
+    this->close();
+}
+
+void UringTcpClient::close() noexcept
+{
+    for (auto* const event_ptr : {&ring_event_, &submit_event_, &timer_event_})
+    {
+        if (*event_ptr != nullptr)
+        {
+            ::event_del(*event_ptr);
+            ::event_free(*event_ptr);
+            *event_ptr = nullptr;
+        }
+    }
+    for (auto&& connection : connections_)
+    {
+        if (0 <= connection.fd)
+        {
+            ::close(connection.fd);
+            connection.fd = -1;
+        }
+    }
+}
+
+UringTcpClient& UringTcpClient::set_max_queries_per_connection(std::size_t value) noexcept
+{
+    max_queries_per_connection_ = 0 < value ? value : 1;
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::set_max_connections_per_address(std::size_t value) noexcept
+{
+    max_connections_per_address_ = 0 < value ? value : 1;
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::send(
+        Token token,
+        const boost::asio::ip::address& address,
+        const char* name,
+        std::uint16_t type,
+        std::chrono::nanoseconds timeout)
+{
+    const std::size_t index = this->acquire_slot();
+    Slot& slot = slots_[index];
+    try
+    {
+        //authoritative nameservers are asked, the ID is set once the connection is known
+        slot.query.assign(length_prefix, 0);
+        append_query(slot.query, 0, name, type, QueryOptions{false, edns_payload_size, false});
+        const std::size_t length = slot.query.size() - length_prefix;
+        slot.query[0] = length >> 8;
+        slot.query[1] = length & 0xff;
+        Connection& connection = this->get_connection_to(address);
+        slot.token = token;
+        slot.connection = connection.index;
+        slot.id = this->make_id(connection);
+        slot.query[length_prefix] = slot.id >> 8;
+        slot.query[length_prefix + 1] = slot.id & 0xff;
+        connection.queries.push_back(index);
+        connection.outgoing.insert(connection.outgoing.end(), slot.query.begin(), slot.query.end());
+    }
+    catch (...)
+    {
+        this->release_slot(index);
+        throw;
+    }
+    slot.state = State::sent;
+    ++number_of_unresolved_requests_;
+    ++statistics_.queries;
+    this->start_send(connections_[slot.connection]);
+    const auto deadline = TimeUnit::Uptime{TimeUnit::get_uptime().get() + timeout};
+    expirations_.push(Expiration{deadline, index, slot.generation});
+    if ((expirations_.top().slot == index) && (expirations_.top().generation == slot.generation))
+    {
+        this->schedule_timer();
+    }
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::do_one_step()
+{
+    switch (event_base_(Event::Loop::Once{}))
+    {
+        case Event::Base::Result::success:
+        case Event::Base::Result::no_events:
+            return *this;
+    }
+    throw std::runtime_error("event_base_loop returned unexpected value");
+}
+
+std::size_t UringTcpClient::get_number_of_unresolved_requests() const noexcept
+{
+    return number_of_unresolved_requests_;
+}
+
+Event::Base& UringTcpClient::get_event_base()
+{
+    return event_base_;
+}
+
+const UringTcpClient::Statistics& UringTcpClient::get_statistics() const noexcept
+{
+    return statistics_;
+}
+
+std::size_t UringTcpClient::acquire_slot()
+{
+    if (free_slots_.empty())
+    {
+        slots_.push_back(Slot{slots_.size(), 0, State::free, 0, 0, 0, {}, {}, Outcome::failed});
+        return slots_.size() - 1;
+    }
+    const std::size_t index = free_slots_.back();
+    free_slots_.pop_back();
+    return index;
+}
+
+UringTcpClient& UringTcpClient::release_slot(std::size_t index)
+{
+    Slot& slot = slots_[index];
+    ++slot.generation;
+    slot.state = State::free;
+    slot.answer.clear();
+    free_slots_.push_back(index);
+    return *this;
+}
+
+//the least loaded connection to the address unless a new one is allowed
+UringTcpClient::Connection& UringTcpClient::get_connection_to(const boost::asio::ip::address& address)
+{
+    auto& indices = connections_by_address_[address];
+    const auto least_loaded = std::min_element(indices.begin(), indices.end(), [&](std::size_t lhs, std::size_t rhs)
+    {
+        return connections_[lhs].queries.size() < connections_[rhs].queries.size();
+    });
+    if (least_loaded != indices.end())
+    {
+        const bool is_overloaded = max_queries_per_connection_ <= connections_[*least_loaded].queries.size();
+        const bool limit_reached = max_connections_per_address_ <= indices.size();
+        if (!is_overloaded || limit_reached)
+        {
+            return connections_[*least_loaded];
+        }
+    }
+    //a blocking socket, io_uring polls it by itself
+    const int fd = ::socket(address.is_v4() ? AF_INET : AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        if (indices.empty())
+        {
+            connections_by_address_.erase(address);
+        }
+        throw_system_error("socket");
+    }
+    if (free_connections_.empty())
+    {
+        connections_.push_back(Connection{connections_.size(), ConnectionState::free, -1, {}, {}, 0, {}, {}, {}, 0, {}, 0, 0, false, false, false});
+        free_connections_.push_back(connections_.back().index);
+    }
+    Connection& connection = connections_[free_connections_.back()];
+    connection.state = ConnectionState::connecting;
+    connection.fd = fd;
+    connection.address = address;
+    connection.peer_length = to_sockaddr(address, connection.peer);
+    connection.bytes_sent = 0;
+    connection.bytes_received = 0;
+    try
+    {
+        ::io_uring_sqe& sqe = this->prepare(connection, Operation::connect);
+        sqe.opcode = IORING_OP_CONNECT;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(&connection.peer);
+        sqe.off = connection.peer_length;
+    }
+    catch (...)
+    {
+        ::close(fd);
+        connection.fd = -1;
+        connection.state = ConnectionState::free;
+        if (indices.empty())
+        {
+            connections_by_address_.erase(address);
+        }
+        throw;
+    }
+    free_connections_.pop_back();
+    connection.connect_in_flight = true;
+    indices.push_back(connection.index);
+    ++statistics_.connections;
+    return connection;
+}
+
+//random ID unused by the other queries of the connection
+std::uint16_t UringTcpClient::make_id(const Connection& connection)
+{
+    std::uniform_int_distribution<std::uint32_t> random_id{0, 0xffff};
+    while (true)
+    {
+        const auto id = static_cast<std::uint16_t>(random_id(random_));
+        const bool in_use = std::any_of(connection.queries.begin(), connection.queries.end(), [&](std::size_t index)
+        {
+            return slots_[index].id == id;
+        });
+        if (!in_use)
+        {
+            return id;
+        }
+    }
+}
+
+//the operation goes out with the next submission; if the queue is full the queued ones are submitted right now
+::io_uring_sqe& UringTcpClient::prepare(Connection& connection, Operation operation)
+{
+    ::io_uring_sqe* sqe = ring_.get_sqe();
+    if (sqe == nullptr)
+    {
+        this->submit();
+        sqe = ring_.get_sqe();
+        if (sqe == nullptr)
+        {
+            throw std::runtime_error("io_uring submission queue is full");
+        }
+    }
+    sqe->user_data = (std::uint64_t{connection.index} << operation_bits) | static_cast<std::uint64_t>(operation);
+    ++connection.operations_in_flight;
+    this->schedule_submit();
+    return *sqe;
+}
+
+//queries which came since the previous write go out by one write
+UringTcpClient& UringTcpClient::start_send(Connection& connection)
+{
+    if ((connection.state != ConnectionState::open) || connection.send_in_flight)
+    {
+        return *this;
+    }
+    if (connection.sending.size() <= connection.bytes_sent)
+    {
+        connection.sending.clear();
+        connection.bytes_sent = 0;
+        if (connection.outgoing.empty())
+        {
+            return *this;
+        }
+        std::swap(connection.sending, connection.outgoing);
+    }
+    ::io_uring_sqe& sqe = this->prepare(connection, Operation::send);
+    sqe.opcode = IORING_OP_SEND;
+    sqe.fd = connection.fd;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(connection.sending.data() + connection.bytes_sent);
+    sqe.len = connection.sending.size() - connection.bytes_sent;
+    sqe.msg_flags = MSG_NOSIGNAL;
+    connection.send_in_flight = true;
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::start_receive(Connection& connection)
+{
+    if ((connection.state != ConnectionState::open) || connection.receive_in_flight)
+    {
+        return *this;
+    }
+    if (connection.incoming.size() <= connection.bytes_received)
+    {
+        connection.incoming.resize(std::max(initial_receive_buffer_size, 2 * connection.incoming.size()));
+    }
+    ::io_uring_sqe& sqe = this->prepare(connection, Operation::receive);
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = connection.fd;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(connection.incoming.data() + connection.bytes_received);
+    sqe.len = connection.incoming.size() - connection.bytes_received;
+    connection.receive_in_flight = true;
+    return *this;
+}
+
+//the connection is closed once no operation of it is in flight
+UringTcpClient& UringTcpClient::start_close(Connection& connection)
+{
+    if ((connection.state != ConnectionState::connecting) && (connection.state != ConnectionState::open))
+    {
+        return *this;
+    }
+    const bool was_connecting = connection.state == ConnectionState::connecting;
+    connection.state = ConnectionState::closing;
+    const auto indices = connections_by_address_.find(connection.address);
+    if (indices != connections_by_address_.end())
+    {
+        indices->second.erase(std::remove(indices->second.begin(), indices->second.end(), connection.index), indices->second.end());
+        if (indices->second.empty())
+        {
+            connections_by_address_.erase(indices);
+        }
+    }
+    if (was_connecting && connection.connect_in_flight)
+    {
+        ::io_uring_sqe& sqe = this->prepare(connection, Operation::cancel);
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = (std::uint64_t{connection.index} << operation_bits) | static_cast<std::uint64_t>(Operation::connect);
+    }
+    else
+    {
+        //a write or read in flight ends right away
+        ::shutdown(connection.fd, SHUT_RDWR);
+    }
+    if (connection.operations_in_flight == 0)
+    {
+        this->finish_close(connection);
+    }
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::finish_close(Connection& connection)
+{
+    try
+    {
+        ::io_uring_sqe& sqe = this->prepare(connection, Operation::close);
+        sqe.opcode = IORING_OP_CLOSE;
+        sqe.fd = connection.fd;
+    }
+    catch (...)
+    {
+        ::close(connection.fd);
+        connection.fd = -1;
+        connection.state = ConnectionState::free;
+        free_connections_.push_back(connection.index);
+        throw;
+    }
+    return *this;
+}
+
+//queries of a connection which failed are not asked again here, the caller decides
+UringTcpClient& UringTcpClient::fail(Connection& connection)
+{
+    const auto queries = connection.queries;
+    for (const auto index : queries)
+    {
+        this->finish(slots_[index], Outcome::failed);
+    }
+    return this->start_close(connection);
+}
+
+UringTcpClient& UringTcpClient::on_completion(const ::io_uring_cqe& completion)
+{
+    Connection& connection = connections_[completion.user_data >> operation_bits];
+    --connection.operations_in_flight;
+    const bool is_closing = connection.state == ConnectionState::closing;
+    switch (static_cast<Operation>(completion.user_data & operation_mask))
+    {
+        case Operation::connect:
+            connection.connect_in_flight = false;
+            if (is_closing)
+            {
+                break;
+            }
+            if (completion.res < 0)
+            {
+                this->fail(connection);
+                break;
+            }
+            connection.state = ConnectionState::open;
+            this->start_receive(connection).start_send(connection);
+            break;
+        case Operation::send:
+            connection.send_in_flight = false;
+            if (is_closing)
+            {
+                break;
+            }
+            if (completion.res < 0)
+            {
+                this->fail(connection);
+                break;
+            }
+            connection.bytes_sent += completion.res;
+            this->start_send(connection);
+            break;
+        case Operation::receive:
+            connection.receive_in_flight = false;
+            if (is_closing)
+            {
+                break;
+            }
+            //the nameserver closed the connection before all answers came
+            if (completion.res <= 0)
+            {
+                this->fail(connection);
+                break;
+            }
+            connection.bytes_received += completion.res;
+            this->on_received(connection);
+            break;
+        case Operation::cancel:
+            break;
+        case Operation::close:
+            connection.fd = -1;
+            connection.state = ConnectionState::free;
+            connection.outgoing.clear();
+            connection.sending.clear();
+            free_connections_.push_back(connection.index);
+            return *this;
+    }
+    if ((connection.state == ConnectionState::closing) && (connection.operations_in_flight == 0))
+    {
+        this->finish_close(connection);
+    }
+    return *this;
+}
+
+//answers come prefixed by their length, possibly several by one read or one by several reads
+UringTcpClient& UringTcpClient::on_received(Connection& connection)
+{
+    std::size_t offset = 0;
+    while ((length_prefix <= (connection.bytes_received - offset)) &&
+           ((length_prefix + get_length_at(connection.incoming, offset)) <= (connection.bytes_received - offset)))
+    {
+        const std::size_t length = get_length_at(connection.incoming, offset);
+        this->on_answer(connection, connection.incoming.data() + offset + length_prefix, length);
+        offset += length_prefix + length;
+    }
+    if (0 < offset)
+    {
+        std::copy(connection.incoming.begin() + offset,
+                  connection.incoming.begin() + connection.bytes_received,
+                  connection.incoming.begin());
+        connection.bytes_received -= offset;
+    }
+    if (length_prefix <= connection.bytes_received)
+    {
+        const std::size_t message_size = length_prefix + get_length_at(connection.incoming, 0);
+        connection.incoming.resize(std::max(connection.incoming.size(), message_size));
+    }
+    return this->start_receive(connection);
+}
+
+UringTcpClient& UringTcpClient::on_answer(Connection& connection, const std::uint8_t* data, std::size_t size)
+{
+    if (header_length <= size)
+    {
+        const std::uint16_t id = (std::uint16_t{data[0]} << 8) | data[1];
+        for (const auto index : connection.queries)
+        {
+            Slot& slot = slots_[index];
+            if ((slot.id == id) && this->is_answer_of(slot, data, size))
+            {
+                slot.answer.assign(data, data + size);
+                return this->finish(slot, Outcome::answered);
+            }
+        }
+    }
+    ++statistics_.unexpected_answers;
+    return *this;
+}
+
+//the answer repeats the question of the query
+bool UringTcpClient::is_answer_of(const Slot& slot, const std::uint8_t* data, std::size_t size) const
+{
+    try
+    {
+        const Message answer{data, size};
+        const Header& header = answer.get_header();
+        if (!header.is_response() || (header.id != slot.id) || (header.number_of_questions != 1))
+        {
+            return false;
+        }
+    }
+    catch (const MalformedMessage&)
+    {
+        return false;
+    }
+    //no records follow the question in the query except the OPT record
+    const std::uint8_t* const query = slot.query.data() + length_prefix;
+    const std::size_t question_end = Message{query, slot.query.size() - length_prefix}.get_end_of_questions();
+    return (question_end <= size) &&
+           std::equal(query + header_length, query + question_end, data + header_length);
+}
+
+//a connection without queries is closed, queries asked later open a new one
+UringTcpClient& UringTcpClient::finish(Slot& slot, Outcome outcome)
+{
+    Connection& connection = connections_[slot.connection];
+    connection.queries.erase(std::remove(connection.queries.begin(), connection.queries.end(), slot.index), connection.queries.end());
+    slot.state = State::finished;
+    slot.outcome = outcome;
+    if (outcome != Outcome::answered)
+    {
+        slot.answer.clear();
+    }
+    --number_of_unresolved_requests_;
+    finished_slots_.push_back(slot.index);
+    if (connection.queries.empty())
+    {
+        this->start_close(connection);
+    }
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::submit()
+{
+    if (ring_.get_number_of_unsubmitted() == 0)
+    {
+        return *this;
+    }
+    ++statistics_.submit_calls;
+    statistics_.operations_submitted += ring_.submit();
+    if (0 < ring_.get_number_of_unsubmitted())
+    {
+        //the kernel is busy, completions have to be reaped first
+        this->schedule_timer();
+    }
+    return *this;
+}
+
+//operations queued during the current round of callbacks are submitted together once it is over
+UringTcpClient& UringTcpClient::schedule_submit()
+{
+    if (!submit_scheduled_)
+    {
+        ::event_active(submit_event_, 0, 0);
+        submit_scheduled_ = true;
+    }
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::expire()
+{
+    const auto now = TimeUnit::get_uptime();
+    while (!expirations_.empty() && (expirations_.top().deadline <= now))
+    {
+        const Expiration expiration = expirations_.top();
+        expirations_.pop();
+        Slot& slot = slots_[expiration.slot];
+        if ((slot.generation == expiration.generation) && (slot.state == State::sent))
+        {
+            ++statistics_.timeouts;
+            this->finish(slot, Outcome::timed_out);
+        }
+    }
+    return *this;
+}
+
+UringTcpClient& UringTcpClient::schedule_timer()
+{
+    ::event_del(timer_event_);
+    const bool retry_submit = 0 < ring_.get_number_of_unsubmitted();
+    if (expirations_.empty() && !retry_submit)
+    {
+        return *this;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            expirations_.empty() ? std::chrono::nanoseconds{retry_submit_after}
+                                 : expirations_.top().deadline.get() - TimeUnit::get_uptime().get());
+    if (retry_submit)
+    {
+        wait = std::min<std::chrono::microseconds>(wait, retry_submit_after);
+    }
+    wait = std::max(wait, std::chrono::microseconds{0});
+    struct ::timeval timeout;
+    timeout.tv_sec = wait.count() / 1000000;
+    timeout.tv_usec = wait.count() % 1000000;
+    if (::event_add(timer_event_, &timeout) != 0)
+    {
+        throw std::runtime_error("event_add failed");
+    }
+    return *this;
+}
+
+//completions of one wakeup are handled together and operations they start go out by one submission
+void UringTcpClient::on_ring_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        auto* const client = static_cast<UringTcpClient*>(user_data);
+        client->completions_.clear();
+        ++client->statistics_.reaps;
+        client->statistics_.completions += client->ring_.reap(client->completions_);
+        for (const auto& completion : client->completions_)
+        {
+            client->on_completion(completion);
+        }
+        client->submit();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UringTcpClient::reap failed: " << e.what() << std::endl;
+    }
+}
+
+void UringTcpClient::on_submit_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        auto* const client = static_cast<UringTcpClient*>(user_data);
+        client->submit_scheduled_ = false;
+        client->submit();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UringTcpClient::submit failed: " << e.what() << std::endl;
+    }
+}
+
+void UringTcpClient::on_timer_event(evutil_socket_t, short, void* user_data)
+{
+    try
+    {
+        auto* const client = static_cast<UringTcpClient*>(user_data);
+        client->submit();
+        client->expire().schedule_timer();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "UringTcpClient::expire failed: " << e.what() << std::endl;
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, const UringTcpClient::Statistics& statistics)
+{
+    return out << statistics.operations_submitted << " operations submitted by " << statistics.submit_calls << " calls, "
+               << statistics.completions << " completions reaped by " << statistics.reaps << " wakeups, "
+               << statistics.queries << " queries over " << statistics.connections << " connections, "
+               << statistics.unexpected_answers << " unexpected answers, "
+               << statistics.timeouts << " timeouts";
+}
+
+}//namespace Dns
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef URING_TCP_CLIENT_HH_D54EA25F4C256D4D794CF8838ECA04DD//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define URING_TCP_CLIENT_HH_D54EA25F4C256D4D794CF8838ECA04DD
+
+#include "src/dns/uring.hh"
+#include "src/dns/wire.hh"
+
+#include "src/event/base.hh"
+
+#include "src/time_unit.hh"
+
+#include <boost/asio/ip/address.hpp>
+
+#include <event2/event.h>
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace Dns {
+
+//queries to authoritative nameservers over TCP whose connects, writes, reads and closes go through io_uring;
+//operations queued during one round of callbacks are submitted by one syscall and their completions are reaped
+//together when the ring becomes readable, queries of one address are pipelined over a few shared connections
+class UringTcpClient
+{
+public:
+    enum class Outcome
+    {
+        answered,
+        timed_out,
+        failed
+    };
+    struct Statistics
+    {
+        std::size_t submit_calls;
+        std::size_t operations_submitted;
+        std::size_t reaps;
+        std::size_t completions;
+        std::size_t connections;
+        std::size_t queries;
+        //late or garbled answers
+        std::size_t unexpected_answers;
+        std::size_t timeouts;
+        friend std::ostream& operator<<(std::ostream& out, const Statistics& statistics);
+    };
+    using Token = std::size_t;
+    //number_of_entries is the size of the submission queue, more operations wait for the next submission
+    UringTcpClient(Event::Base& event_base, std::size_t number_of_entries);
+    UringTcpClient(const UringTcpClient&) = delete;
+    ~UringTcpClient();
+    UringTcpClient& operator=(const UringTcpClient&) = delete;
+    //a new connection is opened if all connections to the address carry at least max_queries_per_connection
+    //queries and there are less than max_connections_per_address of them
+    UringTcpClient& set_max_queries_per_connection(std::size_t value) noexcept;
+    UringTcpClient& set_max_connections_per_address(std::size_t value) noexcept;
+    //the query goes out over a connection to port 53 of the address with the next submission
+    UringTcpClient& send(
+            Token token,
+            const boost::asio::ip::address& address,
+            const char* name,
+            std::uint16_t type,
+            std::chrono::nanoseconds timeout);
+    UringTcpClient& do_one_step();
+    std::size_t get_number_of_unresolved_requests() const noexcept;
+    //calls handle(Token, Outcome, const Message*) for each query finished since the previous call, the message is
+    //nullptr unless the query was answered and it is valid during the call only
+    template <typename Handler>
+    UringTcpClient& for_each_finished_request(Handler handle);
+    Event::Base& get_event_base();
+    const Statistics& get_statistics() const noexcept;
+private:
+    enum class State
+    {
+        free,
+        sent,
+        finished
+    };
+    enum class ConnectionState
+    {
+        free,
+        connecting,
+        open,
+        closing
+    };
+    //kind of operation is kept in the low bits of the user data of its entry, the connection in the others
+    enum class Operation : std::uint64_t
+    {
+        connect,
+        send,
+        receive,
+        cancel,
+        close
+    };
+    struct Slot
+    {
+        std::size_t index;
+        std::uint32_t generation;
+        State state;
+        Token token;
+        std::size_t connection;
+        std::uint16_t id;
+        //prefixed by its length
+        std::vector<std::uint8_t> query;
+        std::vector<std::uint8_t> answer;
+        Outcome outcome;
+    };
+    struct Connection
+    {
+        std::size_t index;
+        ConnectionState state;
+        int fd;
+        boost::asio::ip::address address;
+        ::sockaddr_storage peer;
+        ::socklen_t peer_length;
+        //slots waiting for their answers
+        std::vector<std::size_t> queries;
+        //queries which come while a write is in flight go out by the next one
+        std::vector<std::uint8_t> outgoing;
+        std::vector<std::uint8_t> sending;
+        std::size_t bytes_sent;
+        std::vector<std::uint8_t> incoming;
+        std::size_t bytes_received;
+        std::size_t operations_in_flight;
+        bool connect_in_flight;
+        bool send_in_flight;
+        bool receive_in_flight;
+    };
+    struct Expiration
+    {
+        TimeUnit::Uptime deadline;
+        std::size_t slot;
+        std::uint32_t generation;
+        friend bool operator>(const Expiration& lhs, const Expiration& rhs) { return rhs.deadline < lhs.deadline; }
+    };
+    void close() noexcept;
+    std::size_t acquire_slot();
+    UringTcpClient& release_slot(std::size_t index);
+    Connection& get_connection_to(const boost::asio::ip::address& address);
+    std::uint16_t make_id(const Connection& connection);
+    ::io_uring_sqe& prepare(Connection& connection, Operation operation);
+    UringTcpClient& start_send(Connection& connection);
+    UringTcpClient& start_receive(Connection& connection);
+    UringTcpClient& start_close(Connection& connection);
+    UringTcpClient& finish_close(Connection& connection);
+    UringTcpClient& fail(Connection& connection);
+    UringTcpClient& on_completion(const ::io_uring_cqe& completion);
+    UringTcpClient& on_received(Connection& connection);
+    UringTcpClient& on_answer(Connection& connection, const std::uint8_t* data, std::size_t size);
+    bool is_answer_of(const Slot& slot, const std::uint8_t* data, std::size_t size) const;
+    UringTcpClient& finish(Slot& slot, Outcome outcome);
+    UringTcpClient& submit();
+    UringTcpClient& schedule_submit();
+    UringTcpClient& expire();
+    UringTcpClient& schedule_timer();
+    static void on_ring_event(evutil_socket_t, short, void* user_data);
+    static void on_submit_event(evutil_socket_t, short, void* user_data);
+    static void on_timer_event(evutil_socket_t, short, void* user_data);
+    Event::Base& event_base_;
+    std::size_t max_queries_per_connection_;
+    std::size_t max_connections_per_address_;
+    std::deque<Slot> slots_;
+    std::vector<std::size_t> free_slots_;
+    std::vector<std::size_t> finished_slots_;
+    std::deque<Connection> connections_;
+    std::vector<std::size_t> free_connections_;
+    std::map<boost::asio::ip::address, std::vector<std::size_t>> connections_by_address_;
+    std::priority_queue<Expiration, std::vector<Expiration>, std::greater<Expiration>> expirations_;
+    std::size_t number_of_unresolved_requests_;
+    std::mt19937 random_;
+    ::event* ring_event_;
+    ::event* submit_event_;
+    bool submit_scheduled_;
+    ::event* timer_event_;
+    std::vector<::io_uring_cqe> completions_;
+    Statistics statistics_;
+    //destroyed first, operations in flight are cancelled before their buffers go away
+    Uring ring_;
+};
+
+template <typename Handler>
+UringTcpClient& UringTcpClient::for_each_finished_request(Handler handle)
+{
+    for (std::size_t position = 0; position < finished_slots_.size(); ++position)
+    {
+        const std::size_t index = finished_slots_[position];
+        Slot& slot = slots_[index];
+        try
+        {
+            if (slot.outcome == Outcome::answered)
+            {
+                const Message answer{slot.answer.data(), slot.answer.size()};
+                handle(slot.token, slot.outcome, &answer);
+            }
+            else
+            {
+                handle(slot.token, slot.outcome, static_cast<const Message*>(nullptr));
+            }
+        }
+        catch (...)
+        {
+            this->release_slot(index);
+            finished_slots_.erase(finished_slots_.begin(), finished_slots_.begin() + position + 1);
+            throw;
+        }
+        this->release_slot(index);
+    }
+    finished_slots_.clear();
+    return *this;
+}
+
+}//namespace Dns
+
+#endif//URING_TCP_CLIENT_HH_D54EA25F4C256D4D794CF8838ECA04DD
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/dns/wire.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Dns {
+
+namespace {
+
+constexpr std::size_t header_length = 12;
+constexpr std::size_t max_label_length = 63;
+constexpr std::size_t max_name_length = 255;
+
+std::uint16_t get_uint16(const std::uint8_t* data) noexcept
+{
+    return (std::uint16_t{data[0]} << 8) | data[1];
+}
+
+std::uint32_t get_uint32(const std::uint8_t* data) noexcept
+{
+    return (std::uint32_t{get_uint16(data)} << 16) | get_uint16(data + 2);
+}
+
+void append_uint16(std::vector<std::uint8_t>& packet, std::uint16_t value)
+{
+    packet.push_back(value >> 8);
+    packet.push_back(value & 0xff);
+}
+
+void append_name(std::vector<std::uint8_t>& packet, const char* name)
+{
+    const auto name_length = std::strlen(name);
+    const auto name_end = ((0 < name_length) && (name[name_length - 1] == '.')) ? name_length - 1 : name_length;
+    std::size_t wire_length = 1;
+    std::size_t label_begin = 0;
+    while (label_begin < name_end)
+    {
+        const auto dot = static_cast<const char*>(std::memchr(name + label_begin, '.', name_end - label_begin));
+        const std::size_t label_end = dot == nullptr ? name_end : dot - name;
+        const auto label_length = label_end - label_begin;
+        if ((label_length == 0) || (max_label_length < label_length))
+        {
+            throw BadDomainName{};
+        }
+        wire_length += 1 + label_length;
+        if (max_name_length < wire_length)
+        {
+            throw BadDomainName{};
+        }
+        packet.push_back(label_length);
+        packet.insert(packet.end(), name + label_begin, name + label_end);
+        label_begin = label_end + 1;
+    }
+    packet.push_back(0);
+}
+
+}//namespace Dns::{anonymous}
+
+void append_query(
+        std::vector<std::uint8_t>& packet,
+        std::uint16_t id,
+        const char* name,
+        std::uint16_t type,
+        const QueryOptions& options)
+{
+    const bool has_opt_record = 0 < options.udp_payload_size;
+    append_uint16(packet, id);
+    append_uint16(packet, options.recursion_desired ? 0x0100 : 0x0000);
+    append_uint16(packet, 1);
+    append_uint16(packet, 0);
+    append_uint16(packet, 0);
+    append_uint16(packet, has_opt_record ? 1 : 0);
+    append_name(packet, name);
+    append_uint16(packet, type);
+    append_uint16(packet, RrClass::in);
+    if (has_opt_record)
+    {
+        packet.push_back(0);//root owner
+        append_uint16(packet, RrType::opt);
+        append_uint16(packet, options.udp_payload_size);
+        packet.push_back(0);//extended rcode
+        packet.push_back(0);//version
+        append_uint16(packet, options.dnssec_ok ? 0x8000 : 0x0000);
+        append_uint16(packet, 0);//no options
+    }
+}
+
+Message::Message(const void* data, std::size_t size)
+    : data_{static_cast<const std::uint8_t*>(data)},
+      size_{size},
+      header_{},
+      answers_offset_{header_length}
+{
+    if (size_ < header_length)
+    {
+        throw MalformedMessage{};
+    }
+    header_.id = get_uint16(data_);
+    header_.flags = get_uint16(data_ + 2);
+    header_.number_of_questions = get_uint16(data_ + 4);
+    header_.number_of_answers = get_uint16(data_ + 6);
+    header_.number_of_authorities = get_uint16(data_ + 8);
+    header_.number_of_additionals = get_uint16(data_ + 10);
+    for (std::uint16_t idx = 0; idx < header_.number_of_questions; ++idx)
+    {
+        answers_offset_ = this->skip_question(answers_offset_);
+    }
+}
+
+const Header& Message::get_header() const noexcept
+{
+    return header_;
+}
+
+std::size_t Message::get_end_of_questions() const noexcept
+{
+    return answers_offset_;
+}
+
+//compression pointers end the name so they are never followed
+std::size_t Message::skip_name(std::size_t offset) const
+{
+    while (offset < size_)
+    {
+        const auto length = data_[offset];
+        switch (length & 0xc0)
+        {
+            case 0x00:
+                if (length == 0)
+                {
+                    return offset + 1;
+                }
+                offset += 1 + length;
+                break;
+            case 0xc0:
+                if (size_ < offset + 2)
+                {
+                    throw MalformedMessage{};
+                }
+                return offset + 2;
+            default:
+                throw MalformedMessage{};
+        }
+    }
+    throw MalformedMessage{};
+}
+
+std::size_t Message::skip_question(std::size_t offset) const
+{
+    offset = this->skip_name(offset) + 4;
+    if (size_ < offset)
+    {
+        throw MalformedMessage{};
+    }
+    return offset;
+}
+
+ResourceRecord Message::parse_record(std::size_t& offset) const
+{
+    const auto fixed_part = this->skip_name(offset);
+    if (size_ < fixed_part + 10)
+    {
+        throw MalformedMessage{};
+    }
+    const auto record = ResourceRecord{
+            get_uint16(data_ + fixed_part),
+            get_uint16(data_ + fixed_part + 2),
+            get_uint32(data_ + fixed_part + 4),
+            data_ + fixed_part + 10,
+            get_uint16(data_ + fixed_part + 8)};
+    offset = fixed_part + 10 + record.rdata_length;
+    if (size_ < offset)
+    {
+        throw MalformedMessage{};
+    }
+    return record;
+}
+
+Dnskey parse_dnskey(const ResourceRecord& record)
+{
+    if (record.rdata_length < 4)
+    {
+        throw MalformedMessage{};
+    }
+    return Dnskey{
+            get_uint16(record.rdata),
+            record.rdata[2],
+            record.rdata[3],
+            record.rdata + 4,
+            record.rdata_length - 4u};
+}
+
+boost::asio::ip::address parse_address(const ResourceRecord& record)
+{
+    if ((record.type == RrType::a) && (record.rdata_length == 4))
+    {
+        boost::asio::ip::address_v4::bytes_type bytes;
+        std::copy(record.rdata, record.rdata + bytes.size(), bytes.begin());
+        return boost::asio::ip::address_v4{bytes};
+    }
+    if ((record.type == RrType::aaaa) && (record.rdata_length == 16))
+    {
+        boost::asio::ip::address_v6::bytes_type bytes;
+        std::copy(record.rdata, record.rdata + bytes.size(), bytes.begin());
+        return boost::asio::ip::address_v6{bytes};
+    }
+    throw MalformedMessage{};
+}
+
+std::string base64_encode(const void* data, std::size_t size)
+{
+    static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const auto* const bytes = static_cast<const std::uint8_t*>(data);
+    std::string result;
+    result.reserve(4 * ((size + 2) / 3));
+    std::size_t idx = 0;
+    for (; idx + 3 <= size; idx += 3)
+    {
+        const std::uint32_t triple = (std::uint32_t{bytes[idx]} << 16) | (std::uint32_t{bytes[idx + 1]} << 8) | bytes[idx + 2];
+        result.push_back(alphabet[(triple >> 18) & 0x3f]);
+        result.push_back(alphabet[(triple >> 12) & 0x3f]);
+        result.push_back(alphabet[(triple >> 6) & 0x3f]);
+        result.push_back(alphabet[triple & 0x3f]);
+    }
+    const auto rest = size - idx;
+    if (0 < rest)
+    {
+        const std::uint32_t triple = (std::uint32_t{bytes[idx]} << 16) | (rest == 2 ? std::uint32_t{bytes[idx + 1]} << 8 : 0u);
+        result.push_back(alphabet[(triple >> 18) & 0x3f]);
+        result.push_back(alphabet[(triple >> 12) & 0x3f]);
+        result.push_back(rest == 2 ? alphabet[(triple >> 6) & 0x3f] : '=');
+        result.push_back('=');
+    }
+    return result;
+}
+
+}//namespace Dns
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WIRE_HH_20BED975A14824C14DB0BB55C653F66F//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define WIRE_HH_20BED975A14824C14DB0BB55C653F66F
+
+#include <boost/asio/ip/address.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+//DNS messages in wire format (RFC 1035) without intermediate dictionaries
+namespace Dns {
+
+struct Exception : std::exception { };
+
+struct MalformedMessage : Exception
+{
+    const char* what() const noexcept override { return "malformed DNS message"; }
+};
+
+struct BadDomainName : Exception
+{
+    const char* what() const noexcept override { return "bad domain name"; }
+};
+
+namespace RrType {
+
+constexpr std::uint16_t a = 1;
+constexpr std::uint16_t cname = 5;
+constexpr std::uint16_t aaaa = 28;
+constexpr std::uint16_t opt = 41;
+constexpr std::uint16_t dnskey = 48;
+constexpr std::uint16_t cdnskey = 60;
+
+}//namespace Dns::RrType
+
+namespace RrClass {
+
+constexpr std::uint16_t in = 1;
+
+}//namespace Dns::RrClass
+
+namespace Rcode {
+
+constexpr std::uint8_t no_error = 0;
+constexpr std::uint8_t servfail = 2;
+constexpr std::uint8_t nxdomain = 3;
+constexpr std::uint8_t refused = 5;
+
+}//namespace Dns::Rcode
+
+struct Header
+{
+    std::uint16_t id;
+    std::uint16_t flags;
+    std::uint16_t number_of_questions;
+    std::uint16_t number_of_answers;
+    std::uint16_t number_of_authorities;
+    std::uint16_t number_of_additionals;
+    bool is_response() const noexcept { return (flags & 0x8000) != 0; }
+    bool is_truncated() const noexcept { return (flags & 0x0200) != 0; }
+    //extended rcodes of EDNS are not taken into account
+    std::uint8_t get_rcode() const noexcept { return flags & 0x000f; }
+};
+
+struct QueryOptions
+{
+    bool recursion_desired;
+    //0 means no EDNS0 OPT record
+    std::uint16_t udp_payload_size;
+    bool dnssec_ok;
+};
+
+//appends the query to the packet; name is a domain name without escapes, the trailing dot is optional
+void append_query(
+        std::vector<std::uint8_t>& packet,
+        std::uint16_t id,
+        const char* name,
+        std::uint16_t type,
+        const QueryOptions& options);
+
+//rdata points into the message
+struct ResourceRecord
+{
+    std::uint16_t type;
+    std::uint16_t rr_class;
+    std::uint32_t ttl;
+    const std::uint8_t* rdata;
+    std::uint16_t rdata_length;
+};
+
+//view of a message, the data has to outlive it; the header is parsed by the constructor, records on demand
+//without copying owner names
+class Message
+{
+public:
+    Message(const void* data, std::size_t size);
+    const Header& get_header() const noexcept;
+    //offset of the answer section
+    std::size_t get_end_of_questions() const noexcept;
+    //calls handle(const ResourceRecord&) for every record of the answer section
+    template <typename Handler>
+    const Message& for_each_answer(Handler handle) const;
+private:
+    std::size_t skip_name(std::size_t offset) const;
+    std::size_t skip_question(std::size_t offset) const;
+    ResourceRecord parse_record(std::size_t& offset) const;
+    const std::uint8_t* data_;
+    std::size_t size_;
+    Header header_;
+    std::size_t answers_offset_;
+};
+
+template <typename Handler>
+const Message& Message::for_each_answer(Handler handle) const
+{
+    std::size_t offset = answers_offset_;
+    for (std::uint16_t idx = 0; idx < header_.number_of_answers; ++idx)
+    {
+        handle(this->parse_record(offset));
+    }
+    return *this;
+}
+
+//rdata of DNSKEY and CDNSKEY records, public_key points into the message
+struct Dnskey
+{
+    std::uint16_t flags;
+    std::uint8_t protocol;
+    std::uint8_t algorithm;
+    const std::uint8_t* public_key;
+    std::size_t public_key_length;
+};
+
+Dnskey parse_dnskey(const ResourceRecord& record);
+
+//rdata of A and AAAA records
+boost::asio::ip::address parse_address(const ResourceRecord& record);
+
+std::string base64_encode(const void* data, std::size_t size);
+
+}//namespace Dns
+
+#endif//WIRE_HH_20BED975A14824C14DB0BB55C653F66F
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/domains_to_scan.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr auto section_of_secure_domains = "[secure]";
+constexpr auto section_of_insecure_domains = "[insecure]";
+constexpr char item_delimiter = ' ';
+constexpr char line_delimiter = '\n';
+
+//the first delimiter at or after begin, end if there is none
+const char* find_delimiter(const char* begin, const char* end) noexcept
+{
+#ifdef __SSE2__
+    //16 bytes are compared with both delimiters at once
+    const __m128i items = _mm_set1_epi8(item_delimiter);
+    const __m128i lines = _mm_set1_epi8(line_delimiter);
+    for (; 16 <= (end - begin); begin += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, items), _mm_cmpeq_epi8(chunk, lines)));
+        if (found != 0)
+        {
+            return begin + __builtin_ctz(found);
+        }
+    }
+#endif
+    while ((begin != end) && (*begin != item_delimiter) && (*begin != line_delimiter))
+    {
+        ++begin;
+    }
+    return begin;
+}
+
+//sorted and without duplicates
+void make_distinct(Util::NameTable::Ids& ids)
+{
+    std::sort(begin(ids), end(ids));
+    ids.erase(std::unique(begin(ids), end(ids)), end(ids));
+}
+
+}//namespace {anonymous}
+
+DomainsToScan::DomainsToScan()
+    : section_{Section::none},
+      names_{},
+      insecure_domains_of_namserver_{},
+      nameserver_{},
+      secure_domains_{},
+      insecure_domains_{},
+      data_starts_at_new_line_{true},
+      taken_secure_domains_{},
+      taken_insecure_domains_of_nameservers_{}
+{ }
+
+DomainsToScan::DomainsToScan(const char* data, std::size_t size)
+    : DomainsToScan{}
+{
+    this->append_last_line(data, size);
+    make_distinct(secure_domains_);
+    for (auto&& nameserver_and_domains : insecure_domains_of_namserver_)
+    {
+        make_distinct(nameserver_and_domains.second);
+    }
+}
+
+const char* DomainsToScan::parse(const char* data, const char* data_end)
+{
+    const char* item_begin = data;
+    while (true)
+    {
+        const char* const item_end = find_delimiter(item_begin, data_end);
+        if (item_end == data_end)
+        {
+            return item_begin;
+        }
+        this->add_item(Item{item_begin, static_cast<std::size_t>(item_end - item_begin)}, *item_end == line_delimiter);
+        item_begin = item_end + 1;
+    }
+}
+
+std::size_t DomainsToScan::append_lines(const char* data, std::size_t size)
+{
+    return this->parse(data, data + size) - data;
+}
+
+DomainsToScan& DomainsToScan::append_last_line(const char* data, std::size_t size)
+{
+    const char* const data_end = data + size;
+    const char* const item_begin = this->parse(data, data_end);
+    this->data_finished(Item{item_begin, static_cast<std::size_t>(data_end - item_begin)});
+    return *this;
+}
+
+DomainsToScan::Domains DomainsToScan::take_secure_domains()
+{
+    Domains domains;
+    std::swap(domains, secure_domains_);
+    make_distinct(domains);
+    taken_secure_domains_.grow(names_.size());
+    domains.erase(std::remove_if(begin(domains), end(domains), [&](Util::NameTable::Id domain)
+    {
+        return !taken_secure_domains_.set(domain);
+    }), end(domains));
+    return domains;
+}
+
+DomainsToScan::DomainsOfNameservers DomainsToScan::take_insecure_domains_of_nameservers()
+{
+    DomainsOfNameservers domains_of_nameservers;
+    std::swap(domains_of_nameservers, insecure_domains_of_namserver_);
+    for (auto nameserver_itr = domains_of_nameservers.begin(); nameserver_itr != domains_of_nameservers.end();)
+    {
+        Domains& domains = nameserver_itr->second;
+        make_distinct(domains);
+        Domains& taken = taken_insecure_domains_of_nameservers_[nameserver_itr->first];
+        Domains not_taken;
+        std::set_difference(begin(domains), end(domains), begin(taken), end(taken), std::back_inserter(not_taken));
+        if (not_taken.empty())
+        {
+            nameserver_itr = domains_of_nameservers.erase(nameserver_itr);
+            continue;
+        }
+        Domains all_taken;
+        all_taken.reserve(taken.size() + not_taken.size());
+        std::merge(begin(taken), end(taken), begin(not_taken), end(not_taken), std::back_inserter(all_taken));
+        taken.swap(all_taken);
+        domains.swap(not_taken);
+        ++nameserver_itr;
+    }
+    return domains_of_nameservers;
+}
+
+std::size_t DomainsToScan::get_number_of_nameservers() const
+{
+    return insecure_domains_of_namserver_.size();
+}
+
+std::size_t DomainsToScan::get_number_of_domains() const
+{
+    std::size_t sum_count = secure_domains_.size();
+    for (DomainsOfNameservers::const_iterator itr = insecure_domains_of_namserver_.begin();
+         itr != insecure_domains_of_namserver_.end(); ++itr)
+    {
+        sum_count += itr->second.size();
+    }
+    return sum_count;
+}
+
+std::size_t DomainsToScan::get_number_of_secure_domains() const
+{
+    return secure_domains_.size();
+}
+
+DomainsToScan& DomainsToScan::add_item(Item item, bool line_end_reached)
+{
+    const bool check_section_flag = data_starts_at_new_line_ && line_end_reached;
+    if (check_section_flag)
+    {
+        const bool section_of_secure_domains_reached = item == section_of_secure_domains;
+        if (section_of_secure_domains_reached)
+        {
+            section_ = Section::secure;
+            nameserver_ = boost::none;
+            insecure_domains_.clear();
+            data_starts_at_new_line_ = true;
+            return *this;
+        }
+        const bool section_of_insecure_domains_reached = item == section_of_insecure_domains;
+        if (section_of_insecure_domains_reached)
+        {
+            section_ = Section::insecure;
+            nameserver_ = boost::none;
+            insecure_domains_.clear();
+            data_starts_at_new_line_ = true;
+            return *this;
+        }
+    }
+    switch (section_)
+    {
+        case Section::secure:
+            if (!item.empty())
+            {
+                secure_domains_.push_back(names_.intern(item.data(), item.size()));
+            }
+            else
+            {
+                std::cerr << "secure section contains an empty fqdn of domain" << std::endl;
+            }
+            break;
+        case Section::insecure:
+        {
+            const bool item_is_nameserver = data_starts_at_new_line_;
+            if (item_is_nameserver)
+            {
+                if (item.empty())
+                {
+                    throw std::runtime_error("insecure section contains an empty hostname of nameserver");
+                }
+                nameserver_ = names_.intern(item.data(), item.size());
+                data_starts_at_new_line_ = false;
+                insecure_domains_.clear();
+            }
+            else
+            {
+                if (!item.empty())
+                {
+                    insecure_domains_.push_back(names_.intern(item.data(), item.size()));
+                }
+                else
+                {
+                    std::cerr << "insecure section contains an empty fqdn of domain" << std::endl;
+                }
+            }
+            break;
+        }
+        case Section::none:
+            throw std::runtime_error("no section specified yet");
+    }
+    if (line_end_reached)
+    {
+        this->add_domains_of_nameserver();
+        data_starts_at_new_line_ = true;
+    }
+    return *this;
+}
+
+void DomainsToScan::data_finished(Item item)
+{
+    const bool check_section_flag = data_starts_at_new_line_;
+    if (check_section_flag)
+    {
+        const bool section_of_secure_domains_reached = item == section_of_secure_domains;
+        if (section_of_secure_domains_reached)
+        {
+            return;
+        }
+        const bool section_of_insecure_domains_reached = item == section_of_insecure_domains;
+        if (section_of_insecure_domains_reached)
+        {
+            return;
+        }
+    }
+    switch (section_)
+    {
+        case Section::secure:
+            if (!item.empty())
+            {
+                secure_domains_.push_back(names_.intern(item.data(), item.size()));
+            }
+            return;
+        case Section::insecure:
+        {
+            const bool item_is_nameserver = data_starts_at_new_line_;
+            if (!item_is_nameserver)
+            {
+                if (!item.empty())
+                {
+                    insecure_domains_.push_back(names_.intern(item.data(), item.size()));
+                }
+                this->add_domains_of_nameserver();
+            }
+            return;
+        }
+        case Section::none:
+            throw std::runtime_error("no section specified yet");
+    }
+}
+
+DomainsToScan& DomainsToScan::add_domains_of_nameserver()
+{
+    const bool nameserver_data_available =
+            (section_ == Section::insecure) && (nameserver_ != boost::none) && !insecure_domains_.empty();
+    if (nameserver_data_available)
+    {
+        auto& domains = insecure_domains_of_namserver_[*nameserver_];
+        domains.insert(end(domains), begin(insecure_domains_), end(insecure_domains_));
+    }
+    nameserver_ = boost::none;
+    insecure_domains_.clear();
+    return *this;
+}
+
+const Util::NameTable& DomainsToScan::get_names()const
+{
+    return names_;
+}
+
+const DomainsToScan::Domains& DomainsToScan::get_secure_domains()const
+{
+    return secure_domains_;
+}
+
+const DomainsToScan::DomainsOfNameservers& DomainsToScan::get_insecure_domains_of_nameservers()const
+{
+    return insecure_domains_of_namserver_;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DOMAINS_TO_SCAN_HH_F257F5893C453F22570099BDB1017135//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define DOMAINS_TO_SCAN_HH_F257F5893C453F22570099BDB1017135
+
+#include "src/util/bitmap.hh"
+#include "src/util/name_table.hh"
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <map>
+
+//names are interned in one table and all containers hold their ids, names differing in case or a trailing dot
+//only are one name
+class DomainsToScan
+{
+public:
+    using Domains = Util::NameTable::Ids;
+    //sorted distinct ids of domains by ids of their nameservers
+    using DomainsOfNameservers = std::map<Util::NameTable::Id, Util::NameTable::Ids>;
+    //nothing parsed yet, data are given by append_lines() and append_last_line() as they come
+    DomainsToScan();
+    //the whole input is parsed at once, items are scanned in place and interned without temporary copies
+    DomainsToScan(const char* data, std::size_t size);
+    DomainsToScan(DomainsToScan&&) = default;
+    ~DomainsToScan() = default;
+    std::size_t get_number_of_nameservers() const;
+    std::size_t get_number_of_domains() const;
+    std::size_t get_number_of_secure_domains() const;
+    const Util::NameTable& get_names() const;
+    const Domains& get_secure_domains() const;
+    const DomainsOfNameservers& get_insecure_domains_of_nameservers() const;
+    //returns the number of bytes parsed, an unfinished item is left for the next call together with following data
+    std::size_t append_lines(const char* data, std::size_t size);
+    //the rest of data at the end of input
+    DomainsToScan& append_last_line(const char* data, std::size_t size);
+    //domains parsed since the previous call and not taken by any previous call, their names stay in the table
+    Domains take_secure_domains();
+    DomainsOfNameservers take_insecure_domains_of_nameservers();
+private:
+    using Item = boost::string_ref;
+    //returns the beginning of the last item which is not followed by a delimiter
+    const char* parse(const char* data, const char* data_end);
+    DomainsToScan& add_item(Item item, bool line_end_reached);
+    void data_finished(Item item);
+    //domains of a line are joined with domains of the same nameserver from other lines
+    DomainsToScan& add_domains_of_nameserver();
+    enum class Section
+    {
+        none,
+        secure,
+        insecure,
+    } section_;
+    Util::NameTable names_;
+    DomainsOfNameservers insecure_domains_of_namserver_;
+    boost::optional<Util::NameTable::Id> nameserver_;
+    Domains secure_domains_;
+    Domains insecure_domains_;
+    bool data_starts_at_new_line_;
+    //ids of secure domains taken already
+    Util::Bitmap taken_secure_domains_;
+    //a domain comes with each of its nameservers, so insecure domains are taken per nameserver
+    DomainsOfNameservers taken_insecure_domains_of_nameservers_;
+};
+
+#endif//DOMAINS_TO_SCAN_HH_F257F5893C453F22570099BDB1017135
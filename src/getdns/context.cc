@@ -77,6 +77,11 @@ Context& Context::set_dns_transport_list(std::size_t count, ::getdns_transport_l
     return *this;
 }
 
+Context& Context::set_dns_transport_list(std::vector<::getdns_transport_list_t> transport_list)
+{
+    return this->set_dns_transport_list(transport_list.size(), transport_list.data());
+}
+
 Context& Context::set_upstream_recursive_servers(const std::list<boost::asio::ip::address>& servers)
 {
     if (!servers.empty())
@@ -110,6 +115,25 @@ Context& Context::set_upstream_recursive_servers(const std::list<boost::asio::ip
     return *this;
 }
 
+std::list<boost::asio::ip::address> Context::get_upstream_recursive_servers()
+{
+    const Data::List servers{[&](::getdns_list** list)
+    {
+        MUST_BE_GOOD(::getdns_context_get_upstream_recursive_servers(ptr_, list));
+    }};
+    std::list<boost::asio::ip::address> result;
+    for (std::size_t idx = 0; idx < servers.length(); ++idx)
+    {
+        //one server may be listed for more transports
+        const auto address = (*servers).get<Data::DictRef>(idx).get<Data::BinDataRef>("address_data").as<boost::asio::ip::address>();
+        if (std::find(result.begin(), result.end(), address) == result.end())
+        {
+            result.push_back(address);
+        }
+    }
+    return result;
+}
+
 Context& Context::set_follow_redirects(bool yes)
 {
     MUST_BE_GOOD(::getdns_context_set_follow_redirects(ptr_, yes ? ::GETDNS_REDIRECTS_FOLLOW : ::GETDNS_REDIRECTS_DO_NOT_FOLLOW));
@@ -122,6 +146,12 @@ Context& Context::set_timeout(Timeout value)
     return *this;
 }
 
+Context& Context::set_idle_timeout(Timeout value)
+{
+    MUST_BE_GOOD(::getdns_context_set_idle_timeout(ptr_, value.count()));
+    return *this;
+}
+
 Context& Context::set_dnssec_trust_anchors(Data::TrustAnchorList anchors)
 {
     MUST_BE_GOOD(::getdns_context_set_dnssec_trust_anchors(ptr_, anchors));
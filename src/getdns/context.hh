@@ -35,6 +35,7 @@
 #include <cstdint>
 #include <list>
 #include <string>
+#include <vector>
 
 
 namespace GetDns {
@@ -58,10 +59,13 @@ public:
     ~Context();
     template <typename ...Ts>
     Context& set_dns_transport_list(TransportsList<Ts...> transport_list);
+    Context& set_dns_transport_list(std::vector<::getdns_transport_list_t> transport_list);
     Context& set_upstream_recursive_servers(const std::list<boost::asio::ip::address>& servers);
+    std::list<boost::asio::ip::address> get_upstream_recursive_servers();
     Context& set_follow_redirects(bool yes);
     using Timeout = TimeUnit::Milliseconds<struct TimeoutTag_>;
     Context& set_timeout(Timeout value);
+    Context& set_idle_timeout(Timeout value);
     Context& set_dnssec_trust_anchors(Data::TrustAnchorList anchors);
     Context& set_libevent_base(Event::Base& event_base);
     operator ::getdns_context*();
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/getdns/context_pool.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+
+namespace GetDns {
+
+namespace {
+
+bool less(const TrustAnchor& lhs, const TrustAnchor& rhs)
+{
+    return std::tie(lhs.zone, lhs.flags, lhs.protocol, lhs.algorithm, lhs.public_key) <
+           std::tie(rhs.zone, rhs.flags, rhs.protocol, rhs.algorithm, rhs.public_key);
+}
+
+}//namespace GetDns::{anonymous}
+
+bool operator<(const ContextPool::Key& lhs, const ContextPool::Key& rhs)
+{
+    if (lhs.upstreams != rhs.upstreams)
+    {
+        return lhs.upstreams < rhs.upstreams;
+    }
+    if (lhs.transports != rhs.transports)
+    {
+        return lhs.transports < rhs.transports;
+    }
+    if (lhs.timeout != rhs.timeout)
+    {
+        return lhs.timeout < rhs.timeout;
+    }
+    if (lhs.idle_timeout != rhs.idle_timeout)
+    {
+        return lhs.idle_timeout < rhs.idle_timeout;
+    }
+    return std::lexicographical_compare(
+            begin(lhs.trust_anchors), end(lhs.trust_anchors),
+            begin(rhs.trust_anchors), end(rhs.trust_anchors),
+            less);
+}
+
+ContextPool::Lease::Lease() noexcept
+    : pool_{nullptr},
+      entry_{}
+{ }
+
+ContextPool::Lease::Lease(ContextPool& pool, Entries::iterator entry) noexcept
+    : pool_{&pool},
+      entry_{entry}
+{ }
+
+ContextPool::Lease::Lease(Lease&& src) noexcept
+    : pool_{nullptr},
+      entry_{}
+{
+    std::swap(src.pool_, pool_);
+    std::swap(src.entry_, entry_);
+}
+
+ContextPool::Lease::~Lease()
+{
+    if (pool_ != nullptr)
+    {
+        pool_->give_back(entry_);
+        pool_ = nullptr;
+    }
+}
+
+ContextPool::Lease& ContextPool::Lease::operator=(Lease&& src) noexcept
+{
+    std::swap(src.pool_, pool_);
+    std::swap(src.entry_, entry_);
+    return *this;
+}
+
+ContextPool::Lease::operator ::getdns_context*()
+{
+    if (pool_ == nullptr)
+    {
+        throw std::logic_error("no context leased");
+    }
+    return entry_->second.context;
+}
+
+ContextPool::Entry::Entry(Context context)
+    : context{std::move(context)},
+      number_of_borrowers{0},
+      idle_since{},
+      is_idle{false},
+      idle_position{}
+{ }
+
+ContextPool::ContextPool(Event::Base& event_base, std::size_t max_number_of_idle_contexts)
+    : event_base_{event_base},
+      max_number_of_idle_contexts_{max_number_of_idle_contexts},
+      max_leases_per_context_{std::numeric_limits<std::size_t>::max()},
+      max_contexts_per_key_{1},
+      entries_{},
+      idle_entries_{},
+      statistics_{0, 0, 0, 0}
+{ }
+
+ContextPool::~ContextPool()
+{
+    const auto number_of_borrowed_contexts = entries_.size() - idle_entries_.size();
+    if (0 < number_of_borrowed_contexts)
+    {
+        std::cerr << "context pool destroyed with " << number_of_borrowed_contexts << " borrowed contexts" << std::endl;
+    }
+}
+
+ContextPool& ContextPool::set_max_leases_per_context(std::size_t value) noexcept
+{
+    max_leases_per_context_ = 0 < value ? value : 1;
+    return *this;
+}
+
+ContextPool& ContextPool::set_max_contexts_per_key(std::size_t value) noexcept
+{
+    max_contexts_per_key_ = 0 < value ? value : 1;
+    return *this;
+}
+
+ContextPool::Lease ContextPool::borrow(const Key& key)
+{
+    const bool sharing_enabled = 0 < max_number_of_idle_contexts_;
+    const auto entry = [&]()
+    {
+        if (sharing_enabled)
+        {
+            const auto range = entries_.equal_range(key);
+            if (range.first != range.second)
+            {
+                const auto least_loaded = std::min_element(range.first, range.second, [](auto&& lhs, auto&& rhs)
+                {
+                    return lhs.second.number_of_borrowers < rhs.second.number_of_borrowers;
+                });
+                const bool is_overloaded = max_leases_per_context_ <= least_loaded->second.number_of_borrowers;
+                const bool limit_reached = max_contexts_per_key_ <= static_cast<std::size_t>(std::distance(range.first, range.second));
+                if (!is_overloaded || limit_reached)
+                {
+                    return least_loaded;
+                }
+            }
+        }
+        return this->make_entry(key);
+    }();
+    if (entry->second.number_of_borrowers == 0)
+    {
+        const bool is_new = !entry->second.is_idle;
+        const bool connection_closed = is_new ||
+                                       (key.idle_timeout.get() <= (TimeUnit::get_uptime().get() - entry->second.idle_since.get()));
+        if (connection_closed)
+        {
+            ++statistics_.sessions;
+        }
+    }
+    if (entry->second.is_idle)
+    {
+        idle_entries_.erase(entry->second.idle_position);
+        entry->second.is_idle = false;
+    }
+    ++(entry->second.number_of_borrowers);
+    ++statistics_.leases;
+    return Lease{*this, entry};
+}
+
+const ContextPool::Statistics& ContextPool::get_statistics() const noexcept
+{
+    return statistics_;
+}
+
+ContextPool& ContextPool::give_back(Entries::iterator entry)
+{
+    --(entry->second.number_of_borrowers);
+    if (0 < entry->second.number_of_borrowers)
+    {
+        return *this;
+    }
+    const bool keep_for_later_use = 0 < max_number_of_idle_contexts_;
+    if (keep_for_later_use)
+    {
+        entry->second.idle_position = idle_entries_.insert(idle_entries_.end(), entry);
+        entry->second.idle_since = TimeUnit::get_uptime();
+        entry->second.is_idle = true;
+        if (idle_entries_.size() <= max_number_of_idle_contexts_)
+        {
+            return *this;
+        }
+        entry = idle_entries_.front();
+        idle_entries_.pop_front();
+    }
+    entries_.erase(entry);
+    ++statistics_.contexts_destroyed;
+    return *this;
+}
+
+ContextPool::Entries::iterator ContextPool::make_entry(const Key& key)
+{
+    auto context = Context{Context::InitialSettings::FromOs{}};
+    context.set_timeout(key.timeout)
+           .set_dns_transport_list(key.transports);
+    if (Context::Timeout::zero() < key.idle_timeout)
+    {
+        context.set_idle_timeout(key.idle_timeout);
+    }
+    if (!key.trust_anchors.empty())
+    {
+        context.set_dnssec_trust_anchors(Data::TrustAnchorList{key.trust_anchors});
+    }
+    if (key.upstreams != boost::none)
+    {
+        context.set_upstream_recursive_servers(*key.upstreams);
+    }
+    context.set_libevent_base(event_base_);
+    const auto entry = entries_.emplace(key, Entry{std::move(context)});
+    ++statistics_.contexts_created;
+    return entry;
+}
+
+std::ostream& operator<<(std::ostream& out, const ContextPool::Statistics& statistics)
+{
+    return out << statistics.contexts_created << " contexts created, "
+                  "reused " << (statistics.leases - statistics.contexts_created) << " times";
+}
+
+}//namespace GetDns
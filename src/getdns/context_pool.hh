@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTEXT_POOL_HH_19211501DC045C1127548D1CB08A7094//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define CONTEXT_POOL_HH_19211501DC045C1127548D1CB08A7094
+
+#include "src/getdns/context.hh"
+#include "src/getdns/data.hh"
+
+#include "src/event/base.hh"
+
+#include "src/time_unit.hh"
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/optional.hpp>
+
+#include <getdns/getdns.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <list>
+#include <map>
+#include <vector>
+
+
+namespace GetDns {
+
+// Contexts are expensive to set up (OS resolver configuration, sockets, trust anchors) and one context
+// is able to serve many concurrent transactions, so queries with equal settings share contexts
+// borrowed from this pool. Contexts nobody borrows are kept for later use up to the given limit.
+class ContextPool
+{
+public:
+    struct Key
+    {
+        // none: keep resolution type configured by OS; otherwise stub resolution using these servers
+        boost::optional<std::list<boost::asio::ip::address>> upstreams;
+        std::vector<::getdns_transport_list_t> transports;
+        Context::Timeout timeout;
+        // how long an unused TCP connection stays open (with EDNS TCP keepalive) for following queries
+        Context::Timeout idle_timeout{Context::Timeout::zero()};
+        std::list<TrustAnchor> trust_anchors;
+        friend bool operator<(const Key& lhs, const Key& rhs);
+    };
+private:
+    struct Entry;
+    using Entries = std::multimap<Key, Entry>;
+public:
+    class Lease
+    {
+    public:
+        Lease() noexcept;
+        Lease(Lease&& src) noexcept;
+        Lease(const Lease&) = delete;
+        ~Lease();
+        Lease& operator=(Lease&& src) noexcept;
+        Lease& operator=(const Lease&) = delete;
+        operator ::getdns_context*();
+    private:
+        Lease(ContextPool& pool, Entries::iterator entry) noexcept;
+        ContextPool* pool_;
+        Entries::iterator entry_;
+        friend class ContextPool;
+    };
+    struct Statistics
+    {
+        std::size_t contexts_created;
+        std::size_t contexts_destroyed;
+        std::size_t leases;
+        // estimated number of connections, a context idle for longer than idle_timeout closed its connection
+        std::size_t sessions;
+        friend std::ostream& operator<<(std::ostream& out, const Statistics& statistics);
+    };
+    // max_number_of_idle_contexts == 0 disables sharing, every lease gets its own context
+    ContextPool(Event::Base& event_base, std::size_t max_number_of_idle_contexts);
+    ContextPool(const ContextPool&) = delete;
+    ~ContextPool();
+    ContextPool& operator=(const ContextPool&) = delete;
+    // a new context with equal key is created if all existing ones serve at least max_leases_per_context
+    // queries and there are less than max_contexts_per_key of them
+    ContextPool& set_max_leases_per_context(std::size_t value) noexcept;
+    ContextPool& set_max_contexts_per_key(std::size_t value) noexcept;
+    Lease borrow(const Key& key);
+    const Statistics& get_statistics() const noexcept;
+private:
+    using IdleEntries = std::list<Entries::iterator>;
+    struct Entry
+    {
+        explicit Entry(Context context);
+        Context context;
+        std::size_t number_of_borrowers;
+        TimeUnit::Uptime idle_since;
+        bool is_idle;
+        IdleEntries::iterator idle_position;
+    };
+    ContextPool& give_back(Entries::iterator entry);
+    Entries::iterator make_entry(const Key& key);
+    Event::Base& event_base_;
+    std::size_t max_number_of_idle_contexts_;
+    std::size_t max_leases_per_context_;
+    std::size_t max_contexts_per_key_;
+    Entries entries_;
+    IdleEntries idle_entries_;
+    Statistics statistics_;
+};
+
+}//namespace GetDns
+
+#endif//CONTEXT_POOL_HH_19211501DC045C1127548D1CB08A7094
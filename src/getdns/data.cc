@@ -596,4 +596,50 @@ std::string base64_encode(const Data::BinDataRef& raw_data)
     return std::move(base64_encoded_text).str();
 }
 
+namespace {
+
+//false if there is no reply (e.g. all upstreams timed out)
+template <typename Predicate>
+bool all_replies_have(const Data::DictRef& response, Predicate is_expected_rcode)
+{
+    try
+    {
+        bool has_replies = false;
+        bool all_expected = true;
+        for_each_reply(response, [&](const Dns::Message& reply)
+        {
+            has_replies = true;
+            all_expected = all_expected && is_expected_rcode(reply.get_header().get_rcode());
+        });
+        return has_replies && all_expected;
+    }
+    catch (const NoSuchDictName&)
+    {
+        return false;
+    }
+    catch (const Dns::MalformedMessage&)
+    {
+        return false;
+    }
+}
+
+}//namespace GetDns::{anonymous}
+
+bool is_transient_failure(const Data::DictRef& response)
+{
+    if (static_cast<std::uint32_t>(response.get<Data::IntegerRef>("status")) == GETDNS_RESPSTATUS_ALL_TIMEOUT)
+    {
+        return true;
+    }
+    return all_replies_have(response, [](std::uint32_t rcode) { return rcode == GETDNS_RCODE_SERVFAIL; });
+}
+
+bool is_refusal(const Data::DictRef& response)
+{
+    return all_replies_have(response, [](std::uint32_t rcode)
+    {
+        return (rcode == GETDNS_RCODE_REFUSED) || (rcode == GETDNS_RCODE_SERVFAIL);
+    });
+}
+
 }//namespace GetDns
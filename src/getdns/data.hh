@@ -22,6 +22,8 @@
 
 #include "src/getdns/exception.hh"
 
+#include "src/dns/wire.hh"
+
 #include <boost/asio/ip/address.hpp>
 
 #include <getdns/getdns.h>
@@ -265,6 +267,26 @@ T get_as(const Data::BinDataRef&);
 Data::BinData base64_decode(const std::string& base64_encoded_text);
 std::string base64_encode(const Data::BinDataRef& raw_data);
 
+//no definitive answer came (all upstreams timed out or answered SERVFAIL), unlike e.g. NXDOMAIN or REFUSED
+//the query may succeed if it is asked again
+bool is_transient_failure(const Data::DictRef& response);
+
+//all replies are REFUSED or SERVFAIL, the server does not serve the zone (or does not want to)
+bool is_refusal(const Data::DictRef& response);
+
+//calls handle(const Dns::Message&) for every reply in wire format, records are read directly from the packets
+//instead of walking the "replies_tree" dictionaries
+template <typename Handler>
+void for_each_reply(const Data::DictRef& response, Handler handle)
+{
+    const auto replies = response.get<Data::ListRef>("replies_full");
+    for (std::size_t reply_idx = 0; reply_idx < replies.length(); ++reply_idx)
+    {
+        const auto reply = replies.get<Data::BinDataRef>(reply_idx);
+        handle(Dns::Message{reply.data(), reply.size()});
+    }
+}
+
 struct TrustAnchor
 {
     std::string zone;
@@ -23,16 +23,19 @@
 #include "src/event/base.hh"
 
 #include "src/getdns/context.hh"
+#include "src/getdns/context_pool.hh"
 #include "src/getdns/data.hh"
 
 #include <boost/optional.hpp>
 
 #include <getdns/getdns.h>
 
+#include <cstddef>
+#include <deque>
 #include <iostream>
-#include <list>
-#include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 namespace GetDns {
 
@@ -40,41 +43,87 @@ template <typename Query>
 class Solver
 {
 public:
-    explicit Solver() noexcept;
+    explicit Solver(std::size_t max_number_of_idle_contexts);
+    // solvers sharing one event base are driven by do_one_step() of any of them
+    Solver(Event::Base& event_base, std::size_t max_number_of_idle_contexts);
     ~Solver() = default;
 
-    using ListOfQueries = std::list<Query>;
-
     ::getdns_transaction_t add_request(Query query);
     Solver& do_one_step();
     std::size_t get_number_of_unresolved_requests() const noexcept;
-    ListOfQueries pop_finished_requests();
+    // calls handle(Query&) for each query finished since the previous call, the query is dropped afterwards;
+    // handle may add new requests
+    template <typename Handler>
+    Solver& for_each_finished_request(Handler handle);
     Event::Base& get_event_base();
+    ContextPool& get_context_pool();
 private:
-    using QueryByTransactionId = std::map<::getdns_transaction_t, Query>;
+    // queries live in slots which are reused once their query is handed out, user_data of a transaction
+    // points directly to its slot so neither a lookup nor an allocation is needed on completion
+    struct Slot
+    {
+        Solver* solver;
+        std::size_t index;
+        boost::optional<Query> query;
+    };
+    using Slots = std::deque<Slot>;// references stay valid when growing
+    using Indices = std::vector<std::size_t>;
 
+    Slot& acquire_slot();
+    Solver& release_slot(Slot& slot);
     static void getdns_callback_function(
             ::getdns_context*,
             ::getdns_callback_type_t,
             ::getdns_dict*,
             void*,
             ::getdns_transaction_t) noexcept;
-    Event::Base event_base_;
-    QueryByTransactionId active_requests_;
-    ListOfQueries finished_requests_;
+    std::unique_ptr<Event::Base> own_event_base_;
+    Event::Base& event_base_;
+    ContextPool context_pool_;
+    Slots slots_;
+    Indices free_slots_;
+    Indices finished_slots_;
+    std::size_t number_of_active_requests_;
 };
 
 template <typename Query>
-Solver<Query>::Solver() noexcept
-    : event_base_{}
+Solver<Query>::Solver(std::size_t max_number_of_idle_contexts)
+    : own_event_base_{new Event::Base{}},
+      event_base_{*own_event_base_},
+      context_pool_{event_base_, max_number_of_idle_contexts},
+      slots_{},
+      free_slots_{},
+      finished_slots_{},
+      number_of_active_requests_{0}
+{ }
+
+template <typename Query>
+Solver<Query>::Solver(Event::Base& event_base, std::size_t max_number_of_idle_contexts)
+    : own_event_base_{},
+      event_base_{event_base},
+      context_pool_{event_base_, max_number_of_idle_contexts},
+      slots_{},
+      free_slots_{},
+      finished_slots_{},
+      number_of_active_requests_{0}
 { }
 
 template <typename Query>
 ::getdns_transaction_t Solver<Query>::add_request(Query query)
 {
-    const auto transaction_id = query.start_transaction(event_base_, getdns_callback_function, this);
-    active_requests_.insert(std::make_pair(transaction_id, std::move(query)));
-    return transaction_id;
+    Slot& slot = this->acquire_slot();
+    slot.query = std::move(query);
+    ++number_of_active_requests_;
+    try
+    {
+        return slot.query->start_transaction(event_base_, getdns_callback_function, &slot);
+    }
+    catch (...)
+    {
+        --number_of_active_requests_;
+        this->release_slot(slot);
+        throw;
+    }
 }
 
 template <typename Query>
@@ -96,15 +145,31 @@ Solver<Query>& Solver<Query>::do_one_step()
 template <typename Query>
 std::size_t Solver<Query>::get_number_of_unresolved_requests() const noexcept
 {
-    return active_requests_.size();
+    return number_of_active_requests_;
 }
 
 template <typename Query>
-typename Solver<Query>::ListOfQueries Solver<Query>::pop_finished_requests()
+template <typename Handler>
+Solver<Query>& Solver<Query>::for_each_finished_request(Handler handle)
 {
-    ListOfQueries result;
-    std::swap(result, finished_requests_);
-    return result;
+    // requests added by handle may finish immediately and extend finished_slots_
+    for (std::size_t position = 0; position < finished_slots_.size(); ++position)
+    {
+        Slot& slot = slots_[finished_slots_[position]];
+        try
+        {
+            handle(*slot.query);
+        }
+        catch (...)
+        {
+            this->release_slot(slot);
+            finished_slots_.erase(finished_slots_.begin(), finished_slots_.begin() + position + 1);
+            throw;
+        }
+        this->release_slot(slot);
+    }
+    finished_slots_.clear();
+    return *this;
 }
 
 template <typename Query>
@@ -113,6 +178,33 @@ Event::Base& Solver<Query>::get_event_base()
     return event_base_;
 }
 
+template <typename Query>
+ContextPool& Solver<Query>::get_context_pool()
+{
+    return context_pool_;
+}
+
+template <typename Query>
+typename Solver<Query>::Slot& Solver<Query>::acquire_slot()
+{
+    if (free_slots_.empty())
+    {
+        slots_.push_back(Slot{this, slots_.size(), boost::none});
+        return slots_.back();
+    }
+    Slot& slot = slots_[free_slots_.back()];
+    free_slots_.pop_back();
+    return slot;
+}
+
+template <typename Query>
+Solver<Query>& Solver<Query>::release_slot(Slot& slot)
+{
+    slot.query = boost::none;
+    free_slots_.push_back(slot.index);
+    return *this;
+}
+
 template <typename Query>
 void Solver<Query>::getdns_callback_function(
         ::getdns_context*,
@@ -124,9 +216,8 @@ void Solver<Query>::getdns_callback_function(
     try
     {
         Data::Dict answer{response};
-        Solver* const solver_instance_ptr = reinterpret_cast<Solver*>(user_data_ptr);
-        const auto request_itr = solver_instance_ptr->active_requests_.find(transaction_id);
-        if (request_itr == solver_instance_ptr->active_requests_.end())
+        Slot* const slot_ptr = reinterpret_cast<Slot*>(user_data_ptr);
+        if ((slot_ptr == nullptr) || (slot_ptr->query == boost::none))
         {
             std::cerr << "transaction " << transaction_id << " not found" << std::endl;
             return;
@@ -155,7 +246,7 @@ void Solver<Query>::getdns_callback_function(
                     const char* what() const noexcept override { return "unexpected callback type"; }
                 };
                 throw UnexpectedCallbackType{};
-            }(callback_type, response, request_itr->second, transaction_id);
+            }(callback_type, response, *slot_ptr->query, transaction_id);
         }
         catch (const std::exception& e)
         {
@@ -165,8 +256,9 @@ void Solver<Query>::getdns_callback_function(
         {
             std::cerr << "unexpected exception caught" << std::endl;
         }
-        solver_instance_ptr->finished_requests_.push_back(std::move(request_itr->second));
-        solver_instance_ptr->active_requests_.erase(request_itr);
+        Solver* const solver_instance_ptr = slot_ptr->solver;
+        --(solver_instance_ptr->number_of_active_requests_);
+        solver_instance_ptr->finished_slots_.push_back(slot_ptr->index);
     }
     catch (const std::exception& e)
     {
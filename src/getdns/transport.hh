@@ -25,6 +25,7 @@
 #include <getdns/getdns.h>
 
 #include <array>
+#include <vector>
 
 
 namespace GetDns {
@@ -57,6 +58,12 @@ decltype(auto) make_transports_list(TransportsList<TransportProtocol::Item<Ts>..
     return std::array<::getdns_transport_list_t, sizeof...(Ts)>{to_transport_protocol<TransportProtocol::Item<Ts>>()...};
 }
 
+template <typename ...Ts>
+std::vector<::getdns_transport_list_t> make_transports_vector(TransportsList<TransportProtocol::Item<Ts>...>)
+{
+    return std::vector<::getdns_transport_list_t>{to_transport_protocol<TransportProtocol::Item<Ts>>()...};
+}
+
 }//namespace GetDns
 
 #endif//TRANSPORT_HH_7C85D5BE63ECB56E0176E62068801E57
@@ -19,83 +19,91 @@
 
 #include "src/hostname_resolver.hh"
 
+#include "src/dns/udp_multiplexer.hh"
+#include "src/dns/wire.hh"
+
+#include "src/event/base.hh"
+
 #include "src/getdns/context.hh"
-#include "src/getdns/data.hh"
-#include "src/getdns/exception.hh"
-#include "src/getdns/extensions_set.hh"
-#include "src/getdns/solver.hh"
 
 #include "src/time_unit.hh"
 
-#include "src/util/fork.hh"
+#include "src/util/bitmap.hh"
+#include "src/util/concurrency_window.hh"
+#include "src/util/ip_address.hh"
+#include "src/util/name_table.hh"
+#include "src/util/pacer.hh"
 #include "src/util/pipe.hh"
+#include "src/util/record.hh"
+#include "src/util/retry_queue.hh"
+#include "src/util/throughput.hh"
+#include "src/util/token_bucket.hh"
+#include "src/util/workers.hh"
+
+#include <unistd.h>
 
-#include <cstring>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
 
 namespace {
 
-constexpr int max_number_of_unresolved_queries = 200;
+constexpr auto window_settings = Util::ConcurrencyWindow::Settings{200, 0, 0.1, 4.0};
+//A and AAAA
+constexpr std::size_t queries_per_hostname = 2;
+constexpr std::size_t datagrams_per_batch = 64;
+//no fragmentation of answers (DNS flag day 2020)
+constexpr std::uint16_t udp_payload_size = 1232;
+
+using Hostnames = Util::NameTable::Ids;
+
+//records sent by the child process: resolved (index, number of addresses, addresses), unresolved_ip (index);
+//all addresses of a hostname come in one record so a hostname is either done or not
+enum class RecordType : std::uint8_t
+{
+    resolved,
+    unresolved_ip
+};
 
+//A and AAAA queries of one hostname, the hostname is finished when both of them are
 class Query
 {
 public:
-    Query(const std::string& hostname,
-          GetDns::Context context)
-        : hostname_{[&]() { char* const str = new char[hostname.length() + 1]; std::memcpy(str, hostname.c_str(), hostname.length() + 1); return str; }()},
-          context_{std::move(context)},
-          extensions_{make_extensions(GetDns::ExtensionsSet<GetDns::Extension::ReturnBothV4AndV6>{})},
-          status_{Status::none},
-          result_{}
+    Query(std::size_t index, std::size_t attempt)
+        : index_{index},
+          sent_at_{TimeUnit::get_uptime()},
+          result_{},
+          attempt_{attempt},
+          number_of_pending_queries_{queries_per_hostname},
+          number_of_answers_{0},
+          number_of_servfails_{0},
+          number_of_timeouts_{0}
     { }
-    Query(const Query&) = delete;
-    Query(Query&& src) noexcept
-        : hostname_{nullptr},
-          context_{std::move(src.context_)},
-          extensions_{std::move(src.extensions_)},
-          status_{src.status_},
-          result_{std::move(src.result_)}
-    {
-        std::swap(src.hostname_, hostname_);
-    }
-    ~Query() noexcept
-    {
-        delete[] hostname_;
-    }
-    Query& operator=(const Query&) = delete;
-    Query& operator=(Query&& src) noexcept
-    {
-        std::swap(src.hostname_, hostname_);
-        std::swap(src.context_, context_);
-        std::swap(src.extensions_, extensions_);
-        status_ = src.status_;
-        std::swap(src.result_, result_);
-        return *this;
-    }
-    ::getdns_transaction_t start_transaction(Event::Base& event_base, ::getdns_callback_t callback_fnc, void* user_data)
-    {
-        context_.set_libevent_base(event_base);
-        ::getdns_transaction_t transaction_id;
-        MUST_BE_GOOD(::getdns_address(context_, hostname_, *extensions_, user_data, &transaction_id, callback_fnc));
-        status_ = Status::in_progress;
-        return transaction_id;
-    }
     enum class Status
     {
-        none,
         in_progress,
         completed,
-        cancelled,
         timed_out,
         failed
     };
     Status get_status() const
     {
-        return status_;
+        if (0 < number_of_pending_queries_)
+        {
+            return Status::in_progress;
+        }
+        if (0 < number_of_answers_)
+        {
+            return Status::completed;
+        }
+        return 0 < number_of_timeouts_ ? Status::timed_out : Status::failed;
     }
-    using Result = std::set<boost::asio::ip::address>;
+    using Result = Util::IpAddresses;
     const Result& get_result() const
     {
         if (this->get_status() == Status::completed)
@@ -108,514 +116,428 @@ public:
         };
         throw NoResultAvailable();
     }
-    const char* get_hostname() const
+    std::size_t get_index() const
     {
-        return hostname_;
+        return index_;
     }
-    void on_complete(GetDns::Data::DictRef answer, ::getdns_transaction_t)
+    TimeUnit::Uptime get_sent_at() const
     {
-        status_ = Status::completed;
-        result_.clear();
-        const auto addresses = answer.get<GetDns::Data::ListRef>("just_address_answers");
-        const std::size_t number_of_addresses = addresses.length();
-        for (std::size_t idx = 0; idx < number_of_addresses; ++idx)
-        {
-            const auto address_data = addresses.get<GetDns::Data::DictRef>(idx).get<GetDns::Data::BinDataRef>("address_data");
-            result_.insert(address_data.as<boost::asio::ip::address>());
-        }
+        return sent_at_;
     }
-    void on_cancel(::getdns_transaction_t)
+    std::size_t get_attempt() const
     {
-        status_ = Status::cancelled;
+        return attempt_;
     }
-    void on_timeout(::getdns_transaction_t)
+    //no definitive answer came, asking again may help
+    bool is_worth_retrying() const
     {
-        status_ = Status::timed_out;
+        const auto status = this->get_status();
+        return (status == Status::timed_out) ||
+               (status == Status::failed) ||
+               ((status == Status::completed) && (number_of_servfails_ == number_of_answers_));
     }
-    void on_error(::getdns_transaction_t)
+    void on_finished(Dns::UdpMultiplexer::Outcome outcome, const Dns::Message* answer, const char* hostname)
     {
-        status_ = Status::failed;
+        --number_of_pending_queries_;
+        switch (outcome)
+        {
+            case Dns::UdpMultiplexer::Outcome::answered:
+                ++number_of_answers_;
+                if (answer->get_header().get_rcode() == Dns::Rcode::servfail)
+                {
+                    ++number_of_servfails_;
+                    return;
+                }
+                try
+                {
+                    answer->for_each_answer([&](const Dns::ResourceRecord& record)
+                    {
+                        if (((record.type == Dns::RrType::a) || (record.type == Dns::RrType::aaaa)) &&
+                            (record.rr_class == Dns::RrClass::in))
+                        {
+                            Util::insert(result_, Util::IpAddress{Dns::parse_address(record)});
+                        }
+                    });
+                }
+                catch (const Dns::MalformedMessage& e)
+                {
+                    std::cerr << "resolve " << hostname << ": " << e.what() << std::endl;
+                }
+                return;
+            case Dns::UdpMultiplexer::Outcome::timed_out:
+                ++number_of_timeouts_;
+                return;
+            case Dns::UdpMultiplexer::Outcome::failed:
+                return;
+        }
     }
 private:
-    const char* hostname_;
-    GetDns::Context context_;
-    GetDns::Data::Dict extensions_;
-    Status status_;
+    std::size_t index_;
+    TimeUnit::Uptime sent_at_;
     Result result_;
+    std::size_t attempt_;
+    std::size_t number_of_pending_queries_;
+    std::size_t number_of_answers_;
+    std::size_t number_of_servfails_;
+    std::size_t number_of_timeouts_;
 };
 
-template <typename ...Ts>
-class QueryGenerator : public Event::OnTimeout<QueryGenerator<Ts...>>
+class QueryGenerator : public Event::OnTimeout<QueryGenerator>
 {
 public:
-    using Solver = GetDns::Solver<Query>;
     using OnTimeout = Event::OnTimeout<QueryGenerator>;
     QueryGenerator(
-            Solver& solver,
-            std::set<std::string> hostnames,
+            Dns::UdpMultiplexer& multiplexer,
+            const Util::NameTable& names,
+            const Hostnames& hostnames,
+            const Util::Bitmap& done,
             GetDns::Context::Timeout query_timeout,
-            std::list<boost::asio::ip::address> resolvers,
-            std::chrono::nanoseconds assigned_time)
-        : OnTimeout{solver.get_event_base()},
-          solver_{solver},
-          hostnames_{std::move(hostnames)},
-          hostname_ptr_{hostnames_.begin()},
-          remaining_queries_{hostnames_.size()},
+            Util::Pacer pacer,
+            const Util::RetrySettings& retries,
+            Util::RecordWriter& to_parent)
+        : OnTimeout{multiplexer.get_event_base()},
+          multiplexer_{multiplexer},
+          names_{names},
+          hostnames_{hostnames},
+          done_{done},
+          next_index_{done_.find_next_unset(0)},
+          remaining_queries_{done_.size() - done_.count()},
+          queries_{},
           query_timeout_{query_timeout},
-          resolvers_{std::move(resolvers)},
-          time_end_{TimeUnit::get_uptime().get() + assigned_time}
+          window_{make_window_settings(multiplexer)},
+          pacer_{pacer},
+          retries_{retries},
+          throughput_{},
+          to_parent_{to_parent}
     {
         this->OnTimeout::set(std::chrono::microseconds{0});
-        while (0 < (remaining_queries_ + solver_.get_number_of_unresolved_requests()))
+        while (0 < (remaining_queries_ + queries_.size()))
         {
-            solver_.do_one_step();
-            const Solver::ListOfQueries finished_requests = solver_.pop_finished_requests();
-            for (auto&& query : finished_requests)
+            multiplexer_.do_one_step();
+            multiplexer_.for_each_finished_request([&](
+                    Dns::UdpMultiplexer::Token index,
+                    Dns::UdpMultiplexer::Outcome outcome,
+                    const Dns::Message* answer)
             {
-                const char* const nameserver = query.get_hostname();
-                switch (query.get_status())
+                const auto query_itr = queries_.find(index);
+                if (query_itr == queries_.end())
                 {
-                    case Query::Status::completed:
-                    {
-                        const Query::Result addresses = query.get_result();
-                        if (addresses.empty())
-                        {
-                            std::cout << "unresolved-ip " << nameserver << std::endl;
-                        }
-                        else
-                        {
-                            for (auto&& addr : addresses)
-                            {
-                                std::cout << "resolved " << nameserver << " " << addr << std::endl;
-                            }
-                        }
-                        break;
-                    }
-                    case Query::Status::timed_out:
-                    case Query::Status::cancelled:
-                    case Query::Status::failed:
-                    case Query::Status::in_progress:
-                    case Query::Status::none:
-                        std::cout << "unresolved-ip " << nameserver << std::endl;
-                        break;
+                    return;
                 }
-            }
+                query_itr->second.on_finished(outcome, answer, names_.get_name(hostnames_[index]));
+                if (query_itr->second.get_status() == Query::Status::in_progress)
+                {
+                    return;
+                }
+                const Query query = std::move(query_itr->second);
+                queries_.erase(query_itr);
+                this->on_finished(query);
+            });
+            to_parent_.flush();
             if (remaining_queries_ <= 0)
             {
                 this->OnTimeout::remove();
             }
         }
+        std::cerr << "hostname resolver: " << throughput_ << ", " << window_ << ", "
+                  << multiplexer_.get_statistics() << std::endl;
     }
     QueryGenerator& on_timeout_occurrence()
     {
-        if (solver_.get_number_of_unresolved_requests() < max_number_of_unresolved_queries)
+        const auto number_of_allowed_requests = pacer_.take(remaining_queries_);
+        std::size_t number_of_added_requests = 0;
+        while ((number_of_added_requests < number_of_allowed_requests) &&
+               (0 < remaining_queries_) &&
+               (queries_.size() < window_.get_limit()))
         {
-            const auto make_context = [&]()
+            auto retry = retries_.pop_ready();
+            if ((retry == boost::none) && (done_.size() <= next_index_))
+            {
+                //only retries waiting for their backoff remain
+                break;
+            }
+            const std::size_t index = retry != boost::none ? retry->item : next_index_;
+            if (retry == boost::none)
+            {
+                next_index_ = done_.find_next_unset(next_index_ + 1);
+            }
+            --remaining_queries_;
+            ++number_of_added_requests;
+            try
             {
-                auto context = GetDns::Context{GetDns::Context::InitialSettings::FromOs{}};
-                context.set_timeout(query_timeout_)
-                       .set_upstream_recursive_servers(resolvers_)
-                       .set_dns_transport_list(GetDns::TransportsList<Ts...>{});
-                return context;
-            };
-            solver_.add_request(Query{*hostname_ptr_, make_context()});
-            this->set_time_of_next_query();
-            if (hostname_ptr_ != hostnames_.end())
+                const char* const hostname = names_.get_name(hostnames_[index]);
+                multiplexer_.send(index, hostname, Dns::RrType::a)
+                            .send(index, hostname, Dns::RrType::aaaa);
+            }
+            catch (const Dns::BadDomainName&)
             {
-                ++hostname_ptr_;
-                --remaining_queries_;
+                to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(static_cast<std::uint32_t>(index)).finish();
+                continue;
             }
+            queries_.emplace(index, Query{index, retry != boost::none ? retry->attempt : 1});
         }
-        else if (0 < remaining_queries_)
+        pacer_.give_back(number_of_allowed_requests - number_of_added_requests);
+        if (0 < remaining_queries_)
         {
-            this->set_time_of_next_query();
+            this->OnTimeout::set(pacer_.get_time_to_next_tick());
         }
         return *this;
     }
 private:
-    QueryGenerator& set_time_of_next_query()
+    void on_finished(const Query& query)
     {
-        const auto now = TimeUnit::get_uptime();
-        using Time = TimeUnit::Nanoseconds<struct TimeTag_>;
-        const auto remaining_time = Time{time_end_ - now.get()};
-        static constexpr auto min_timeout = Time{std::chrono::microseconds{4000}};//smaller value exhausts file descriptors :-(
-        if (remaining_time <= Time::zero())
+        throughput_.query_finished();
+        //retried queries count in the window too
+        if (query.get_status() == Query::Status::completed)
         {
-            this->OnTimeout::set(min_timeout.template as<std::chrono::microseconds>());
+            window_.on_answer(query.get_sent_at());
         }
-        else
+        else if (query.get_status() == Query::Status::timed_out)
         {
-            const auto one_query_time = remaining_time / remaining_queries_;
-            this->OnTimeout::set((one_query_time < min_timeout ? min_timeout
-                                                               : one_query_time).template as<std::chrono::microseconds>());
+            window_.on_timeout(query.get_sent_at());
         }
-        return *this;
-    }
-    Solver& solver_;
-    std::set<std::string> hostnames_;
-    std::set<std::string>::const_iterator hostname_ptr_;
-    std::size_t remaining_queries_;
-    GetDns::Context::Timeout query_timeout_;
-    std::list<boost::asio::ip::address> resolvers_;
-    std::chrono::nanoseconds time_end_;
-};
-
-class Answer
-{
-public:
-    Answer(Event::Base& loop,
-           HostnameResolver::Result& resolved,
-           std::set<std::string>& unresolved,
-           const Util::ImReader& source,
-           std::chrono::seconds max_idle)
-        : source_{source},
-          resolved_{resolved},
-          unresolved_{unresolved},
-          event_ptr_{::event_new(loop,
-                                 source_.get_descriptor(),
-                                 monitored_events_ | EV_PERSIST,
-                                 callback_routine,
-                                 this)},
-          max_idle_{max_idle},
-          source_stream_closed_{false},
-          timed_out_{false}
-    {
-        this->monitor_events_on_source_stream();
-        while (true)
+        if (this->retry_later(query))
         {
-            loop(Event::Loop::Once{});
-            if (timed_out_)
-            {
-                return;
-            }
-            if (content_.empty())
-            {
-                if (source_stream_closed_)
-                {
-                    return;
-                }
-                continue;
-            }
-            const char* line_begin = content_.c_str();
-            while (*line_begin != '\0')
+            return;
+        }
+        const auto index = static_cast<std::uint32_t>(query.get_index());
+        switch (query.get_status())
+        {
+            case Query::Status::completed:
             {
-                const char* line_end = line_begin;
-                while ((*line_end != '\0') && (*line_end != '\n'))
+                const Query::Result& addresses = query.get_result();
+                if (addresses.empty())
                 {
-                    ++line_end;
+                    to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
                 }
-                const bool line_end_reached = (*line_end == '\n') || source_stream_closed_;
-                if (!line_end_reached)
-                {
-                    break;
-                }
-                this->line_received(line_begin, line_end);
-                const bool data_end_reached = (*line_end == '\0') && source_stream_closed_;
-                if (data_end_reached)
+                else
                 {
-                    return;
+                    to_parent_.start(static_cast<std::uint8_t>(RecordType::resolved))
+                              .add(index)
+                              .add(static_cast<std::uint32_t>(addresses.size()));
+                    for (auto&& addr : addresses)
+                    {
+                        to_parent_.add(addr);
+                    }
+                    to_parent_.finish();
                 }
-                line_begin = line_end + 1;
-            }
-            content_ = line_begin;
-        }
-    }
-    ~Answer()
-    {
-        this->remove();
-    }
-    bool timed_out()const
-    {
-        return timed_out_;
-    }
-private:
-    void line_received(const char* _line_begin, const char* _line_end)
-    {
-        const int string_equal = 0;
-        const char* const prefix = _line_begin;
-        if (std::strncmp(prefix, "resolved ", std::strlen("resolved ")) == string_equal)
-        {
-            const char* const hostname_begin = prefix + std::strlen("resolved ");
-            const char* hostname_end = hostname_begin;
-            while ((hostname_end < _line_end) && (*hostname_end != ' '))
-            {
-                ++hostname_end;
-            }
-            const std::string hostname(hostname_begin, hostname_end - hostname_begin);
-            const char* const address_begin = hostname_end + 1;
-            if (_line_end <= address_begin)
-            {
-                throw std::runtime_error("invalid data received");
+                return;
             }
-            const std::string address(address_begin, _line_end - address_begin);
-            resolved_[hostname].insert(boost::asio::ip::address::from_string(address));
-            return;
-        }
-        if (std::strncmp(prefix, "unresolved-ip ", std::strlen("unresolved-ip ")) == string_equal)
-        {
-            const char* const hostname_begin = prefix + std::strlen("unresolved-ip ");
-            const std::string hostname(hostname_begin, _line_end - hostname_begin);
-            unresolved_.insert(hostname);
-            std::cout << std::string(_line_begin, _line_end - _line_begin) << std::endl;
-            return;
+            case Query::Status::timed_out:
+                to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
+                return;
+            case Query::Status::failed:
+            case Query::Status::in_progress:
+                to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
+                return;
         }
-        throw std::runtime_error("invalid data received");
     }
-    Answer& monitor_events_on_source_stream()
+    //transient failures are asked again after a backoff if the assigned time allows
+    bool retry_later(const Query& query)
     {
-        struct ::timeval timeout;
-        timeout.tv_sec = max_idle_.count();
-        timeout.tv_usec = 0;
-        const int success = 0;
-        const int retval = ::event_add(event_ptr_, &timeout);
-        if (retval == success)
+        const auto time_left = pacer_.get_remaining_time() - query_timeout_.as<std::chrono::nanoseconds>();
+        if (!retries_.retry_later(query, query.get_index(), time_left, remaining_queries_))
         {
-            return *this;
+            return false;
         }
-        struct EventAddFailure:std::runtime_error
-        {
-            EventAddFailure():std::runtime_error("event_add failed") { }
-        };
-        throw EventAddFailure();
+        this->OnTimeout::set(pacer_.get_time_to_next_tick());
+        return true;
     }
-    Answer& remove()
+    static Util::ConcurrencyWindow::Settings make_window_settings(const Dns::UdpMultiplexer& multiplexer)
     {
-        if (event_ptr_ != nullptr)
-        {
-            ::event_del(event_ptr_);
-            ::event_free(event_ptr_);
-            event_ptr_ = nullptr;
-        }
-        return *this;
+        auto settings = window_settings;
+        settings.max_limit = multiplexer.get_capacity() / queries_per_hostname;
+        return settings;
     }
-    void on_event(short _events)
+    Dns::UdpMultiplexer& multiplexer_;
+    const Util::NameTable& names_;
+    const Hostnames& hostnames_;
+    const Util::Bitmap& done_;
+    std::size_t next_index_;
+    std::size_t remaining_queries_;
+    std::unordered_map<std::size_t, Query> queries_;
+    GetDns::Context::Timeout query_timeout_;
+    Util::ConcurrencyWindow window_;
+    Util::Pacer pacer_;
+    Util::RetryQueue<std::size_t> retries_;
+    Util::Throughput throughput_;
+    Util::RecordWriter& to_parent_;
+};
+
+//handles records received from child processes
+class Answer
+{
+public:
+    Answer(const Util::NameTable& names,
+           const Hostnames& hostnames,
+           HostnameResolver::Result& resolved,
+           Util::Bitmap& done)
+        : names_{names},
+          hostnames_{hostnames},
+          resolved_{resolved},
+          done_{done}
+    { }
+    void operator()(Util::Record& record) const
     {
-        const bool timed_out = (_events & EV_TIMEOUT) == EV_TIMEOUT;
-        if (timed_out)
+        const std::size_t index = record.get_uint32();
+        if (hostnames_.size() <= index)
         {
-            this->on_timeout();
+            throw std::runtime_error("invalid data received");
         }
-        const bool ready_for_reading = (_events & EV_READ) == EV_READ;
-        if (ready_for_reading)
-        {
-            this->on_read();
-        }
-    }
-    void on_timeout()
-    {
-        timed_out_ = true;
-    }
-    void on_read()
-    {
-        char buffer[0x10000];
-        while (true)
+        const auto hostname = hostnames_[index];
+        switch (static_cast<RecordType>(record.get_type()))
         {
-            static constexpr ::ssize_t failure = -1;
-            const auto read_retval = ::read(source_.get_descriptor(), buffer, sizeof(buffer));
-            const bool read_failed = (read_retval == failure);
-            if (!read_failed)
+            case RecordType::resolved:
             {
-                const bool end_reached = (read_retval == 0);
-                if (end_reached)
+                auto& addresses = resolved_[hostname];
+                for (auto number_of_addresses = record.get_uint32(); 0 < number_of_addresses; --number_of_addresses)
                 {
-                    source_stream_closed_ = true;
-                }
-                else
-                {
-                    const auto data_length = static_cast<std::size_t>(read_retval);
-                    content_.append(buffer, data_length);
-                    const bool all_available_data_already_read = data_length < sizeof(buffer);
-                    if (!all_available_data_already_read)
-                    {
-                        continue;
-                    }
+                    Util::insert(addresses, record.get_address());
                 }
+                done_.set(index);
                 return;
             }
-            const int c_errno = errno;
-            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK);
-            if (data_unavailable)
-            {
+            case RecordType::unresolved_ip:
+                done_.set(index);
+                std::cout << "unresolved-ip " << names_.get_name(hostname) << '\n';
                 return;
-            }
-            const bool operation_was_interrupted_by_a_signal = c_errno == EINTR;
-            if (operation_was_interrupted_by_a_signal)
-            {
-                return;
-            }
-            struct ReadFailed:std::runtime_error
-            {
-                ReadFailed(int error_code):std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
-            };
-            throw ReadFailed(c_errno);
-        }
-    }
-    static void callback_routine(evutil_socket_t _fd, short _events, void* _user_data_ptr)
-    {
-        auto const event_ptr = static_cast<Answer*>(_user_data_ptr);
-        if ((event_ptr != nullptr) && (event_ptr->source_.get_descriptor() == _fd))
-        {
-            try
-            {
-                event_ptr->on_event(_events);
-            }
-            catch (const std::exception& e)
-            {
-                std::cerr << "Answer::on_event failed: " << e.what() << std::endl;
-            }
-            catch (...)
-            {
-                std::cerr << "Answer::on_event caught an unexpected exception" << std::endl;
-            }
         }
+        throw std::runtime_error("invalid data received");
     }
-    const Util::ImReader& source_;
+private:
+    const Util::NameTable& names_;
+    const Hostnames& hostnames_;
     HostnameResolver::Result& resolved_;
-    std::set<std::string>& unresolved_;
-    struct ::event* event_ptr_;
-    std::chrono::seconds max_idle_;
-    std::string content_;
-    bool source_stream_closed_;
-    bool timed_out_;
-    static constexpr auto monitored_events_ = short{EV_READ};
+    Util::Bitmap& done_;
 };
 
-template <typename ...Ts>
 class ChildProcess
 {
 public:
     ChildProcess(
-            const std::set<std::string>& hostnames,
+            const Util::NameTable& names,
+            const Hostnames& hostnames,
             GetDns::Context::Timeout query_timeout,
             const std::list<boost::asio::ip::address>& resolvers,
             std::chrono::nanoseconds assigned_time,
-            const HostnameResolver::Result& resolved,
-            const std::set<std::string>& unresolved,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t number_of_sockets,
+            const Util::Bitmap& done,
             Util::Pipe& pipe_to_parent)
-        : hostnames_{hostnames},
+        : names_{names},
+          hostnames_{hostnames},
           query_timeout_{query_timeout},
           resolvers_{resolvers},
           assigned_time_{assigned_time},
-          resolved_{resolved},
-          unresolved_{unresolved},
+          pacing_{pacing},
+          retries_{retries},
+          number_of_sockets_{number_of_sockets},
+          done_{done},
           pipe_to_parent_{pipe_to_parent}
     { }
     int operator()()const
     {
         Util::ImWriter to_parent(pipe_to_parent_, Util::ImWriter::Stream::stdout);
-        GetDns::Solver<Query> solver;
-        if (resolved_.empty() && unresolved_.empty())
-        {
-            const QueryGenerator<Ts...> resolve{
-                    solver,
-                    hostnames_,
-                    query_timeout_,
-                    resolvers_,
-                    assigned_time_};
-        }
-        else
-        {
-            std::set<std::string> hostnames;
-            HostnameResolver::Result::const_iterator resolved_itr = resolved_.begin();
-            std::set<std::string>::const_iterator unresolved_itr = unresolved_.begin();
-            for (const auto& hostname : hostnames_)
-            {
-                if ((resolved_itr != resolved_.end()) && (hostname == resolved_itr->first))
-                {
-                    ++resolved_itr;
-                }
-                else if ((unresolved_itr != unresolved_.end()) && (hostname == *unresolved_itr))
-                {
-                    ++unresolved_itr;
-                }
-                else
-                {
-                    hostnames.insert(hostname);
-                }
-            }
-            const QueryGenerator<Ts...> resolve{
-                    solver,
-                    hostnames,
-                    query_timeout_,
-                    resolvers_,
-                    std::chrono::nanoseconds{static_cast<std::int64_t>(assigned_time_.count() * double(hostnames.size()) / hostnames_.size())}};
-        }
+        Util::RecordWriter records_to_parent{STDOUT_FILENO};
+        Event::Base event_base;
+        Dns::UdpMultiplexer multiplexer{
+                event_base,
+                resolvers_,
+                Dns::UdpMultiplexer::Settings{
+                        number_of_sockets_,
+                        datagrams_per_batch,
+                        query_timeout_.get(),
+                        udp_payload_size}};
+        Util::TokenBucket limit{pacing_.get_limit()};
+        const QueryGenerator resolve{
+                multiplexer,
+                names_,
+                hostnames_,
+                done_,
+                query_timeout_,
+                Util::Pacer{limit, pacing_, assigned_time_},
+                retries_,
+                records_to_parent};
         return EXIT_SUCCESS;
     }
 private:
-    const std::set<std::string>& hostnames_;
+    const Util::NameTable& names_;
+    const Hostnames& hostnames_;
     GetDns::Context::Timeout query_timeout_;
     const std::list<boost::asio::ip::address>& resolvers_;
     std::chrono::nanoseconds assigned_time_;
-    const HostnameResolver::Result& resolved_;
-    const std::set<std::string>& unresolved_;
+    Util::Pacer::Settings pacing_;
+    Util::RetrySettings retries_;
+    std::size_t number_of_sockets_;
+    const Util::Bitmap& done_;
     Util::Pipe& pipe_to_parent_;
 };
 
 }//namespace {anonymous}
 
 HostnameResolver::Result HostnameResolver::get_result(
-        const std::set<std::string>& hostnames,
+        const Util::NameTable& names,
+        const Util::NameTable::Ids& hostnames,
         GetDns::Context::Timeout query_timeout,
         const std::list<boost::asio::ip::address>& resolvers,
-        std::chrono::nanoseconds assigned_time)
+        std::chrono::nanoseconds assigned_time,
+        const Util::Pacer::Settings& pacing,
+        const Util::RetrySettings& retries,
+        std::size_t number_of_sockets,
+        std::size_t number_of_workers)
 {
     Result resolved;
-    std::set<std::string> unresolved;
     if (hostnames.empty())
     {
         return resolved;
     }
-    while ((resolved.size() + unresolved.size()) < hostnames.size())
+    //queries do not go through getdns, only its view of the system configuration is used
+    const auto upstreams = resolvers.empty() ? GetDns::Context{GetDns::Context::InitialSettings::FromOs{}}.get_upstream_recursive_servers()
+                                             : resolvers;
+    const auto query_distance_sec = (assigned_time.count() / double(hostnames.size())) / 1000000000LL;
+    const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
+    Util::Bitmap done{hostnames.size()};
+    while (!done.all())
     {
-        Util::Pipe pipe;
-        Util::Fork parent{
-                ChildProcess<GetDns::TransportProtocol::Udp, GetDns::TransportProtocol::Tcp>{
-                        hostnames,
-                        query_timeout,
-                        resolvers,
-                        assigned_time,
-                        resolved,
-                        unresolved,
-                        pipe}};
-        Util::ImReader from_child{pipe};
-        from_child.set_nonblocking();
-        Event::Base monitor;
-        const auto query_distance_sec = (assigned_time.count() / double(hostnames.size())) / 1000000000LL;
-        const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
-        const auto answer = Answer{monitor, resolved, unresolved, from_child, answer_timeout};
-        try
+        //workers share the time of the remaining part of hostnames
+        const auto time_for_remaining_hostnames = std::chrono::nanoseconds{static_cast<std::int64_t>(
+                assigned_time.count() * double(done.size() - done.count()) / done.size())};
+        std::vector<Util::Bitmap> done_of_shards;
+        for (std::size_t idx = 0; idx < number_of_workers; ++idx)
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.get_child_result_status();
-            if (child_result_status.exited())
-            {
-                if (child_result_status.get_exit_status() == EXIT_SUCCESS)
-                {
-                    std::cerr << "hostnames A and AAAA records resolved" << std::endl;
-                    if ((resolved.size() + unresolved.size()) < hostnames.size())
-                    {
-                        throw std::runtime_error("hostname resolver did not complete it's job");
-                    }
-                    return resolved;
-                }
-                std::cerr << "child process failed" << std::endl;
-            }
-            else if (child_result_status.signaled())
+            done_of_shards.push_back(Util::Shard{idx, number_of_workers}.mask(done, hostnames));
+        }
+        Util::Workers workers{answer_timeout};
+        for (auto&& done_of_shard : done_of_shards)
+        {
+            if (done_of_shard.all())
             {
-                std::cerr << "child process terminated by signal " << child_result_status.get_signal_number() << std::endl;
+                continue;
             }
-            else
+            workers.start([&](Util::Pipe& pipe_to_parent)
             {
-                std::cerr << "child process done" << std::endl;
-            }
+                return ChildProcess{
+                        names,
+                        hostnames,
+                        query_timeout,
+                        upstreams,
+                        time_for_remaining_hostnames,
+                        pacing.get_part(number_of_workers),
+                        retries,
+                        number_of_sockets,
+                        done_of_shard,
+                        pipe_to_parent};
+            });
         }
-        catch (const Util::Fork::ChildIsStillRunning&)
+        if (workers.wait(Answer{names, hostnames, resolved, done}))
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.kill_child();
-            if (child_result_status.signaled())
+            std::cerr << "hostnames A and AAAA records resolved" << std::endl;
+            if (!done.all())
             {
-                std::cerr << "child process was terminated because of blocking" << std::endl;
+                throw std::runtime_error("hostname resolver did not complete it's job");
             }
+            return resolved;
         }
     }
     return resolved;
@@ -22,22 +22,33 @@
 
 #include "src/getdns/context.hh"
 
+#include "src/util/ip_address.hh"
+#include "src/util/name_table.hh"
+#include "src/util/pacer.hh"
+#include "src/util/retry_queue.hh"
+
 #include <boost/asio/ip/address.hpp>
 
 #include <chrono>
+#include <cstddef>
 #include <list>
 #include <map>
-#include <set>
-#include <string>
 
 struct HostnameResolver
 {
-    using Result = std::map<std::string, std::set<boost::asio::ip::address>>;
+    //addresses by ids of hostnames
+    using Result = std::map<Util::NameTable::Id, Util::IpAddresses>;
+    //hostnames are distinct ids of names
     static Result get_result(
-            const std::set<std::string>& hostnames,
+            const Util::NameTable& names,
+            const Util::NameTable::Ids& hostnames,
             GetDns::Context::Timeout query_timeout,
             const std::list<boost::asio::ip::address>& resolvers,
-            std::chrono::nanoseconds assigned_time);
+            std::chrono::nanoseconds assigned_time,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t number_of_sockets,
+            std::size_t number_of_workers);
 };
 
 #endif//HOSTNAME_RESOLVER_HH_0C273EEF65B9F6F9FD6A9F48B3CE9AA5
@@ -20,26 +20,81 @@
 #include "src/insecure_cdnskey_resolver.hh"
 #include "src/time_unit.hh"
 
+#include "src/dns/uring_solver.hh"
+#include "src/dns/uring_tcp_client.hh"
+#include "src/dns/wire.hh"
+
 #include "src/getdns/context.hh"
+#include "src/getdns/context_pool.hh"
 #include "src/getdns/data.hh"
 #include "src/getdns/exception.hh"
 #include "src/getdns/extensions_set.hh"
 #include "src/getdns/solver.hh"
 
-#include "src/util/fork.hh"
+#include "src/util/bitmap.hh"
+#include "src/util/circuit_breaker.hh"
+#include "src/util/concurrency_window.hh"
+#include "src/util/ip_address.hh"
+#include "src/util/pacer.hh"
+#include "src/util/nameserver_lists.hh"
 #include "src/util/pipe.hh"
+#include "src/util/polite_scheduler.hh"
+#include "src/util/prefix_trie.hh"
+#include "src/util/queued_tasks.hh"
+#include "src/util/record.hh"
+#include "src/util/resident_memory.hh"
+#include "src/util/retry_queue.hh"
+#include "src/util/sample_gate.hh"
+#include "src/util/task_source.hh"
+#include "src/util/throughput.hh"
+#include "src/util/upstream_timeouts.hh"
+#include "src/util/work_stealing_queues.hh"
+#include "src/util/workers.hh"
+
+#include <boost/optional.hpp>
 
+#include <unistd.h>
+
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
-#include <set>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace {
 
-constexpr auto max_number_of_unresolved_queries = 200;
+//timeouts of unreachable nameservers are frequent and their round trip times differ a lot, so the window
+//reacts to a high timeout ratio only
+constexpr auto window_settings = Util::ConcurrencyWindow::Settings{200, 0, 0.3, 0.0};
+//one tcp connection is shared by pipelined queries
+constexpr std::size_t descriptors_per_query = 1;
+//addresses of nameservers are resolved in pipelined mode only
+constexpr auto nameserver_window_settings = Util::ConcurrencyWindow::Settings{200, 0, 0.1, 4.0};
+constexpr std::size_t descriptors_per_nameserver_query = 2;
+//nameserver queries and CDNSKEY queries of one process share its descriptors, the nameserver queries take
+//this part of them
+constexpr std::size_t descriptors_of_nameservers_divisor = 4;
+constexpr auto tcp_idle_timeout = GetDns::Context::Timeout{std::chrono::seconds{2}};
+//timeout of queries of a nameserver address which did not answer yet
+constexpr auto initial_query_timeout = std::chrono::seconds{2};
+//operations queued between two submissions of the io_uring backend, a connection needs up to four of them
+constexpr std::size_t uring_entries = 4096;
+//tasks of one address come in slices so that tasks of many addresses are queued at once
+constexpr std::size_t tasks_per_address_in_turn = 256;
+//tasks generated ahead of their queries, less of them if the memory limit does not allow
+constexpr std::size_t max_number_of_buffered_tasks = 0x100000;
+constexpr std::size_t bytes_per_mib = 1024 * 1024;
 
 struct Cdnskey
 {
@@ -57,88 +112,179 @@ struct Cdnskey
     }
 };
 
-using Nameservers = std::set<std::string>;
+//records sent by the child process, domains are sent as ids of names, nameservers as indices into
+//NameTables::nameservers:
+//  resolved (nameserver, number of addresses, addresses), unresolved_ip (nameserver),
+//  insecure (task, number of keys, flags, protocol, algorithm and public key of each key),
+//  unresolved (task)
+//where task is (domain, address, number of nameservers, nameservers); each record completes its subject
+enum class RecordType : std::uint8_t
+{
+    resolved,
+    unresolved_ip,
+    insecure,
+    unresolved
+};
+
+//names known to both processes, nameservers are ordered as NameserverStates
+struct NameTables
+{
+    const Util::NameTable& table;
+    Util::NameTable::Ids nameservers;
+};
+
+using AddressClassifier = Util::AddressClassifier;
+using NameserverLists = Util::NameserverLists;
+using NameserverState = Util::NameserverState;
+using NameserverStates = Util::NameserverStates;
+using ResolvedNameserver = Util::ResolvedNameserver;
+using ResolvedNameservers = Util::ResolvedNameservers;
+using Task = Util::Task;
+using Tasks = Util::Tasks;
+using TaskSources = Util::TaskSources;
+
+//nameservers of one hosting usually share a /24 (IPv4) or /48 (IPv6) network
+Util::IpAddress get_network_of(const Util::IpAddress& address)
+{
+    return address.get_prefix(address.is_v4_mapped() ? 96 + 24 : 48);
+}
+
+NameserverState& set_addresses(NameserverState& nameserver, Util::IpAddresses addresses)
+{
+    nameserver.addresses = std::move(addresses);
+    nameserver.is_resolved = true;
+    nameserver.answered = Util::Bitmap{nameserver.domains.size() * nameserver.addresses.size()};
+    return nameserver;
+}
+
+Util::RecordWriter& start_record(
+        Util::RecordWriter& to_parent,
+        RecordType type,
+        const Task& task,
+        const NameserverLists& nameserver_lists)
+{
+    const auto nameservers = nameserver_lists.get(task.nameservers);
+    to_parent.start(static_cast<std::uint8_t>(type))
+             .add(task.domain)
+             .add(task.address)
+             .add(static_cast<std::uint32_t>(nameservers.size()));
+    for (auto&& nameserver : nameservers)
+    {
+        to_parent.add(nameserver);
+    }
+    return to_parent;
+}
 
-bool is_public(const boost::asio::ip::address_v4& addr)
+//tasks on addresses which are not public are unresolved without a query
+Util::TaskSource::OnNonPublic report_as_unresolved(Util::RecordWriter& to_parent, const NameserverLists& nameserver_lists)
 {
-    return !((addr.to_uint() & 0xFF000000) == 0x0A000000) && // 10.0.0.0/8
-           !((addr.to_uint() & 0xFFF00000) == 0xAC100000) && // 172.16.0.0/12
-           !((addr.to_uint() & 0xFFFF0000) == 0xC0A80000) && // 192.168.0.0/16
-           !((addr.to_uint() & 0xFFFF0000) == 0xA9FE0000) && // 169.254.0.0/16
-           !addr.is_loopback() &&
-           !addr.is_multicast() &&
-           !addr.is_unspecified();
+    return [&to_parent, &nameserver_lists](const Task& task)
+    {
+        start_record(to_parent, RecordType::unresolved, task, nameserver_lists).finish();
+    };
 }
 
-bool is_public(const boost::asio::ip::address_v6& addr)
+AddressClassifier& add_range(AddressClassifier& classifier, const Util::IpPrefix& prefix, bool is_public)
 {
-    if (addr.is_v4_mapped() || addr.is_v4_compatible())
+    classifier.add(prefix, is_public);
+    static constexpr unsigned v4_mapped_prefix_length = 96;
+    if (prefix.address.is_v4_mapped() && (v4_mapped_prefix_length <= prefix.length))
     {
-        return is_public(addr.to_v4());
+        //IPv4 ranges apply to v4-compatible addresses (::a.b.c.d) too
+        auto bytes = prefix.address.get_bytes();
+        bytes[10] = 0;
+        bytes[11] = 0;
+        classifier.add(Util::IpPrefix{Util::IpAddress{bytes, Util::IpAddress::Family::v6}, prefix.length}, is_public);
     }
-    return !addr.is_link_local() &&
-           !addr.is_loopback() &&
-           !addr.is_multicast() &&
-           !addr.is_multicast_global() &&
-           !addr.is_multicast_link_local() &&
-           !addr.is_multicast_node_local() &&
-           !addr.is_multicast_org_local() &&
-           !addr.is_multicast_site_local() &&
-           !addr.is_site_local() &&
-           !addr.is_unspecified();
+    return classifier;
 }
 
-bool is_public(const boost::asio::ip::address& addr)
+AddressClassifier make_address_classifier(const InsecureCdnskeyResolver::AddressRanges& ranges)
 {
-    return addr.is_v4() ? is_public(addr.to_v4())
-                        : is_public(addr.to_v6());
+    static const char* const non_public_ranges[] = {
+            "10.0.0.0/8",
+            "172.16.0.0/12",
+            "192.168.0.0/16",
+            "169.254.0.0/16",
+            "127.0.0.0/8",//loopback
+            "224.0.0.0/4",//multicast
+            "0.0.0.0/32",
+            "fe80::/10",//link local
+            "fec0::/10",//site local
+            "ff00::/8",//multicast
+            "::1/128",
+            "::/128"};
+    AddressClassifier classifier;
+    classifier.add(Util::IpPrefix{Util::IpAddress{}, 0}, true);
+    for (const char* range : non_public_ranges)
+    {
+        add_range(classifier, Util::parse_ip_prefix(range), false);
+    }
+    for (auto&& range : ranges.allowed)
+    {
+        add_range(classifier, range, true);
+    }
+    for (auto&& range : ranges.blocked)
+    {
+        add_range(classifier, range, false);
+    }
+    return classifier;
 }
 
 class Query
 {
 public:
-    Query(Insecure task,
-          GetDns::Context context)
-        : hostname_{[&]() { char* const str = new char[task.domain.length() + 1]; std::memcpy(str, task.domain.c_str(), task.domain.length() + 1); return str; }()},
+    //the io_uring backend has no context, it connects to the address of the task with the given timeout;
+    //domain points into the name table
+    Query(const char* domain,
+          Task task,
+          GetDns::ContextPool::Lease context,
+          std::chrono::nanoseconds timeout)
+        : hostname_{domain},
           task_{std::move(task)},
           context_{std::move(context)},
+          timeout_{timeout},
           extensions_{make_extensions(GetDns::ExtensionsSet<>{})},
           status_{Status::none},
-          result_{}
+          sent_at_{TimeUnit::Uptime::zero()},
+          result_{},
+          transient_failure_{false},
+          refusal_{false}
     { }
     Query(const Query&) = delete;
     Query(Query&& src) noexcept
-        : hostname_{nullptr},
+        : hostname_{src.hostname_},
           task_{std::move(src.task_)},
           context_{std::move(src.context_)},
+          timeout_{src.timeout_},
           extensions_{std::move(src.extensions_)},
           status_{src.status_},
-          result_{std::move(src.result_)}
-    {
-        std::swap(src.hostname_, hostname_);
-    }
-    ~Query() noexcept
-    {
-        delete[] hostname_;
-    }
+          sent_at_{src.sent_at_},
+          result_{std::move(src.result_)},
+          transient_failure_{src.transient_failure_},
+          refusal_{src.refusal_}
+    { }
     Query& operator=(const Query&) = delete;
     Query& operator=(Query&& src) noexcept
     {
-        std::swap(src.hostname_, hostname_);
+        hostname_ = src.hostname_;
         std::swap(src.task_, task_);
         std::swap(src.context_, context_);
+        timeout_ = src.timeout_;
         std::swap(src.extensions_, extensions_);
         status_ = src.status_;
+        sent_at_ = src.sent_at_;
         std::swap(src.result_, result_);
+        transient_failure_ = src.transient_failure_;
+        refusal_ = src.refusal_;
         return *this;
     }
-    ::getdns_transaction_t start_transaction(Event::Base& event_base, ::getdns_callback_t callback_fnc, void* user_data)
+    ::getdns_transaction_t start_transaction(Event::Base&, ::getdns_callback_t callback_fnc, void* user_data)
     {
-        context_.set_libevent_base(event_base);
         ::getdns_transaction_t transaction_id;
-        context_.set_upstream_recursive_servers(std::list<boost::asio::ip::address>{task_.address});
         try
         {
+            sent_at_ = TimeUnit::get_uptime();
             MUST_BE_GOOD(::getdns_general(context_, hostname_, std::uint16_t{GETDNS_RRTYPE_CDNSKEY}, *extensions_, user_data, &transaction_id, callback_fnc));
             status_ = Status::in_progress;
             return transaction_id;
@@ -150,6 +296,21 @@ public:
             throw;
         }
     }
+    void start_exchange(Dns::UringTcpClient& client, Dns::UringTcpClient::Token token)
+    {
+        try
+        {
+            sent_at_ = TimeUnit::get_uptime();
+            client.send(token, task_.address.to_address(), hostname_, Dns::RrType::cdnskey, timeout_);
+            status_ = Status::in_progress;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << hostname_ << " CDNSKEY resolved, exception caught: " << e.what() << std::endl;
+            status_ = Status::failed;
+            throw;
+        }
+    }
     enum class Status
     {
         none,
@@ -176,43 +337,208 @@ public:
         };
         throw NoResultAvailable();
     }
-    const Insecure& get_task() const
+    const Task& get_task() const
     {
         return task_;
     }
+    TimeUnit::Uptime get_sent_at() const
+    {
+        return sent_at_;
+    }
+    std::size_t get_attempt() const
+    {
+        return task_.attempt;
+    }
+    //no definitive answer came, asking again may help
+    bool is_worth_retrying() const
+    {
+        return (status_ == Status::cancelled) ||
+               (status_ == Status::timed_out) ||
+               (status_ == Status::failed) ||
+               ((status_ == Status::completed) && transient_failure_);
+    }
+    //the nameserver answered REFUSED or SERVFAIL
+    bool is_refusal() const
+    {
+        return (status_ == Status::completed) && refusal_;
+    }
     void on_complete(GetDns::Data::DictRef answer, ::getdns_transaction_t)
     {
         status_ = Status::completed;
+        transient_failure_ = GetDns::is_transient_failure(answer);
+        refusal_ = GetDns::is_refusal(answer);
+        result_.clear();
+        try
+        {
+            GetDns::for_each_reply(answer, [&](const Dns::Message& reply) { this->collect_cdnskeys(reply); });
+        }
+        catch (const Dns::MalformedMessage& e)
+        {
+            std::cerr << "resolve " << hostname_ << ": " << e.what() << std::endl;
+        }
+    }
+    void on_answer(const Dns::Message& answer)
+    {
+        const auto rcode = answer.get_header().get_rcode();
+        status_ = Status::completed;
+        transient_failure_ = rcode == Dns::Rcode::servfail;
+        refusal_ = (rcode == Dns::Rcode::refused) || (rcode == Dns::Rcode::servfail);
         result_.clear();
-        const auto replies = answer.get<GetDns::Data::ListRef>("replies_tree");
-        for (std::size_t reply_idx = 0; reply_idx < replies.length(); ++reply_idx)
+        try
+        {
+            this->collect_cdnskeys(answer);
+        }
+        catch (const Dns::MalformedMessage& e)
+        {
+            std::cerr << "resolve " << hostname_ << ": " << e.what() << std::endl;
+        }
+    }
+    void on_cancel(::getdns_transaction_t)
+    {
+        status_ = Status::cancelled;
+    }
+    void on_timeout(::getdns_transaction_t)
+    {
+        status_ = Status::timed_out;
+    }
+    void on_error(::getdns_transaction_t)
+    {
+        status_ = Status::failed;
+    }
+private:
+    void collect_cdnskeys(const Dns::Message& reply)
+    {
+        reply.for_each_answer([&](const Dns::ResourceRecord& record)
         {
-            const auto reply = replies.get<GetDns::Data::DictRef>(reply_idx);
-            const auto answers = reply.get<GetDns::Data::ListRef>("answer");
-            const auto number_of_answers = answers.length();
-            for (std::size_t answer_idx = 0; answer_idx < number_of_answers; ++answer_idx)
+            if ((record.type == Dns::RrType::cdnskey) && (record.rr_class == Dns::RrClass::in))
             {
-                try
-                {
-                    const auto answer = answers.get<GetDns::Data::DictRef>(answer_idx);
-                    if ((static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("type")) == GETDNS_RRTYPE_CDNSKEY) &&
-                        (static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("class")) == GETDNS_RRCLASS_IN))
-                    {
-                        const auto rdata = answer.get<GetDns::Data::DictRef>("rdata");
-                        Cdnskey cdnskey;
-                        cdnskey.algorithm = rdata.get<GetDns::Data::IntegerRef>("algorithm");
-                        cdnskey.flags = rdata.get<GetDns::Data::IntegerRef>("flags");
-                        cdnskey.protocol = rdata.get<GetDns::Data::IntegerRef>("protocol");
-                        cdnskey.public_key = GetDns::base64_encode(rdata.get<GetDns::Data::BinDataRef>("public_key"));
-                        result_.push_back(std::move(cdnskey));
-                    }
-                }
-                catch (const ::GetDns::NoSuchDictName& e)
-                {
-                    std::cerr << "resolve " << hostname_ << ": " << e.what() << std::endl;
-                }
+                const auto dnskey = Dns::parse_dnskey(record);
+                result_.push_back(Cdnskey{
+                        dnskey.flags,
+                        dnskey.protocol,
+                        dnskey.algorithm,
+                        Dns::base64_encode(dnskey.public_key, dnskey.public_key_length)});
             }
+        });
+    }
+    const char* hostname_;
+    Task task_;
+    GetDns::ContextPool::Lease context_;
+    std::chrono::nanoseconds timeout_;
+    GetDns::Data::Dict extensions_;
+    Status status_;
+    TimeUnit::Uptime sent_at_;
+    Result result_;
+    bool transient_failure_;
+    bool refusal_;
+};
+
+class NameserverQuery
+{
+public:
+    //nameserver points into the name table
+    NameserverQuery(std::uint32_t index,
+                    const char* nameserver,
+                    GetDns::ContextPool::Lease context,
+                    std::size_t attempt)
+        : index_{index},
+          nameserver_{nameserver},
+          context_{std::move(context)},
+          extensions_{make_extensions(GetDns::ExtensionsSet<GetDns::Extension::ReturnBothV4AndV6>{})},
+          status_{Status::none},
+          sent_at_{TimeUnit::Uptime::zero()},
+          result_{},
+          attempt_{attempt},
+          transient_failure_{false}
+    { }
+    NameserverQuery(const NameserverQuery&) = delete;
+    NameserverQuery(NameserverQuery&& src) noexcept
+        : index_{src.index_},
+          nameserver_{src.nameserver_},
+          context_{std::move(src.context_)},
+          extensions_{std::move(src.extensions_)},
+          status_{src.status_},
+          sent_at_{src.sent_at_},
+          result_{std::move(src.result_)},
+          attempt_{src.attempt_},
+          transient_failure_{src.transient_failure_}
+    { }
+    NameserverQuery& operator=(const NameserverQuery&) = delete;
+    NameserverQuery& operator=(NameserverQuery&& src) noexcept
+    {
+        index_ = src.index_;
+        nameserver_ = src.nameserver_;
+        std::swap(src.context_, context_);
+        std::swap(src.extensions_, extensions_);
+        status_ = src.status_;
+        sent_at_ = src.sent_at_;
+        std::swap(src.result_, result_);
+        attempt_ = src.attempt_;
+        transient_failure_ = src.transient_failure_;
+        return *this;
+    }
+    ::getdns_transaction_t start_transaction(Event::Base&, ::getdns_callback_t callback_fnc, void* user_data)
+    {
+        ::getdns_transaction_t transaction_id;
+        sent_at_ = TimeUnit::get_uptime();
+        MUST_BE_GOOD(::getdns_address(context_, nameserver_, *extensions_, user_data, &transaction_id, callback_fnc));
+        status_ = Status::in_progress;
+        return transaction_id;
+    }
+    using Status = Query::Status;
+    Status get_status() const
+    {
+        return status_;
+    }
+    using Result = Util::IpAddresses;
+    const Result& get_result() const
+    {
+        if (this->get_status() == Status::completed)
+        {
+            return result_;
         }
+        struct NoResultAvailable : std::runtime_error
+        {
+            NoResultAvailable() : std::runtime_error("Request is not completed yet") { }
+        };
+        throw NoResultAvailable();
+    }
+    std::uint32_t get_index() const
+    {
+        return index_;
+    }
+    TimeUnit::Uptime get_sent_at() const
+    {
+        return sent_at_;
+    }
+    std::size_t get_attempt() const
+    {
+        return attempt_;
+    }
+    //no definitive answer came, asking again may help
+    bool is_worth_retrying() const
+    {
+        return (status_ == Status::cancelled) ||
+               (status_ == Status::timed_out) ||
+               (status_ == Status::failed) ||
+               ((status_ == Status::completed) && transient_failure_);
+    }
+    void on_complete(GetDns::Data::DictRef answer, ::getdns_transaction_t)
+    {
+        status_ = Status::completed;
+        transient_failure_ = GetDns::is_transient_failure(answer);
+        result_.clear();
+        GetDns::for_each_reply(answer, [&](const Dns::Message& reply)
+        {
+            reply.for_each_answer([&](const Dns::ResourceRecord& record)
+            {
+                if (((record.type == Dns::RrType::a) || (record.type == Dns::RrType::aaaa)) &&
+                    (record.rr_class == Dns::RrClass::in))
+                {
+                    Util::insert(result_, Util::IpAddress{Dns::parse_address(record)});
+                }
+            });
+        });
     }
     void on_cancel(::getdns_transaction_t)
     {
@@ -227,572 +553,1532 @@ public:
         status_ = Status::failed;
     }
 private:
-    const char* hostname_;
-    Insecure task_;
-    GetDns::Context context_;
+    std::uint32_t index_;
+    const char* nameserver_;
+    GetDns::ContextPool::Lease context_;
     GetDns::Data::Dict extensions_;
     Status status_;
+    TimeUnit::Uptime sent_at_;
     Result result_;
+    std::size_t attempt_;
+    bool transient_failure_;
 };
 
-template <typename ...Ts>
-class QueryGenerator : public Event::OnTimeout<QueryGenerator<Ts...>>
+//CDNSKEY queries go through getdns driven by libevent or through io_uring, the generator differs in connection
+//management only
+using LibeventSolver = GetDns::Solver<Query>;
+using UringSolver = Dns::UringSolver<Query>;
+
+struct ConnectionStatistics
+{
+    std::size_t tasks;
+    std::size_t connections;
+};
+
+void set_limits_of_connections(LibeventSolver& solver, std::size_t pipeline_depth, std::size_t max_connections_per_ip)
+{
+    solver.get_context_pool().set_max_leases_per_context(pipeline_depth)
+                             .set_max_contexts_per_key(max_connections_per_ip);
+}
+
+void set_limits_of_connections(UringSolver& solver, std::size_t pipeline_depth, std::size_t max_connections_per_ip)
+{
+    solver.get_client().set_max_queries_per_connection(pipeline_depth)
+                       .set_max_connections_per_address(max_connections_per_ip);
+}
+
+GetDns::ContextPool::Lease borrow_context(LibeventSolver& solver, const GetDns::ContextPool::Key& key)
+{
+    return solver.get_context_pool().borrow(key);
+}
+
+GetDns::ContextPool::Lease borrow_context(UringSolver&, const GetDns::ContextPool::Key&)
+{
+    return GetDns::ContextPool::Lease{};
+}
+
+const GetDns::ContextPool::Statistics& get_statistics_of(LibeventSolver& solver)
+{
+    return solver.get_context_pool().get_statistics();
+}
+
+const Dns::UringTcpClient::Statistics& get_statistics_of(UringSolver& solver)
+{
+    return solver.get_client().get_statistics();
+}
+
+//a context idle for longer than its idle timeout closed its connection
+ConnectionStatistics get_connection_statistics_of(LibeventSolver& solver)
+{
+    const auto& statistics = solver.get_context_pool().get_statistics();
+    return ConnectionStatistics{statistics.leases, statistics.sessions};
+}
+
+ConnectionStatistics get_connection_statistics_of(UringSolver& solver)
+{
+    const auto& statistics = solver.get_client().get_statistics();
+    return ConnectionStatistics{statistics.queries, statistics.connections};
+}
+
+template <typename Solver, typename ...Ts>
+class QueryGenerator : public Event::OnTimeout<QueryGenerator<Solver, Ts...>>
 {
 public:
-    using Solver = GetDns::Solver<Query>;
     using OnTimeout = Event::OnTimeout<QueryGenerator>;
+    using Scheduler = Util::PoliteScheduler<Util::IpAddress, Task>;
+    using Breaker = Util::CircuitBreaker<Util::IpAddress>;
+    using Samples = Util::SampleGate<Util::IpAddress, Task>;
     QueryGenerator(
             Solver& solver,
-            const VectorOfInsecures& to_resolve,
+            Tasks to_resolve,
             GetDns::Context::Timeout query_timeout,
-            std::chrono::nanoseconds assigned_time)
+            GetDns::Context::Timeout min_query_timeout,
+            std::size_t pipeline_depth,
+            std::size_t max_connections_per_ip,
+            const InsecureCdnskeyResolver::Politeness& politeness,
+            const Util::CircuitBreakerSettings& breaker,
+            const InsecureCdnskeyResolver::ProbeFirst& probe_first,
+            std::size_t expected_number_of_tasks,
+            Util::Pacer pacer,
+            const Util::RetrySettings& retries,
+            std::size_t number_of_descriptors,
+            const NameTables& names,
+            const NameserverLists& nameserver_lists,
+            Util::RecordWriter& to_parent)
         : OnTimeout{solver.get_event_base()},
           solver_{solver},
-          to_resolve_{to_resolve},
-          to_resolve_itr_{to_resolve_.begin()},
-          remaining_queries_{to_resolve_.size()},
-          query_timeout_{query_timeout},
-          time_end_{TimeUnit::get_uptime().get() + assigned_time}
+          pending_tasks_{make_scheduler_settings(pipeline_depth, politeness), get_key_of_task(politeness)},
+          remaining_queries_{std::max(expected_number_of_tasks, to_resolve.size())},
+          more_tasks_expected_{true},
+          context_key_{make_context_key(query_timeout)},
+          timeouts_{make_timeouts_settings(query_timeout, min_query_timeout)},
+          breaker_{breaker},
+          number_of_rejected_tasks_{0},
+          samples_{probe_first.sample_size},
+          policy_of_refusing_{probe_first.policy_of_refusing},
+          number_of_pruned_tasks_{0},
+          window_{make_window_settings(number_of_descriptors)},
+          pacer_{pacer},
+          retries_{retries},
+          throughput_{},
+          names_{names},
+          nameserver_lists_{nameserver_lists},
+          to_parent_{to_parent}
     {
-        this->OnTimeout::set(std::chrono::microseconds{0});
-        while (0 < (remaining_queries_ + solver_.get_number_of_unresolved_requests()))
+        set_limits_of_connections(solver_, pipeline_depth, max_connections_per_ip);
+        for (auto&& task : to_resolve)
         {
-            solver_.do_one_step();
-            const auto finished_requests = solver_.pop_finished_requests();
-            for (auto&& query : finished_requests)
-            {
-                const Insecure& to_resolve = query.get_task();
-                const Nameservers& nameservers = to_resolve.nameservers;
-                if (query.get_status() == Query::Status::completed)
-                {
-                    const auto result = query.get_result();
-                    if (result.empty())
-                    {
-                        for (const auto& nameserver : nameservers)
-                        {
-                            std::cout << "insecure-empty " << nameserver << " "
-                                      << to_resolve.address << " "
-                                      << to_resolve.domain << std::endl;
-                        }
-                    }
-                    else
-                    {
-                        for (auto&& key : result)
-                        {
-                            for (auto&& nameserver : nameservers)
-                            {
-                                std::cout << "insecure " << nameserver << " "
-                                          << to_resolve.address << " "
-                                          << to_resolve.domain << " "
-                                          << key << std::endl;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    for (auto&& nameserver : nameservers)
-                    {
-                        std::cout << "unresolved " << nameserver << " "
-                                  << to_resolve.address << " "
-                                  << to_resolve.domain << std::endl;
-                    }
-                }
-            }
-            if (remaining_queries_ <= 0)
-            {
-                this->OnTimeout::remove();
-            }
+            pending_tasks_.push(std::move(task));
         }
+        this->OnTimeout::set(std::chrono::microseconds{0});
     }
-    QueryGenerator& on_timeout_occurrence()
+    //tasks of just resolved nameservers are queued behind the remaining ones of the same address
+    QueryGenerator& add_tasks(Tasks tasks)
     {
-        if (solver_.get_number_of_unresolved_requests() < max_number_of_unresolved_queries)
+        const bool was_idle = this->get_number_of_pending_tasks() == 0;
+        for (auto&& task : tasks)
         {
-            while (true)
-            {
-                const auto make_context = [&]()
-                {
-                    auto context = GetDns::Context{GetDns::Context::InitialSettings::FromOs{}};
-                    context.set_timeout(query_timeout_)
-                        .set_dns_transport_list(GetDns::TransportsList<Ts...>{});
-                    return context;
-                };
-                const bool request_added = [&]()
-                {
-                    try
-                    {
-                        solver_.add_request(Query{*to_resolve_itr_, make_context()});
-                        return true;
-                    }
-                    catch (...)
-                    {
-                        std::for_each(
-                                begin(to_resolve_itr_->nameservers),
-                                end(to_resolve_itr_->nameservers),
-                                [&](auto&& nameserver)
-                                {
-                                    std::cout << "unresolved " << nameserver << " "
-                                            << to_resolve_itr_->address << " "
-                                            << to_resolve_itr_->domain << std::endl;
-                                });
-                        return false;
-                    }
-                }();
-                this->set_time_of_next_query();
-                if (to_resolve_itr_ != to_resolve_.end())
-                {
-                    ++to_resolve_itr_;
-                    --remaining_queries_;
-                }
-                if (request_added)
-                {
-                    break;
-                }
-            }
+            pending_tasks_.push(std::move(task));
         }
-        else if (0 < remaining_queries_)
+        remaining_queries_ = std::max(remaining_queries_, this->get_number_of_pending_tasks());
+        if (was_idle && (0 < this->get_number_of_pending_tasks()))
         {
-            this->set_time_of_next_query();
+            this->OnTimeout::set(std::chrono::microseconds{0});
         }
         return *this;
     }
-private:
-    QueryGenerator& set_time_of_next_query()
+    QueryGenerator& no_more_tasks()
     {
-        const auto now = TimeUnit::get_uptime();
-        using Time = TimeUnit::Nanoseconds<struct TimeTag_>;
-        const auto remaining_time = Time{time_end_ - now.get()};
-        static constexpr auto min_timeout = Time{std::chrono::microseconds{1000}};//smaller value exhausts file descriptors :-(
-        if (remaining_time <= Time::zero())
-        {
-            this->OnTimeout::set(min_timeout.template as<std::chrono::microseconds>());
-        }
-        else
-        {
-            const auto one_query_time = remaining_time / remaining_queries_;
-            this->OnTimeout::set((one_query_time < min_timeout ? min_timeout
-                                                               : one_query_time).template as<std::chrono::microseconds>());
-        }
+        more_tasks_expected_ = false;
+        remaining_queries_ = this->get_number_of_pending_tasks();
         return *this;
     }
-    Solver& solver_;
-    const VectorOfInsecures& to_resolve_;
-    VectorOfInsecures::const_iterator to_resolve_itr_;
-    std::size_t remaining_queries_;
-    GetDns::Context::Timeout query_timeout_;
-    std::chrono::nanoseconds time_end_;
-};
-
-struct QueryDone
-{
-    QueryDone(const std::string& domain,
-              const boost::asio::ip::address& address_of_nameserver)
-        : domain{domain},
-          address_of_nameserver{address_of_nameserver}
-    { }
-    explicit QueryDone(const Insecure& query)
-        : domain{query.domain},
-          address_of_nameserver{query.address}
-    { }
-    std::string domain;
-    boost::asio::ip::address address_of_nameserver;
-    friend bool operator<(const QueryDone& lhs, const QueryDone& rhs) noexcept
+    bool is_done() const
     {
-        return (lhs.domain < rhs.domain) ||
-               ((lhs.domain == rhs.domain) && (lhs.address_of_nameserver < rhs.address_of_nameserver));
+        return !more_tasks_expected_ && this->is_idle();
     }
-};
-
-using AnsweredQueries = std::set<QueryDone>;
-
-class Answer
-{
-public:
-    Answer(Event::Base& loop,
-           AnsweredQueries& answered,
-           const Util::ImReader& source,
-           std::chrono::seconds max_idle)
-        : source_{source},
-          answered_{answered},
-          event_ptr_{::event_new(loop,
-                                 source_.get_descriptor(),
-                                 monitored_events_ | EV_PERSIST,
-                                 callback_routine,
-                                 this)},
-          max_idle_{max_idle},
-          source_stream_closed_{false},
-          timed_out_{false}
-    {
-        this->monitor_events_on_source_stream();
-        while (true)
+    bool is_idle() const
+    {
+        return (this->get_number_of_pending_tasks() == 0) &&
+               (solver_.get_number_of_unresolved_requests() == 0);
+    }
+    //retries waiting for their backoff and tasks waiting for the sample of their address included
+    std::size_t get_number_of_pending_tasks() const
+    {
+        return pending_tasks_.size() + retries_.size() + samples_.size();
+    }
+    //number of tasks which would fill the window
+    std::size_t get_number_of_missing_tasks() const
+    {
+        const auto number_of_pending_tasks = this->get_number_of_pending_tasks();
+        return number_of_pending_tasks < window_.get_limit() ? window_.get_limit() - number_of_pending_tasks
+                                                             : 0;
+    }
+    QueryGenerator& process_finished_requests()
+    {
+        solver_.for_each_finished_request([&](Query& query)
         {
-            loop(Event::Loop::Once{});
-            if (timed_out_)
+            throughput_.query_finished();
+            const Task& to_resolve = query.get_task();
+            if (query.get_status() == Query::Status::completed)
+            {
+                window_.on_answer(query.get_sent_at());
+                timeouts_.on_answer(to_resolve.address, TimeUnit::get_uptime().get() - query.get_sent_at().get());
+                log(breaker_.on_answer(to_resolve.address), to_resolve.address);
+            }
+            else if (query.get_status() == Query::Status::timed_out)
+            {
+                window_.on_timeout(query.get_sent_at());
+                timeouts_.on_timeout(to_resolve.address);
+                log(breaker_.on_timeout(to_resolve.address, query.get_sent_at()), to_resolve.address);
+            }
+            else
+            {
+                log(breaker_.on_failure(to_resolve.address, query.get_sent_at()), to_resolve.address);
+            }
+            pending_tasks_.on_finished(to_resolve);
+            if (this->retry_later(query))
             {
                 return;
             }
-            if (content_.empty())
+            this->finish_sample(to_resolve, query.is_refusal());
+            if (query.get_status() == Query::Status::completed)
             {
-                if (source_stream_closed_)
+                const auto& result = query.get_result();
+                start_record(to_parent_, RecordType::insecure, to_resolve, nameserver_lists_).add(static_cast<std::uint32_t>(result.size()));
+                for (auto&& key : result)
                 {
-                    return;
+                    to_parent_.add(key.flags)
+                              .add(key.protocol)
+                              .add(key.algorithm)
+                              .add(key.public_key);
                 }
-                continue;
+                to_parent_.finish();
             }
-            const char* line_begin = content_.c_str();
-            while (*line_begin != '\0')
+            else
             {
-                const char* line_end = line_begin;
-                while ((*line_end != '\0') && (*line_end != '\n'))
-                {
-                    ++line_end;
-                }
-                const bool line_end_reached = (*line_end == '\n') || source_stream_closed_;
-                if (!line_end_reached)
-                {
-                    break;
-                }
-                this->line_received(line_begin, line_end);
-                const bool data_end_reached = (*line_end == '\0') && source_stream_closed_;
-                if (data_end_reached)
-                {
-                    return;
-                }
-                line_begin = line_end + 1;
+                start_record(to_parent_, RecordType::unresolved, to_resolve, nameserver_lists_).finish();
             }
-            content_ = line_begin;
-        }
-    }
-    ~Answer()
-    {
-        this->remove();
-    }
-    bool timed_out()const
-    {
-        return timed_out_;
+        });
+        to_parent_.flush();
+        return *this;
     }
-private:
-    static const char* skip_to(const char* begin, const char* end, char stop)
+    const QueryGenerator& print_statistics() const
     {
-        const char* position_of_stop_character = std::find(begin, end, stop);
-        const bool end_reached = position_of_stop_character == end;
-        if (!end_reached)
+        std::cerr << "insecure CDNSKEY resolver: " << throughput_ << ", " << window_ << ", " << timeouts_ << ", "
+                  << get_statistics_of(solver_) << std::endl;
+        const auto statistics = get_connection_statistics_of(solver_);
+        if (0 < statistics.connections)
+        {
+            std::cerr << "insecure CDNSKEY resolver: " << statistics.tasks << " tasks over "
+                      << statistics.connections << " tcp connections, "
+                      << (statistics.tasks - statistics.connections) << " handshakes saved, "
+                      << (double(statistics.tasks) / statistics.connections) << " tasks per connection" << std::endl;
+        }
+        if (0 < breaker_.get_number_of_opened_circuits())
         {
-            return position_of_stop_character;
+            std::cerr << "insecure CDNSKEY resolver: " << breaker_.get_number_of_opened_circuits() << " addresses cut off, "
+                      << number_of_rejected_tasks_ << " tasks unresolved without a query" << std::endl;
         }
-        throw std::runtime_error("stop character not found");
+        if (0 < number_of_pruned_tasks_)
+        {
+            std::cerr << "insecure CDNSKEY resolver: " << number_of_pruned_tasks_ << " tasks of refusing addresses pruned" << std::endl;
+        }
+        return *this;
     }
-    void line_received(const char* _line_begin, const char* _line_end)
+    QueryGenerator& on_timeout_occurrence()
     {
-        const int number_of_known_prefixes = 3;
-        const char* const known_prefixes[number_of_known_prefixes] =
-            {
-                "insecure",
-                "insecure-empty",
-                "unresolved"
-            };
-        const std::ptrdiff_t insecure_prefix_idx = 0;
-        const char* const* end_of_known_prefixes = known_prefixes + number_of_known_prefixes;
-        const char* nameserver_begin = nullptr;
-        const char* const* known_prefix_ptr = known_prefixes;
-        while (known_prefix_ptr < end_of_known_prefixes)
+        for (auto retry = retries_.pop_ready(); retry != boost::none; retry = retries_.pop_ready())
+        {
+            retry->item.attempt = retry->attempt;
+            pending_tasks_.push(std::move(retry->item));
+        }
+        const auto number_of_allowed_requests = pacer_.take(remaining_queries_);
+        std::size_t number_of_added_requests = 0;
+        while ((number_of_added_requests < number_of_allowed_requests) &&
+               (0 < this->get_number_of_pending_tasks()) &&
+               (solver_.get_number_of_unresolved_requests() < window_.get_limit()))
         {
-            const char* const prefix = *known_prefix_ptr;
-            const ::size_t prefix_len = std::strlen(prefix);
-            const int string_equal = 0;
-            const bool prefix_candidate_found = std::strncmp(_line_begin, prefix, prefix_len) == string_equal;
-            const bool prefix_found = prefix_candidate_found && (_line_begin[prefix_len] == ' ');
-            if (prefix_found)
+            auto task = pending_tasks_.pop();
+            if (task == boost::none)
             {
-                nameserver_begin = _line_begin + prefix_len + 1;
+                //addresses of all pending tasks are busy or only retries waiting for their backoff remain
                 break;
             }
-            ++known_prefix_ptr;
+            if (!breaker_.allow(task->address))
+            {
+                //the address does not answer, its tasks are not worth waiting for timeouts
+                start_record(to_parent_, RecordType::unresolved, *task, nameserver_lists_).finish();
+                pending_tasks_.on_finished(*task);
+                this->finish_sample(*task, false);
+                ++number_of_rejected_tasks_;
+                --remaining_queries_;
+                continue;
+            }
+            //retries of sampled tasks belong to the sample already
+            const auto admission = task->is_sample ? Samples::Admission::sample : samples_.admit(task->address);
+            if (admission == Samples::Admission::hold)
+            {
+                pending_tasks_.on_finished(*task);
+                samples_.hold(task->address, std::move(*task));
+                continue;
+            }
+            if (admission == Samples::Admission::prune)
+            {
+                pending_tasks_.on_finished(*task);
+                this->prune(*task);
+                --remaining_queries_;
+                continue;
+            }
+            task->is_sample = admission == Samples::Admission::sample;
+            errno = 0;
+            try
+            {
+                const auto timeout = timeouts_.get_timeout(task->address);
+                context_key_.upstreams->front() = task->address.to_address();
+                context_key_.timeout = GetDns::Context::Timeout{timeout};
+                solver_.add_request(Query{
+                        names_.table.get_name(task->domain),
+                        *task,
+                        borrow_context(solver_, context_key_),
+                        timeout});
+                ++number_of_added_requests;
+            }
+            catch (...)
+            {
+                const bool descriptors_exhausted = (errno == EMFILE) || (errno == ENFILE);
+                const auto number_of_queries_in_flight = solver_.get_number_of_unresolved_requests();
+                if (descriptors_exhausted && (0 < number_of_queries_in_flight))
+                {
+                    //the task will be tried again when some descriptors get released, it stays in the sample
+                    window_.on_descriptors_exhausted(number_of_queries_in_flight);
+                    breaker_.cancel(task->address);
+                    pending_tasks_.give_back(std::move(*task));
+                    break;
+                }
+                start_record(to_parent_, RecordType::unresolved, *task, nameserver_lists_).finish();
+                pending_tasks_.on_finished(*task);
+                //the query was about to be sent now
+                log(breaker_.on_failure(task->address, TimeUnit::get_uptime()), task->address);
+                this->finish_sample(*task, false);
+            }
+            --remaining_queries_;
         }
-        if (nameserver_begin == nullptr)
+        pacer_.give_back(number_of_allowed_requests - number_of_added_requests);
+        if (0 < this->get_number_of_pending_tasks())
         {
-            throw std::runtime_error("invalid data received");
+            this->OnTimeout::set(pacer_.get_time_to_next_tick());
         }
-        try
+        return *this;
+    }
+private:
+    static GetDns::ContextPool::Key make_context_key(GetDns::Context::Timeout query_timeout)
+    {
+        GetDns::ContextPool::Key key;
+        key.transports = GetDns::make_transports_vector(GetDns::TransportsList<Ts...>{});
+        key.timeout = query_timeout;
+        key.idle_timeout = tcp_idle_timeout;
+        //the only upstream is the address of the task, it is assigned in place for each query
+        key.upstreams = std::list<boost::asio::ip::address>{boost::asio::ip::address{}};
+        return key;
+    }
+    //query_timeout is the upper bound of adaptive timeouts
+    static Util::UpstreamTimeouts::Settings make_timeouts_settings(
+            GetDns::Context::Timeout query_timeout,
+            GetDns::Context::Timeout min_query_timeout)
+    {
+        return Util::UpstreamTimeouts::Settings{
+                min_query_timeout.as<std::chrono::nanoseconds>(),
+                initial_query_timeout,
+                query_timeout.as<std::chrono::nanoseconds>()};
+    }
+    //queries in flight keep at most number_of_descriptors descriptors open
+    static Util::ConcurrencyWindow::Settings make_window_settings(std::size_t number_of_descriptors)
+    {
+        auto settings = window_settings;
+        settings.max_limit = std::max(std::size_t{1}, number_of_descriptors / descriptors_per_query);
+        return settings;
+    }
+    //tasks of one address are sent in batches in quick succession so that they share one tcp connection
+    static Scheduler::Settings make_scheduler_settings(
+            std::size_t pipeline_depth,
+            const InsecureCdnskeyResolver::Politeness& politeness)
+    {
+        return Scheduler::Settings{
+                pipeline_depth,
+                politeness.max_queries_in_flight_per_ip,
+                politeness.max_queries_per_second_per_ip};
+    }
+    static Scheduler::GetKey get_key_of_task(const InsecureCdnskeyResolver::Politeness& politeness)
+    {
+        if (politeness.per_network)
         {
-            const char* const nameserver_end = skip_to(nameserver_begin, _line_end, ' ');
-            const char* const address_begin = nameserver_end + 1;
-            const char* const address_end = skip_to(address_begin, _line_end, ' ');
-            const std::string address_str(address_begin, address_end - address_begin);
-            boost::asio::ip::address address(boost::asio::ip::address::from_string(address_str));
-            const char* const domain_begin = address_end + 1;
-            const bool cdnskey_record_found = (known_prefix_ptr - known_prefixes) == insecure_prefix_idx;
-            const char* const domain_end = cdnskey_record_found ? skip_to(domain_begin, _line_end, ' ')
-                                                                : _line_end;
-            const std::string domain(domain_begin, domain_end - domain_begin);
-            const QueryDone query_done(domain, address);
-            answered_.insert(query_done);
-            std::cout << std::string(_line_begin, _line_end - _line_begin) << std::endl;
-            return;
+            return [](const Task& task) { return get_network_of(task.address); };
         }
-        catch (...)
+        return [](const Task& task) { return task.address; };
+    }
+    static void log(Breaker::Transition transition, const Util::IpAddress& address)
+    {
+        switch (transition)
         {
-            throw std::runtime_error("invalid data received");
+            case Breaker::Transition::none:
+                return;
+            case Breaker::Transition::opened:
+                std::cerr << "insecure CDNSKEY resolver: " << address << " cut off after consecutive timeouts" << std::endl;
+                return;
+            case Breaker::Transition::probe_failed:
+                std::cerr << "insecure CDNSKEY resolver: probe of " << address << " failed" << std::endl;
+                return;
+            case Breaker::Transition::closed:
+                std::cerr << "insecure CDNSKEY resolver: " << address << " answers again" << std::endl;
+                return;
         }
     }
-    Answer& monitor_events_on_source_stream()
+    //tasks of an address which refused all sampled queries are not asked
+    void prune(const Task& task)
     {
-        struct ::timeval timeout;
-        timeout.tv_sec = max_idle_.count();
-        timeout.tv_usec = 0;
-        const int success = 0;
-        const int retval = ::event_add(event_ptr_, &timeout);
-        if (retval == success)
+        switch (policy_of_refusing_)
         {
-            return *this;
+            case InsecureCdnskeyResolver::ProbeFirst::Policy::report_empty:
+                start_record(to_parent_, RecordType::insecure, task, nameserver_lists_).add(std::uint32_t{0}).finish();
+                break;
+            case InsecureCdnskeyResolver::ProbeFirst::Policy::report_unresolved:
+                start_record(to_parent_, RecordType::unresolved, task, nameserver_lists_).finish();
+                break;
         }
-        struct EventAddFailure:std::runtime_error
+        ++number_of_pruned_tasks_;
+    }
+    //every sampled task counts for the verdict of its address however it ends, rejected by the breaker included
+    void finish_sample(const Task& task, bool refused)
+    {
+        if (task.is_sample)
         {
-            EventAddFailure():std::runtime_error("event_add failed") { }
-        };
-        throw EventAddFailure();
+            this->release(task.address, samples_.on_result(task.address, refused));
+        }
     }
-    Answer& remove()
+    void release(const Util::IpAddress& address, boost::optional<Samples::Released> released)
     {
-        if (event_ptr_ != nullptr)
+        if (released == boost::none)
         {
-            ::event_del(event_ptr_);
-            ::event_free(event_ptr_);
-            event_ptr_ = nullptr;
+            return;
+        }
+        if (released->verdict == Samples::Verdict::pass)
+        {
+            for (auto&& task : released->items)
+            {
+                pending_tasks_.push(std::move(task));
+            }
+            this->OnTimeout::set(pacer_.get_time_to_next_tick());
+            return;
+        }
+        std::cerr << "insecure CDNSKEY resolver: " << address << " refused all sampled queries, "
+                  << released->items.size() << " tasks pruned" << std::endl;
+        for (auto&& task : released->items)
+        {
+            this->prune(task);
+            --remaining_queries_;
         }
-        return *this;
     }
-    void on_event(short _events)
+    //transient failures are asked again after a backoff if the assigned time allows
+    bool retry_later(const Query& query)
     {
-        const bool timed_out = (_events & EV_TIMEOUT) == EV_TIMEOUT;
-        if (timed_out)
+        const auto time_left = pacer_.get_remaining_time() - timeouts_.get_timeout(query.get_task().address);
+        if (!retries_.retry_later(query, query.get_task(), time_left, remaining_queries_))
         {
-            this->on_timeout();
+            return false;
         }
-        const bool ready_for_reading = (_events & EV_READ) == EV_READ;
-        if (ready_for_reading)
+        this->OnTimeout::set(pacer_.get_time_to_next_tick());
+        return true;
+    }
+    Solver& solver_;
+    Scheduler pending_tasks_;
+    std::size_t remaining_queries_;
+    bool more_tasks_expected_;
+    GetDns::ContextPool::Key context_key_;
+    Util::UpstreamTimeouts timeouts_;
+    Breaker breaker_;
+    std::size_t number_of_rejected_tasks_;
+    Samples samples_;
+    InsecureCdnskeyResolver::ProbeFirst::Policy policy_of_refusing_;
+    std::size_t number_of_pruned_tasks_;
+    Util::ConcurrencyWindow window_;
+    Util::Pacer pacer_;
+    Util::RetryQueue<Task> retries_;
+    Util::Throughput throughput_;
+    const NameTables& names_;
+    const NameserverLists& nameserver_lists_;
+    Util::RecordWriter& to_parent_;
+};
+
+template <typename ...Ts>
+class NameserverQueryGenerator : public Event::OnTimeout<NameserverQueryGenerator<Ts...>>
+{
+public:
+    using Solver = GetDns::Solver<NameserverQuery>;
+    using OnTimeout = Event::OnTimeout<NameserverQueryGenerator>;
+    NameserverQueryGenerator(
+            Solver& solver,
+            const std::vector<std::uint32_t>& nameservers,
+            GetDns::Context::Timeout query_timeout,
+            const std::list<boost::asio::ip::address>& resolvers,
+            Util::Pacer pacer,
+            const Util::RetrySettings& retries,
+            std::size_t number_of_descriptors,
+            const NameTables& names,
+            Util::RecordWriter& to_parent)
+        : OnTimeout{solver.get_event_base()},
+          solver_{solver},
+          nameservers_{nameservers},
+          nameserver_itr_{nameservers_.begin()},
+          remaining_queries_{nameservers_.size()},
+          context_key_{make_context_key(query_timeout, resolvers)},
+          window_{make_window_settings(number_of_descriptors)},
+          pacer_{pacer},
+          retries_{retries},
+          throughput_{},
+          names_{names},
+          to_parent_{to_parent}
+    {
+        if (0 < remaining_queries_)
         {
-            this->on_read();
+            this->OnTimeout::set(std::chrono::microseconds{0});
         }
     }
-    void on_timeout()
+    bool is_done() const
     {
-        timed_out_ = true;
+        return (remaining_queries_ == 0) && (solver_.get_number_of_unresolved_requests() == 0);
     }
-    void on_read()
+    ResolvedNameservers process_finished_requests()
     {
-        char buffer[0x10000];
-        while (true)
+        ResolvedNameservers resolved;
+        solver_.for_each_finished_request([&](NameserverQuery& query)
         {
-            static constexpr ::ssize_t failure = -1;
-            const auto read_retval = ::read(source_.get_descriptor(), buffer, sizeof(buffer));
-            const bool read_failed = (read_retval == failure);
-            if (!read_failed)
+            throughput_.query_finished();
+            //retried queries count in the window too
+            if (query.get_status() == NameserverQuery::Status::completed)
+            {
+                window_.on_answer(query.get_sent_at());
+            }
+            else if (query.get_status() == NameserverQuery::Status::timed_out)
+            {
+                window_.on_timeout(query.get_sent_at());
+            }
+            if (this->retry_later(query))
+            {
+                return;
+            }
+            const auto index = query.get_index();
+            switch (query.get_status())
             {
-                const bool end_reached = (read_retval == 0);
-                if (end_reached)
+                case NameserverQuery::Status::completed:
                 {
-                    source_stream_closed_ = true;
+                    const NameserverQuery::Result& addresses = query.get_result();
+                    if (addresses.empty())
+                    {
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
+                    }
+                    else
+                    {
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::resolved))
+                                  .add(index)
+                                  .add(static_cast<std::uint32_t>(addresses.size()));
+                        for (auto&& addr : addresses)
+                        {
+                            to_parent_.add(addr);
+                        }
+                        to_parent_.finish();
+                        resolved.push_back(ResolvedNameserver{index, addresses});
+                    }
+                    break;
                 }
-                else
+                case NameserverQuery::Status::timed_out:
+                    to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
+                    break;
+                case NameserverQuery::Status::cancelled:
+                case NameserverQuery::Status::failed:
+                case NameserverQuery::Status::in_progress:
+                case NameserverQuery::Status::none:
+                    to_parent_.start(static_cast<std::uint8_t>(RecordType::unresolved_ip)).add(index).finish();
+                    break;
+            }
+        });
+        return resolved;
+    }
+    const NameserverQueryGenerator& print_statistics() const
+    {
+        if (0 < throughput_.get_number_of_queries())
+        {
+            std::cerr << "hostname resolver: " << throughput_ << ", " << window_ << ", "
+                      << solver_.get_context_pool().get_statistics() << std::endl;
+        }
+        return *this;
+    }
+    NameserverQueryGenerator& on_timeout_occurrence()
+    {
+        const auto number_of_allowed_requests = pacer_.take(remaining_queries_);
+        std::size_t number_of_added_requests = 0;
+        while ((number_of_added_requests < number_of_allowed_requests) &&
+               (0 < remaining_queries_) &&
+               (solver_.get_number_of_unresolved_requests() < window_.get_limit()))
+        {
+            auto retry = retries_.pop_ready();
+            if ((retry == boost::none) && (nameserver_itr_ == nameservers_.end()))
+            {
+                //only retries waiting for their backoff remain
+                break;
+            }
+            const std::uint32_t nameserver = retry != boost::none ? retry->item : *nameserver_itr_;
+            errno = 0;
+            try
+            {
+                solver_.add_request(NameserverQuery{
+                        nameserver,
+                        names_.table.get_name(names_.nameservers[nameserver]),
+                        solver_.get_context_pool().borrow(context_key_),
+                        retry != boost::none ? retry->attempt : 1});
+            }
+            catch (...)
+            {
+                const bool descriptors_exhausted = (errno == EMFILE) || (errno == ENFILE);
+                const auto number_of_queries_in_flight = solver_.get_number_of_unresolved_requests();
+                if (descriptors_exhausted && (0 < number_of_queries_in_flight))
                 {
-                    const auto data_length = static_cast<std::size_t>(read_retval);
-                    content_.append(buffer, data_length);
-                    const bool all_available_data_already_read = data_length < sizeof(buffer);
-                    if (!all_available_data_already_read)
+                    //the nameserver will be tried again when some descriptors get released
+                    window_.on_descriptors_exhausted(number_of_queries_in_flight);
+                    if (retry != boost::none)
                     {
-                        continue;
+                        retries_.give_back(std::move(*retry));
                     }
+                    break;
                 }
-                return;
+                throw;
             }
-            const int c_errno = errno;
-            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK);
-            if (data_unavailable)
+            ++number_of_added_requests;
+            if (retry == boost::none)
             {
-                return;
+                ++nameserver_itr_;
             }
-            const bool operation_was_interrupted_by_a_signal = c_errno == EINTR;
-            if (operation_was_interrupted_by_a_signal)
+            --remaining_queries_;
+        }
+        pacer_.give_back(number_of_allowed_requests - number_of_added_requests);
+        if (0 < remaining_queries_)
+        {
+            this->OnTimeout::set(pacer_.get_time_to_next_tick());
+        }
+        return *this;
+    }
+private:
+    //transient failures are asked again after a backoff if the assigned time allows
+    bool retry_later(const NameserverQuery& query)
+    {
+        const auto time_left = pacer_.get_remaining_time() - context_key_.timeout.template as<std::chrono::nanoseconds>();
+        if (!retries_.retry_later(query, query.get_index(), time_left, remaining_queries_))
+        {
+            return false;
+        }
+        this->OnTimeout::set(pacer_.get_time_to_next_tick());
+        return true;
+    }
+    static GetDns::ContextPool::Key make_context_key(
+            GetDns::Context::Timeout query_timeout,
+            const std::list<boost::asio::ip::address>& resolvers)
+    {
+        GetDns::ContextPool::Key key;
+        key.upstreams = resolvers;
+        key.transports = GetDns::make_transports_vector(GetDns::TransportsList<Ts...>{});
+        key.timeout = query_timeout;
+        return key;
+    }
+    //queries in flight keep at most number_of_descriptors descriptors open
+    static Util::ConcurrencyWindow::Settings make_window_settings(std::size_t number_of_descriptors)
+    {
+        auto settings = nameserver_window_settings;
+        settings.max_limit = std::max(std::size_t{1}, number_of_descriptors / descriptors_per_nameserver_query);
+        return settings;
+    }
+    Solver& solver_;
+    const std::vector<std::uint32_t>& nameservers_;
+    std::vector<std::uint32_t>::const_iterator nameserver_itr_;
+    std::size_t remaining_queries_;
+    GetDns::ContextPool::Key context_key_;
+    Util::ConcurrencyWindow window_;
+    Util::Pacer pacer_;
+    Util::RetryQueue<std::uint32_t> retries_;
+    Util::Throughput throughput_;
+    const NameTables& names_;
+    Util::RecordWriter& to_parent_;
+};
+
+//queries of a nameserver resolved by the worker are asked by the same worker whatever their addresses are
+//tasks of one address make a group, the group is processed by one thread so that its queries share
+//tcp connections of the thread
+std::vector<Tasks> make_groups_of_the_same_address(Tasks tasks)
+{
+    std::stable_sort(begin(tasks), end(tasks), [](auto&& lhs, auto&& rhs) { return lhs.address < rhs.address; });
+    std::vector<Tasks> groups;
+    for (auto&& task : tasks)
+    {
+        if (groups.empty() || (groups.back().front().address != task.address))
+        {
+            groups.emplace_back();
+        }
+        groups.back().push_back(std::move(task));
+    }
+    return groups;
+}
+
+std::vector<std::uint32_t> get_unresolved_nameservers(
+        const NameserverStates& nameservers,
+        const NameTables& names,
+        Util::Shard shard = Util::Shard{0, 1})
+{
+    std::vector<std::uint32_t> unresolved;
+    for (std::uint32_t nameserver = 0; nameserver < nameservers.size(); ++nameserver)
+    {
+        if (!nameservers[nameserver].is_resolved && shard.owns(names.nameservers[nameserver]))
+        {
+            unresolved.push_back(nameserver);
+        }
+    }
+    return unresolved;
+}
+
+std::size_t get_number_of_unanswered_queries(const NameserverStates& nameservers)
+{
+    std::size_t number_of_queries = 0;
+    for (auto&& state : nameservers)
+    {
+        number_of_queries += state.answered.size() - state.answered.count();
+    }
+    return number_of_queries;
+}
+
+std::size_t get_estimated_number_of_queries(
+        const std::vector<std::uint32_t>& unresolved_nameservers,
+        const NameserverStates& nameservers)
+{
+    //nameserver usually has one IPv4 and one IPv6 address
+    static constexpr std::size_t estimated_number_of_addresses = 2;
+    std::size_t number_of_queries = 0;
+    for (auto&& nameserver : unresolved_nameservers)
+    {
+        number_of_queries += estimated_number_of_addresses * nameservers[nameserver].domains.size();
+    }
+    return number_of_queries;
+}
+
+//handles records received from child processes
+class Answer
+{
+public:
+    Answer(const NameTables& names,
+           NameserverStates& nameservers)
+        : names_{names},
+          nameservers_{nameservers}
+    { }
+    void operator()(Util::Record& record) const
+    {
+        const auto type = static_cast<RecordType>(record.get_type());
+        switch (type)
+        {
+            case RecordType::resolved:
             {
+                NameserverState& nameserver = this->get_nameserver(record.get_uint32());
+                Util::IpAddresses addresses;
+                for (auto number_of_addresses = record.get_uint32(); 0 < number_of_addresses; --number_of_addresses)
+                {
+                    Util::insert(addresses, record.get_address());
+                }
+                set_addresses(nameserver, std::move(addresses));
                 return;
             }
-            struct ReadFailed:std::runtime_error
+            case RecordType::unresolved_ip:
             {
-                ReadFailed(int error_code):std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
-            };
-            throw ReadFailed(c_errno);
+                const auto index = record.get_uint32();
+                this->get_nameserver(index).is_resolved = true;
+                std::cout << "unresolved-ip " << this->get_name_of_nameserver(index) << '\n';
+                return;
+            }
+            case RecordType::insecure:
+            case RecordType::unresolved:
+                break;
+            default:
+                throw std::runtime_error("invalid data received");
         }
-    }
-    static void callback_routine(evutil_socket_t _fd, short _events, void* _user_data_ptr)
-    {
-        auto const event_ptr = static_cast<Answer*>(_user_data_ptr);
-        if ((event_ptr != nullptr) && (event_ptr->source_.get_descriptor() == _fd))
+        const auto domain = record.get_uint32();
+        const auto address = record.get_address();
+        std::vector<std::uint32_t> nameservers(record.get_uint32());
+        for (auto&& nameserver : nameservers)
         {
-            try
+            nameserver = record.get_uint32();
+            this->set_answered(nameserver, domain, address);
+        }
+        const char* const domain_name = this->get_name_of_domain(domain);
+        if (type == RecordType::unresolved)
+        {
+            for (auto&& nameserver : nameservers)
             {
-                event_ptr->on_event(_events);
+                std::cout << "unresolved " << this->get_name_of_nameserver(nameserver) << " " << address << " " << domain_name << '\n';
             }
-            catch (const std::exception& e)
+            return;
+        }
+        std::vector<Cdnskey> keys(record.get_uint32());
+        for (auto&& key : keys)
+        {
+            key.flags = record.get_uint16();
+            key.protocol = record.get_uint8();
+            key.algorithm = record.get_uint8();
+            key.public_key = record.get_string();
+        }
+        for (auto&& nameserver : nameservers)
+        {
+            const char* const nameserver_name = this->get_name_of_nameserver(nameserver);
+            if (keys.empty())
             {
-                std::cerr << "Answer::on_event failed: " << e.what() << std::endl;
+                std::cout << "insecure-empty " << nameserver_name << " " << address << " " << domain_name << '\n';
             }
-            catch (...)
+            for (auto&& key : keys)
             {
-                std::cerr << "Answer::on_event caught an unexpected exception" << std::endl;
+                std::cout << "insecure " << nameserver_name << " " << address << " " << domain_name << " " << key << '\n';
             }
         }
     }
-    const Util::ImReader& source_;
-    AnsweredQueries& answered_;
-    struct ::event* event_ptr_;
-    std::chrono::seconds max_idle_;
-    std::string content_;
-    bool source_stream_closed_;
-    bool timed_out_;
-    static constexpr auto monitored_events_ = short{EV_READ};
+private:
+    const char* get_name_of_nameserver(std::size_t index) const
+    {
+        if (index < names_.nameservers.size())
+        {
+            return names_.table.get_name(names_.nameservers[index]);
+        }
+        throw std::runtime_error("invalid data received");
+    }
+    const char* get_name_of_domain(Util::NameTable::Id domain) const
+    {
+        if (domain < names_.table.size())
+        {
+            return names_.table.get_name(domain);
+        }
+        throw std::runtime_error("invalid data received");
+    }
+    NameserverState& get_nameserver(std::size_t index) const
+    {
+        if (index < nameservers_.size())
+        {
+            return nameservers_[index];
+        }
+        throw std::runtime_error("invalid data received");
+    }
+    void set_answered(std::uint32_t nameserver, std::uint32_t domain, const Util::IpAddress& address) const
+    {
+        NameserverState& state = this->get_nameserver(nameserver);
+        const auto domain_itr = std::lower_bound(begin(state.domains), end(state.domains), domain);
+        const auto address_itr = std::lower_bound(begin(state.addresses), end(state.addresses), address);
+        if ((domain_itr == end(state.domains)) || (*domain_itr != domain) ||
+            (address_itr == end(state.addresses)) || (*address_itr != address))
+        {
+            throw std::runtime_error("invalid data received");
+        }
+        const auto domain_slot = static_cast<std::size_t>(std::distance(begin(state.domains), domain_itr));
+        const auto address_slot = static_cast<std::size_t>(std::distance(begin(state.addresses), address_itr));
+        state.answered.set(domain_slot * state.addresses.size() + address_slot);
+    }
+    const NameTables& names_;
+    NameserverStates& nameservers_;
 };
 
+//a queued task costs its own size and the same again for the queue; the estimate decides the size of a batch
+//of tasks only, the resident memory is read again before each batch
+constexpr std::size_t memory_per_buffered_task = 2 * sizeof(Task);
+
 template <typename ...Ts>
 class ChildProcess
 {
 public:
     ChildProcess(
-            const VectorOfInsecures& to_resolve,
+            const NameTables& names,
+            const NameserverStates& nameservers,
+            Util::Shard shard,
+            const std::vector<std::uint32_t>& nameservers_to_resolve,
+            const std::list<boost::asio::ip::address>& hostname_resolvers,
             GetDns::Context::Timeout query_timeout,
-            std::chrono::nanoseconds assigned_time,
-            const AnsweredQueries& answered,
+            GetDns::Context::Timeout min_query_timeout,
+            std::chrono::nanoseconds time_for_nameservers,
+            std::chrono::nanoseconds time_for_tasks,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t context_pool_size,
+            std::size_t pipeline_depth,
+            std::size_t max_connections_per_ip,
+            const InsecureCdnskeyResolver::Politeness& politeness,
+            const Util::CircuitBreakerSettings& breaker,
+            const InsecureCdnskeyResolver::ProbeFirst& probe_first,
+            const AddressClassifier& address_classifier,
+            InsecureCdnskeyResolver::IoBackend io_backend,
+            std::size_t memory_limit,
+            std::size_t number_of_threads,
             Util::Pipe& pipe_to_parent)
-        : to_resolve_{to_resolve},
+        : names_{names},
+          nameservers_{nameservers},
+          shard_{shard},
+          nameservers_to_resolve_{nameservers_to_resolve},
+          hostname_resolvers_{hostname_resolvers},
           query_timeout_{query_timeout},
-          assigned_time_{assigned_time},
-          answered_{answered},
+          min_query_timeout_{min_query_timeout},
+          time_for_nameservers_{time_for_nameservers},
+          time_for_tasks_{time_for_tasks},
+          pacing_{pacing},
+          retries_{retries},
+          context_pool_size_{context_pool_size},
+          pipeline_depth_{pipeline_depth},
+          max_connections_per_ip_{max_connections_per_ip},
+          politeness_{politeness},
+          breaker_{breaker},
+          probe_first_{probe_first},
+          address_classifier_{address_classifier},
+          io_backend_{io_backend},
+          memory_limit_{memory_limit},
+          number_of_threads_{number_of_threads},
           pipe_to_parent_{pipe_to_parent}
     { }
     int operator()()const
     {
         Util::ImWriter to_parent{pipe_to_parent_, Util::ImWriter::Stream::stdout};
-        GetDns::Solver<Query> solver;
-        if (answered_.empty())
+        if (1 < number_of_threads_)
         {
-            const QueryGenerator<Ts...> resolve{
-                    solver,
-                    to_resolve_,
-                    query_timeout_,
-                    assigned_time_};
+            return this->resolve_in_threads();
         }
-        else
+        Event::Base event_base;
+        switch (io_backend_)
         {
-            VectorOfInsecures to_resolve;
-            to_resolve.reserve(to_resolve_.size() - answered_.size());
-            for (auto&& task : to_resolve_)
+            case InsecureCdnskeyResolver::IoBackend::libevent:
             {
-                const bool resolved = answered_.find(QueryDone(task)) != answered_.end();
-                if (!resolved)
+                LibeventSolver solver{event_base, context_pool_size_};
+                return this->resolve_here(solver);
+            }
+            case InsecureCdnskeyResolver::IoBackend::io_uring:
+            {
+                UringSolver solver{event_base, uring_entries};
+                return this->resolve_here(solver);
+            }
+        }
+        throw std::logic_error("unexpected I/O backend");
+    }
+private:
+    using Groups = Util::WorkStealingQueues<Tasks>;
+    //nameservers are resolved by getdns in the event loop of the solver whichever I/O backend it uses
+    template <typename Solver>
+    int resolve_here(Solver& solver) const
+    {
+        Util::RecordWriter records_to_parent{STDOUT_FILENO};
+        auto& event_base = solver.get_event_base();
+        GetDns::Solver<NameserverQuery> nameserver_solver{event_base, context_pool_size_};
+        //both generators share one event loop and so one limit
+        Util::TokenBucket limit{pacing_.get_limit()};
+        NameserverLists nameserver_lists;
+        TaskSources sources;
+        sources.emplace_back(nameservers_, shard_, address_classifier_);
+        const auto expected_number_of_tasks = sources.front().get_number_of_queries() +
+                                              get_estimated_number_of_queries(nameservers_to_resolve_, nameservers_);
+        NameserverQueryGenerator<GetDns::TransportProtocol::Udp, GetDns::TransportProtocol::Tcp> resolve_nameservers{
+                nameserver_solver,
+                nameservers_to_resolve_,
+                query_timeout_,
+                hostname_resolvers_,
+                Util::Pacer{limit, pacing_, time_for_nameservers_},
+                retries_,
+                this->get_descriptors_of_nameservers(),
+                names_,
+                records_to_parent};
+        QueryGenerator<Solver, Ts...> resolve{
+                solver,
+                Tasks{},
+                query_timeout_,
+                min_query_timeout_,
+                pipeline_depth_,
+                max_connections_per_ip_,
+                politeness_,
+                breaker_,
+                probe_first_,
+                expected_number_of_tasks,
+                Util::Pacer{limit, pacing_, time_for_tasks_},
+                retries_,
+                this->get_descriptors_of_tasks(),
+                names_,
+                nameserver_lists,
+                records_to_parent};
+        while (true)
+        {
+            if (resolve_nameservers.is_done() && sources.empty())
+            {
+                resolve.no_more_tasks();
+                if (resolve.is_done())
                 {
-                    to_resolve.push_back(task);
+                    break;
                 }
             }
-            const auto resolve = QueryGenerator<Ts...>{
-                    solver,
-                    to_resolve,
-                    query_timeout_,
-                    std::chrono::nanoseconds{static_cast<std::int64_t>(assigned_time_.count() * double(to_resolve.size()) / to_resolve_.size())}};
+            //more tasks are generated once a half of the buffered ones is gone
+            const auto number_of_pending_tasks = resolve.get_number_of_pending_tasks();
+            if (!sources.empty() && (number_of_pending_tasks < max_number_of_buffered_tasks / 2))
+            {
+                const auto number_of_tasks = this->limit_by_memory(max_number_of_buffered_tasks - number_of_pending_tasks);
+                if (0 < number_of_tasks)
+                {
+                    resolve.add_tasks(Util::take_tasks(
+                            sources,
+                            number_of_tasks,
+                            tasks_per_address_in_turn,
+                            nameserver_lists,
+                            report_as_unresolved(records_to_parent, nameserver_lists)));
+                }
+                else if (resolve.is_idle())
+                {
+                    records_to_parent.flush();
+                    resolve_nameservers.print_statistics();
+                    resolve.print_statistics();
+                    report_memory_limit_exceeded();
+                    return EXIT_FAILURE;
+                }
+            }
+            solver.do_one_step();
+            const auto resolved = resolve_nameservers.process_finished_requests();
+            if (!resolved.empty())
+            {
+                sources.emplace_back(resolved, nameservers_, address_classifier_);
+            }
+            resolve.process_finished_requests();
         }
+        resolve_nameservers.print_statistics();
+        resolve.print_statistics();
         return EXIT_SUCCESS;
     }
-private:
-    const VectorOfInsecures& to_resolve_;
-    GetDns::Context::Timeout query_timeout_;
-    std::chrono::nanoseconds assigned_time_;
-    const AnsweredQueries& answered_;
-    Util::Pipe& pipe_to_parent_;
-};
-
-}//namespace {anonymous}
-
-void InsecureCdnskeyResolver::resolve(
-        const VectorOfInsecures& to_resolve,
-        GetDns::Context::Timeout query_timeout,
-        std::chrono::nanoseconds assigned_time)
-{
-    if (to_resolve.empty())
+    //CDNSKEY queries are asked by a pool of threads, each one with its own event loop; this thread resolves
+    //nameservers and hands out groups of tasks of the same address, an idle thread steals whole groups
+    int resolve_in_threads() const
     {
-        return;
-    }
-    VectorOfInsecures to_resolve_on_public_addresses;
-    to_resolve_on_public_addresses.reserve(to_resolve.size());
-    std::copy_if(
-            begin(to_resolve),
-            end(to_resolve),
-            back_inserter(to_resolve_on_public_addresses),
-            [](auto&& insecure)
+        std::mutex output_lock;
+        Util::RecordWriter records_to_parent{STDOUT_FILENO, output_lock};
+        Groups groups{number_of_threads_};
+        Util::QueuedTasks queued_tasks{max_number_of_buffered_tasks};
+        NameserverLists nameserver_lists;
+        TaskSources sources;
+        //false if the memory limit let no task through
+        const auto push_groups = [&]()
+        {
+            //more tasks are queued once a half of the queued ones is gone
+            const auto room = queued_tasks.get_room();
+            if (sources.empty() || (room < max_number_of_buffered_tasks / 2))
+            {
+                return true;
+            }
+            const auto number_of_tasks = this->limit_by_memory(room);
+            if (number_of_tasks <= 0)
+            {
+                return false;
+            }
+            //addresses give all their tasks at once, so that queries of one address are asked by one thread
+            auto tasks = Util::take_tasks(
+                    sources,
+                    number_of_tasks,
+                    std::numeric_limits<std::size_t>::max(),
+                    nameserver_lists,
+                    report_as_unresolved(records_to_parent, nameserver_lists));
+            //the parent has to know addresses of nameservers before answers of their queries come
+            records_to_parent.flush();
+            queued_tasks.add(tasks.size());
+            for (auto&& group : make_groups_of_the_same_address(std::move(tasks)))
+            {
+                const auto owner = group.front().address.get_hash();
+                groups.push(owner, std::move(group));
+            }
+            return true;
+        };
+        sources.emplace_back(nameservers_, shard_, address_classifier_);
+        const auto expected_number_of_tasks = sources.front().get_number_of_queries() +
+                                              get_estimated_number_of_queries(nameservers_to_resolve_, nameservers_);
+        push_groups();
+        std::atomic<bool> thread_failed{false};
+        bool memory_limit_exceeded = false;
+        std::vector<std::thread> threads;
+        const auto join_threads = [&]()
+        {
+            groups.close();
+            for (auto&& thread : threads)
+            {
+                thread.join();
+            }
+        };
+        try
+        {
+            for (std::size_t thread_idx = 0; thread_idx < number_of_threads_; ++thread_idx)
             {
-                if (is_public(insecure.address))
+                threads.emplace_back([&, thread_idx]()
                 {
-                    return true;
+                    try
+                    {
+                        this->resolve_groups(
+                                thread_idx,
+                                groups,
+                                queued_tasks,
+                                nameserver_lists,
+                                expected_number_of_tasks / number_of_threads_,
+                                output_lock);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "thread " << thread_idx << " failed: " << e.what() << std::endl;
+                        thread_failed = true;
+                    }
+                    catch (...)
+                    {
+                        std::cerr << "thread " << thread_idx << " caught an unexpected exception" << std::endl;
+                        thread_failed = true;
+                    }
+                });
+            }
+            Event::Base event_base;
+            GetDns::Solver<NameserverQuery> nameserver_solver{event_base, context_pool_size_};
+            Util::TokenBucket limit{this->get_pacing_of_thread().get_limit()};
+            NameserverQueryGenerator<GetDns::TransportProtocol::Udp, GetDns::TransportProtocol::Tcp> resolve_nameservers{
+                    nameserver_solver,
+                    nameservers_to_resolve_,
+                    query_timeout_,
+                    hostname_resolvers_,
+                    Util::Pacer{limit, pacing_, time_for_nameservers_},
+                    retries_,
+                    this->get_descriptors_of_nameservers(),
+                    names_,
+                    records_to_parent};
+            while (!resolve_nameservers.is_done())
+            {
+                nameserver_solver.do_one_step();
+                const auto resolved = resolve_nameservers.process_finished_requests();
+                if (!resolved.empty())
+                {
+                    sources.emplace_back(resolved, nameservers_, address_classifier_);
                 }
-                std::for_each(
-                        begin(insecure.nameservers),
-                        end(insecure.nameservers),
-                        [&](auto&& nameserver)
-                        {
-                            std::cout << "unresolved " << nameserver << " "
-                                      << insecure.address << " "
-                                      << insecure.domain << std::endl;
-                        });
-                return false;
-            });
-    std::set<QueryDone> answered;
-    while (answered.size() < to_resolve_on_public_addresses.size())
+                push_groups();
+            }
+            resolve_nameservers.print_statistics();
+            //a failed thread does not take its groups anymore
+            while (!sources.empty() && !thread_failed && !memory_limit_exceeded)
+            {
+                queued_tasks.wait_for_room(std::chrono::milliseconds{100});
+                //threads finish the tasks they took already
+                memory_limit_exceeded = !push_groups() && (queued_tasks.size() == 0);
+            }
+        }
+        catch (...)
+        {
+            join_threads();
+            throw;
+        }
+        join_threads();
+        if (memory_limit_exceeded)
+        {
+            report_memory_limit_exceeded();
+            return EXIT_FAILURE;
+        }
+        return thread_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    void resolve_groups(
+            std::size_t thread_idx,
+            Groups& groups,
+            Util::QueuedTasks& queued_tasks,
+            const NameserverLists& nameserver_lists,
+            std::size_t expected_number_of_tasks,
+            std::mutex& output_lock) const
     {
-        Util::Pipe pipe;
-        Util::Fork parent{
-                ChildProcess<GetDns::TransportProtocol::Tcp>{
-                        to_resolve_on_public_addresses,
-                        query_timeout,
-                        assigned_time,
-                        answered,
-                        pipe}};
-        Util::ImReader from_child{pipe};
-        from_child.set_nonblocking();
-        Event::Base monitor;
-        const auto query_distance_sec = (assigned_time.count() / double(to_resolve_on_public_addresses.size())) / 1000000000LL;
-        const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
-        const auto answer = Answer{monitor, answered, from_child, answer_timeout};
-        try
+        Event::Base event_base;
+        switch (io_backend_)
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.get_child_result_status();
-            if (child_result_status.exited())
+            case InsecureCdnskeyResolver::IoBackend::libevent:
+            {
+                LibeventSolver solver{event_base, context_pool_size_};
+                return this->resolve_groups(solver, thread_idx, groups, queued_tasks, nameserver_lists, expected_number_of_tasks, output_lock);
+            }
+            case InsecureCdnskeyResolver::IoBackend::io_uring:
             {
-                if (child_result_status.get_exit_status() == EXIT_SUCCESS)
+                UringSolver solver{event_base, uring_entries};
+                return this->resolve_groups(solver, thread_idx, groups, queued_tasks, nameserver_lists, expected_number_of_tasks, output_lock);
+            }
+        }
+        throw std::logic_error("unexpected I/O backend");
+    }
+    template <typename Solver>
+    void resolve_groups(
+            Solver& solver,
+            std::size_t thread_idx,
+            Groups& groups,
+            Util::QueuedTasks& queued_tasks,
+            const NameserverLists& nameserver_lists,
+            std::size_t expected_number_of_tasks,
+            std::mutex& output_lock) const
+    {
+        Util::RecordWriter records_to_parent{STDOUT_FILENO, output_lock};
+        Util::TokenBucket limit{this->get_pacing_of_thread().get_limit()};
+        QueryGenerator<Solver, Ts...> resolve{
+                solver,
+                Tasks{},
+                query_timeout_,
+                min_query_timeout_,
+                pipeline_depth_,
+                max_connections_per_ip_,
+                politeness_,
+                breaker_,
+                probe_first_,
+                expected_number_of_tasks,
+                Util::Pacer{limit, pacing_, time_for_tasks_},
+                retries_,
+                this->get_descriptors_of_tasks() / number_of_threads_,
+                names_,
+                nameserver_lists,
+                records_to_parent};
+        while (true)
+        {
+            Tasks tasks;
+            while (tasks.size() < resolve.get_number_of_missing_tasks())
+            {
+                //an idle thread waits for more groups
+                const bool wait_for_group = tasks.empty() && resolve.is_idle();
+                auto group = wait_for_group ? groups.take(thread_idx)
+                                            : groups.try_take(thread_idx);
+                if (group == boost::none)
                 {
-                    std::cerr << "insecure CDNSKEY records resolved" << std::endl;
-                    if (answered.size() < to_resolve_on_public_addresses.size())
+                    if (wait_for_group)
                     {
-                        throw std::runtime_error("insecure CDNSKEY resolver did not complete it's job");
+                        resolve.no_more_tasks();
                     }
-                    return;
+                    break;
                 }
-                std::cerr << "child process failed" << std::endl;
+                queued_tasks.remove(group->size());
+                std::move(begin(*group), end(*group), back_inserter(tasks));
             }
-            else if (child_result_status.signaled())
+            if (!tasks.empty())
             {
-                std::cerr << "child process terminated by signal " << child_result_status.get_signal_number() << std::endl;
+                resolve.add_tasks(std::move(tasks));
             }
-            else
+            if (resolve.is_done())
             {
-                std::cerr << "child process done" << std::endl;
+                break;
             }
+            solver.do_one_step();
+            resolve.process_finished_requests();
+        }
+        resolve.print_statistics();
+    }
+    //number of tasks which may be generated now, at most number_of_tasks; the memory limit counts memory
+    //inherited from the parent too, a batch takes a half of the memory left under the limit at most, so an
+    //estimate of the memory of a task off by half does not exceed it, nothing is generated over the limit
+    std::size_t limit_by_memory(std::size_t number_of_tasks) const
+    {
+        if (memory_limit_ <= 0)
+        {
+            return number_of_tasks;
+        }
+        const auto resident_memory = Util::get_resident_memory();
+        const auto free_memory = resident_memory < memory_limit_ ? memory_limit_ - resident_memory : 0;
+        return std::min(number_of_tasks, free_memory / 2 / memory_per_buffered_task);
+    }
+    //resident memory does not shrink by waiting, the parent starts a new worker for the rest of the tasks
+    static void report_memory_limit_exceeded()
+    {
+        std::cerr << "insecure CDNSKEY resolver: memory limit exceeded, "
+                  << (Util::get_resident_memory() / bytes_per_mib) << " MiB resident" << std::endl;
+    }
+    //a fixed part of the descriptors of this process, the window of nameserver queries never takes more
+    static std::size_t get_descriptors_of_nameservers()
+    {
+        return Util::ConcurrencyWindow::get_descriptors_budget(1) / descriptors_of_nameservers_divisor;
+    }
+    //descriptors of this process left by nameserver queries, threads asking CDNSKEY queries split them
+    std::size_t get_descriptors_of_tasks() const
+    {
+        const bool nameservers_resolved_here = !nameservers_to_resolve_.empty();
+        return Util::ConcurrencyWindow::get_descriptors_budget(1) -
+               (nameservers_resolved_here ? get_descriptors_of_nameservers() : 0);
+    }
+    //event loops of threads do not share a limit, each one gets its part of the limit of this process
+    Util::Pacer::Settings get_pacing_of_thread() const
+    {
+        const bool nameservers_resolved_here = !nameservers_to_resolve_.empty();
+        return pacing_.get_part(number_of_threads_ + (nameservers_resolved_here ? 1 : 0));
+    }
+    const NameTables& names_;
+    const NameserverStates& nameservers_;
+    Util::Shard shard_;
+    const std::vector<std::uint32_t>& nameservers_to_resolve_;
+    const std::list<boost::asio::ip::address>& hostname_resolvers_;
+    GetDns::Context::Timeout query_timeout_;
+    GetDns::Context::Timeout min_query_timeout_;
+    std::chrono::nanoseconds time_for_nameservers_;
+    std::chrono::nanoseconds time_for_tasks_;
+    Util::Pacer::Settings pacing_;
+    Util::RetrySettings retries_;
+    std::size_t context_pool_size_;
+    std::size_t pipeline_depth_;
+    std::size_t max_connections_per_ip_;
+    InsecureCdnskeyResolver::Politeness politeness_;
+    Util::CircuitBreakerSettings breaker_;
+    InsecureCdnskeyResolver::ProbeFirst probe_first_;
+    const AddressClassifier& address_classifier_;
+    InsecureCdnskeyResolver::IoBackend io_backend_;
+    std::size_t memory_limit_;
+    std::size_t number_of_threads_;
+    Util::Pipe& pipe_to_parent_;
+};
+
+NameTables make_name_tables(
+        const Util::NameTable& table,
+        const InsecureCdnskeyResolver::DomainsOfNameservers& domains_of_nameservers)
+{
+    NameTables names{table, {}};
+    names.nameservers.reserve(domains_of_nameservers.size());
+    for (auto&& nameserver_and_domains : domains_of_nameservers)
+    {
+        names.nameservers.push_back(nameserver_and_domains.first);
+    }
+    return names;
+}
+
+//nameservers are not resolved yet, nothing is answered
+NameserverStates make_nameserver_states(const InsecureCdnskeyResolver::DomainsOfNameservers& domains_of_nameservers)
+{
+    NameserverStates nameservers;
+    nameservers.reserve(domains_of_nameservers.size());
+    for (auto&& nameserver_and_domains : domains_of_nameservers)
+    {
+        NameserverState state;
+        state.domains = nameserver_and_domains.second;
+        std::sort(begin(state.domains), end(state.domains));
+        state.domains.erase(std::unique(begin(state.domains), end(state.domains)), end(state.domains));
+        state.is_resolved = false;
+        nameservers.push_back(std::move(state));
+    }
+    return nameservers;
+}
+
+std::chrono::nanoseconds get_part_of(std::chrono::nanoseconds time, std::size_t part, std::size_t total)
+{
+    if ((total <= 0) || (total <= part))
+    {
+        return time;
+    }
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(time.count() * double(part) / total)};
+}
+
+//queries of resolved nameservers are made of their addresses, the other nameservers are resolved by the child
+//process first
+void resolve_in_child_processes(
+        const NameTables& names,
+        NameserverStates& nameservers,
+        const std::list<boost::asio::ip::address>& hostname_resolvers,
+        GetDns::Context::Timeout query_timeout,
+        GetDns::Context::Timeout min_query_timeout,
+        std::chrono::nanoseconds time_for_nameservers,
+        std::chrono::nanoseconds time_for_tasks,
+        const Util::Pacer::Settings& pacing,
+        const Util::RetrySettings& retries,
+        std::size_t context_pool_size,
+        std::size_t pipeline_depth,
+        std::size_t max_connections_per_ip,
+        const InsecureCdnskeyResolver::Politeness& politeness,
+        const Util::CircuitBreakerSettings& breaker,
+        const InsecureCdnskeyResolver::ProbeFirst& probe_first,
+        const AddressClassifier& address_classifier,
+        InsecureCdnskeyResolver::IoBackend io_backend,
+        std::size_t memory_limit,
+        std::size_t number_of_workers,
+        std::size_t number_of_threads)
+{
+    const auto unresolved_nameservers = get_unresolved_nameservers(nameservers, names);
+    const std::size_t number_of_nameservers = unresolved_nameservers.size();
+    const std::size_t expected_number_of_queries = get_number_of_unanswered_queries(nameservers) +
+                                                    get_estimated_number_of_queries(unresolved_nameservers, nameservers);
+    while (true)
+    {
+        const auto nameservers_to_resolve = get_unresolved_nameservers(nameservers, names);
+        const auto number_of_unanswered_queries = get_number_of_unanswered_queries(nameservers);
+        if (nameservers_to_resolve.empty() && (number_of_unanswered_queries == 0))
+        {
+            return;
         }
-        catch (const Util::Fork::ChildIsStillRunning&)
+        //some work is left, so the divisor is not 0
+        const auto query_distance_sec = ((time_for_nameservers + time_for_tasks).count() / double(number_of_nameservers + expected_number_of_queries)) / 1000000000LL;
+        const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
+        //workers inherit the memory of this process, they could not generate a single task
+        if ((0 < memory_limit) && (memory_limit <= Util::get_resident_memory()))
+        {
+            throw std::runtime_error("memory limit is lower than the memory used by the scanner already");
+        }
+        //workers share the time of the remaining part of work
+        const auto time_for_remaining_nameservers = get_part_of(time_for_nameservers, nameservers_to_resolve.size(), number_of_nameservers);
+        const auto time_for_remaining_tasks = get_part_of(
+                time_for_tasks,
+                number_of_unanswered_queries + get_estimated_number_of_queries(nameservers_to_resolve, nameservers),
+                expected_number_of_queries);
+        std::vector<std::vector<std::uint32_t>> nameservers_to_resolve_by_shards;
+        for (std::size_t idx = 0; idx < number_of_workers; ++idx)
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.kill_child();
-            if (child_result_status.signaled())
+            nameservers_to_resolve_by_shards.push_back(get_unresolved_nameservers(nameservers, names, Util::Shard{idx, number_of_workers}));
+        }
+        Util::Workers workers{answer_timeout};
+        for (std::size_t idx = 0; idx < number_of_workers; ++idx)
+        {
+            workers.start([&](Util::Pipe& pipe_to_parent)
             {
-                std::cerr << "child process was terminated because of blocking" << std::endl;
+                return ChildProcess<GetDns::TransportProtocol::Tcp>{
+                        names,
+                        nameservers,
+                        Util::Shard{idx, number_of_workers},
+                        nameservers_to_resolve_by_shards[idx],
+                        hostname_resolvers,
+                        query_timeout,
+                        min_query_timeout,
+                        time_for_remaining_nameservers,
+                        time_for_remaining_tasks,
+                        pacing.get_part(number_of_workers),
+                        retries,
+                        context_pool_size,
+                        pipeline_depth,
+                        max_connections_per_ip,
+                        politeness,
+                        breaker,
+                        probe_first,
+                        address_classifier,
+                        io_backend,
+                        memory_limit,
+                        number_of_threads,
+                        pipe_to_parent};
+            });
+        }
+        if (workers.wait(Answer{names, nameservers}))
+        {
+            std::cerr << "insecure CDNSKEY records resolved" << std::endl;
+            if (!get_unresolved_nameservers(nameservers, names).empty() ||
+                (get_number_of_unanswered_queries(nameservers) != 0))
+            {
+                throw std::runtime_error("insecure CDNSKEY resolver did not complete it's job");
             }
+            return;
         }
+        //workers over the memory limit exit, the next ones continue if the previous ones got somewhere
+        const bool no_progress = (get_unresolved_nameservers(nameservers, names).size() == nameservers_to_resolve.size()) &&
+                                 (get_number_of_unanswered_queries(nameservers) == number_of_unanswered_queries);
+        if ((0 < memory_limit) && no_progress)
+        {
+            throw std::runtime_error("memory limit is too low for insecure CDNSKEY resolver to get anywhere");
+        }
+    }
+}
+
+}//namespace {anonymous}
+
+void InsecureCdnskeyResolver::resolve(
+        const Util::NameTable& table,
+        const DomainsOfNameservers& to_resolve,
+        const NameserverAddresses& nameserver_addresses,
+        GetDns::Context::Timeout query_timeout,
+        GetDns::Context::Timeout min_query_timeout,
+        std::chrono::nanoseconds assigned_time,
+        const Util::Pacer::Settings& pacing,
+        const Util::RetrySettings& retries,
+        std::size_t context_pool_size,
+        std::size_t pipeline_depth,
+        std::size_t max_connections_per_ip,
+        const Politeness& politeness,
+        const Util::CircuitBreakerSettings& breaker,
+        const ProbeFirst& probe_first,
+        const AddressRanges& address_ranges,
+        IoBackend io_backend,
+        std::size_t memory_limit,
+        std::size_t number_of_workers,
+        std::size_t number_of_threads)
+{
+    if (to_resolve.empty())
+    {
+        return;
+    }
+    const NameTables names = make_name_tables(table, to_resolve);
+    auto nameservers = make_nameserver_states(to_resolve);
+    for (std::size_t idx = 0; idx < nameservers.size(); ++idx)
+    {
+        //nameservers without addresses were already reported by the hostname resolver
+        const auto addresses_itr = nameserver_addresses.find(names.nameservers[idx]);
+        set_addresses(
+                nameservers[idx],
+                addresses_itr != nameserver_addresses.end() ? addresses_itr->second
+                                                            : Util::IpAddresses{});
+    }
+    resolve_in_child_processes(
+            names,
+            nameservers,
+            std::list<boost::asio::ip::address>{},
+            query_timeout,
+            min_query_timeout,
+            std::chrono::nanoseconds::zero(),
+            assigned_time,
+            pacing,
+            retries,
+            context_pool_size,
+            pipeline_depth,
+            max_connections_per_ip,
+            politeness,
+            breaker,
+            probe_first,
+            make_address_classifier(address_ranges),
+            io_backend,
+            memory_limit,
+            number_of_workers,
+            number_of_threads);
+}
+
+void InsecureCdnskeyResolver::resolve_pipelined(
+        const Util::NameTable& table,
+        const DomainsOfNameservers& to_resolve,
+        GetDns::Context::Timeout query_timeout,
+        GetDns::Context::Timeout min_query_timeout,
+        const std::list<boost::asio::ip::address>& hostname_resolvers,
+        std::chrono::nanoseconds time_for_nameservers,
+        std::chrono::nanoseconds time_for_cdnskeys,
+        const Util::Pacer::Settings& pacing,
+        const Util::RetrySettings& retries,
+        std::size_t context_pool_size,
+        std::size_t pipeline_depth,
+        std::size_t max_connections_per_ip,
+        const Politeness& politeness,
+        const Util::CircuitBreakerSettings& breaker,
+        const ProbeFirst& probe_first,
+        const AddressRanges& address_ranges,
+        IoBackend io_backend,
+        std::size_t memory_limit,
+        std::size_t number_of_workers,
+        std::size_t number_of_threads)
+{
+    if (to_resolve.empty())
+    {
+        return;
     }
+    const NameTables names = make_name_tables(table, to_resolve);
+    auto nameservers = make_nameserver_states(to_resolve);
+    resolve_in_child_processes(
+            names,
+            nameservers,
+            hostname_resolvers,
+            query_timeout,
+            min_query_timeout,
+            time_for_nameservers,
+            time_for_cdnskeys,
+            pacing,
+            retries,
+            context_pool_size,
+            pipeline_depth,
+            max_connections_per_ip,
+            politeness,
+            breaker,
+            probe_first,
+            make_address_classifier(address_ranges),
+            io_backend,
+            memory_limit,
+            number_of_workers,
+            number_of_threads);
 }
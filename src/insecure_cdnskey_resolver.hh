@@ -23,28 +23,111 @@
 
 #include "src/getdns/context.hh"
 
+#include "src/util/circuit_breaker.hh"
+#include "src/util/ip_address.hh"
+#include "src/util/name_table.hh"
+#include "src/util/pacer.hh"
+#include "src/util/retry_queue.hh"
+
 #include <boost/asio/ip/address.hpp>
 
 #include <chrono>
-#include <set>
-#include <string>
+#include <cstddef>
+#include <list>
+#include <map>
 #include <vector>
 
-struct Insecure
-{
-    std::string domain;
-    std::set<std::string> nameservers;
-    boost::asio::ip::address address;
-};
-
-using VectorOfInsecures = std::vector<Insecure>;
-
 struct InsecureCdnskeyResolver
 {
+    //sorted distinct ids of domains by ids of their nameservers
+    using DomainsOfNameservers = std::map<Util::NameTable::Id, Util::NameTable::Ids>;
+    using NameserverAddresses = std::map<Util::NameTable::Id, Util::IpAddresses>;
+    // limits of CDNSKEY queries asked by one event loop on one nameserver address
+    struct Politeness
+    {
+        // 0 means no limit
+        std::size_t max_queries_in_flight_per_ip;
+        // 0 means no limit
+        double max_queries_per_second_per_ip;
+        // limits apply to /24 (IPv4) and /48 (IPv6) networks instead of single addresses
+        bool per_network;
+    };
+    // CDNSKEY queries of every nameserver address start with a sample, the other queries of the address wait
+    // for its answers
+    struct ProbeFirst
+    {
+        // 0 disables sampling
+        std::size_t sample_size;
+        // what is reported for queries of an address which answered all sampled queries by REFUSED or SERVFAIL
+        enum class Policy
+        {
+            report_empty,
+            report_unresolved
+        } policy_of_refusing;
+    };
+    // CDNSKEY records are not queried on addresses out of public ranges, such queries are reported as unresolved;
+    // private and special purpose ranges are built in, the longest range containing an address decides
+    struct AddressRanges
+    {
+        // e.g. bogons or networks of operators which asked not to be scanned
+        std::vector<Util::IpPrefix> blocked;
+        // e.g. a test nameserver in a private network
+        std::vector<Util::IpPrefix> allowed;
+    };
+    // how CDNSKEY queries go over TCP; io_uring needs Linux 5.6 or newer
+    enum class IoBackend
+    {
+        libevent,
+        io_uring
+    };
+    // memory_limit is the resident memory (in bytes, 0 means no limit) of each worker process, CDNSKEY tasks
+    // are generated in batches while the worker is under it; a worker over it finishes its tasks and exits,
+    // a new one continues with the rest of them
+    // nameservers missing in nameserver_addresses have no address, CDNSKEY records of their domains
+    // are not queried
     static void resolve(
-            const VectorOfInsecures& to_resolve,
+            const Util::NameTable& names,
+            const DomainsOfNameservers& to_resolve,
+            const NameserverAddresses& nameserver_addresses,
+            GetDns::Context::Timeout query_timeout,
+            GetDns::Context::Timeout min_query_timeout,
+            std::chrono::nanoseconds assigned_time,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t context_pool_size,
+            std::size_t pipeline_depth,
+            std::size_t max_connections_per_ip,
+            const Politeness& politeness,
+            const Util::CircuitBreakerSettings& breaker,
+            const ProbeFirst& probe_first,
+            const AddressRanges& address_ranges,
+            IoBackend io_backend,
+            std::size_t memory_limit,
+            std::size_t number_of_workers,
+            std::size_t number_of_threads);
+    // addresses of nameservers are resolved by the same event loop, CDNSKEY queries of a nameserver
+    // start as soon as its addresses are known
+    static void resolve_pipelined(
+            const Util::NameTable& names,
+            const DomainsOfNameservers& to_resolve,
             GetDns::Context::Timeout query_timeout,
-            std::chrono::nanoseconds assigned_time);
+            GetDns::Context::Timeout min_query_timeout,
+            const std::list<boost::asio::ip::address>& hostname_resolvers,
+            std::chrono::nanoseconds time_for_nameservers,
+            std::chrono::nanoseconds time_for_cdnskeys,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t context_pool_size,
+            std::size_t pipeline_depth,
+            std::size_t max_connections_per_ip,
+            const Politeness& politeness,
+            const Util::CircuitBreakerSettings& breaker,
+            const ProbeFirst& probe_first,
+            const AddressRanges& address_ranges,
+            IoBackend io_backend,
+            std::size_t memory_limit,
+            std::size_t number_of_workers,
+            std::size_t number_of_threads);
 };
 
 #endif//INSECURE_CDNSKEY_RESOLVER_HH_E7501EBD49F1AFA724581AA72FFD4314
@@ -17,6 +17,7 @@
  * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "src/domains_to_scan.hh"
 #include "src/hostname_resolver.hh"
 #include "src/insecure_cdnskey_resolver.hh"
 #include "src/secure_cdnskey_resolver.hh"
@@ -27,6 +28,15 @@
 #include "src/getdns/exception.hh"
 #include "src/getdns/solver.hh"
 
+#include "src/util/fork.hh"
+#include "src/util/input_buffer.hh"
+#include "src/util/input_stream.hh"
+#include "src/util/ip_address.hh"
+#include "src/util/name_table.hh"
+#include "src/util/output_merger.hh"
+#include "src/util/pacer.hh"
+#include "src/util/pipe.hh"
+
 #include <boost/asio/ip/address.hpp>
 #include <boost/optional.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -34,8 +44,10 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <unistd.h>
 
 #include <cerrno>
 #include <cmath>
@@ -43,60 +55,145 @@
 #include <cstring>
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <map>
-#include <random>
 #include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace {
 
-using Nameservers = std::set<std::string>;
-using Domains = std::set<std::string>;
+template <class T>
+T split(const std::string& src, const std::string& delimiters, void(*append)(const std::string& item, T& container));
+
+//at least 1/max_queries_per_second is reserved for one query
+std::chrono::nanoseconds get_time_for_queries(
+        std::size_t number_of_queries,
+        std::chrono::nanoseconds t_end,
+        double max_queries_per_second);
+
+//runs a phase of the scan in a child process, its standard output goes into the pipe
+template <typename F>
+class PhaseProcess
+{
+public:
+    PhaseProcess(const char* name, Util::Pipe& pipe_to_parent, F phase)
+        : name_{name},
+          pipe_to_parent_{pipe_to_parent},
+          phase_{std::move(phase)}
+    { }
+    int operator()()const
+    {
+        Util::ImWriter to_parent{pipe_to_parent_, Util::ImWriter::Stream::stdout};
+        try
+        {
+            phase_();
+            return EXIT_SUCCESS;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << name_ << " failed: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << name_ << " failed: unexpected exception caught" << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+private:
+    const char* name_;
+    Util::Pipe& pipe_to_parent_;
+    F phase_;
+};
+
+template <typename F>
+PhaseProcess<F> make_phase_process(const char* name, Util::Pipe& pipe_to_parent, F phase)
+{
+    return PhaseProcess<F>{name, pipe_to_parent, std::move(phase)};
+}
 
-class DomainsToScan
+bool has_succeeded(const Util::Fork::ChildResultStatus& status);
+
+//batches of one phase are scanned one after another, each one in its own child process, so the phase never
+//exceeds its rate while the input is still being read
+template <typename Batch>
+class BatchedPhase
 {
 public:
-    DomainsToScan(std::istream& data_source);
-    ~DomainsToScan() = default;
-    std::size_t get_number_of_nameservers() const;
-    std::size_t get_number_of_domains() const;
-    std::size_t get_number_of_secure_domains() const;
-    Nameservers get_nameservers() const;
-    const Domains& get_secure_domains() const;
-    Domains get_insecure_domains_of(const std::string& nameserver) const;
+    using Scan = std::function<void(const Batch& batch, std::chrono::nanoseconds t_end)>;
+    BatchedPhase(const char* name, Util::OutputMerger& output, Scan scan)
+        : name_{name},
+          output_{output},
+          scan_{std::move(scan)},
+          children_{}
+    { }
+    bool is_running() const
+    {
+        return !children_.empty() && !output_.is_closed(children_.back().from_child);
+    }
+    BatchedPhase& start(const Batch& batch, std::chrono::nanoseconds t_end)
+    {
+        children_.emplace_back([&](Util::Pipe& to_parent)
+        {
+            return make_phase_process(name_, to_parent, [&]() { scan_(batch, t_end); });
+        });
+        output_.add(children_.back().from_child);
+        return *this;
+    }
+    //waits for all batches
+    bool has_succeeded()
+    {
+        bool all_succeeded = true;
+        for (auto&& child : children_)
+        {
+            all_succeeded = ::has_succeeded(child.process.wait_for_child_result_status()) && all_succeeded;
+        }
+        return all_succeeded;
+    }
 private:
-    DomainsToScan& append_data(const char* data_chunk, std::streamsize data_chunk_length);
-    void data_finished();
-    enum class Section
+    struct Child
     {
-        none,
-        secure,
-        insecure,
-    } section_;
-    using DomainsOfNamserver = std::map<std::string, Domains>;
-    DomainsOfNamserver insecure_domains_of_namserver_;
-    std::string nameserver_;
-    Domains secure_domains_;
-    Domains insecure_domains_;
-    std::string rest_of_data_;
-    bool data_starts_at_new_line_;
+        template <typename F>
+        explicit Child(F make_process)
+            : to_parent{},
+              process{make_process(to_parent)},
+              from_child{to_parent}
+        { }
+        Util::Pipe to_parent;
+        Util::Fork process;
+        const Util::ImReader from_child;
+    };
+    const char* name_;
+    Util::OutputMerger& output_;
+    Scan scan_;
+    std::list<Child> children_;
 };
 
-VectorOfInsecures resolve_hostnames_of_nameservers(
-        const DomainsToScan& domains_to_scan,
-        GetDns::Context::Timeout query_timeout,
-        std::chrono::nanoseconds runtime,
-        const std::list<boost::asio::ip::address>& resolvers);
+//a batch gets the part of the remaining runtime its domains make of all domains not scanned yet, their number is
+//known once the input is over, until then it is declared or estimated
+class RuntimeBudget
+{
+public:
+    //0 means nothing declared, batches read before the end of input get no more time than their rate needs
+    RuntimeBudget(std::chrono::nanoseconds t_end, std::size_t expected_domains);
+    std::chrono::nanoseconds get_end_of_batch(std::size_t domains_of_batch, std::size_t waiting_domains, bool input_finished);
+private:
+    std::chrono::nanoseconds t_end_;
+    std::size_t expected_domains_;
+    std::size_t started_domains_;
+};
 
-template <class T>
-T split(const std::string& src, const std::string& delimiters, void(*append)(const std::string& item, T& container));
+Util::NameTable::Ids get_nameservers(const DomainsToScan::DomainsOfNameservers& domains_of_nameservers);
+std::size_t get_number_of_domains(const DomainsToScan::DomainsOfNameservers& domains_of_nameservers);
+bool is_pipe(int fd);
 
 void append_ip_address(const std::string& item, std::list<boost::asio::ip::address>& addresses);
+void append_ip_prefix(const std::string& item, std::vector<Util::IpPrefix>& prefixes);
 void append_trust_anchor(const std::string& item, std::list<GetDns::TrustAnchor>& anchors);
 
 extern const char cmdline_help_text[];
@@ -114,6 +211,32 @@ int main(int argc, char* argv[])
     std::string cdnskey_resolvers_opt;
     std::string dnssec_trust_anchors_opt;
     std::string timeout_opt;
+    std::string min_timeout_opt;
+    std::string context_pool_size_opt;
+    std::string hostname_sockets_opt;
+    std::string insecure_pipeline_depth_opt;
+    std::string insecure_connections_per_ip_opt;
+    std::string insecure_queries_in_flight_per_ip_opt;
+    std::string insecure_queries_per_second_per_ip_opt;
+    bool insecure_limits_per_network = false;
+    std::string insecure_breaker_timeouts_opt;
+    std::string insecure_breaker_probe_after_opt;
+    std::string insecure_probe_first_opt;
+    std::string insecure_probe_policy_opt;
+    std::string insecure_io_opt;
+    std::string insecure_blocked_ranges_opt;
+    std::string insecure_allowed_ranges_opt;
+    std::string workers_opt;
+    std::string threads_opt;
+    std::string max_queries_per_second_opt;
+    std::string burst_opt;
+    bool as_fast_as_allowed = false;
+    std::string max_attempts_opt;
+    bool pipelined = false;
+    std::string input_file_opt;
+    std::string input_batch_opt;
+    std::string expected_domains_opt;
+    std::string memory_limit_opt;
     std::string runtime_opt;
     char** const arg_end = argv + argc;
     char** arg_ptr = argv + 1;
@@ -200,6 +323,493 @@ int main(int argc, char* argv[])
                 return EXIT_FAILURE;
             }
         }
+        else if (std::strcmp(*arg_ptr, "--min_timeout") == are_the_same)
+        {
+            if (!min_timeout_opt.empty())
+            {
+                std::cerr << "min_timeout option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for min_timeout option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            min_timeout_opt = *arg_ptr;
+            if (min_timeout_opt.empty())
+            {
+                std::cerr << "min_timeout argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--context_pool_size") == are_the_same)
+        {
+            if (!context_pool_size_opt.empty())
+            {
+                std::cerr << "context_pool_size option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for context_pool_size option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            context_pool_size_opt = *arg_ptr;
+            if (context_pool_size_opt.empty())
+            {
+                std::cerr << "context_pool_size argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--hostname_sockets") == are_the_same)
+        {
+            if (!hostname_sockets_opt.empty())
+            {
+                std::cerr << "hostname_sockets option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for hostname_sockets option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            hostname_sockets_opt = *arg_ptr;
+            if (hostname_sockets_opt.empty())
+            {
+                std::cerr << "hostname_sockets argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_pipeline_depth") == are_the_same)
+        {
+            if (!insecure_pipeline_depth_opt.empty())
+            {
+                std::cerr << "insecure_pipeline_depth option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_pipeline_depth option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_pipeline_depth_opt = *arg_ptr;
+            if (insecure_pipeline_depth_opt.empty())
+            {
+                std::cerr << "insecure_pipeline_depth argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_connections_per_ip") == are_the_same)
+        {
+            if (!insecure_connections_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_connections_per_ip option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_connections_per_ip option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_connections_per_ip_opt = *arg_ptr;
+            if (insecure_connections_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_connections_per_ip argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_queries_in_flight_per_ip") == are_the_same)
+        {
+            if (!insecure_queries_in_flight_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_queries_in_flight_per_ip option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_queries_in_flight_per_ip option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_queries_in_flight_per_ip_opt = *arg_ptr;
+            if (insecure_queries_in_flight_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_queries_in_flight_per_ip argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_queries_per_second_per_ip") == are_the_same)
+        {
+            if (!insecure_queries_per_second_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_queries_per_second_per_ip option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_queries_per_second_per_ip option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_queries_per_second_per_ip_opt = *arg_ptr;
+            if (insecure_queries_per_second_per_ip_opt.empty())
+            {
+                std::cerr << "insecure_queries_per_second_per_ip argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_limits_per_network") == are_the_same)
+        {
+            if (insecure_limits_per_network)
+            {
+                std::cerr << "insecure_limits_per_network option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_limits_per_network = true;
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_breaker_timeouts") == are_the_same)
+        {
+            if (!insecure_breaker_timeouts_opt.empty())
+            {
+                std::cerr << "insecure_breaker_timeouts option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_breaker_timeouts option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_breaker_timeouts_opt = *arg_ptr;
+            if (insecure_breaker_timeouts_opt.empty())
+            {
+                std::cerr << "insecure_breaker_timeouts argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_breaker_probe_after") == are_the_same)
+        {
+            if (!insecure_breaker_probe_after_opt.empty())
+            {
+                std::cerr << "insecure_breaker_probe_after option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_breaker_probe_after option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_breaker_probe_after_opt = *arg_ptr;
+            if (insecure_breaker_probe_after_opt.empty())
+            {
+                std::cerr << "insecure_breaker_probe_after argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_probe_first") == are_the_same)
+        {
+            if (!insecure_probe_first_opt.empty())
+            {
+                std::cerr << "insecure_probe_first option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_probe_first option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_probe_first_opt = *arg_ptr;
+            if (insecure_probe_first_opt.empty())
+            {
+                std::cerr << "insecure_probe_first argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_probe_policy") == are_the_same)
+        {
+            if (!insecure_probe_policy_opt.empty())
+            {
+                std::cerr << "insecure_probe_policy option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_probe_policy option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_probe_policy_opt = *arg_ptr;
+            if (insecure_probe_policy_opt.empty())
+            {
+                std::cerr << "insecure_probe_policy argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_io") == are_the_same)
+        {
+            if (!insecure_io_opt.empty())
+            {
+                std::cerr << "insecure_io option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_io option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_io_opt = *arg_ptr;
+            if (insecure_io_opt.empty())
+            {
+                std::cerr << "insecure_io argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_blocked_ranges") == are_the_same)
+        {
+            if (!insecure_blocked_ranges_opt.empty())
+            {
+                std::cerr << "insecure_blocked_ranges option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_blocked_ranges option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_blocked_ranges_opt = *arg_ptr;
+            if (insecure_blocked_ranges_opt.empty())
+            {
+                std::cerr << "insecure_blocked_ranges argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--insecure_allowed_ranges") == are_the_same)
+        {
+            if (!insecure_allowed_ranges_opt.empty())
+            {
+                std::cerr << "insecure_allowed_ranges option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for insecure_allowed_ranges option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            insecure_allowed_ranges_opt = *arg_ptr;
+            if (insecure_allowed_ranges_opt.empty())
+            {
+                std::cerr << "insecure_allowed_ranges argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--workers") == are_the_same)
+        {
+            if (!workers_opt.empty())
+            {
+                std::cerr << "workers option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for workers option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            workers_opt = *arg_ptr;
+            if (workers_opt.empty())
+            {
+                std::cerr << "workers argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--threads") == are_the_same)
+        {
+            if (!threads_opt.empty())
+            {
+                std::cerr << "threads option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for threads option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            threads_opt = *arg_ptr;
+            if (threads_opt.empty())
+            {
+                std::cerr << "threads argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--max_queries_per_second") == are_the_same)
+        {
+            if (!max_queries_per_second_opt.empty())
+            {
+                std::cerr << "max_queries_per_second option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for max_queries_per_second option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            max_queries_per_second_opt = *arg_ptr;
+            if (max_queries_per_second_opt.empty())
+            {
+                std::cerr << "max_queries_per_second argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--burst") == are_the_same)
+        {
+            if (!burst_opt.empty())
+            {
+                std::cerr << "burst option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for burst option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            burst_opt = *arg_ptr;
+            if (burst_opt.empty())
+            {
+                std::cerr << "burst argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--as_fast_as_allowed") == are_the_same)
+        {
+            if (as_fast_as_allowed)
+            {
+                std::cerr << "as_fast_as_allowed option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            as_fast_as_allowed = true;
+        }
+        else if (std::strcmp(*arg_ptr, "--max_attempts") == are_the_same)
+        {
+            if (!max_attempts_opt.empty())
+            {
+                std::cerr << "max_attempts option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for max_attempts option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            max_attempts_opt = *arg_ptr;
+            if (max_attempts_opt.empty())
+            {
+                std::cerr << "max_attempts argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--pipelined") == are_the_same)
+        {
+            if (pipelined)
+            {
+                std::cerr << "pipelined option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            pipelined = true;
+        }
+        else if (std::strcmp(*arg_ptr, "--input_file") == are_the_same)
+        {
+            if (!input_file_opt.empty())
+            {
+                std::cerr << "input_file option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for input_file option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            input_file_opt = *arg_ptr;
+            if (input_file_opt.empty())
+            {
+                std::cerr << "input_file argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--input_batch") == are_the_same)
+        {
+            if (!input_batch_opt.empty())
+            {
+                std::cerr << "input_batch option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for input_batch option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            input_batch_opt = *arg_ptr;
+            if (input_batch_opt.empty())
+            {
+                std::cerr << "input_batch argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--expected_domains") == are_the_same)
+        {
+            if (!expected_domains_opt.empty())
+            {
+                std::cerr << "expected_domains option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for expected_domains option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            expected_domains_opt = *arg_ptr;
+            if (expected_domains_opt.empty())
+            {
+                std::cerr << "expected_domains argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(*arg_ptr, "--memory_limit") == are_the_same)
+        {
+            if (!memory_limit_opt.empty())
+            {
+                std::cerr << "memory_limit option can be used once only" << std::endl;
+                return EXIT_FAILURE;
+            }
+            ++arg_ptr;
+            if (*arg_ptr == nullptr)
+            {
+                std::cerr << "no argument for memory_limit option" << std::endl;
+                return EXIT_FAILURE;
+            }
+            memory_limit_opt = *arg_ptr;
+            if (memory_limit_opt.empty())
+            {
+                std::cerr << "memory_limit argument can not be empty" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
         else if (std::strcmp(*arg_ptr, "--help") == are_the_same)
         {
             std::cerr << cmdline_help_text << std::endl;
@@ -278,56 +888,352 @@ int main(int argc, char* argv[])
         static constexpr auto timeout_default = std::chrono::seconds{10};
         const auto query_timeout = GetDns::Context::Timeout{timeout_opt.empty() ? timeout_default
                                                                                 : std::chrono::seconds{boost::lexical_cast<std::uint64_t>(timeout_opt)}};
-        const DomainsToScan domains_to_scan(std::cin);
-        if ((domains_to_scan.get_number_of_nameservers() <= 0) &&
-            (domains_to_scan.get_number_of_secure_domains() <= 0))
+        static constexpr auto min_timeout_default = std::chrono::milliseconds{500};
+        const auto min_query_timeout = GetDns::Context::Timeout{min_timeout_opt.empty() ? min_timeout_default
+                                                                                        : std::chrono::milliseconds{boost::lexical_cast<std::uint64_t>(min_timeout_opt)}};
+        if (query_timeout < min_query_timeout)
         {
-            return EXIT_SUCCESS;
+            std::cerr << "min_timeout argument can not exceed timeout" << std::endl;
+            return EXIT_FAILURE;
         }
-        const auto t_end = std::chrono::nanoseconds{TimeUnit::get_uptime().get() + runtime};
-        VectorOfInsecures insecure_queries;
+        static constexpr std::size_t context_pool_size_default = 1000;
+        const std::size_t context_pool_size = context_pool_size_opt.empty() ? context_pool_size_default
+                                                                            : boost::lexical_cast<std::size_t>(context_pool_size_opt);
+        static constexpr std::size_t hostname_sockets_default = 4;
+        const std::size_t hostname_sockets = hostname_sockets_opt.empty() ? hostname_sockets_default
+                                                                          : boost::lexical_cast<std::size_t>(hostname_sockets_opt);
+        if (hostname_sockets <= 0)
+        {
+            std::cerr << "hostname_sockets argument has to be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        static constexpr std::size_t insecure_pipeline_depth_default = 10;
+        const std::size_t insecure_pipeline_depth = insecure_pipeline_depth_opt.empty() ? insecure_pipeline_depth_default
+                                                                                        : boost::lexical_cast<std::size_t>(insecure_pipeline_depth_opt);
+        static constexpr std::size_t insecure_connections_per_ip_default = 2;
+        const std::size_t insecure_connections_per_ip = insecure_connections_per_ip_opt.empty() ? insecure_connections_per_ip_default
+                                                                                                : boost::lexical_cast<std::size_t>(insecure_connections_per_ip_opt);
+        //as many queries as the tcp connections of one nameserver carry at once
+        const std::size_t insecure_queries_in_flight_per_ip_default = insecure_pipeline_depth * insecure_connections_per_ip;
+        const std::size_t insecure_queries_in_flight_per_ip = insecure_queries_in_flight_per_ip_opt.empty()
+                ? insecure_queries_in_flight_per_ip_default
+                : boost::lexical_cast<std::size_t>(insecure_queries_in_flight_per_ip_opt);
+        const double insecure_queries_per_second_per_ip = insecure_queries_per_second_per_ip_opt.empty()
+                ? 0.0
+                : boost::lexical_cast<double>(insecure_queries_per_second_per_ip_opt);
+        if (!(0.0 <= insecure_queries_per_second_per_ip))
+        {
+            std::cerr << "insecure_queries_per_second_per_ip argument can not be negative" << std::endl;
+            return EXIT_FAILURE;
+        }
+        const auto politeness = InsecureCdnskeyResolver::Politeness{
+                insecure_queries_in_flight_per_ip,
+                insecure_queries_per_second_per_ip,
+                insecure_limits_per_network};
+        static constexpr std::size_t insecure_breaker_timeouts_default = 0;
+        const std::size_t insecure_breaker_timeouts = insecure_breaker_timeouts_opt.empty()
+                ? insecure_breaker_timeouts_default
+                : boost::lexical_cast<std::size_t>(insecure_breaker_timeouts_opt);
+        static constexpr auto insecure_breaker_probe_after_default = std::chrono::seconds{60};
+        const auto insecure_breaker_probe_after = insecure_breaker_probe_after_opt.empty()
+                ? insecure_breaker_probe_after_default
+                : std::chrono::seconds{boost::lexical_cast<std::uint64_t>(insecure_breaker_probe_after_opt)};
+        const auto breaker = Util::CircuitBreakerSettings{insecure_breaker_timeouts, insecure_breaker_probe_after};
+        const std::size_t insecure_probe_first = insecure_probe_first_opt.empty() ? 0
+                                                                                  : boost::lexical_cast<std::size_t>(insecure_probe_first_opt);
+        auto probe_first = InsecureCdnskeyResolver::ProbeFirst{insecure_probe_first, InsecureCdnskeyResolver::ProbeFirst::Policy::report_empty};
+        if (insecure_probe_policy_opt == "unresolved")
+        {
+            probe_first.policy_of_refusing = InsecureCdnskeyResolver::ProbeFirst::Policy::report_unresolved;
+        }
+        else if (!insecure_probe_policy_opt.empty() && (insecure_probe_policy_opt != "empty"))
         {
-            const std::size_t estimated_total_number_of_queries =
-                    domains_to_scan.get_number_of_nameservers() + 2 * domains_to_scan.get_number_of_domains();
+            std::cerr << "insecure_probe_policy argument has to be empty or unresolved" << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto insecure_io = InsecureCdnskeyResolver::IoBackend::libevent;
+        if (insecure_io_opt == "io_uring")
+        {
+            insecure_io = InsecureCdnskeyResolver::IoBackend::io_uring;
+        }
+        else if (!insecure_io_opt.empty() && (insecure_io_opt != "libevent"))
+        {
+            std::cerr << "insecure_io argument has to be libevent or io_uring" << std::endl;
+            return EXIT_FAILURE;
+        }
+        const auto address_ranges = InsecureCdnskeyResolver::AddressRanges{
+                split(insecure_blocked_ranges_opt, ",", append_ip_prefix),
+                split(insecure_allowed_ranges_opt, ",", append_ip_prefix)};
+        static constexpr std::size_t number_of_workers_default = 1;
+        const std::size_t number_of_workers = workers_opt.empty() ? number_of_workers_default
+                                                                  : boost::lexical_cast<std::size_t>(workers_opt);
+        if (number_of_workers <= 0)
+        {
+            std::cerr << "workers argument has to be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        static constexpr std::size_t number_of_threads_default = 1;
+        const std::size_t number_of_threads = threads_opt.empty() ? number_of_threads_default
+                                                                  : boost::lexical_cast<std::size_t>(threads_opt);
+        if (number_of_threads <= 0)
+        {
+            std::cerr << "threads argument has to be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        static constexpr double max_queries_per_second_default = 1000.0;
+        const double max_queries_per_second = max_queries_per_second_opt.empty() ? max_queries_per_second_default
+                                                                                 : boost::lexical_cast<double>(max_queries_per_second_opt);
+        if (!(0.0 <= max_queries_per_second))
+        {
+            std::cerr << "max_queries_per_second argument can not be negative" << std::endl;
+            return EXIT_FAILURE;
+        }
+        //10ms worth of queries
+        const std::size_t burst_default = std::max(std::size_t{1}, static_cast<std::size_t>(max_queries_per_second / 100));
+        const std::size_t burst = burst_opt.empty() ? burst_default
+                                                    : boost::lexical_cast<std::size_t>(burst_opt);
+        if (burst <= 0)
+        {
+            std::cerr << "burst argument has to be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        //each phase has its own limit, the secure phase asks other servers than the insecure ones
+        const auto pacing = Util::Pacer::Settings{max_queries_per_second, burst, as_fast_as_allowed};
+        static constexpr std::size_t max_attempts_default = 3;
+        const std::size_t max_attempts = max_attempts_opt.empty() ? max_attempts_default
+                                                                  : boost::lexical_cast<std::size_t>(max_attempts_opt);
+        if (max_attempts <= 0)
+        {
+            std::cerr << "max_attempts argument has to be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        //backoff stays well below the answer timeout of workers
+        const auto retries = Util::RetrySettings{max_attempts, std::chrono::milliseconds{500}, std::chrono::seconds{4}};
+        static constexpr std::size_t input_batch_default = 0;
+        const std::size_t input_batch = input_batch_opt.empty() ? input_batch_default
+                                                                : boost::lexical_cast<std::size_t>(input_batch_opt);
+        const std::size_t expected_domains = expected_domains_opt.empty() ? 0
+                                                                          : boost::lexical_cast<std::size_t>(expected_domains_opt);
+        if ((0 < expected_domains) && (input_batch <= 0))
+        {
+            std::cerr << "expected_domains option can be used with input_batch only" << std::endl;
+            return EXIT_FAILURE;
+        }
+        static constexpr std::size_t bytes_per_mib = 1024 * 1024;
+        const std::size_t memory_limit = memory_limit_opt.empty() ? 0
+                                                                  : bytes_per_mib * boost::lexical_cast<std::size_t>(memory_limit_opt);
+        const auto scan_secure_domains = [&](
+                const Util::NameTable& names,
+                const DomainsToScan::Domains& secure_domains,
+                std::chrono::nanoseconds t_end)
+        {
+            const std::size_t number_of_secure_queries = secure_domains.size();
+            std::cerr << "number_of_secure_queries = " << number_of_secure_queries << std::endl;
+            SecureCdnskeyResolver::resolve(
+                    names,
+                    secure_domains,
+                    query_timeout,
+                    cdnskey_resolvers,
+                    anchors,
+                    get_time_for_queries(number_of_secure_queries, t_end, max_queries_per_second),
+                    pacing,
+                    retries,
+                    context_pool_size,
+                    number_of_workers);
+        };
+        const auto scan_insecure_domains = [&](
+                const Util::NameTable& names,
+                const DomainsToScan::DomainsOfNameservers& domains_of_nameservers,
+                std::chrono::nanoseconds t_end)
+        {
+            const std::size_t number_of_nameservers = domains_of_nameservers.size();
+            //addresses of nameservers are not known yet, usually there are two of them
+            const std::size_t estimated_number_of_insecure_queries = 2 * get_number_of_domains(domains_of_nameservers);
+            const std::size_t estimated_total_number_of_queries = number_of_nameservers + estimated_number_of_insecure_queries;
             std::cerr << "estimated_total_number_of_queries = " << estimated_total_number_of_queries << std::endl;
-            const auto query_distance = static_cast<double>(runtime.count()) / estimated_total_number_of_queries;
-            std::cerr << "query_distance = " << query_distance << std::endl;
-            const std::size_t queries_to_ask_now = domains_to_scan.get_number_of_nameservers();
-            std::cerr << "queries_to_ask_now = " << queries_to_ask_now << std::endl;
-            const auto time_for_hostname_resolver = std::chrono::nanoseconds{static_cast<std::int64_t>(query_distance * queries_to_ask_now * 1000000000LL)};
+            if (estimated_total_number_of_queries <= 0)
+            {
+                return;
+            }
+            if (pipelined)
+            {
+                const auto time_for_insecure_phases = get_time_for_queries(estimated_total_number_of_queries, t_end, max_queries_per_second);
+                const auto query_distance_nsec = double(time_for_insecure_phases.count()) / estimated_total_number_of_queries;
+                std::cerr << "query_distance = " << query_distance_nsec << "ns" << std::endl;
+                InsecureCdnskeyResolver::resolve_pipelined(
+                        names,
+                        domains_of_nameservers,
+                        query_timeout,
+                        min_query_timeout,
+                        hostname_resolvers,
+                        std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(query_distance_nsec * number_of_nameservers))},
+                        std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(query_distance_nsec * estimated_number_of_insecure_queries))},
+                        pacing,
+                        retries,
+                        context_pool_size,
+                        insecure_pipeline_depth,
+                        insecure_connections_per_ip,
+                        politeness,
+                        breaker,
+                        probe_first,
+                        address_ranges,
+                        insecure_io,
+                        memory_limit,
+                        number_of_workers,
+                        number_of_threads);
+                return;
+            }
+            const auto query_distance_nsec = double((t_end - TimeUnit::get_uptime().get()).count()) / estimated_total_number_of_queries;
+            std::cerr << "query_distance = " << query_distance_nsec << "ns" << std::endl;
+            const auto time_for_hostname_resolver = std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(query_distance_nsec * number_of_nameservers))};
             std::cerr << "time_for_hostname_resolver = " << time_for_hostname_resolver.count() << "ns" << std::endl;
-            insecure_queries = resolve_hostnames_of_nameservers(
-                    domains_to_scan,
+            const auto nameserver_addresses = HostnameResolver::get_result(
+                    names,
+                    get_nameservers(domains_of_nameservers),
                     query_timeout,
+                    hostname_resolvers,
                     time_for_hostname_resolver,
-                    hostname_resolvers);
-        }
-        const std::size_t number_of_insecure_queries = insecure_queries.size();
-        std::cerr << "number_of_insecure_queries = " << number_of_insecure_queries << std::endl;
-        const std::size_t number_of_secure_queries = domains_to_scan.get_number_of_secure_domains();
-        std::cerr << "number_of_secure_queries = " << number_of_secure_queries << std::endl;
-        const std::size_t total_number_of_queries = number_of_insecure_queries + number_of_secure_queries;
-        const std::size_t max_number_of_queries_per_second = 1000;
-        const auto min_runtime = std::chrono::nanoseconds{static_cast<std::int64_t>(total_number_of_queries / (max_number_of_queries_per_second / 1.0e+9))};
-        auto time_to_the_end = t_end - TimeUnit::get_uptime().get();
-        if (time_to_the_end < min_runtime)
-        {
-            time_to_the_end = min_runtime;
-        }
-        const double query_distance_nsec = double(time_to_the_end.count()) / total_number_of_queries;
-        std::cerr << "query_distance = " << query_distance_nsec << "ns" << std::endl;
-        const auto time_for_insecure_resolver = std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(query_distance_nsec * number_of_insecure_queries))};
-        const auto time_for_secure_resolver = std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround(query_distance_nsec * number_of_secure_queries))};
-        InsecureCdnskeyResolver::resolve(
-                insecure_queries,
-                query_timeout,
-                time_for_insecure_resolver);
-        SecureCdnskeyResolver::resolve(
-                domains_to_scan.get_secure_domains(),
-                query_timeout,
-                cdnskey_resolvers,
-                GetDns::Data::TrustAnchorList{anchors},
-                time_for_secure_resolver);
+                    pacing,
+                    retries,
+                    hostname_sockets,
+                    number_of_workers);
+            std::size_t number_of_insecure_queries = 0;
+            for (auto&& nameserver_and_addresses : nameserver_addresses)
+            {
+                const auto domains_itr = domains_of_nameservers.find(nameserver_and_addresses.first);
+                if (domains_itr != domains_of_nameservers.end())
+                {
+                    number_of_insecure_queries += nameserver_and_addresses.second.size() * domains_itr->second.size();
+                }
+            }
+            std::cerr << "number_of_insecure_queries = " << number_of_insecure_queries << std::endl;
+            InsecureCdnskeyResolver::resolve(
+                    names,
+                    domains_of_nameservers,
+                    nameserver_addresses,
+                    query_timeout,
+                    min_query_timeout,
+                    get_time_for_queries(number_of_insecure_queries, t_end, max_queries_per_second),
+                    pacing,
+                    retries,
+                    context_pool_size,
+                    insecure_pipeline_depth,
+                    insecure_connections_per_ip,
+                    politeness,
+                    breaker,
+                    probe_first,
+                    address_ranges,
+                    insecure_io,
+                    memory_limit,
+                    number_of_workers,
+                    number_of_threads);
+        };
+        const bool scan_while_reading = (0 < input_batch) && input_file_opt.empty() && is_pipe(STDIN_FILENO);
+        if (scan_while_reading)
+        {
+            //each phase starts its next batch once the previous one is done and input_batch domains are waiting
+            //or the input is over, the secure and the insecure phases run concurrently as in the other mode
+            const auto t_end = std::chrono::nanoseconds{TimeUnit::get_uptime().get() + runtime};
+            RuntimeBudget budget{t_end, expected_domains};
+            DomainsToScan domains_to_scan;
+            Event::Base loop;
+            Util::OutputMerger merge_output{loop};
+            const Util::InputStream input{loop, STDIN_FILENO, [&](const char* data, std::size_t size, bool end_reached)
+            {
+                if (end_reached)
+                {
+                    domains_to_scan.append_last_line(data, size);
+                    return size;
+                }
+                return domains_to_scan.append_lines(data, size);
+            }};
+            BatchedPhase<DomainsToScan::Domains> secure_phase{"secure CDNSKEY phase", merge_output, [&](
+                    const DomainsToScan::Domains& batch,
+                    std::chrono::nanoseconds t_end_of_batch)
+            {
+                scan_secure_domains(domains_to_scan.get_names(), batch, t_end_of_batch);
+            }};
+            BatchedPhase<DomainsToScan::DomainsOfNameservers> insecure_phases{"insecure CDNSKEY phases", merge_output, [&](
+                    const DomainsToScan::DomainsOfNameservers& batch,
+                    std::chrono::nanoseconds t_end_of_batch)
+            {
+                scan_insecure_domains(domains_to_scan.get_names(), batch, t_end_of_batch);
+            }};
+            while (true)
+            {
+                const bool input_finished = input.is_finished();
+                const auto is_batch_ready = [&](std::size_t waiting_domains)
+                {
+                    return (input_batch <= waiting_domains) || (input_finished && (0 < waiting_domains));
+                };
+                const std::size_t waiting_secure_domains = domains_to_scan.get_number_of_secure_domains();
+                const std::size_t waiting_domains = domains_to_scan.get_number_of_domains();
+                if (!secure_phase.is_running() && is_batch_ready(waiting_secure_domains))
+                {
+                    const auto t_end_of_batch = budget.get_end_of_batch(waiting_secure_domains, waiting_domains, input_finished);
+                    secure_phase.start(domains_to_scan.take_secure_domains(), t_end_of_batch);
+                }
+                const std::size_t waiting_insecure_domains = domains_to_scan.get_number_of_domains() -
+                                                             domains_to_scan.get_number_of_secure_domains();
+                if (!insecure_phases.is_running() && is_batch_ready(waiting_insecure_domains))
+                {
+                    const auto t_end_of_batch = budget.get_end_of_batch(
+                            waiting_insecure_domains,
+                            domains_to_scan.get_number_of_domains(),
+                            input_finished);
+                    insecure_phases.start(domains_to_scan.take_insecure_domains_of_nameservers(), t_end_of_batch);
+                }
+                if (input_finished && !secure_phase.is_running() && !insecure_phases.is_running())
+                {
+                    break;
+                }
+                loop(Event::Loop::Once{});
+            }
+            const bool insecure_phases_succeeded = insecure_phases.has_succeeded();
+            const bool secure_phase_succeeded = secure_phase.has_succeeded();
+            if (!insecure_phases_succeeded || !secure_phase_succeeded)
+            {
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        //the input is released once its names are interned
+        const DomainsToScan domains_to_scan = [&]()
+        {
+            const auto input = input_file_opt.empty() ? Util::InputBuffer::read_all(STDIN_FILENO)
+                                                      : Util::InputBuffer::map_file(input_file_opt.c_str());
+            return DomainsToScan{input.data(), input.size()};
+        }();
+        if ((domains_to_scan.get_number_of_nameservers() <= 0) &&
+            (domains_to_scan.get_number_of_secure_domains() <= 0))
+        {
+            return EXIT_SUCCESS;
+        }
+        const auto t_end = std::chrono::nanoseconds{TimeUnit::get_uptime().get() + runtime};
+        //the secure phase asks cdnskey_resolvers only while the insecure phases ask authoritative nameservers,
+        //so they run concurrently in separate processes, each one with its own budget of queries in flight
+        Util::Pipe secure_phase_output;
+        Util::Fork secure_phase{make_phase_process("secure CDNSKEY phase", secure_phase_output, [&]()
+        {
+            scan_secure_domains(domains_to_scan.get_names(), domains_to_scan.get_secure_domains(), t_end);
+        })};
+        const Util::ImReader from_secure_phase{secure_phase_output};
+        Util::Pipe insecure_phases_output;
+        Util::Fork insecure_phases{make_phase_process("insecure CDNSKEY phases", insecure_phases_output, [&]()
+        {
+            scan_insecure_domains(domains_to_scan.get_names(), domains_to_scan.get_insecure_domains_of_nameservers(), t_end);
+        })};
+        const Util::ImReader from_insecure_phases{insecure_phases_output};
+        {
+            Event::Base monitor;
+            const Util::OutputMerger merge_output{monitor, {std::cref(from_insecure_phases), std::cref(from_secure_phase)}};
+        }
+        const bool insecure_phases_succeeded = has_succeeded(insecure_phases.wait_for_child_result_status());
+        const bool secure_phase_succeeded = has_succeeded(secure_phase.wait_for_child_result_status());
+        if (!insecure_phases_succeeded || !secure_phase_succeeded)
+        {
+            return EXIT_FAILURE;
+        }
         return EXIT_SUCCESS;
     }
     catch (const Event::Exception& e)
@@ -354,290 +1260,87 @@ int main(int argc, char* argv[])
 
 namespace {
 
-DomainsToScan::DomainsToScan(std::istream& data_source)
-    : section_{Section::none},
-      data_starts_at_new_line_{true}
+std::chrono::nanoseconds get_time_for_queries(
+        std::size_t number_of_queries,
+        std::chrono::nanoseconds t_end,
+        double max_queries_per_second)
 {
-    while (!data_source.eof())
+    const auto time_to_the_end = t_end - TimeUnit::get_uptime().get();
+    if (max_queries_per_second <= 0.0)
     {
-        const bool stdin_is_broken = !data_source;
-        if (stdin_is_broken)
-        {
-            throw std::runtime_error("stream is broken");
-        }
-        char data_chunk[0x10000];
-        data_source.read(data_chunk, sizeof(data_chunk));
-        const std::streamsize data_chunk_length = data_source.gcount();
-        this->append_data(data_chunk, data_chunk_length);
+        return time_to_the_end;
     }
-    this->data_finished();
+    const auto min_runtime = std::chrono::nanoseconds{static_cast<std::int64_t>(number_of_queries / (max_queries_per_second / 1.0e+9))};
+    return time_to_the_end < min_runtime ? min_runtime : time_to_the_end;
 }
 
-std::size_t DomainsToScan::get_number_of_nameservers() const
+bool has_succeeded(const Util::Fork::ChildResultStatus& status)
 {
-    return insecure_domains_of_namserver_.size();
-}
-
-std::size_t DomainsToScan::get_number_of_domains() const
-{
-    std::size_t sum_count = secure_domains_.size();
-    for (DomainsOfNamserver::const_iterator itr = insecure_domains_of_namserver_.begin();
-         itr != insecure_domains_of_namserver_.end(); ++itr)
+    if (status.signaled())
     {
-        sum_count += itr->second.size();
+        std::cerr << "child process terminated by signal " << status.get_signal_number() << std::endl;
+        return false;
     }
-    return sum_count;
-}
-
-std::size_t DomainsToScan::get_number_of_secure_domains() const
-{
-    return secure_domains_.size();
+    return status.exited() && (status.get_exit_status() == EXIT_SUCCESS);
 }
 
-constexpr auto section_of_secure_domains = "[secure]";
-constexpr auto section_of_insecure_domains = "[insecure]";
+RuntimeBudget::RuntimeBudget(std::chrono::nanoseconds t_end, std::size_t expected_domains)
+    : t_end_{t_end},
+      expected_domains_{expected_domains},
+      started_domains_{0}
+{ }
 
-DomainsToScan& DomainsToScan::append_data(const char* data_chunk, std::streamsize data_chunk_length)
+std::chrono::nanoseconds RuntimeBudget::get_end_of_batch(
+        std::size_t domains_of_batch,
+        std::size_t waiting_domains,
+        bool input_finished)
 {
-    const char* const data_end = data_chunk + data_chunk_length;
-    const char* item_begin = data_chunk;
-    const char* current_pos = data_chunk;
-    while (current_pos < data_end)
+    const auto now = TimeUnit::get_uptime().get();
+    const bool total_known = input_finished || (0 < expected_domains_);
+    if (!total_known)
     {
-        static const char item_delimiter = ' ';
-        static const char line_delimiter = '\n';
-        const bool item_end_reached = *current_pos == item_delimiter;
-        const bool line_end_reached = *current_pos == line_delimiter;
-        const bool some_delimiter_reached = item_end_reached || line_end_reached;
-        if (!some_delimiter_reached)
-        {
-            ++current_pos;
-            continue;
-        }
-        const std::size_t item_length = current_pos - item_begin;
-        const std::string item = rest_of_data_ + std::string(item_begin, item_length);
-        rest_of_data_.clear();
-        const bool check_section_flag = data_starts_at_new_line_ && line_end_reached;
-        if (check_section_flag)
-        {
-            const bool section_of_secure_domains_reached = item == section_of_secure_domains;
-            if (section_of_secure_domains_reached)
-            {
-                section_ = Section::secure;
-                nameserver_.clear();
-                insecure_domains_.clear();
-                data_starts_at_new_line_ = true;
-                ++current_pos;
-                item_begin = current_pos;
-                continue;
-            }
-            const bool section_of_insecure_domains_reached = item == section_of_insecure_domains;
-            if (section_of_insecure_domains_reached)
-            {
-                section_ = Section::insecure;
-                nameserver_.clear();
-                insecure_domains_.clear();
-                data_starts_at_new_line_ = true;
-                ++current_pos;
-                item_begin = current_pos;
-                continue;
-            }
-        }
-        switch (section_)
-        {
-            case Section::secure:
-                if (!item.empty())
-                {
-                    secure_domains_.insert(item);
-                }
-                else
-                {
-                    std::cerr << "secure section contains an empty fqdn of domain" << std::endl;
-                }
-                break;
-            case Section::insecure:
-            {
-                const bool item_is_nameserver = data_starts_at_new_line_;
-                if (item_is_nameserver)
-                {
-                    if (item.empty())
-                    {
-                        throw std::runtime_error("insecure section contains an empty hostname of nameserver");
-                    }
-                    nameserver_ = item;
-                    data_starts_at_new_line_ = false;
-                    insecure_domains_.clear();
-                }
-                else
-                {
-                    if (!item.empty())
-                    {
-                        insecure_domains_.insert(item);
-                    }
-                    else
-                    {
-                        std::cerr << "insecure section contains an empty fqdn of domain" << std::endl;
-                    }
-                }
-                break;
-            }
-            case Section::none:
-                throw std::runtime_error("no section specified yet");
-        }
-        if (line_end_reached)
-        {
-            const bool nameserver_data_available =
-                    (section_ == Section::insecure) && !nameserver_.empty() && !insecure_domains_.empty();
-            if (nameserver_data_available)
-            {
-                insecure_domains_of_namserver_.insert(std::make_pair(nameserver_, insecure_domains_));
-            }
-            nameserver_.clear();
-            insecure_domains_.clear();
-            data_starts_at_new_line_ = true;
-        }
-        ++current_pos;
-        item_begin = current_pos;
+        started_domains_ += domains_of_batch;
+        return now;
     }
-    const std::size_t rest_of_data_length = current_pos - item_begin;
-    rest_of_data_.append(item_begin, rest_of_data_length);
-    return *this;
-}
-
-void DomainsToScan::data_finished()
-{
-    const std::string item = rest_of_data_;
-    const bool check_section_flag = data_starts_at_new_line_;
-    if (check_section_flag)
+    const std::size_t parsed_domains = started_domains_ + waiting_domains;
+    const std::size_t remaining_domains = input_finished ? waiting_domains
+                                                         : std::max(expected_domains_, parsed_domains) - started_domains_;
+    started_domains_ += domains_of_batch;
+    if ((t_end_ <= now) || (remaining_domains <= 0))
     {
-        const bool section_of_secure_domains_reached = item == section_of_secure_domains;
-        if (section_of_secure_domains_reached)
-        {
-            return;
-        }
-        const bool section_of_insecure_domains_reached = item == section_of_insecure_domains;
-        if (section_of_insecure_domains_reached)
-        {
-            return;
-        }
-    }
-    switch (section_)
-    {
-        case Section::secure:
-            if (!item.empty())
-            {
-                secure_domains_.insert(item);
-            }
-            return;
-        case Section::insecure:
-        {
-            const bool item_is_nameserver = data_starts_at_new_line_;
-            if (!item_is_nameserver)
-            {
-                if (!item.empty())
-                {
-                    insecure_domains_.insert(item);
-                }
-                const bool nameserver_data_available = !nameserver_.empty() && !insecure_domains_.empty();
-                if (nameserver_data_available)
-                {
-                    insecure_domains_of_namserver_.insert(std::make_pair(nameserver_, insecure_domains_));
-                }
-                nameserver_.clear();
-                insecure_domains_.clear();
-            }
-            return;
-        }
-        case Section::none:
-            throw std::runtime_error("no section specified yet");
+        return t_end_;
     }
+    const double part_of_remaining_domains = double(domains_of_batch) / remaining_domains;
+    std::cerr << "batch of " << domains_of_batch << " domains gets " << part_of_remaining_domains << " of remaining time" << std::endl;
+    return now + std::chrono::nanoseconds{static_cast<std::int64_t>(std::llround((t_end_ - now).count() * part_of_remaining_domains))};
 }
 
-VectorOfInsecures resolve_hostnames_of_nameservers(
-        const DomainsToScan& domains_to_scan,
-        GetDns::Context::Timeout query_timeout,
-        std::chrono::nanoseconds runtime,
-        const std::list<boost::asio::ip::address>& resolvers)
+Util::NameTable::Ids get_nameservers(const DomainsToScan::DomainsOfNameservers& domains_of_nameservers)
 {
-    using IpAddresses = std::set<boost::asio::ip::address>;
-    using IpAddressesOfNameservers = std::map<std::string, IpAddresses>;
-    using DomainNameservers = std::map<std::string, Nameservers>;
-    using IpAddressesToDomainNameservers = std::map<boost::asio::ip::address, DomainNameservers>;
-    const Nameservers nameservers = domains_to_scan.get_nameservers();
-    const auto nameserver_addresses = HostnameResolver::get_result(
-            nameservers,
-            query_timeout,
-            resolvers,
-            runtime);
-
-    IpAddressesToDomainNameservers addresses_to_domains;
-    for (IpAddressesOfNameservers::const_iterator nameserver_itr = nameserver_addresses.begin();
-         nameserver_itr != nameserver_addresses.end(); ++nameserver_itr)
-    {
-        const std::string nameserver = nameserver_itr->first;
-        const Domains domains = domains_to_scan.get_insecure_domains_of(nameserver);
-        for (IpAddresses::const_iterator address_itr = nameserver_itr->second.begin();
-             address_itr != nameserver_itr->second.end(); ++address_itr)
-        {
-            DomainNameservers& domain_nameservers = addresses_to_domains[*address_itr];
-            for (Domains::const_iterator domain_itr = domains.begin(); domain_itr != domains.end(); ++domain_itr)
-            {
-                domain_nameservers[*domain_itr].insert(nameserver);
-            }
-        }
-    }
-
-    std::size_t number_of_items = 0;
-    for (IpAddressesToDomainNameservers::const_iterator address_itr = addresses_to_domains.begin();
-         address_itr != addresses_to_domains.end(); ++address_itr)
+    Util::NameTable::Ids nameservers;
+    nameservers.reserve(domains_of_nameservers.size());
+    for (auto&& nameserver_and_domains : domains_of_nameservers)
     {
-        number_of_items += address_itr->second.size();
+        nameservers.push_back(nameserver_and_domains.first);
     }
-    VectorOfInsecures result;
-    result.reserve(number_of_items);
-    for (IpAddressesToDomainNameservers::const_iterator address_itr = addresses_to_domains.begin();
-         address_itr != addresses_to_domains.end(); ++address_itr)
-    {
-        Insecure item;
-        item.address = address_itr->first;
-        for (DomainNameservers::const_iterator domain_itr = address_itr->second.begin();
-             domain_itr != address_itr->second.end(); ++domain_itr)
-        {
-            item.domain = domain_itr->first;
-            item.nameservers = domain_itr->second;
-            result.push_back(item);
-        }
-    }
-    std::shuffle(result.begin(), result.end(), std::mt19937(std::random_device()()));
-    return result;
+    return nameservers;
 }
 
-Nameservers DomainsToScan::get_nameservers()const
+std::size_t get_number_of_domains(const DomainsToScan::DomainsOfNameservers& domains_of_nameservers)
 {
-    Nameservers nameservers;
-    for (DomainsOfNamserver::const_iterator nameserver_itr = insecure_domains_of_namserver_.begin();
-         nameserver_itr != insecure_domains_of_namserver_.end(); ++nameserver_itr)
+    std::size_t number_of_domains = 0;
+    for (auto&& nameserver_and_domains : domains_of_nameservers)
     {
-        nameservers.insert(nameserver_itr->first);
+        number_of_domains += nameserver_and_domains.second.size();
     }
-    return nameservers;
+    return number_of_domains;
 }
 
-const Domains& DomainsToScan::get_secure_domains()const
+bool is_pipe(int fd)
 {
-    return secure_domains_;
-}
-
-Domains DomainsToScan::get_insecure_domains_of(const std::string& _nameserver)const
-{
-    const DomainsOfNamserver::const_iterator nameserver_itr = insecure_domains_of_namserver_.find(_nameserver);
-    const bool nameserver_found = nameserver_itr != insecure_domains_of_namserver_.end();
-    if (nameserver_found)
-    {
-        return nameserver_itr->second;
-    }
-    const Domains no_content;
-    return no_content;
+    struct ::stat status;
+    static constexpr int success = 0;
+    return (::fstat(fd, &status) == success) && (S_ISFIFO(status.st_mode) || S_ISSOCK(status.st_mode));
 }
 
 template <class T>
@@ -663,6 +1366,11 @@ void append_ip_address(const std::string& item, std::list<boost::asio::ip::addre
     addresses.push_back(boost::asio::ip::address::from_string(item));
 }
 
+void append_ip_prefix(const std::string& item, std::vector<Util::IpPrefix>& prefixes)
+{
+    prefixes.push_back(Util::parse_ip_prefix(item));
+}
+
 void append_trust_anchor(const std::string& item, std::list<GetDns::TrustAnchor>& anchors)
 {
     std::istringstream anchor_stream(item);
@@ -691,6 +1399,32 @@ const char cmdline_help_text[] =
                                "[--cdnskey_resolvers IP address[,...]] "
                                "[--dnssec_trust_anchors anchor[,...]] "
                                "[--timeout sec] "
+                               "[--min_timeout msec] "
+                               "[--context_pool_size count] "
+                               "[--hostname_sockets count] "
+                               "[--insecure_pipeline_depth count] "
+                               "[--insecure_connections_per_ip count] "
+                               "[--insecure_queries_in_flight_per_ip count] "
+                               "[--insecure_queries_per_second_per_ip rate] "
+                               "[--insecure_limits_per_network] "
+                               "[--insecure_breaker_timeouts count] "
+                               "[--insecure_breaker_probe_after sec] "
+                               "[--insecure_probe_first count] "
+                               "[--insecure_probe_policy empty|unresolved] "
+                               "[--insecure_io libevent|io_uring] "
+                               "[--insecure_blocked_ranges prefix[,...]] "
+                               "[--insecure_allowed_ranges prefix[,...]] "
+                               "[--workers count] "
+                               "[--threads count] "
+                               "[--max_queries_per_second rate] "
+                               "[--burst count] "
+                               "[--as_fast_as_allowed] "
+                               "[--max_attempts count] "
+                               "[--pipelined] "
+                               "[--input_file path] "
+                               "[--input_batch count] "
+                               "[--expected_domains count] "
+                               "[--memory_limit MiB] "
                                "RUNTIME | "
                                "--help\n\n"
         "    Arguments:\n"
@@ -706,9 +1440,91 @@ const char cmdline_help_text[] =
         "                       example: . 257 3 8 AwEAAdAjHYjq...xAU8=\n"
         "        --timeout ................ maximum time (in seconds) spent by one DNS request;\n"
         "                                   default is 10 seconds\n"
+        "        --min_timeout ............ minimum time (in milliseconds) spent by one CDNSKEY request\n"
+        "                                   to a nameserver, timeouts of nameserver addresses follow\n"
+        "                                   their round trip times between min_timeout and timeout;\n"
+        "                                   default is 500 milliseconds\n"
+        "        --context_pool_size ...... maximum number of unused getdns contexts kept for reuse\n"
+        "                                   by later queries with the same settings; 0 disables\n"
+        "                                   reuse of contexts; default is 1000\n"
+        "        --hostname_sockets ....... number of UDP sockets per address family shared by all A and\n"
+        "                                   AAAA queries of nameservers in a worker, truncated answers\n"
+        "                                   are asked again over TCP; default is 4\n"
+        "        --insecure_pipeline_depth  maximum number of CDNSKEY queries sent at once over one TCP\n"
+        "                                   connection to a nameserver; default is 10\n"
+        "        --insecure_connections_per_ip  maximum number of TCP connections opened at once to one\n"
+        "                                   nameserver; default is 2\n"
+        "        --insecure_queries_in_flight_per_ip  maximum number of CDNSKEY queries waiting for an\n"
+        "                                   answer of one nameserver address, other addresses get\n"
+        "                                   their turn meanwhile; 0 means no limit; default is\n"
+        "                                   insecure_pipeline_depth * insecure_connections_per_ip\n"
+        "        --insecure_queries_per_second_per_ip  maximum rate of CDNSKEY queries sent to one\n"
+        "                                   nameserver address; 0 means no limit; default is 0\n"
+        "        --insecure_limits_per_network  per ip limits apply to /24 (IPv4) and /48 (IPv6) networks\n"
+        "        --insecure_breaker_timeouts  number of consecutive timeouts of one nameserver address\n"
+        "                                   after which its remaining CDNSKEY queries are reported as\n"
+        "                                   unresolved without being sent; timeouts of queries sent\n"
+        "                                   before the last answer or the last counted timeout do not\n"
+        "                                   count; 0 disables it; default is 0\n"
+        "        --insecure_breaker_probe_after  time (in seconds) after which one query probes a cut off\n"
+        "                                   address, its answer lets the remaining queries through\n"
+        "                                   again; 0 disables probes; default is 60 seconds\n"
+        "        --insecure_probe_first ... number of CDNSKEY queries sent to each nameserver address\n"
+        "                                   before the other ones; if all of them are answered by\n"
+        "                                   REFUSED or SERVFAIL the other ones are not sent; 0 means\n"
+        "                                   no sampling; default is 0\n"
+        "        --insecure_probe_policy .. what is reported for CDNSKEY queries not sent because of\n"
+        "                                   insecure_probe_first: empty (insecure domain without\n"
+        "                                   CDNSKEY records, as if the nameserver refused them too)\n"
+        "                                   or unresolved; default is empty\n"
+        "        --insecure_io ............ how CDNSKEY queries go over TCP to nameservers: libevent\n"
+        "                                   (getdns) or io_uring (connects, writes and reads submitted\n"
+        "                                   in batches, needs Linux 5.6 or newer); default is libevent\n"
+        "        --insecure_blocked_ranges  address ranges (e.g. 192.0.2.0/24,2001:db8::/32) whose\n"
+        "                                   nameserver addresses are not asked for CDNSKEY records,\n"
+        "                                   they are reported as unresolved like private and special\n"
+        "                                   purpose addresses are\n"
+        "        --insecure_allowed_ranges  address ranges asked although a blocked, private or special\n"
+        "                                   purpose range contains them; the longest range containing\n"
+        "                                   an address decides\n"
+        "        --workers ................ number of processes sharing queries of each phase, tasks\n"
+        "                                   are split by hash of domain or nameserver address; default\n"
+        "                                   is 1\n"
+        "        --threads ................ number of threads asking insecure CDNSKEY queries in each\n"
+        "                                   worker, queries of one nameserver address are asked by\n"
+        "                                   one thread; default is 1\n"
+        "        --max_queries_per_second   maximum rate of queries of each phase, shared by its workers\n"
+        "                                   and threads; RUNTIME is extended if it is too short for\n"
+        "                                   this rate; 0 means no limit; default is 1000\n"
+        "        --burst .................. maximum number of queries sent at once after a pause;\n"
+        "                                   default is 10 ms worth of queries\n"
+        "        --as_fast_as_allowed ..... queries are sent as fast as the rate limit and the number of\n"
+        "                                   queries in flight allow instead of being spread over RUNTIME,\n"
+        "                                   the scan finishes early\n"
+        "        --max_attempts ........... maximum number of queries asked for one task, timed out,\n"
+        "                                   failed and SERVFAIL queries are asked again after a growing\n"
+        "                                   randomized pause if the assigned time allows; default is 3\n"
+        "        --pipelined .............. CDNSKEY records of nameserver are resolved as soon as its\n"
+        "                                   addresses are known, both phases share one event loop\n"
+        "        --input_file ............. data are read from this file instead of standard input; both\n"
+        "                                   are mapped into memory if they are regular files\n"
+        "        --input_batch ............ scanning starts while standard input is still being read\n"
+        "                                   from a pipe, each phase scans batches of at least this\n"
+        "                                   number of domains one after another; a batch gets the part\n"
+        "                                   of the remaining time its domains make of all domains not\n"
+        "                                   scanned yet; default is 0 (the whole input is read first)\n"
+        "        --expected_domains ....... number of domains expected in standard input, used for time\n"
+        "                                   of batches until the input is over; by default batches\n"
+        "                                   read before the end of input are scanned as fast as\n"
+        "                                   max_queries_per_second allows\n"
+        "        --memory_limit ........... resident memory (in MiB) of each insecure worker process;\n"
+        "                                   CDNSKEY tasks are generated in batches while the worker\n"
+        "                                   is under the limit, a worker over the limit finishes its\n"
+        "                                   tasks and a new one continues with the rest of them;\n"
+        "                                   by default up to 1M tasks are generated ahead\n"
         "        RUNTIME .................. total time (in seconds) reserved for application run\n"
         "        --help ................... this help\n\n"
-        "    Format of data received from standard input:\n"
+        "    Format of data received from standard input or input_file:\n"
         "        [secure]\n"
         "        podepsana1.cz podepsana2.cz ... podepsanaN.cz\n"
         "        [insecure]\n"
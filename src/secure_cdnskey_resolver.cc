@@ -21,6 +21,7 @@
 #include "src/time_unit.hh"
 
 #include "src/getdns/context.hh"
+#include "src/getdns/context_pool.hh"
 #include "src/getdns/data.hh"
 #include "src/getdns/exception.hh"
 #include "src/getdns/extensions_set.hh"
@@ -30,8 +31,18 @@
 #include <boost/optional.hpp>
 
 #include "src/util/pipe.hh"
-#include "src/util/fork.hh"
+#include "src/util/bitmap.hh"
+#include "src/util/concurrency_window.hh"
+#include "src/util/name_table.hh"
+#include "src/util/pacer.hh"
+#include "src/util/record.hh"
+#include "src/util/retry_queue.hh"
+#include "src/util/throughput.hh"
+#include "src/util/workers.hh"
 
+#include <unistd.h>
+
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
 
@@ -39,11 +50,14 @@
 #include <iostream>
 #include <list>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace {
 
-constexpr auto max_number_of_unresolved_queries = 200;
+constexpr auto window_settings = Util::ConcurrencyWindow::Settings{200, 0, 0.1, 4.0};
+//udp and tcp sockets, validation asks for DNSKEY and DS records of the chain of trust
+constexpr std::size_t descriptors_per_query = 4;
 
 struct Cdnskey
 {
@@ -61,47 +75,62 @@ struct Cdnskey
     }
 };
 
-using Nameservers = std::set<std::string>;
+using DomainByIndex = Util::NameTable::Ids;
+
+//records sent by the child process: secure (index, number of keys, keys of flags, protocol, algorithm and
+//public key), untrustworthy (index), unknown (index); one record answers one domain completely
+enum class RecordType : std::uint8_t
+{
+    secure,
+    untrustworthy,
+    unknown
+};
 
 class Query
 {
 public:
-    Query(const std::string& domain,
-          GetDns::Context context)
-        : hostname_{[&]() { char* const str = new char[domain.length() + 1]; std::memcpy(str, domain.c_str(), domain.length() + 1); return str; }()},
+    //domain points into the name table
+    Query(const char* domain,
+          std::size_t index,
+          GetDns::ContextPool::Lease context,
+          std::size_t attempt)
+        : hostname_{domain},
+          index_{index},
           context_{std::move(context)},
           extensions_{make_extensions(GetDns::ExtensionsSet<GetDns::Extension::DnssecReturnOnlySecure>{})},
           status_{Status::none},
-          result_{}
+          sent_at_{TimeUnit::Uptime::zero()},
+          result_{},
+          attempt_{attempt}
     { }
     Query(const Query&) = delete;
     Query(Query&& src) noexcept
-        : hostname_{nullptr},
+        : hostname_{src.hostname_},
+          index_{src.index_},
           context_{std::move(src.context_)},
           extensions_{std::move(src.extensions_)},
           status_{src.status_},
-          result_{std::move(src.result_)}
-    {
-        std::swap(src.hostname_, hostname_);
-    }
-    ~Query() noexcept
-    {
-        delete[] hostname_;
-    }
+          sent_at_{src.sent_at_},
+          result_{std::move(src.result_)},
+          attempt_{src.attempt_}
+    { }
     Query& operator=(const Query&) = delete;
     Query& operator=(Query&& src) noexcept
     {
-        std::swap(src.hostname_, hostname_);
+        hostname_ = src.hostname_;
+        index_ = src.index_;
         std::swap(src.context_, context_);
         std::swap(src.extensions_, extensions_);
         status_ = src.status_;
+        sent_at_ = src.sent_at_;
         std::swap(src.result_, result_);
+        attempt_ = src.attempt_;
         return *this;
     }
-    ::getdns_transaction_t start_transaction(Event::Base& event_base, ::getdns_callback_t callback_fnc, void* user_data)
+    ::getdns_transaction_t start_transaction(Event::Base&, ::getdns_callback_t callback_fnc, void* user_data)
     {
-        context_.set_libevent_base(event_base);
         ::getdns_transaction_t transaction_id;
+        sent_at_ = TimeUnit::get_uptime();
         MUST_BE_GOOD(::getdns_general(context_, hostname_, std::uint16_t{GETDNS_RRTYPE_CDNSKEY}, *extensions_, user_data, &transaction_id, callback_fnc));
         status_ = Status::in_progress;
         return transaction_id;
@@ -140,6 +169,25 @@ public:
     {
         return hostname_;
     }
+    std::size_t get_index()const
+    {
+        return index_;
+    }
+    TimeUnit::Uptime get_sent_at()const
+    {
+        return sent_at_;
+    }
+    std::size_t get_attempt() const
+    {
+        return attempt_;
+    }
+    //no definitive answer came, asking again may help
+    bool is_worth_retrying() const
+    {
+        return (status_ == Status::cancelled) ||
+               (status_ == Status::timed_out) ||
+               (status_ == Status::failed);
+    }
     void on_complete(GetDns::Data::DictRef answer, ::getdns_transaction_t)
     {
         status_ = Status::untrustworthy_answer;
@@ -165,34 +213,27 @@ public:
                 status_ = Status::failed;
                 return;
         }
-        const auto replies = answer.get<GetDns::Data::ListRef>("replies_tree");
-        for (std::size_t reply_idx = 0; reply_idx < replies.length(); ++reply_idx)
+        try
         {
-            const auto reply = replies.get<GetDns::Data::DictRef>(reply_idx);
-            const auto answers = reply.get<GetDns::Data::ListRef>("answer");
-            const auto number_of_answers = answers.length();
-            for (std::size_t answer_idx = 0; answer_idx < number_of_answers; ++answer_idx)
+            GetDns::for_each_reply(answer, [&](const Dns::Message& reply)
             {
-                try
+                reply.for_each_answer([&](const Dns::ResourceRecord& record)
                 {
-                    const auto answer = answers.get<GetDns::Data::DictRef>(answer_idx);
-                    if ((static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("type")) == GETDNS_RRTYPE_CDNSKEY) &&
-                        (static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("class")) == GETDNS_RRCLASS_IN))
+                    if ((record.type == Dns::RrType::cdnskey) && (record.rr_class == Dns::RrClass::in))
                     {
-                        const auto rdata = answer.get<GetDns::Data::DictRef>("rdata");
-                        Cdnskey cdnskey;
-                        cdnskey.algorithm = rdata.get<GetDns::Data::IntegerRef>("algorithm");
-                        cdnskey.flags = rdata.get<GetDns::Data::IntegerRef>("flags");
-                        cdnskey.protocol = rdata.get<GetDns::Data::IntegerRef>("protocol");
-                        cdnskey.public_key = GetDns::base64_encode(rdata.get<GetDns::Data::BinDataRef>("public_key"));
-                        result_.cdnskeys.push_back(std::move(cdnskey));
+                        const auto dnskey = Dns::parse_dnskey(record);
+                        result_.cdnskeys.push_back(Cdnskey{
+                                dnskey.flags,
+                                dnskey.protocol,
+                                dnskey.algorithm,
+                                Dns::base64_encode(dnskey.public_key, dnskey.public_key_length)});
                     }
-                }
-                catch (const ::GetDns::NoSuchDictName& e)
-                {
-                    std::cerr << "resolve " << hostname_ << ": " << e.what() << std::endl;
-                }
-            }
+                });
+            });
+        }
+        catch (const Dns::MalformedMessage& e)
+        {
+            std::cerr << "resolve " << hostname_ << ": " << e.what() << std::endl;
         }
         status_ = Status::completed;
     }
@@ -210,10 +251,13 @@ public:
     }
 private:
     const char* hostname_;
-    GetDns::Context context_;
+    std::size_t index_;
+    GetDns::ContextPool::Lease context_;
     GetDns::Data::Dict extensions_;
     Status status_;
+    TimeUnit::Uptime sent_at_;
     Result result_;
+    std::size_t attempt_;
 };
 
 template <typename ...Ts>
@@ -224,371 +268,257 @@ public:
     using OnTimeout = Event::OnTimeout<QueryGenerator>;
     QueryGenerator(
             Solver& solver,
-            const Domains& to_resolve,
+            const Util::NameTable& names,
+            const DomainByIndex& domains,
+            const Util::Bitmap& done,
             GetDns::Context::Timeout query_timeout,
             const std::list<boost::asio::ip::address>& resolvers,
-            const GetDns::Data::TrustAnchorList& trust_anchors,
-            std::chrono::nanoseconds assigned_time)
+            const std::list<GetDns::TrustAnchor>& trust_anchors,
+            Util::Pacer pacer,
+            const Util::RetrySettings& retries,
+            Util::RecordWriter& to_parent)
         : OnTimeout{solver.get_event_base()},
           solver_{solver},
-          to_resolve_{to_resolve},
-          to_resolve_itr_{to_resolve_.begin()},
-          remaining_queries_{to_resolve_.size()},
-          query_timeout_{query_timeout},
-          resolvers_{resolvers},
-          trust_anchors_{trust_anchors},
-          time_end_{TimeUnit::get_uptime().get() + assigned_time}
+          names_{names},
+          domains_{domains},
+          done_{done},
+          next_index_{done_.find_next_unset(0)},
+          remaining_queries_{done_.size() - done_.count()},
+          context_key_{make_context_key(query_timeout, resolvers, trust_anchors)},
+          window_{make_window_settings()},
+          pacer_{pacer},
+          retries_{retries},
+          throughput_{},
+          to_parent_{to_parent}
     {
         this->OnTimeout::set(std::chrono::microseconds{0});
         while (0 < (remaining_queries_ + solver_.get_number_of_unresolved_requests()))
         {
             solver_.do_one_step();
-            const auto finished_requests = solver_.pop_finished_requests();
-            for (auto&& query : finished_requests)
+            solver_.for_each_finished_request([&](Query& query)
             {
-                const char* const to_resolve = query.get_domain();
+                throughput_.query_finished();
+                //retried queries count in the window too
+                if ((query.get_status() == Query::Status::completed) ||
+                    (query.get_status() == Query::Status::untrustworthy_answer))
+                {
+                    window_.on_answer(query.get_sent_at());
+                }
+                else if (query.get_status() == Query::Status::timed_out)
+                {
+                    window_.on_timeout(query.get_sent_at());
+                }
+                if (this->retry_later(query))
+                {
+                    return;
+                }
+                const auto index = static_cast<std::uint32_t>(query.get_index());
                 switch (query.get_status())
                 {
                     case Query::Status::completed:
                     {
-                        const Query::Result result = query.get_result();
-                        if (result.cdnskeys.empty())
+                        const Query::Result& result = query.get_result();
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::secure))
+                                  .add(index)
+                                  .add(static_cast<std::uint32_t>(result.cdnskeys.size()));
+                        for (auto&& key : result.cdnskeys)
                         {
-                            std::cout << "secure-empty " << to_resolve << std::endl;
-                        }
-                        else
-                        {
-                            for (auto&& key : result.cdnskeys)
-                            {
-                                std::cout << "secure " << to_resolve << " " << key << std::endl;
-                            }
+                            to_parent_.add(key.flags)
+                                      .add(key.protocol)
+                                      .add(key.algorithm)
+                                      .add(key.public_key);
                         }
+                        to_parent_.finish();
                         break;
                     }
                     case Query::Status::untrustworthy_answer:
                     {
-                        std::cout << "untrustworthy " << to_resolve << std::endl;
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::untrustworthy)).add(index).finish();
+                        break;
+                    }
+                    case Query::Status::timed_out:
+                    {
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::unknown)).add(index).finish();
                         break;
                     }
                     case Query::Status::cancelled:
                     case Query::Status::failed:
                     case Query::Status::none:
                     case Query::Status::in_progress:
-                    case Query::Status::timed_out:
                     {
-                        std::cout << "unknown " << to_resolve << std::endl;
+                        to_parent_.start(static_cast<std::uint8_t>(RecordType::unknown)).add(index).finish();
                         break;
                     }
                 }
-            }
+            });
+            to_parent_.flush();
             if (remaining_queries_ <= 0)
             {
                 this->OnTimeout::remove();
             }
         }
+        std::cerr << "secure CDNSKEY resolver: " << throughput_ << ", " << window_ << ", "
+                  << solver_.get_context_pool().get_statistics() << std::endl;
     }
     QueryGenerator& on_timeout_occurrence()
     {
-        if (solver_.get_number_of_unresolved_requests() < max_number_of_unresolved_queries)
+        const auto number_of_allowed_requests = pacer_.take(remaining_queries_);
+        std::size_t number_of_added_requests = 0;
+        while ((number_of_added_requests < number_of_allowed_requests) &&
+               (0 < remaining_queries_) &&
+               (solver_.get_number_of_unresolved_requests() < window_.get_limit()))
         {
-            const auto make_context = [&]()
+            auto retry = retries_.pop_ready();
+            if ((retry == boost::none) && (done_.size() <= next_index_))
             {
-                auto context = GetDns::Context{GetDns::Context::InitialSettings::FromOs{}};
-                context.set_timeout(query_timeout_)
-                       .set_dns_transport_list(GetDns::TransportsList<Ts...>{});
-                if (!trust_anchors_.empty())
-                {
-                    context.set_dnssec_trust_anchors(trust_anchors_);
-                }
-                if (!resolvers_.empty())
+                //only retries waiting for their backoff remain
+                break;
+            }
+            const std::size_t index = retry != boost::none ? retry->item : next_index_;
+            errno = 0;
+            try
+            {
+                solver_.add_request(Query{
+                        names_.get_name(domains_[index]),
+                        index,
+                        solver_.get_context_pool().borrow(context_key_),
+                        retry != boost::none ? retry->attempt : 1});
+            }
+            catch (...)
+            {
+                const bool descriptors_exhausted = (errno == EMFILE) || (errno == ENFILE);
+                const auto number_of_queries_in_flight = solver_.get_number_of_unresolved_requests();
+                if (descriptors_exhausted && (0 < number_of_queries_in_flight))
                 {
-                    context.set_upstream_recursive_servers(resolvers_);
+                    //the domain will be tried again when some descriptors get released
+                    window_.on_descriptors_exhausted(number_of_queries_in_flight);
+                    if (retry != boost::none)
+                    {
+                        retries_.give_back(std::move(*retry));
+                    }
+                    break;
                 }
-                return context;
-            };
-            solver_.add_request(Query{*to_resolve_itr_, make_context()});
-            this->set_time_of_next_query();
-            if (to_resolve_itr_ != to_resolve_.end())
+                throw;
+            }
+            ++number_of_added_requests;
+            if (retry == boost::none)
             {
-                ++to_resolve_itr_;
-                --remaining_queries_;
+                next_index_ = done_.find_next_unset(next_index_ + 1);
             }
+            --remaining_queries_;
         }
-        else if (0 < remaining_queries_)
+        pacer_.give_back(number_of_allowed_requests - number_of_added_requests);
+        if (0 < remaining_queries_)
         {
-            this->set_time_of_next_query();
+            this->OnTimeout::set(pacer_.get_time_to_next_tick());
         }
         return *this;
     }
 private:
-    QueryGenerator& set_time_of_next_query()
+    //transient failures are asked again after a backoff if the assigned time allows
+    bool retry_later(const Query& query)
     {
-        const auto now = TimeUnit::get_uptime();
-        using Time = TimeUnit::Nanoseconds<struct TimeTag_>;
-        const auto remaining_time = Time{time_end_ - now.get()};
-        static constexpr auto min_timeout = Time{std::chrono::microseconds{10000}};//smaller value exhausts file descriptors :-(
-        if (remaining_time <= Time::zero())
+        const auto time_left = pacer_.get_remaining_time() - context_key_.timeout.template as<std::chrono::nanoseconds>();
+        if (!retries_.retry_later(query, query.get_index(), time_left, remaining_queries_))
         {
-            this->OnTimeout::set(min_timeout.template as<std::chrono::microseconds>());
+            return false;
         }
-        else
+        this->OnTimeout::set(pacer_.get_time_to_next_tick());
+        return true;
+    }
+    static GetDns::ContextPool::Key make_context_key(
+            GetDns::Context::Timeout query_timeout,
+            const std::list<boost::asio::ip::address>& resolvers,
+            const std::list<GetDns::TrustAnchor>& trust_anchors)
+    {
+        GetDns::ContextPool::Key key;
+        if (!resolvers.empty())
         {
-            const auto one_query_time = remaining_time / remaining_queries_;
-            this->OnTimeout::set((one_query_time < min_timeout ? min_timeout
-                                                               : one_query_time).template as<std::chrono::microseconds>());
+            key.upstreams = resolvers;
         }
-        return *this;
+        key.transports = GetDns::make_transports_vector(GetDns::TransportsList<Ts...>{});
+        key.timeout = query_timeout;
+        key.trust_anchors = trust_anchors;
+        return key;
+    }
+    static Util::ConcurrencyWindow::Settings make_window_settings()
+    {
+        auto settings = window_settings;
+        settings.max_limit = Util::ConcurrencyWindow::get_descriptors_budget(descriptors_per_query);
+        return settings;
     }
     Solver& solver_;
-    const Domains& to_resolve_;
-    Domains::const_iterator to_resolve_itr_;
+    const Util::NameTable& names_;
+    const DomainByIndex& domains_;
+    const Util::Bitmap& done_;
+    std::size_t next_index_;
     std::size_t remaining_queries_;
-    GetDns::Context::Timeout query_timeout_;
-    const std::list<boost::asio::ip::address>& resolvers_;
-    const GetDns::Data::TrustAnchorList& trust_anchors_;
-    std::chrono::nanoseconds time_end_;
+    GetDns::ContextPool::Key context_key_;
+    Util::ConcurrencyWindow window_;
+    Util::Pacer pacer_;
+    Util::RetryQueue<std::size_t> retries_;
+    Util::Throughput throughput_;
+    Util::RecordWriter& to_parent_;
 };
 
+//handles records received from child processes
 class Answer
 {
 public:
-    Answer(Event::Base& loop,
-           Domains& answered,
-           const Util::ImReader& source,
-           std::chrono::seconds max_idle)
-        : source_{source},
-          answered_{answered},
-          event_ptr_{::event_new(loop,
-                                 source_.get_descriptor(),
-                                 monitored_events_ | EV_PERSIST,
-                                 callback_routine,
-                                 this)},
-          max_idle_{max_idle},
-          source_stream_closed_{false},
-          timed_out_{false}
-    {
-        this->monitor_events_on_source_stream();
-        while (true)
-        {
-            loop(Event::Loop::Once{});
-            if (timed_out_)
-            {
-                return;
-            }
-            if (content_.empty())
-            {
-                if (source_stream_closed_)
-                {
-                    return;
-                }
-                continue;
-            }
-            const char* line_begin = content_.c_str();
-            while (*line_begin != '\0')
-            {
-                const char* line_end = line_begin;
-                while ((*line_end != '\0') && (*line_end != '\n'))
-                {
-                    ++line_end;
-                }
-                const bool line_end_reached = (*line_end == '\n') || source_stream_closed_;
-                if (!line_end_reached)
-                {
-                    break;
-                }
-                this->line_received(line_begin, line_end);
-                const bool data_end_reached = (*line_end == '\0') && source_stream_closed_;
-                if (data_end_reached)
-                {
-                    return;
-                }
-                line_begin = line_end + 1;
-            }
-            content_ = line_begin;
-        }
-    }
-    ~Answer()
-    {
-        this->remove();
-    }
-    bool timed_out()const
-    {
-        return timed_out_;
-    }
-private:
-    static const char* skip_to(const char* begin, const char* end, char stop)
-    {
-        const char* position_of_stop_character = std::find(begin, end, stop);
-        const bool end_reached = position_of_stop_character == end;
-        if (!end_reached)
-        {
-            return position_of_stop_character;
-        }
-        throw std::runtime_error("stop character not found");
-    }
-    void line_received(const char* _line_begin, const char* _line_end)
+    Answer(const Util::NameTable& names,
+           const DomainByIndex& domains,
+           Util::Bitmap& done)
+        : names_{names},
+          domains_{domains},
+          done_{done}
+    { }
+    void operator()(Util::Record& record) const
     {
-        const int number_of_known_prefixes = 4;
-        const char* const known_prefixes[number_of_known_prefixes] =
-            {
-                "secure",
-                "secure-empty",
-                "untrustworthy",
-                "unknown"
-            };
-        const std::ptrdiff_t secure_prefix_idx = 0;
-        const char* const* end_of_known_prefixes = known_prefixes + number_of_known_prefixes;
-        const char* domain_begin = nullptr;
-        const char* const* known_prefix_ptr = known_prefixes;
-        while (known_prefix_ptr < end_of_known_prefixes)
-        {
-            const char* const prefix = *known_prefix_ptr;
-            const ::size_t prefix_len = std::strlen(prefix);
-            const int string_equal = 0;
-            const bool prefix_candidate_found = std::strncmp(_line_begin, prefix, prefix_len) == string_equal;
-            const bool prefix_found = prefix_candidate_found && (_line_begin[prefix_len] == ' ');
-            if (prefix_found)
-            {
-                domain_begin = _line_begin + prefix_len + 1;
-                break;
-            }
-            ++known_prefix_ptr;
-        }
-        if (domain_begin == nullptr)
-        {
-            throw std::runtime_error("invalid data received");
-        }
-        try
-        {
-            const bool cdnskey_record_found = (known_prefix_ptr - known_prefixes) == secure_prefix_idx;
-            const char* const domain_end = cdnskey_record_found ? skip_to(domain_begin, _line_end, ' ')
-                                                                : _line_end;
-            const std::string domain(domain_begin, domain_end - domain_begin);
-            answered_.insert(domain);
-            std::cout << std::string(_line_begin, _line_end - _line_begin) << std::endl;
-            return;
-        }
-        catch (...)
+        const std::size_t index = record.get_uint32();
+        if (domains_.size() <= index)
         {
             throw std::runtime_error("invalid data received");
         }
-    }
-    Answer& monitor_events_on_source_stream()
-    {
-        struct ::timeval timeout;
-        timeout.tv_sec = max_idle_.count();
-        timeout.tv_usec = 0;
-        const int success = 0;
-        const int retval = ::event_add(event_ptr_, &timeout);
-        if (retval == success)
-        {
-            return *this;
-        }
-        struct EventAddFailure:std::runtime_error
+        const char* const domain = names_.get_name(domains_[index]);
+        switch (static_cast<RecordType>(record.get_type()))
         {
-            EventAddFailure():std::runtime_error("event_add failed") { }
-        };
-        throw EventAddFailure();
-    }
-    Answer& remove()
-    {
-        if (event_ptr_ != nullptr)
-        {
-            ::event_del(event_ptr_);
-            ::event_free(event_ptr_);
-            event_ptr_ = nullptr;
-        }
-        return *this;
-    }
-    void on_event(short _events)
-    {
-        const bool timed_out = (_events & EV_TIMEOUT) == EV_TIMEOUT;
-        if (timed_out)
-        {
-            this->on_timeout();
-        }
-        const bool ready_for_reading = (_events & EV_READ) == EV_READ;
-        if (ready_for_reading)
-        {
-            this->on_read();
-        }
-    }
-    void on_timeout()
-    {
-        timed_out_ = true;
-    }
-    void on_read()
-    {
-        char buffer[0x10000];
-        while (true)
-        {
-            static constexpr ::ssize_t failure = -1;
-            const auto read_retval = ::read(source_.get_descriptor(), buffer, sizeof(buffer));
-            const bool read_failed = (read_retval == failure);
-            if (!read_failed)
+            case RecordType::secure:
             {
-                const bool end_reached = (read_retval == 0);
-                if (end_reached)
+                std::vector<Cdnskey> keys(record.get_uint32());
+                for (auto&& key : keys)
                 {
-                    source_stream_closed_ = true;
+                    key.flags = record.get_uint16();
+                    key.protocol = record.get_uint8();
+                    key.algorithm = record.get_uint8();
+                    key.public_key = record.get_string();
                 }
-                else
+                done_.set(index);
+                if (keys.empty())
                 {
-                    const auto data_length = static_cast<std::size_t>(read_retval);
-                    content_.append(buffer, data_length);
-                    const bool all_available_data_already_read = data_length < sizeof(buffer);
-                    if (!all_available_data_already_read)
-                    {
-                        continue;
-                    }
+                    std::cout << "secure-empty " << domain << '\n';
+                    return;
+                }
+                for (auto&& key : keys)
+                {
+                    std::cout << "secure " << domain << " " << key << '\n';
                 }
                 return;
             }
-            const int c_errno = errno;
-            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK);
-            if (data_unavailable)
-            {
+            case RecordType::untrustworthy:
+                done_.set(index);
+                std::cout << "untrustworthy " << domain << '\n';
                 return;
-            }
-            const bool operation_was_interrupted_by_a_signal = c_errno == EINTR;
-            if (operation_was_interrupted_by_a_signal)
-            {
+            case RecordType::unknown:
+                done_.set(index);
+                std::cout << "unknown " << domain << '\n';
                 return;
-            }
-            struct ReadFailed:std::runtime_error
-            {
-                ReadFailed(int error_code):std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
-            };
-            throw ReadFailed(c_errno);
         }
+        throw std::runtime_error("invalid data received");
     }
-    static void callback_routine(evutil_socket_t _fd, short _events, void* _user_data_ptr)
-    {
-        auto const event_ptr = static_cast<Answer*>(_user_data_ptr);
-        if ((event_ptr != nullptr) && (event_ptr->source_.get_descriptor() == _fd))
-        {
-            try
-            {
-                event_ptr->on_event(_events);
-            }
-            catch (const std::exception& e)
-            {
-                std::cerr << "Answer::on_event failed: " << e.what() << std::endl;
-            }
-            catch (...)
-            {
-                std::cerr << "Answer::on_event caught an unexpected exception" << std::endl;
-            }
-        }
-    }
-    const Util::ImReader& source_;
-    Domains& answered_;
-    struct ::event* event_ptr_;
-    std::chrono::seconds max_idle_;
-    std::string content_;
-    bool source_stream_closed_;
-    bool timed_out_;
-    static constexpr auto monitored_events_ = short{EV_READ};
+private:
+    const Util::NameTable& names_;
+    const DomainByIndex& domains_;
+    Util::Bitmap& done_;
 };
 
 template <typename ...Ts>
@@ -596,130 +526,124 @@ class ChildProcess
 {
 public:
     ChildProcess(
-            const Domains& to_resolve,
+            const Util::NameTable& names,
+            const DomainByIndex& to_resolve,
             GetDns::Context::Timeout query_timeout,
             const std::list<boost::asio::ip::address>& resolvers,
-            const GetDns::Data::TrustAnchorList& trust_anchors,
+            const std::list<GetDns::TrustAnchor>& trust_anchors,
             std::chrono::nanoseconds assigned_time,
-            const Domains& answered,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t context_pool_size,
+            const Util::Bitmap& done,
             Util::Pipe& pipe_to_parent)
-        : to_resolve_{to_resolve},
+        : names_{names},
+          to_resolve_{to_resolve},
           query_timeout_{query_timeout},
           resolvers_{resolvers},
-          trust_anchors_{std::move(trust_anchors)},
+          trust_anchors_{trust_anchors},
           assigned_time_{assigned_time},
-          answered_{answered},
+          pacing_{pacing},
+          retries_{retries},
+          context_pool_size_{context_pool_size},
+          done_{done},
           pipe_to_parent_{pipe_to_parent}
     { }
     int operator()()const
     {
         Util::ImWriter to_parent{pipe_to_parent_, Util::ImWriter::Stream::stdout};
-        GetDns::Solver<Query> solver;
-        if (answered_.empty())
-        {
-            const QueryGenerator<Ts...> resolve{
-                    solver,
-                    to_resolve_,
-                    query_timeout_,
-                    resolvers_,
-                    trust_anchors_,
-                    assigned_time_};
-        }
-        else
-        {
-            Domains to_resolve;
-            for (auto&& task : to_resolve_)
-            {
-                const bool resolved = answered_.find(task) != answered_.end();
-                if (!resolved)
-                {
-                    to_resolve.insert(task);
-                }
-            }
-            const QueryGenerator<Ts...> resolve{
-                    solver,
-                    to_resolve,
-                    query_timeout_,
-                    resolvers_,
-                    trust_anchors_,
-                    std::chrono::nanoseconds{static_cast<std::int64_t>(assigned_time_.count() * double(to_resolve.size()) / to_resolve_.size())}};
-        }
+        Util::RecordWriter records_to_parent{STDOUT_FILENO};
+        GetDns::Solver<Query> solver{context_pool_size_};
+        Util::TokenBucket limit{pacing_.get_limit()};
+        const QueryGenerator<Ts...> resolve{
+                solver,
+                names_,
+                to_resolve_,
+                done_,
+                query_timeout_,
+                resolvers_,
+                trust_anchors_,
+                Util::Pacer{limit, pacing_, assigned_time_},
+                retries_,
+                records_to_parent};
         return EXIT_SUCCESS;
     }
 private:
-    const Domains& to_resolve_;
+    const Util::NameTable& names_;
+    const DomainByIndex& to_resolve_;
     GetDns::Context::Timeout query_timeout_;
     const std::list<boost::asio::ip::address>& resolvers_;
-    GetDns::Data::TrustAnchorList trust_anchors_;
+    const std::list<GetDns::TrustAnchor>& trust_anchors_;
     std::chrono::nanoseconds assigned_time_;
-    const Domains& answered_;
+    Util::Pacer::Settings pacing_;
+    Util::RetrySettings retries_;
+    std::size_t context_pool_size_;
+    const Util::Bitmap& done_;
     Util::Pipe& pipe_to_parent_;
 };
 
 }//namespace {anonymous}
 
 void SecureCdnskeyResolver::resolve(
-        const Domains& to_resolve,
+        const Util::NameTable& names,
+        const Util::NameTable::Ids& to_resolve,
         GetDns::Context::Timeout query_timeout,
         const std::list<boost::asio::ip::address>& resolvers,
-        GetDns::Data::TrustAnchorList trust_anchors,
-        std::chrono::nanoseconds assigned_time)
+        const std::list<GetDns::TrustAnchor>& trust_anchors,
+        std::chrono::nanoseconds assigned_time,
+        const Util::Pacer::Settings& pacing,
+        const Util::RetrySettings& retries,
+        std::size_t context_pool_size,
+        std::size_t number_of_workers)
 {
     if (to_resolve.empty())
     {
         return;
     }
-    Domains answered;
-    while (answered.size() < to_resolve.size())
+    const double query_distance_sec = (assigned_time.count() / double(to_resolve.size())) / 1000000000LL;
+    const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
+    Util::Bitmap done{to_resolve.size()};
+    while (!done.all())
     {
-        Util::Pipe pipe;
-        Util::Fork parent{
-                ChildProcess<GetDns::TransportProtocol::Udp, GetDns::TransportProtocol::Tcp>{
-                        to_resolve,
-                        query_timeout,
-                        resolvers,
-                        trust_anchors,
-                        assigned_time,
-                        answered,
-                        pipe}};
-        Util::ImReader from_child{pipe};
-        from_child.set_nonblocking();
-        Event::Base monitor;
-        const double query_distance_sec = (assigned_time.count() / double(to_resolve.size())) / 1000000000LL;
-        const auto answer_timeout = std::chrono::seconds{static_cast<std::int64_t>(query_distance_sec + 5)} + query_timeout.as<std::chrono::seconds>();
-        const Answer answer{monitor, answered, from_child, answer_timeout};
-        try
+        //workers share the time of the remaining part of domains
+        const auto time_for_remaining_domains = std::chrono::nanoseconds{static_cast<std::int64_t>(
+                assigned_time.count() * double(done.size() - done.count()) / done.size())};
+        std::vector<Util::Bitmap> done_of_shards;
+        for (std::size_t idx = 0; idx < number_of_workers; ++idx)
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.get_child_result_status();
-            if (child_result_status.exited())
-            {
-                if (child_result_status.get_exit_status() == EXIT_SUCCESS)
-                {
-                    std::cerr << "secure CDNSKEY records resolved" << std::endl;
-                    if (answered.size() < to_resolve.size())
-                    {
-                        throw std::runtime_error("secure CDNSKEY resolver did not complete it's job");
-                    }
-                    return;
-                }
-                std::cerr << "child process failed" << std::endl;
-            }
-            else if (child_result_status.signaled())
+            done_of_shards.push_back(Util::Shard{idx, number_of_workers}.mask(done, to_resolve));
+        }
+        Util::Workers workers{answer_timeout};
+        for (auto&& done_of_shard : done_of_shards)
+        {
+            if (done_of_shard.all())
             {
-                std::cerr << "child process terminated by signal " << child_result_status.get_signal_number() << std::endl;
+                continue;
             }
-            else
+            workers.start([&](Util::Pipe& pipe_to_parent)
             {
-                std::cerr << "child process done" << std::endl;
-            }
+                return ChildProcess<GetDns::TransportProtocol::Udp, GetDns::TransportProtocol::Tcp>{
+                        names,
+                        to_resolve,
+                        query_timeout,
+                        resolvers,
+                        trust_anchors,
+                        time_for_remaining_domains,
+                        pacing.get_part(number_of_workers),
+                        retries,
+                        context_pool_size,
+                        done_of_shard,
+                        pipe_to_parent};
+            });
         }
-        catch (const Util::Fork::ChildIsStillRunning&)
+        if (workers.wait(Answer{names, to_resolve, done}))
         {
-            const Util::Fork::ChildResultStatus child_result_status = parent.kill_child();
-            if (child_result_status.signaled())
+            std::cerr << "secure CDNSKEY records resolved" << std::endl;
+            if (!done.all())
             {
-                std::cerr << "child process was terminated because of blocking" << std::endl;
+                throw std::runtime_error("secure CDNSKEY resolver did not complete it's job");
             }
+            return;
         }
     }
 }
@@ -23,24 +23,31 @@
 #include "src/getdns/context.hh"
 #include "src/getdns/data.hh"
 
+#include "src/util/name_table.hh"
+#include "src/util/pacer.hh"
+#include "src/util/retry_queue.hh"
+
 #include <boost/asio/ip/address.hpp>
 
 #include <chrono>
+#include <cstddef>
 #include <list>
-#include <set>
-#include <string>
-
 
-using Domains = std::set<std::string>;
 
 struct SecureCdnskeyResolver
 {
+    //to_resolve are distinct ids of names
     static void resolve(
-            const Domains& to_resolve,
+            const Util::NameTable& names,
+            const Util::NameTable::Ids& to_resolve,
             GetDns::Context::Timeout query_timeout,
             const std::list<boost::asio::ip::address>& resolvers,
-            GetDns::Data::TrustAnchorList trust_anchors,
-            std::chrono::nanoseconds assigned_time);
+            const std::list<GetDns::TrustAnchor>& trust_anchors,
+            std::chrono::nanoseconds assigned_time,
+            const Util::Pacer::Settings& pacing,
+            const Util::RetrySettings& retries,
+            std::size_t context_pool_size,
+            std::size_t number_of_workers);
 };
 
 #endif//SECURE_CDNSKEY_RESOLVER_HH_FFBD7215A0403402C6A3E7BDD107973D
@@ -19,9 +19,14 @@
 
 #include "src/time_unit.hh"
 
+#include <time.h>
+
+#include <cerrno>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 
 namespace TimeUnit {
@@ -31,6 +36,21 @@ Uptime get_uptime()
     return Uptime{std::chrono::steady_clock::now().time_since_epoch()};
 }
 
+CpuTime get_cpu_time()
+{
+    struct ::timespec cpu_time;
+    static constexpr int success = 0;
+    if (::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time) == success)
+    {
+        return CpuTime{std::chrono::seconds{cpu_time.tv_sec} + std::chrono::nanoseconds{cpu_time.tv_nsec}};
+    }
+    struct ClockGettimeFailed : std::runtime_error
+    {
+        ClockGettimeFailed(int error_code) : std::runtime_error{std::string{"clock_gettime() failed: "} + std::strerror(error_code)} { }
+    };
+    throw ClockGettimeFailed{errno};
+}
+
 template <>
 std::ostream& operator<<<std::chrono::seconds::rep, std::chrono::seconds::period>(std::ostream& out, const std::chrono::seconds& t)
 {
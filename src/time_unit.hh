@@ -83,6 +83,10 @@ using Uptime = Nanoseconds<struct UptimeTag_>;
 
 Uptime get_uptime();
 
+using CpuTime = Nanoseconds<struct CpuTimeTag_>;
+
+CpuTime get_cpu_time();
+
 }//namespace TimeUnit
 
 #endif//TIME_UNIT_HH_AA862C0A2A13AEFBE6D015A289BED606
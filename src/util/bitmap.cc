@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/bitmap.hh"
+
+#include <stdexcept>
+
+namespace Util {
+
+Bitmap::Bitmap()
+    : words_{},
+      size_{0},
+      count_{0}
+{ }
+
+Bitmap::Bitmap(std::size_t size)
+    : words_((size + bits_per_word - 1) / bits_per_word, Word{0}),
+      size_{size},
+      count_{0}
+{ }
+
+Bitmap& Bitmap::grow(std::size_t size)
+{
+    if (size_ < size)
+    {
+        words_.resize((size + bits_per_word - 1) / bits_per_word, Word{0});
+        size_ = size;
+    }
+    return *this;
+}
+
+bool Bitmap::set(std::size_t idx)
+{
+    if (size_ <= idx)
+    {
+        throw std::out_of_range("bit index out of range");
+    }
+    const auto mask = Word{1} << (idx % bits_per_word);
+    Word& word = words_[idx / bits_per_word];
+    if ((word & mask) != 0)
+    {
+        return false;
+    }
+    word |= mask;
+    ++count_;
+    return true;
+}
+
+bool Bitmap::is_set(std::size_t idx) const
+{
+    if (size_ <= idx)
+    {
+        throw std::out_of_range("bit index out of range");
+    }
+    return (words_[idx / bits_per_word] & (Word{1} << (idx % bits_per_word))) != 0;
+}
+
+std::size_t Bitmap::size() const noexcept
+{
+    return size_;
+}
+
+std::size_t Bitmap::count() const noexcept
+{
+    return count_;
+}
+
+bool Bitmap::all() const noexcept
+{
+    return count_ == size_;
+}
+
+std::size_t Bitmap::find_next_unset(std::size_t idx) const noexcept
+{
+    if (size_ <= idx)
+    {
+        return size_;
+    }
+    std::size_t word_idx = idx / bits_per_word;
+    //bits below idx are considered set
+    Word unset = ~words_[word_idx] & (~Word{0} << (idx % bits_per_word));
+    while (unset == 0)
+    {
+        ++word_idx;
+        if (words_.size() <= word_idx)
+        {
+            return size_;
+        }
+        unset = ~words_[word_idx];
+    }
+    const std::size_t result = word_idx * bits_per_word + static_cast<std::size_t>(__builtin_ctzll(unset));
+    return result < size_ ? result : size_;
+}
+
+}//namespace Util
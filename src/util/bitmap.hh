@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BITMAP_HH_2DA9C7F4E6A10F4B9A7CF9D3A2C4CB89//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define BITMAP_HH_2DA9C7F4E6A10F4B9A7CF9D3A2C4CB89
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Util {
+
+//one bit per task, tasks are identified by their indices
+class Bitmap
+{
+public:
+    Bitmap();
+    explicit Bitmap(std::size_t size);
+    //bits added are not set, the bitmap never shrinks
+    Bitmap& grow(std::size_t size);
+    //returns false if the bit was already set
+    bool set(std::size_t idx);
+    bool is_set(std::size_t idx) const;
+    std::size_t size() const noexcept;
+    std::size_t count() const noexcept;
+    bool all() const noexcept;
+    //index of the first bit not set starting at idx, size() if there is none
+    std::size_t find_next_unset(std::size_t idx) const noexcept;
+private:
+    using Word = std::uint64_t;
+    static constexpr std::size_t bits_per_word = 64;
+    std::vector<Word> words_;
+    std::size_t size_;
+    std::size_t count_;
+};
+
+}//namespace Util
+
+#endif//BITMAP_HH_2DA9C7F4E6A10F4B9A7CF9D3A2C4CB89
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CIRCUIT_BREAKER_HH_3703C97D79AE94554610CEE6E5A5C244//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define CIRCUIT_BREAKER_HH_3703C97D79AE94554610CEE6E5A5C244
+
+#include "src/time_unit.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+
+namespace Util {
+
+struct CircuitBreakerSettings
+{
+    //consecutive timeouts opening the circuit of a key; 0 disables the breaker
+    std::size_t max_consecutive_timeouts;
+    //an open circuit lets one probe through after this time; zero means the circuit stays open
+    std::chrono::nanoseconds probe_after;
+};
+
+//keys (e.g. addresses of servers) which timed out max_consecutive_timeouts times in a row get no more
+//queries; after probe_after one probe query is let through (half-open circuit), its answer closes the
+//circuit, its timeout or failure opens the circuit again; a timeout counts only if its query was sent after
+//the last answer and after the last counted timeout of the key, so queries pipelined at once (e.g. over one
+//stalled connection) count as one timeout
+template <typename Key>
+class CircuitBreaker
+{
+public:
+    enum class Transition
+    {
+        none,
+        opened,
+        probe_failed,
+        closed
+    };
+    explicit CircuitBreaker(const CircuitBreakerSettings& settings);
+    //false if no query of the key may be sent now
+    bool allow(const Key& key);
+    Transition on_answer(const Key& key);
+    Transition on_timeout(const Key& key, TimeUnit::Uptime sent_at);
+    //the query ended without an answer and without a timeout (e.g. it failed or it was cancelled)
+    Transition on_failure(const Key& key, TimeUnit::Uptime sent_at);
+    //the query let through by allow() was not sent, the key lets the next one through
+    CircuitBreaker& cancel(const Key& key);
+    std::size_t get_number_of_opened_circuits() const noexcept;
+private:
+    enum class State
+    {
+        closed,
+        open,
+        half_open
+    };
+    struct KeyState
+    {
+        State state;
+        std::size_t consecutive_timeouts;
+        TimeUnit::Uptime opened_at;
+        //time of the last answer or the last counted timeout
+        TimeUnit::Uptime counted_since;
+    };
+    bool is_enabled() const noexcept;
+    KeyState& get_state_of(const Key& key);
+    CircuitBreakerSettings settings_;
+    //keys without answers and timeouts are not kept
+    std::map<Key, KeyState> keys_;
+    std::size_t number_of_opened_circuits_;
+};
+
+template <typename Key>
+CircuitBreaker<Key>::CircuitBreaker(const CircuitBreakerSettings& settings)
+    : settings_{settings},
+      keys_{},
+      number_of_opened_circuits_{0}
+{ }
+
+template <typename Key>
+bool CircuitBreaker<Key>::allow(const Key& key)
+{
+    const auto key_itr = keys_.find(key);
+    if (key_itr == keys_.end())
+    {
+        return true;
+    }
+    KeyState& key_state = key_itr->second;
+    switch (key_state.state)
+    {
+        case State::closed:
+            return true;
+        case State::open:
+        {
+            const bool probe_allowed = (std::chrono::nanoseconds::zero() < settings_.probe_after) &&
+                                       (settings_.probe_after <= (TimeUnit::get_uptime().get() - key_state.opened_at.get()));
+            if (probe_allowed)
+            {
+                key_state.state = State::half_open;
+                return true;
+            }
+            return false;
+        }
+        case State::half_open:
+            //the probe is in flight
+            return false;
+    }
+    return true;
+}
+
+template <typename Key>
+typename CircuitBreaker<Key>::Transition CircuitBreaker<Key>::on_answer(const Key& key)
+{
+    if (!this->is_enabled())
+    {
+        return Transition::none;
+    }
+    KeyState& key_state = this->get_state_of(key);
+    const bool was_closed = key_state.state == State::closed;
+    key_state.state = State::closed;
+    key_state.consecutive_timeouts = 0;
+    key_state.counted_since = TimeUnit::get_uptime();
+    return was_closed ? Transition::none : Transition::closed;
+}
+
+template <typename Key>
+typename CircuitBreaker<Key>::Transition CircuitBreaker<Key>::on_timeout(const Key& key, TimeUnit::Uptime sent_at)
+{
+    if (!this->is_enabled())
+    {
+        return Transition::none;
+    }
+    KeyState& key_state = this->get_state_of(key);
+    if (sent_at < key_state.counted_since)
+    {
+        //an answer or a counted timeout came meanwhile, queries sent before the circuit opened included
+        return Transition::none;
+    }
+    const auto now = TimeUnit::get_uptime();
+    key_state.counted_since = now;
+    switch (key_state.state)
+    {
+        case State::closed:
+            ++key_state.consecutive_timeouts;
+            if (key_state.consecutive_timeouts < settings_.max_consecutive_timeouts)
+            {
+                return Transition::none;
+            }
+            key_state.state = State::open;
+            key_state.opened_at = now;
+            ++number_of_opened_circuits_;
+            return Transition::opened;
+        case State::open:
+            return Transition::none;
+        case State::half_open:
+            key_state.state = State::open;
+            key_state.opened_at = now;
+            return Transition::probe_failed;
+    }
+    return Transition::none;
+}
+
+template <typename Key>
+typename CircuitBreaker<Key>::Transition CircuitBreaker<Key>::on_failure(const Key& key, TimeUnit::Uptime sent_at)
+{
+    const auto key_itr = keys_.find(key);
+    if ((key_itr == keys_.end()) || (key_itr->second.state != State::half_open))
+    {
+        return Transition::none;
+    }
+    KeyState& key_state = key_itr->second;
+    if (sent_at < key_state.counted_since)
+    {
+        //queries sent before the circuit opened are not the probe
+        return Transition::none;
+    }
+    const auto now = TimeUnit::get_uptime();
+    key_state.state = State::open;
+    key_state.opened_at = now;
+    key_state.counted_since = now;
+    return Transition::probe_failed;
+}
+
+template <typename Key>
+CircuitBreaker<Key>& CircuitBreaker<Key>::cancel(const Key& key)
+{
+    const auto key_itr = keys_.find(key);
+    if ((key_itr != keys_.end()) && (key_itr->second.state == State::half_open))
+    {
+        //opened_at is kept, the probe is let through at once
+        key_itr->second.state = State::open;
+    }
+    return *this;
+}
+
+template <typename Key>
+std::size_t CircuitBreaker<Key>::get_number_of_opened_circuits() const noexcept
+{
+    return number_of_opened_circuits_;
+}
+
+template <typename Key>
+bool CircuitBreaker<Key>::is_enabled() const noexcept
+{
+    return 0 < settings_.max_consecutive_timeouts;
+}
+
+template <typename Key>
+typename CircuitBreaker<Key>::KeyState& CircuitBreaker<Key>::get_state_of(const Key& key)
+{
+    return keys_.emplace(key, KeyState{State::closed, 0, TimeUnit::Uptime::zero(), TimeUnit::Uptime::zero()}).first->second;
+}
+
+}//namespace Util
+
+#endif//CIRCUIT_BREAKER_HH_3703C97D79AE94554610CEE6E5A5C244
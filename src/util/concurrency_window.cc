@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/concurrency_window.hh"
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+namespace Util {
+
+namespace {
+
+constexpr double min_limit = 1.0;
+constexpr double timeout_ratio_weight = 1.0 / 32;
+constexpr int rtt_weight_divider = 8;
+constexpr std::size_t min_number_of_rtt_samples = 16;
+//stdin, stdout, stderr, pipes, event base, resolv.conf, trust anchors, ...
+constexpr ::rlim_t reserved_descriptors = 64;
+
+}//namespace Util::{anonymous}
+
+ConcurrencyWindow::ConcurrencyWindow(const Settings& settings)
+    : limit_{},
+      max_limit_{std::max(min_limit, static_cast<double>(settings.max_limit))},
+      settings_{settings},
+      slow_start_{true},
+      timeout_ratio_{0.0},
+      smoothed_rtt_{TimeUnit::Uptime::zero()},
+      min_smoothed_rtt_{TimeUnit::Uptime::zero()},
+      number_of_rtt_samples_{0},
+      last_decrease_at_{TimeUnit::Uptime::zero()},
+      number_of_decreases_{0}
+{
+    limit_ = std::min(max_limit_, std::max(min_limit, static_cast<double>(settings.initial_limit)));
+}
+
+std::size_t ConcurrencyWindow::get_limit() const noexcept
+{
+    return static_cast<std::size_t>(limit_);
+}
+
+ConcurrencyWindow& ConcurrencyWindow::on_answer(TimeUnit::Uptime query_sent_at)
+{
+    timeout_ratio_ -= timeout_ratio_weight * timeout_ratio_;
+    const auto now = TimeUnit::get_uptime();
+    const auto rtt = now.get() - query_sent_at.get();
+    smoothed_rtt_ = TimeUnit::Uptime{number_of_rtt_samples_ == 0 ? rtt
+                                                                 : smoothed_rtt_.get() + (rtt - smoothed_rtt_.get()) / rtt_weight_divider};
+    ++number_of_rtt_samples_;
+    if (number_of_rtt_samples_ == min_number_of_rtt_samples)
+    {
+        min_smoothed_rtt_ = smoothed_rtt_;
+    }
+    else if ((min_number_of_rtt_samples < number_of_rtt_samples_) && (smoothed_rtt_ < min_smoothed_rtt_))
+    {
+        min_smoothed_rtt_ = smoothed_rtt_;
+    }
+    if (settings_.max_healthy_timeout_ratio < timeout_ratio_)
+    {
+        return *this;
+    }
+    const bool rtt_inflated = (0.0 < settings_.max_healthy_rtt_inflation) &&
+                              (min_number_of_rtt_samples < number_of_rtt_samples_) &&
+                              (settings_.max_healthy_rtt_inflation * min_smoothed_rtt_.get().count() < smoothed_rtt_.get().count());
+    if (rtt_inflated)
+    {
+        //queries wait in queues, back off gently
+        slow_start_ = false;
+        limit_ = std::max(min_limit, limit_ - 1.0 / limit_);
+        return *this;
+    }
+    limit_ = std::min(max_limit_, limit_ + (slow_start_ ? 1.0 : 1.0 / limit_));
+    return *this;
+}
+
+ConcurrencyWindow& ConcurrencyWindow::on_timeout(TimeUnit::Uptime query_sent_at)
+{
+    timeout_ratio_ += timeout_ratio_weight * (1.0 - timeout_ratio_);
+    if (timeout_ratio_ <= settings_.max_healthy_timeout_ratio)
+    {
+        return *this;
+    }
+    //queries sent before the last decrease say nothing about the current limit
+    const bool sent_after_last_decrease = last_decrease_at_ <= query_sent_at;
+    if (sent_after_last_decrease)
+    {
+        this->decrease(TimeUnit::get_uptime());
+    }
+    return *this;
+}
+
+ConcurrencyWindow& ConcurrencyWindow::on_descriptors_exhausted(std::size_t number_of_queries_in_flight)
+{
+    max_limit_ = std::max(min_limit, 0.75 * number_of_queries_in_flight);
+    limit_ = std::min(limit_, max_limit_);
+    return this->decrease(TimeUnit::get_uptime());
+}
+
+ConcurrencyWindow& ConcurrencyWindow::decrease(TimeUnit::Uptime now)
+{
+    slow_start_ = false;
+    limit_ = std::max(min_limit, limit_ / 2);
+    last_decrease_at_ = now;
+    ++number_of_decreases_;
+    return *this;
+}
+
+std::size_t ConcurrencyWindow::get_descriptors_budget(std::size_t descriptors_per_query)
+{
+    struct ::rlimit limit;
+    static constexpr int success = 0;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != success)
+    {
+        const int c_errno = errno;
+        std::cerr << "getrlimit(RLIMIT_NOFILE) failed: " << std::strerror(c_errno) << std::endl;
+        return std::numeric_limits<std::size_t>::max();
+    }
+    if (limit.rlim_cur == RLIM_INFINITY)
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    if (limit.rlim_cur <= reserved_descriptors)
+    {
+        return 1;
+    }
+    return std::max(std::size_t{1}, static_cast<std::size_t>(limit.rlim_cur - reserved_descriptors) / std::max(std::size_t{1}, descriptors_per_query));
+}
+
+std::ostream& operator<<(std::ostream& out, const ConcurrencyWindow& window)
+{
+    out << "window " << window.get_limit() << " of " << static_cast<std::size_t>(window.max_limit_)
+        << " queries, " << window.number_of_decreases_ << " decreases";
+    if (0 < window.number_of_rtt_samples_)
+    {
+        out << ", srtt " << std::chrono::duration<double, std::milli>{window.smoothed_rtt_.get()}.count() << "ms";
+    }
+    return out;
+}
+
+}//namespace Util
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CONCURRENCY_WINDOW_HH_5E0C2F6A8B91D3477A1C60E4B2F98D15//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define CONCURRENCY_WINDOW_HH_5E0C2F6A8B91D3477A1C60E4B2F98D15
+
+#include "src/time_unit.hh"
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace Util {
+
+// Limit of queries in flight. The limit grows while queries are answered without latency inflation
+// and timeouts stay rare (one query per answer until the first decrease, then one query per window),
+// it is halved when timeouts become frequent and its maximum is lowered when file descriptors run out.
+class ConcurrencyWindow
+{
+public:
+    struct Settings
+    {
+        std::size_t initial_limit;
+        std::size_t max_limit;
+        // ratio of timed out queries which is not caused by the load (e.g. unreachable servers)
+        double max_healthy_timeout_ratio;
+        // smoothed round trip time may grow to this multiple of its minimum; 0 ignores round trip times
+        double max_healthy_rtt_inflation;
+    };
+    explicit ConcurrencyWindow(const Settings& settings);
+    std::size_t get_limit() const noexcept;
+    ConcurrencyWindow& on_answer(TimeUnit::Uptime query_sent_at);
+    ConcurrencyWindow& on_timeout(TimeUnit::Uptime query_sent_at);
+    ConcurrencyWindow& on_descriptors_exhausted(std::size_t number_of_queries_in_flight);
+    // number of queries which fit into the RLIMIT_NOFILE limit of this process
+    static std::size_t get_descriptors_budget(std::size_t descriptors_per_query);
+private:
+    ConcurrencyWindow& decrease(TimeUnit::Uptime now);
+    double limit_;
+    double max_limit_;
+    Settings settings_;
+    bool slow_start_;
+    double timeout_ratio_;
+    TimeUnit::Uptime smoothed_rtt_;
+    TimeUnit::Uptime min_smoothed_rtt_;
+    std::size_t number_of_rtt_samples_;
+    TimeUnit::Uptime last_decrease_at_;
+    std::size_t number_of_decreases_;
+    friend std::ostream& operator<<(std::ostream& out, const ConcurrencyWindow& window);
+};
+
+}//namespace Util
+
+#endif//CONCURRENCY_WINDOW_HH_5E0C2F6A8B91D3477A1C60E4B2F98D15
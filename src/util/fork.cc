@@ -55,6 +55,15 @@ Fork::ChildResultStatus Fork::get_child_result_status()
     return ChildResultStatus(*this, ChildResultStatus::WaitpidOption::return_immediately);
 }
 
+Fork::ChildResultStatus Fork::wait_for_child_result_status()
+{
+    if (!child_is_running_)
+    {
+        throw std::runtime_error("no child is running");
+    }
+    return ChildResultStatus(*this, ChildResultStatus::WaitpidOption::wait_on_exit);
+}
+
 namespace {
 
 int get_process_exit_status(::pid_t process, bool wait_on_exit)
@@ -53,6 +53,7 @@ public:
         friend class Fork;
     };
     ChildResultStatus get_child_result_status();
+    ChildResultStatus wait_for_child_result_status();
     ChildResultStatus kill_child();
     ~Fork();
 private:
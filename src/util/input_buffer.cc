@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/input_buffer.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace Util {
+
+namespace {
+
+constexpr std::size_t initial_read_size = 1 << 20;
+
+[[noreturn]] void throw_system_error(const char* operation)
+{
+    const int c_errno = errno;
+    throw std::runtime_error(std::string{operation} + " failed: " + std::strerror(c_errno));
+}
+
+}//namespace Util::{anonymous}
+
+InputBuffer InputBuffer::map_file(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw_system_error("open");
+    }
+    try
+    {
+        auto result = read_all(fd);
+        ::close(fd);
+        return result;
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+}
+
+InputBuffer InputBuffer::read_all(int fd)
+{
+    struct ::stat status;
+    if (::fstat(fd, &status) != 0)
+    {
+        throw_system_error("fstat");
+    }
+    //files of size 0 may be special ones with content (procfs), they are read
+    if (S_ISREG(status.st_mode) && (0 < status.st_size))
+    {
+        const auto size = static_cast<std::size_t>(status.st_size);
+        void* const mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            throw_system_error("mmap");
+        }
+        //the input is parsed once from its beginning to its end
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+        return InputBuffer{mapped, size};
+    }
+    std::vector<char> content(initial_read_size);
+    std::size_t size = 0;
+    while (true)
+    {
+        if (size == content.size())
+        {
+            content.resize(2 * content.size());
+        }
+        const auto bytes = ::read(fd, content.data() + size, content.size() - size);
+        if (bytes == 0)
+        {
+            break;
+        }
+        if (bytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw_system_error("read");
+        }
+        size += bytes;
+    }
+    content.resize(size);
+    return InputBuffer{std::move(content)};
+}
+
+InputBuffer::InputBuffer(void* mapped, std::size_t size) noexcept
+    : mapped_{mapped},
+      mapped_size_{size},
+      content_{}
+{ }
+
+InputBuffer::InputBuffer(std::vector<char> content) noexcept
+    : mapped_{nullptr},
+      mapped_size_{0},
+      content_{std::move(content)}
+{ }
+
+InputBuffer::InputBuffer(InputBuffer&& src) noexcept
+    : mapped_{nullptr},
+      mapped_size_{0},
+      content_{std::move(src.content_)}
+{
+    std::swap(src.mapped_, mapped_);
+    std::swap(src.mapped_size_, mapped_size_);
+}
+
+InputBuffer::~InputBuffer()
+{
+    if (mapped_ != nullptr)
+    {
+        ::munmap(mapped_, mapped_size_);
+    }
+}
+
+const char* InputBuffer::data() const noexcept
+{
+    return mapped_ != nullptr ? static_cast<const char*>(mapped_) : content_.data();
+}
+
+std::size_t InputBuffer::size() const noexcept
+{
+    return mapped_ != nullptr ? mapped_size_ : content_.size();
+}
+
+}//namespace Util
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INPUT_BUFFER_HH_E8840E5B7BB8E3C871557B6974672E85//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define INPUT_BUFFER_HH_E8840E5B7BB8E3C871557B6974672E85
+
+#include <cstddef>
+#include <vector>
+
+namespace Util {
+
+//whole input in memory, regular files are mapped, pipes and terminals are read into one buffer
+class InputBuffer
+{
+public:
+    static InputBuffer map_file(const char* path);
+    //the descriptor is not closed
+    static InputBuffer read_all(int fd);
+    InputBuffer(InputBuffer&& src) noexcept;
+    InputBuffer(const InputBuffer&) = delete;
+    ~InputBuffer();
+    InputBuffer& operator=(InputBuffer&&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+    const char* data() const noexcept;
+    std::size_t size() const noexcept;
+private:
+    InputBuffer(void* mapped, std::size_t size) noexcept;
+    explicit InputBuffer(std::vector<char> content) noexcept;
+    void* mapped_;
+    std::size_t mapped_size_;
+    std::vector<char> content_;
+};
+
+}//namespace Util
+
+#endif//INPUT_BUFFER_HH_E8840E5B7BB8E3C871557B6974672E85
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/input_stream.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace Util {
+
+InputStream::InputStream(Event::Base& loop, int fd, Consumer consume)
+    : fd_{fd},
+      consume_{std::move(consume)},
+      event_ptr_{nullptr},
+      content_{},
+      finished_{false},
+      failure_{}
+{
+    static constexpr int failure = -1;
+    const int current_flags = ::fcntl(fd_, F_GETFL);
+    if ((current_flags == failure) || (::fcntl(fd_, F_SETFL, current_flags | O_NONBLOCK) == failure))
+    {
+        struct FcntlFailed : std::runtime_error
+        {
+            FcntlFailed(int error_code) : std::runtime_error(std::string("fcntl() failed: ") + std::strerror(error_code)) { }
+        };
+        throw FcntlFailed(errno);
+    }
+    event_ptr_ = ::event_new(loop, fd_, EV_READ | EV_PERSIST, callback_routine, this);
+    static constexpr int success = 0;
+    if ((event_ptr_ == nullptr) || (::event_add(event_ptr_, nullptr) != success))
+    {
+        if (event_ptr_ != nullptr)
+        {
+            ::event_free(event_ptr_);
+        }
+        struct EventAddFailure : std::runtime_error
+        {
+            EventAddFailure() : std::runtime_error("event_add failed") { }
+        };
+        throw EventAddFailure();
+    }
+}
+
+InputStream::~InputStream()
+{
+    if (event_ptr_ != nullptr)
+    {
+        ::event_del(event_ptr_);
+        ::event_free(event_ptr_);
+        event_ptr_ = nullptr;
+    }
+}
+
+bool InputStream::is_finished() const
+{
+    if (failure_ != nullptr)
+    {
+        std::rethrow_exception(failure_);
+    }
+    return finished_;
+}
+
+InputStream& InputStream::on_read()
+{
+    static constexpr std::size_t chunk_size = 0x10000;
+    while (true)
+    {
+        const auto used_size = content_.size();
+        content_.resize(used_size + chunk_size);
+        static constexpr ::ssize_t failure = -1;
+        const auto read_retval = ::read(fd_, content_.data() + used_size, chunk_size);
+        content_.resize(used_size + (0 < read_retval ? read_retval : 0));
+        if (read_retval == failure)
+        {
+            const int c_errno = errno;
+            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK) || (c_errno == EINTR);
+            if (data_unavailable)
+            {
+                break;
+            }
+            struct ReadFailed : std::runtime_error
+            {
+                ReadFailed(int error_code) : std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
+            };
+            throw ReadFailed(c_errno);
+        }
+        const bool end_reached = (read_retval == 0);
+        if (end_reached)
+        {
+            consume_(content_.data(), content_.size(), true);
+            content_.clear();
+            return this->finish();
+        }
+    }
+    const auto used_size = consume_(content_.data(), content_.size(), false);
+    content_.erase(content_.begin(), content_.begin() + used_size);
+    return *this;
+}
+
+InputStream& InputStream::finish()
+{
+    if (!finished_)
+    {
+        ::event_del(event_ptr_);
+        finished_ = true;
+    }
+    return *this;
+}
+
+void InputStream::callback_routine(evutil_socket_t fd, short events, void* user_data_ptr)
+{
+    auto* const stream_ptr = static_cast<InputStream*>(user_data_ptr);
+    if ((stream_ptr != nullptr) && (stream_ptr->fd_ == fd) && ((events & EV_READ) == EV_READ))
+    {
+        try
+        {
+            stream_ptr->on_read();
+        }
+        catch (...)
+        {
+            stream_ptr->failure_ = std::current_exception();
+            stream_ptr->finish();
+        }
+    }
+}
+
+}//namespace Util
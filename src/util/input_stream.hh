@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INPUT_STREAM_HH_10C9E1B7C2BBEAD72ADEB506E1BFA00C//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define INPUT_STREAM_HH_10C9E1B7C2BBEAD72ADEB506E1BFA00C
+
+#include "src/event/base.hh"
+
+#include <event2/event.h>
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace Util {
+
+//reads a pipe from an event loop as its data come, data not used by the consumer yet are given to it again
+//together with following data
+class InputStream
+{
+public:
+    //returns the number of bytes used, all of them have to be used once the end is reached
+    using Consumer = std::function<std::size_t(const char* data, std::size_t size, bool end_reached)>;
+    //the descriptor is not closed
+    InputStream(Event::Base& loop, int fd, Consumer consume);
+    ~InputStream();
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+    //throws the exception which stopped reading
+    bool is_finished() const;
+private:
+    static void callback_routine(evutil_socket_t fd, short events, void* user_data_ptr);
+    InputStream& on_read();
+    InputStream& finish();
+    const int fd_;
+    Consumer consume_;
+    struct ::event* event_ptr_;
+    std::vector<char> content_;
+    bool finished_;
+    std::exception_ptr failure_;
+};
+
+}//namespace Util
+
+#endif//INPUT_STREAM_HH_10C9E1B7C2BBEAD72ADEB506E1BFA00C
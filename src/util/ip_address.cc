@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/ip_address.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+namespace Util {
+
+namespace {
+
+constexpr IpAddress::Bytes v4_mapped_prefix = {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0}};
+constexpr unsigned v4_mapped_prefix_length = 96;
+constexpr unsigned bits_per_byte = 8;
+
+}//namespace Util::{anonymous}
+
+IpAddress::IpAddress() noexcept
+    : bytes_{},
+      family_{Family::v6}
+{ }
+
+IpAddress::IpAddress(const Bytes& bytes, Family family) noexcept
+    : bytes_{bytes},
+      family_{family}
+{ }
+
+IpAddress::IpAddress(const boost::asio::ip::address& address) noexcept
+    : bytes_{},
+      family_{address.is_v4() ? Family::v4 : Family::v6}
+{
+    if (address.is_v4())
+    {
+        const auto bytes = address.to_v4().to_bytes();
+        bytes_ = v4_mapped_prefix;
+        std::copy(begin(bytes), end(bytes), begin(bytes_) + v4_mapped_prefix_length / bits_per_byte);
+        return;
+    }
+    const auto bytes = address.to_v6().to_bytes();
+    std::copy(begin(bytes), end(bytes), begin(bytes_));
+}
+
+boost::asio::ip::address IpAddress::to_address() const
+{
+    if (this->is_v4())
+    {
+        boost::asio::ip::address_v4::bytes_type bytes;
+        std::copy(begin(bytes_) + v4_mapped_prefix_length / bits_per_byte, end(bytes_), begin(bytes));
+        return boost::asio::ip::address_v4{bytes};
+    }
+    boost::asio::ip::address_v6::bytes_type bytes;
+    std::copy(begin(bytes_), end(bytes_), begin(bytes));
+    return boost::asio::ip::address_v6{bytes};
+}
+
+bool IpAddress::is_v4() const noexcept
+{
+    return family_ == Family::v4;
+}
+
+bool IpAddress::is_v4_mapped() const noexcept
+{
+    return std::memcmp(bytes_.data(), v4_mapped_prefix.data(), v4_mapped_prefix_length / bits_per_byte) == 0;
+}
+
+IpAddress::Family IpAddress::get_family() const noexcept
+{
+    return family_;
+}
+
+const IpAddress::Bytes& IpAddress::get_bytes() const noexcept
+{
+    return bytes_;
+}
+
+bool IpAddress::get_bit(unsigned idx) const noexcept
+{
+    return (bytes_[idx / bits_per_byte] & (0x80u >> (idx % bits_per_byte))) != 0;
+}
+
+IpAddress IpAddress::get_prefix(unsigned length) const noexcept
+{
+    IpAddress prefix{Bytes{}, family_};
+    const unsigned whole_bytes = std::min(length, 128u) / bits_per_byte;
+    std::copy(begin(bytes_), begin(bytes_) + whole_bytes, begin(prefix.bytes_));
+    if ((whole_bytes < prefix.bytes_.size()) && (length % bits_per_byte != 0))
+    {
+        prefix.bytes_[whole_bytes] = bytes_[whole_bytes] & static_cast<unsigned char>(0xFF00u >> (length % bits_per_byte));
+    }
+    return prefix;
+}
+
+std::size_t IpAddress::get_hash() const noexcept
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const auto byte : bytes_)
+    {
+        hash = (hash ^ byte) * 1099511628211ULL;
+    }
+    hash = (hash ^ static_cast<unsigned char>(family_)) * 1099511628211ULL;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+std::ostream& operator<<(std::ostream& out, const IpAddress& address)
+{
+    return out << address.to_address();
+}
+
+IpAddresses& insert(IpAddresses& addresses, const IpAddress& address)
+{
+    const auto itr = std::lower_bound(begin(addresses), end(addresses), address);
+    if ((itr == end(addresses)) || (*itr != address))
+    {
+        addresses.insert(itr, address);
+    }
+    return addresses;
+}
+
+IpPrefix parse_ip_prefix(const std::string& text)
+{
+    const auto slash = text.find('/');
+    boost::system::error_code error;
+    const auto address = boost::asio::ip::make_address(text.substr(0, slash), error);
+    if (error)
+    {
+        throw std::invalid_argument("invalid address in prefix " + text);
+    }
+    const unsigned max_length = address.is_v4() ? 32 : 128;
+    if (slash == std::string::npos)
+    {
+        return IpPrefix{IpAddress{address}, 128};
+    }
+    const auto digits = text.substr(slash + 1);
+    const bool is_number = !digits.empty() && (digits.size() <= 3) &&
+                           std::all_of(begin(digits), end(digits), [](char c) { return ('0' <= c) && (c <= '9'); });
+    const unsigned length = is_number ? static_cast<unsigned>(std::stoul(digits)) : max_length + 1;
+    if (max_length < length)
+    {
+        throw std::invalid_argument("invalid length of prefix " + text);
+    }
+    const unsigned full_length = length + (address.is_v4() ? v4_mapped_prefix_length : 0);
+    return IpPrefix{IpAddress{address}.get_prefix(full_length), full_length};
+}
+
+}//namespace Util
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef IP_ADDRESS_HH_2623DD29DDB02AE2EFD191656CB7E093//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define IP_ADDRESS_HH_2623DD29DDB02AE2EFD191656CB7E093
+
+#include <boost/asio/ip/address.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Util {
+
+//IPv6 address or IPv4 address in its v4-mapped form (::ffff:a.b.c.d), 16 plain bytes compared by memcmp
+//and the family; boost::asio::ip::address is twice as large and its comparison dispatches on the family;
+//an IPv4 address and the v4-mapped IPv6 address share the bytes, so prefixes match both of them
+class IpAddress
+{
+public:
+    using Bytes = std::array<unsigned char, 16>;
+    enum class Family : unsigned char
+    {
+        v4,
+        v6
+    };
+    //::
+    IpAddress() noexcept;
+    //bytes of an IPv4 address are in the v4-mapped form
+    IpAddress(const Bytes& bytes, Family family) noexcept;
+    explicit IpAddress(const boost::asio::ip::address& address) noexcept;
+    boost::asio::ip::address to_address() const;
+    bool is_v4() const noexcept;
+    //IPv4 address or v4-mapped IPv6 address
+    bool is_v4_mapped() const noexcept;
+    Family get_family() const noexcept;
+    const Bytes& get_bytes() const noexcept;
+    //bit 0 is the most significant bit of the first byte
+    bool get_bit(unsigned idx) const noexcept;
+    //bits behind the first length bits cleared, the family kept
+    IpAddress get_prefix(unsigned length) const noexcept;
+    std::size_t get_hash() const noexcept;
+    friend bool operator==(const IpAddress& lhs, const IpAddress& rhs) noexcept
+    {
+        return (std::memcmp(lhs.bytes_.data(), rhs.bytes_.data(), lhs.bytes_.size()) == 0) &&
+               (lhs.family_ == rhs.family_);
+    }
+    friend bool operator!=(const IpAddress& lhs, const IpAddress& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+    friend bool operator<(const IpAddress& lhs, const IpAddress& rhs) noexcept
+    {
+        const int bytes_order = std::memcmp(lhs.bytes_.data(), rhs.bytes_.data(), lhs.bytes_.size());
+        return (bytes_order < 0) || ((bytes_order == 0) && (lhs.family_ < rhs.family_));
+    }
+    friend std::ostream& operator<<(std::ostream& out, const IpAddress& address);
+private:
+    Bytes bytes_;
+    Family family_;
+};
+
+//sorted, distinct
+using IpAddresses = std::vector<IpAddress>;
+
+//address is inserted at its place unless it is already there
+IpAddresses& insert(IpAddresses& addresses, const IpAddress& address);
+
+//length counts bits of the 16 bytes form, an IPv4 prefix a.b.c.d/n has length 96 + n and it is the same
+//as the prefix ::ffff:a.b.c.d/(96 + n)
+struct IpPrefix
+{
+    IpAddress address;
+    unsigned length;
+};
+
+//"address/length" or "address" (full length), throws std::invalid_argument
+IpPrefix parse_ip_prefix(const std::string& text);
+
+}//namespace Util
+
+#endif//IP_ADDRESS_HH_2623DD29DDB02AE2EFD191656CB7E093
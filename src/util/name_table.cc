@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/name_table.hh"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace Util {
+
+namespace {
+
+constexpr NameTable::Id no_id = 0;
+constexpr std::size_t min_number_of_buckets = 16;
+
+//FNV-1a
+std::uint32_t get_hash_of(const char* name, std::size_t length) noexcept
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        hash = (hash ^ static_cast<unsigned char>(name[idx])) * 16777619u;
+    }
+    return hash;
+}
+
+char to_lower(char c) noexcept
+{
+    return (('A' <= c) && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+}//namespace Util::{anonymous}
+
+NameTable::NameTable()
+    : chunks_{},
+      used_of_last_chunk_{0},
+      size_of_last_chunk_{0},
+      names_{},
+      buckets_{}
+{ }
+
+NameTable::Id NameTable::intern(const char* name, std::size_t length)
+{
+    //the root zone keeps its dot
+    if ((1 < length) && (name[length - 1] == '.'))
+    {
+        --length;
+    }
+    //the name is normalized in place of its future copy which is given back if the name is known already
+    char* const normalized = this->reserve(length + 1);
+    for (std::size_t idx = 0; idx < length; ++idx)
+    {
+        normalized[idx] = to_lower(name[idx]);
+    }
+    normalized[length] = '\0';
+    //load factor stays below 3/4
+    if ((3 * buckets_.size()) < (4 * (names_.size() + 1)))
+    {
+        this->grow();
+    }
+    const auto hash = get_hash_of(normalized, length);
+    const auto bucket = this->find_bucket(normalized, length, hash);
+    if (buckets_[bucket].id_plus_one != no_id)
+    {
+        return buckets_[bucket].id_plus_one - 1;
+    }
+    if (std::numeric_limits<Id>::max() <= names_.size())
+    {
+        throw std::length_error("too many names");
+    }
+    const auto id = static_cast<Id>(names_.size());
+    names_.push_back(normalized);
+    buckets_[bucket] = Bucket{id + 1, hash};
+    used_of_last_chunk_ += length + 1;
+    return id;
+}
+
+NameTable::Id NameTable::intern(const std::string& name)
+{
+    return this->intern(name.data(), name.length());
+}
+
+const char* NameTable::get_name(Id id) const noexcept
+{
+    return names_[id];
+}
+
+std::size_t NameTable::size() const noexcept
+{
+    return names_.size();
+}
+
+char* NameTable::reserve(std::size_t length)
+{
+    if (size_of_last_chunk_ < (used_of_last_chunk_ + length))
+    {
+        //long names get a chunk of their own
+        const auto size = length < chunk_size ? chunk_size : length;
+        chunks_.emplace_back(new char[size]);
+        used_of_last_chunk_ = 0;
+        size_of_last_chunk_ = size;
+    }
+    return chunks_.back().get() + used_of_last_chunk_;
+}
+
+std::size_t NameTable::find_bucket(const char* name, std::size_t length, std::uint32_t hash) const noexcept
+{
+    const std::size_t mask = buckets_.size() - 1;
+    for (std::size_t bucket = hash & mask; true; bucket = (bucket + 1) & mask)
+    {
+        if (buckets_[bucket].id_plus_one == no_id)
+        {
+            return bucket;
+        }
+        if (buckets_[bucket].hash != hash)
+        {
+            continue;
+        }
+        const char* const known = names_[buckets_[bucket].id_plus_one - 1];
+        if ((std::strncmp(known, name, length) == 0) && (std::strlen(known) == length))
+        {
+            return bucket;
+        }
+    }
+}
+
+void NameTable::grow()
+{
+    std::vector<Bucket> buckets(buckets_.empty() ? min_number_of_buckets : 2 * buckets_.size(), Bucket{no_id, 0});
+    const std::size_t mask = buckets.size() - 1;
+    //names are distinct, only an empty bucket is looked for
+    for (auto&& bucket : buckets_)
+    {
+        if (bucket.id_plus_one != no_id)
+        {
+            auto idx = bucket.hash & mask;
+            while (buckets[idx].id_plus_one != no_id)
+            {
+                idx = (idx + 1) & mask;
+            }
+            buckets[idx] = bucket;
+        }
+    }
+    buckets_.swap(buckets);
+}
+
+}//namespace Util
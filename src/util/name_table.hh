@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef NAME_TABLE_HH_48CD844C61616F529E3114EDAC0DB1E1//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define NAME_TABLE_HH_48CD844C61616F529E3114EDAC0DB1E1
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Util {
+
+//names of domains and nameservers are stored once, lowercase and without the trailing dot, so names differing
+//in these only are the same name; ids are dense and all processes forked after the table is filled share them
+class NameTable
+{
+public:
+    using Id = std::uint32_t;
+    using Ids = std::vector<Id>;
+    NameTable();
+    NameTable(NameTable&&) = default;
+    NameTable(const NameTable&) = delete;
+    ~NameTable() = default;
+    NameTable& operator=(NameTable&&) = default;
+    NameTable& operator=(const NameTable&) = delete;
+    //id of the normalized name, the name is added if it is not known yet
+    Id intern(const char* name, std::size_t length);
+    Id intern(const std::string& name);
+    //normalized name terminated by NUL, it is valid as long as the table; id must be less than size()
+    const char* get_name(Id id) const noexcept;
+    std::size_t size() const noexcept;
+private:
+    char* reserve(std::size_t length);
+    std::size_t find_bucket(const char* name, std::size_t length, std::uint32_t hash) const noexcept;
+    void grow();
+    static constexpr std::size_t chunk_size = 0x10000;
+    //names are packed in chunks which never move
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    std::size_t used_of_last_chunk_;
+    std::size_t size_of_last_chunk_;
+    std::vector<const char*> names_;
+    //open addressing, names are compared only if their hashes are equal
+    struct Bucket
+    {
+        Id id_plus_one;//0 if the bucket is empty
+        std::uint32_t hash;
+    };
+    std::vector<Bucket> buckets_;
+};
+
+}//namespace Util
+
+#endif//NAME_TABLE_HH_48CD844C61616F529E3114EDAC0DB1E1
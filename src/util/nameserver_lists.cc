@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/nameserver_lists.hh"
+
+#include <algorithm>
+
+namespace Util {
+
+namespace {
+
+//nameservers of lists are stored in chunks of this size, most lists hold one or two of them
+constexpr std::size_t nameserver_list_chunk_size = 0x4000;
+
+}//namespace Util::{anonymous}
+
+NameserverLists::NameserverLists()
+    : lock_{},
+      chunks_{},
+      free_space_{nullptr},
+      free_space_size_{0},
+      lists_{},
+      buckets_{}
+{ }
+
+NameserverLists::Id NameserverLists::add(const std::vector<std::uint32_t>& nameservers)
+{
+    const std::uint32_t* const begin = nameservers.data();
+    const std::uint32_t* const end = begin + nameservers.size();
+    const std::lock_guard<std::mutex> lock{lock_};
+    //load factor stays below 3/4
+    if (buckets_.size() * 3 <= (lists_.size() + 1) * 4)
+    {
+        this->rehash(std::max(std::size_t{1024}, 2 * buckets_.size()));
+    }
+    const std::size_t mask = buckets_.size() - 1;
+    for (std::size_t idx = get_hash_of(begin, end) & mask; ; idx = (idx + 1) & mask)
+    {
+        if (buckets_[idx] == 0)
+        {
+            if (free_space_size_ < nameservers.size())
+            {
+                free_space_size_ = std::max(nameserver_list_chunk_size, nameservers.size());
+                chunks_.emplace_back(new std::uint32_t[free_space_size_]);
+                free_space_ = chunks_.back().get();
+            }
+            std::uint32_t* const first = free_space_;
+            std::copy(begin, end, first);
+            free_space_ += nameservers.size();
+            free_space_size_ -= nameservers.size();
+            lists_.push_back(List{first, free_space_});
+            buckets_[idx] = static_cast<Id>(lists_.size());
+            return static_cast<Id>(lists_.size() - 1);
+        }
+        const List& list = lists_[buckets_[idx] - 1];
+        if ((list.size() == nameservers.size()) && std::equal(begin, end, list.first))
+        {
+            return buckets_[idx] - 1;
+        }
+    }
+}
+
+NameserverLists::List NameserverLists::get(Id id) const
+{
+    const std::lock_guard<std::mutex> lock{lock_};
+    return lists_[id];
+}
+
+std::size_t NameserverLists::get_hash_of(const std::uint32_t* begin, const std::uint32_t* end) noexcept
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (; begin != end; ++begin)
+    {
+        hash = (hash ^ *begin) * 1099511628211ULL;
+    }
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+NameserverLists& NameserverLists::rehash(std::size_t number_of_buckets)
+{
+    buckets_.assign(number_of_buckets, 0);
+    const std::size_t mask = number_of_buckets - 1;
+    for (std::size_t id = 0; id < lists_.size(); ++id)
+    {
+        std::size_t idx = get_hash_of(lists_[id].first, lists_[id].last) & mask;
+        while (buckets_[idx] != 0)
+        {
+            idx = (idx + 1) & mask;
+        }
+        buckets_[idx] = static_cast<Id>(id + 1);
+    }
+    return *this;
+}
+
+}//namespace Util
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef NAMESERVER_LISTS_HH_3C8C983B3789025D9A3FD51DA3E13098//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define NAMESERVER_LISTS_HH_3C8C983B3789025D9A3FD51DA3E13098
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Util {
+
+//distinct lists of indices of nameservers, tasks refer to them by ids; a list never moves once it is added,
+//threads asking queries read lists while the thread resolving nameservers adds more of them
+class NameserverLists
+{
+public:
+    using Id = std::uint32_t;
+    struct List
+    {
+        const std::uint32_t* begin() const noexcept { return first; }
+        const std::uint32_t* end() const noexcept { return last; }
+        std::size_t size() const noexcept { return last - first; }
+        const std::uint32_t* first;
+        const std::uint32_t* last;
+    };
+    NameserverLists();
+    NameserverLists(const NameserverLists&) = delete;
+    NameserverLists& operator=(const NameserverLists&) = delete;
+    //equal lists get the same id
+    Id add(const std::vector<std::uint32_t>& nameservers);
+    List get(Id id) const;
+private:
+    static std::size_t get_hash_of(const std::uint32_t* begin, const std::uint32_t* end) noexcept;
+    NameserverLists& rehash(std::size_t number_of_buckets);
+    mutable std::mutex lock_;
+    std::vector<std::unique_ptr<std::uint32_t[]>> chunks_;
+    std::uint32_t* free_space_;
+    std::size_t free_space_size_;
+    std::vector<List> lists_;
+    //ids + 1 of lists by their hash, 0 marks an empty bucket
+    std::vector<Id> buckets_;
+};
+
+}//namespace Util
+
+#endif//NAMESERVER_LISTS_HH_3C8C983B3789025D9A3FD51DA3E13098
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/output_merger.hh"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <iostream>
+#include <stdexcept>
+
+namespace Util {
+
+OutputMerger::Source::Source(OutputMerger& merger, const ImReader& reader)
+    : merger{merger},
+      reader{reader},
+      event_ptr{nullptr},
+      content{},
+      closed{false}
+{ }
+
+OutputMerger::OutputMerger(Event::Base& loop, const std::vector<std::reference_wrapper<const ImReader>>& sources)
+    : OutputMerger{loop}
+{
+    for (auto&& reader : sources)
+    {
+        this->add(reader.get());
+    }
+    while (0 < number_of_open_sources_)
+    {
+        loop(Event::Loop::Once{});
+    }
+}
+
+OutputMerger::OutputMerger(Event::Base& loop)
+    : loop_{loop},
+      sources_{},
+      number_of_open_sources_{0}
+{ }
+
+OutputMerger::~OutputMerger()
+{
+    for (auto&& source : sources_)
+    {
+        if (source.event_ptr != nullptr)
+        {
+            ::event_del(source.event_ptr);
+            ::event_free(source.event_ptr);
+            source.event_ptr = nullptr;
+        }
+    }
+}
+
+OutputMerger& OutputMerger::add(const ImReader& reader)
+{
+    sources_.emplace_back(*this, reader);
+    Source& source = sources_.back();
+    source.reader.set_nonblocking();
+    source.event_ptr = ::event_new(loop_, source.reader.get_descriptor(), EV_READ | EV_PERSIST, callback_routine, &source);
+    static constexpr int success = 0;
+    if ((source.event_ptr == nullptr) || (::event_add(source.event_ptr, nullptr) != success))
+    {
+        struct EventAddFailure : std::runtime_error
+        {
+            EventAddFailure() : std::runtime_error("event_add failed") { }
+        };
+        throw EventAddFailure();
+    }
+    ++number_of_open_sources_;
+    return *this;
+}
+
+bool OutputMerger::is_closed(const ImReader& reader) const
+{
+    for (auto&& source : sources_)
+    {
+        if (&source.reader == &reader)
+        {
+            return source.closed;
+        }
+    }
+    throw std::logic_error("unknown source");
+}
+
+OutputMerger& OutputMerger::on_read(Source& source)
+{
+    char buffer[0x10000];
+    while (true)
+    {
+        static constexpr ::ssize_t failure = -1;
+        const auto read_retval = ::read(source.reader.get_descriptor(), buffer, sizeof(buffer));
+        if (read_retval == failure)
+        {
+            const int c_errno = errno;
+            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK) || (c_errno == EINTR);
+            if (data_unavailable)
+            {
+                break;
+            }
+            struct ReadFailed : std::runtime_error
+            {
+                ReadFailed(int error_code) : std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
+            };
+            throw ReadFailed(c_errno);
+        }
+        const bool end_reached = (read_retval == 0);
+        if (end_reached)
+        {
+            if (!source.content.empty())
+            {
+                std::cout << source.content << std::endl;
+                source.content.clear();
+            }
+            return this->close(source);
+        }
+        source.content.append(buffer, static_cast<std::size_t>(read_retval));
+    }
+    const auto end_of_last_line = source.content.rfind('\n');
+    if (end_of_last_line != std::string::npos)
+    {
+        std::cout.write(source.content.data(), end_of_last_line + 1);
+        std::cout.flush();
+        source.content.erase(0, end_of_last_line + 1);
+    }
+    return *this;
+}
+
+OutputMerger& OutputMerger::close(Source& source)
+{
+    if (!source.closed)
+    {
+        ::event_del(source.event_ptr);
+        source.closed = true;
+        --number_of_open_sources_;
+    }
+    return *this;
+}
+
+void OutputMerger::callback_routine(evutil_socket_t fd, short events, void* user_data_ptr)
+{
+    auto* const source_ptr = static_cast<Source*>(user_data_ptr);
+    if ((source_ptr != nullptr) && (source_ptr->reader.get_descriptor() == fd) && ((events & EV_READ) == EV_READ))
+    {
+        try
+        {
+            source_ptr->merger.on_read(*source_ptr);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "OutputMerger::on_read failed: " << e.what() << std::endl;
+            source_ptr->merger.close(*source_ptr);
+        }
+        catch (...)
+        {
+            std::cerr << "OutputMerger::on_read caught an unexpected exception" << std::endl;
+            source_ptr->merger.close(*source_ptr);
+        }
+    }
+}
+
+}//namespace Util
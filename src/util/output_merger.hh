@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OUTPUT_MERGER_HH_A2D6C94E07F1B835D9E4160C7B3A5F28//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define OUTPUT_MERGER_HH_A2D6C94E07F1B835D9E4160C7B3A5F28
+
+#include "src/event/base.hh"
+#include "src/util/pipe.hh"
+
+#include <event2/event.h>
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace Util {
+
+//copies whole lines received from more processes into standard output until all sources are closed,
+//the standard output has one writer so lines of different sources are never mixed
+class OutputMerger
+{
+public:
+    OutputMerger(Event::Base& loop, const std::vector<std::reference_wrapper<const ImReader>>& sources);
+    //sources are added one by one later, the loop is run by the caller
+    explicit OutputMerger(Event::Base& loop);
+    ~OutputMerger();
+    OutputMerger(const OutputMerger&) = delete;
+    OutputMerger& operator=(const OutputMerger&) = delete;
+    OutputMerger& add(const ImReader& source);
+    //the end of source was reached and all its lines were copied
+    bool is_closed(const ImReader& source) const;
+private:
+    struct Source
+    {
+        Source(OutputMerger& merger, const ImReader& reader);
+        OutputMerger& merger;
+        const ImReader& reader;
+        struct ::event* event_ptr;
+        std::string content;
+        bool closed;
+    };
+    static void callback_routine(evutil_socket_t fd, short events, void* user_data_ptr);
+    OutputMerger& on_read(Source& source);
+    OutputMerger& close(Source& source);
+    Event::Base& loop_;
+    std::list<Source> sources_;
+    std::size_t number_of_open_sources_;
+};
+
+}//namespace Util
+
+#endif//OUTPUT_MERGER_HH_A2D6C94E07F1B835D9E4160C7B3A5F28
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/pacer.hh"
+
+#include "src/time_unit.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Util {
+
+constexpr std::chrono::microseconds Pacer::tick;
+
+Pacer::Settings Pacer::Settings::get_part(std::size_t number_of_parts) const
+{
+    if (number_of_parts <= 1)
+    {
+        return *this;
+    }
+    return Settings{max_queries_per_second / number_of_parts,
+                    std::max<std::size_t>(1, burst / number_of_parts),
+                    as_fast_as_allowed};
+}
+
+TokenBucket::Settings Pacer::Settings::get_limit() const
+{
+    return TokenBucket::Settings{max_queries_per_second, burst};
+}
+
+Pacer::Pacer(TokenBucket& limit, const Settings& settings, std::chrono::nanoseconds assigned_time)
+    : limit_{limit},
+      schedule_{TokenBucket::Settings{0.0, 1}},
+      spread_{!settings.as_fast_as_allowed},
+      is_on_schedule_{false},
+      time_end_{TimeUnit::get_uptime().get() + assigned_time}
+{ }
+
+std::size_t Pacer::take(std::size_t remaining_queries)
+{
+    const auto remaining_time = std::chrono::duration<double>{time_end_ - TimeUnit::get_uptime().get()};
+    //out of schedule, as fast as the limit allows
+    is_on_schedule_ = spread_ && (0 < remaining_queries) && (0.0 < remaining_time.count());
+    std::size_t wanted = remaining_queries;
+    if (is_on_schedule_)
+    {
+        //one tick worth of queries at most, a generator falling behind gets a higher rate on the next tick
+        const double rate = remaining_queries / remaining_time.count();
+        const auto burst = static_cast<std::size_t>(std::ceil(rate * std::chrono::duration<double>{tick}.count()));
+        wanted = schedule_.set_settings(TokenBucket::Settings{rate, burst}).take(wanted);
+    }
+    const auto allowed = limit_.take(wanted);
+    if (is_on_schedule_)
+    {
+        schedule_.give_back(wanted - allowed);
+    }
+    return allowed;
+}
+
+Pacer& Pacer::give_back(std::size_t unsent_queries)
+{
+    limit_.give_back(unsent_queries);
+    if (is_on_schedule_)
+    {
+        schedule_.give_back(unsent_queries);
+    }
+    return *this;
+}
+
+std::chrono::microseconds Pacer::get_time_to_next_tick()
+{
+    auto time_to_next_query = limit_.get_time_to_next_token();
+    if (is_on_schedule_)
+    {
+        time_to_next_query = std::max(time_to_next_query, schedule_.get_time_to_next_token());
+    }
+    const auto rounded_up = std::chrono::duration_cast<std::chrono::microseconds>(
+            time_to_next_query + std::chrono::microseconds{1} - std::chrono::nanoseconds{1});
+    return std::max(tick, rounded_up);
+}
+
+std::chrono::nanoseconds Pacer::get_remaining_time() const
+{
+    return time_end_ - TimeUnit::get_uptime().get();
+}
+
+}//namespace Util
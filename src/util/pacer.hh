@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PACER_HH_6212D4D5DF2A36C8026C55933C1F140B//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define PACER_HH_6212D4D5DF2A36C8026C55933C1F140B
+
+#include "src/util/token_bucket.hh"
+
+#include <chrono>
+#include <cstddef>
+
+namespace Util {
+
+// Decides how many queries a generator sends on its next tick. Remaining queries are spread evenly over
+// the remaining time unless the scan runs as fast as allowed, the rate of all generators of one event
+// loop is capped by the token bucket they share.
+class Pacer
+{
+public:
+    struct Settings
+    {
+        // 0 means no limit
+        double max_queries_per_second;
+        std::size_t burst;
+        // queries are not spread over the assigned time, the phase finishes early
+        bool as_fast_as_allowed;
+        // settings of a process or a thread asking the given part of queries
+        Settings get_part(std::size_t number_of_parts) const;
+        TokenBucket::Settings get_limit() const;
+    };
+    // shortest period between generations of queries
+    static constexpr auto tick = std::chrono::microseconds{1000};
+    Pacer(TokenBucket& limit, const Settings& settings, std::chrono::nanoseconds assigned_time);
+    // number of queries which may be sent now
+    std::size_t take(std::size_t remaining_queries);
+    // queries allowed by take() but not sent (e.g. the window is full)
+    Pacer& give_back(std::size_t unsent_queries);
+    std::chrono::microseconds get_time_to_next_tick();
+    // negative when the assigned time is over
+    std::chrono::nanoseconds get_remaining_time() const;
+private:
+    TokenBucket& limit_;
+    TokenBucket schedule_;
+    bool spread_;
+    bool is_on_schedule_;
+    std::chrono::nanoseconds time_end_;
+};
+
+}//namespace Util
+
+#endif//PACER_HH_6212D4D5DF2A36C8026C55933C1F140B
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef POLITE_SCHEDULER_HH_1251F5A4B32216B4D0CB1C5FD9E66417//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define POLITE_SCHEDULER_HH_1251F5A4B32216B4D0CB1C5FD9E66417
+
+#include "src/util/token_bucket.hh"
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <utility>
+
+namespace Util {
+
+//items are queued per key (e.g. address of a server) and handed out round-robin over the keys, a key gives
+//at most batch_size items in its turn and it is skipped while it has max_in_flight_per_key items in flight
+//or its rate is exhausted, so a busy key leaves its capacity to the others; a key left without items keeps its
+//rate until it is refilled, so that items pushed again later get no new burst
+template <typename Key, typename Item>
+class PoliteScheduler
+{
+public:
+    struct Settings
+    {
+        std::size_t batch_size;
+        //0 means no limit
+        std::size_t max_in_flight_per_key;
+        //items per second, 0 means no limit
+        double max_rate_per_key;
+    };
+    using GetKey = std::function<Key(const Item&)>;
+    PoliteScheduler(const Settings& settings, GetKey get_key);
+    PoliteScheduler& push(Item item);
+    //none if no key may give an item now
+    boost::optional<Item> pop();
+    //the item handed out by pop() is not in flight anymore
+    PoliteScheduler& on_finished(const Item& item);
+    //the item handed out by pop() was not sent, it is the first one of its key again
+    PoliteScheduler& give_back(Item item);
+    //number of queued items
+    std::size_t size() const noexcept;
+private:
+    struct KeyState
+    {
+        std::deque<Item> items;
+        std::size_t in_flight;
+        TokenBucket rate;
+        bool is_in_ring;
+        bool is_in_idle;
+    };
+    using Keys = std::map<Key, KeyState>;
+    bool is_full(const KeyState& state) const noexcept;
+    static bool is_idle(const KeyState& state) noexcept;
+    PoliteScheduler& make_ready(typename Keys::iterator key_itr);
+    PoliteScheduler& erase_refilled_keys();
+    Settings settings_;
+    GetKey get_key_;
+    Keys keys_;
+    //keys which have queued items and are not full (stale entries are dropped by pop())
+    std::deque<typename Keys::iterator> ring_;
+    //keys which became idle, in that order; an idle key is erased once its rate is refilled (entries of keys
+    //which are not idle anymore are dropped by erase_refilled_keys())
+    std::deque<typename Keys::iterator> idle_;
+    std::size_t given_in_turn_;
+    std::size_t size_;
+};
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>::PoliteScheduler(const Settings& settings, GetKey get_key)
+    : settings_{settings},
+      get_key_{std::move(get_key)},
+      keys_{},
+      ring_{},
+      idle_{},
+      given_in_turn_{0},
+      size_{0}
+{
+    if (settings_.batch_size <= 0)
+    {
+        settings_.batch_size = 1;
+    }
+}
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>& PoliteScheduler<Key, Item>::push(Item item)
+{
+    this->erase_refilled_keys();
+    auto key_itr = keys_.find(get_key_(item));
+    if (key_itr == keys_.end())
+    {
+        const auto rate = TokenBucket::Settings{settings_.max_rate_per_key, settings_.batch_size};
+        key_itr = keys_.emplace(get_key_(item), KeyState{std::deque<Item>{}, 0, TokenBucket{rate}, false, false}).first;
+    }
+    key_itr->second.items.push_back(std::move(item));
+    ++size_;
+    return this->make_ready(key_itr);
+}
+
+template <typename Key, typename Item>
+boost::optional<Item> PoliteScheduler<Key, Item>::pop()
+{
+    //every key gets one chance, the current one a new turn too
+    for (std::size_t chances = ring_.size() + 1; (0 < chances) && !ring_.empty(); --chances)
+    {
+        const auto key_itr = ring_.front();
+        KeyState& state = key_itr->second;
+        if (state.items.empty() || this->is_full(state))
+        {
+            //back in the ring when it gets items or some of its items finish
+            ring_.pop_front();
+            state.is_in_ring = false;
+            given_in_turn_ = 0;
+            continue;
+        }
+        if ((given_in_turn_ < settings_.batch_size) && (0 < state.rate.take(1)))
+        {
+            Item item = std::move(state.items.front());
+            state.items.pop_front();
+            ++state.in_flight;
+            ++given_in_turn_;
+            --size_;
+            return item;
+        }
+        ring_.pop_front();
+        ring_.push_back(key_itr);
+        given_in_turn_ = 0;
+    }
+    return boost::none;
+}
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>& PoliteScheduler<Key, Item>::on_finished(const Item& item)
+{
+    const auto key_itr = keys_.find(get_key_(item));
+    if (key_itr == keys_.end())
+    {
+        return *this;
+    }
+    KeyState& state = key_itr->second;
+    if (0 < state.in_flight)
+    {
+        --state.in_flight;
+    }
+    if (is_idle(state))
+    {
+        if (settings_.max_rate_per_key <= 0.0)
+        {
+            keys_.erase(key_itr);
+        }
+        else if (!state.is_in_idle)
+        {
+            idle_.push_back(key_itr);
+            state.is_in_idle = true;
+        }
+        return this->erase_refilled_keys();
+    }
+    return this->make_ready(key_itr);
+}
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>& PoliteScheduler<Key, Item>::give_back(Item item)
+{
+    const auto key_itr = keys_.find(get_key_(item));
+    if (key_itr == keys_.end())
+    {
+        return this->push(std::move(item));
+    }
+    KeyState& state = key_itr->second;
+    if (0 < state.in_flight)
+    {
+        --state.in_flight;
+    }
+    state.rate.give_back(1);
+    state.items.push_front(std::move(item));
+    ++size_;
+    return this->make_ready(key_itr);
+}
+
+template <typename Key, typename Item>
+std::size_t PoliteScheduler<Key, Item>::size() const noexcept
+{
+    return size_;
+}
+
+template <typename Key, typename Item>
+bool PoliteScheduler<Key, Item>::is_full(const KeyState& state) const noexcept
+{
+    return (0 < settings_.max_in_flight_per_key) && (settings_.max_in_flight_per_key <= state.in_flight);
+}
+
+template <typename Key, typename Item>
+bool PoliteScheduler<Key, Item>::is_idle(const KeyState& state) noexcept
+{
+    return state.items.empty() && (state.in_flight == 0) && !state.is_in_ring;
+}
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>& PoliteScheduler<Key, Item>::make_ready(typename Keys::iterator key_itr)
+{
+    KeyState& state = key_itr->second;
+    if (!state.is_in_ring && !state.items.empty() && !this->is_full(state))
+    {
+        ring_.push_back(key_itr);
+        state.is_in_ring = true;
+    }
+    return *this;
+}
+
+template <typename Key, typename Item>
+PoliteScheduler<Key, Item>& PoliteScheduler<Key, Item>::erase_refilled_keys()
+{
+    //rates of all keys are the same, keys idle for longer are refilled sooner
+    while (!idle_.empty())
+    {
+        const auto key_itr = idle_.front();
+        KeyState& state = key_itr->second;
+        if (!is_idle(state))
+        {
+            idle_.pop_front();
+            state.is_in_idle = false;
+            continue;
+        }
+        if (!state.rate.is_full())
+        {
+            break;
+        }
+        idle_.pop_front();
+        keys_.erase(key_itr);
+    }
+    return *this;
+}
+
+}//namespace Util
+
+#endif//POLITE_SCHEDULER_HH_1251F5A4B32216B4D0CB1C5FD9E66417
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PREFIX_TRIE_HH_83D79CCADF415B248194A56848444DFC//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define PREFIX_TRIE_HH_83D79CCADF415B248194A56848444DFC
+
+#include "src/util/ip_address.hh"
+
+#include <boost/optional.hpp>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+//values of IP prefixes, an address gets the value of the longest added prefix containing it;
+//binary trie over the bits of the 16 bytes form, nodes live in one vector
+template <typename Value>
+class PrefixTrie
+{
+public:
+    PrefixTrie();
+    //value of an equal prefix added before is replaced
+    PrefixTrie& add(const IpPrefix& prefix, Value value);
+    //nullptr if no prefix contains the address
+    const Value* find(const IpAddress& address) const noexcept;
+private:
+    struct Node
+    {
+        //0 means no child, the root is never a child
+        std::array<std::uint32_t, 2> children;
+        boost::optional<Value> value;
+    };
+    std::vector<Node> nodes_;
+};
+
+template <typename Value>
+PrefixTrie<Value>::PrefixTrie()
+    : nodes_(1, Node{{{0, 0}}, boost::none})
+{ }
+
+template <typename Value>
+PrefixTrie<Value>& PrefixTrie<Value>::add(const IpPrefix& prefix, Value value)
+{
+    std::uint32_t node = 0;
+    for (unsigned idx = 0; idx < prefix.length; ++idx)
+    {
+        const auto bit = prefix.address.get_bit(idx) ? 1 : 0;
+        if (nodes_[node].children[bit] == 0)
+        {
+            nodes_[node].children[bit] = static_cast<std::uint32_t>(nodes_.size());
+            nodes_.push_back(Node{{{0, 0}}, boost::none});
+        }
+        node = nodes_[node].children[bit];
+    }
+    nodes_[node].value = std::move(value);
+    return *this;
+}
+
+template <typename Value>
+const Value* PrefixTrie<Value>::find(const IpAddress& address) const noexcept
+{
+    const Value* found = nodes_[0].value.get_ptr();
+    std::uint32_t node = 0;
+    for (unsigned idx = 0; idx < 128; ++idx)
+    {
+        node = nodes_[node].children[address.get_bit(idx) ? 1 : 0];
+        if (node == 0)
+        {
+            break;
+        }
+        if (nodes_[node].value != boost::none)
+        {
+            found = nodes_[node].value.get_ptr();
+        }
+    }
+    return found;
+}
+
+}//namespace Util
+
+#endif//PREFIX_TRIE_HH_83D79CCADF415B248194A56848444DFC
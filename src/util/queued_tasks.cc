@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/queued_tasks.hh"
+
+namespace Util {
+
+QueuedTasks::QueuedTasks(std::size_t max_number_of_tasks)
+    : lock_{},
+      removed_{},
+      max_number_of_tasks_{max_number_of_tasks},
+      number_of_tasks_{0}
+{ }
+
+QueuedTasks& QueuedTasks::add(std::size_t number_of_tasks)
+{
+    const std::lock_guard<std::mutex> lock{lock_};
+    number_of_tasks_ += number_of_tasks;
+    return *this;
+}
+
+QueuedTasks& QueuedTasks::remove(std::size_t number_of_tasks)
+{
+    {
+        const std::lock_guard<std::mutex> lock{lock_};
+        number_of_tasks_ -= number_of_tasks;
+    }
+    removed_.notify_one();
+    return *this;
+}
+
+std::size_t QueuedTasks::get_room() const
+{
+    const std::lock_guard<std::mutex> lock{lock_};
+    return number_of_tasks_ < max_number_of_tasks_ ? max_number_of_tasks_ - number_of_tasks_ : 0;
+}
+
+std::size_t QueuedTasks::size() const
+{
+    const std::lock_guard<std::mutex> lock{lock_};
+    return number_of_tasks_;
+}
+
+QueuedTasks& QueuedTasks::wait_for_room(std::chrono::milliseconds max_waiting_time)
+{
+    std::unique_lock<std::mutex> lock{lock_};
+    removed_.wait_for(lock, max_waiting_time, [&]() { return number_of_tasks_ <= max_number_of_tasks_ / 2; });
+    return *this;
+}
+
+}//namespace Util
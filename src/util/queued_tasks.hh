@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef QUEUED_TASKS_HH_26BB81B2A707696C836D7795BC7DBE4C//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define QUEUED_TASKS_HH_26BB81B2A707696C836D7795BC7DBE4C
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace Util {
+
+//number of tasks handed to threads and not taken by them yet, the thread generating tasks waits for room
+class QueuedTasks
+{
+public:
+    explicit QueuedTasks(std::size_t max_number_of_tasks);
+    QueuedTasks& add(std::size_t number_of_tasks);
+    QueuedTasks& remove(std::size_t number_of_tasks);
+    //number of tasks which may be added now
+    std::size_t get_room() const;
+    std::size_t size() const;
+    //waits until a half of the tasks is taken or the time is up
+    QueuedTasks& wait_for_room(std::chrono::milliseconds max_waiting_time);
+private:
+    mutable std::mutex lock_;
+    std::condition_variable removed_;
+    std::size_t max_number_of_tasks_;
+    std::size_t number_of_tasks_;
+};
+
+}//namespace Util
+
+#endif//QUEUED_TASKS_HH_26BB81B2A707696C836D7795BC7DBE4C
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/record.hh"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace Util {
+
+namespace {
+
+using RecordLength = std::uint32_t;
+
+//buffered records are written before the buffer grows beyond this size
+constexpr std::size_t max_buffer_size = 0x10000;
+
+struct InvalidRecord : std::runtime_error
+{
+    InvalidRecord() : std::runtime_error("invalid data received") { }
+};
+
+}//namespace Util::{anonymous}
+
+RecordWriter::RecordWriter(int descriptor)
+    : descriptor_{descriptor},
+      descriptor_lock_{nullptr},
+      buffer_{},
+      record_begin_{0}
+{
+    buffer_.reserve(max_buffer_size);
+}
+
+RecordWriter::RecordWriter(int descriptor, std::mutex& descriptor_lock)
+    : descriptor_{descriptor},
+      descriptor_lock_{&descriptor_lock},
+      buffer_{},
+      record_begin_{0}
+{
+    buffer_.reserve(max_buffer_size);
+}
+
+RecordWriter::~RecordWriter()
+{
+    try
+    {
+        this->flush();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "RecordWriter::flush failed: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "RecordWriter::flush caught an unexpected exception" << std::endl;
+    }
+}
+
+RecordWriter& RecordWriter::start(std::uint8_t type)
+{
+    if (max_buffer_size <= buffer_.size())
+    {
+        this->flush();
+    }
+    record_begin_ = buffer_.size();
+    const RecordLength length = 0;//known when the record is finished
+    return this->add(&length, sizeof(length)).add(type);
+}
+
+RecordWriter& RecordWriter::add(std::uint8_t value)
+{
+    return this->add(&value, sizeof(value));
+}
+
+RecordWriter& RecordWriter::add(std::uint16_t value)
+{
+    return this->add(&value, sizeof(value));
+}
+
+RecordWriter& RecordWriter::add(std::uint32_t value)
+{
+    return this->add(&value, sizeof(value));
+}
+
+RecordWriter& RecordWriter::add(const IpAddress& value)
+{
+    return this->add(value.get_bytes().data(), value.get_bytes().size())
+                .add(static_cast<std::uint8_t>(value.get_family()));
+}
+
+RecordWriter& RecordWriter::add(const std::string& value)
+{
+    if (std::numeric_limits<RecordLength>::max() < value.length())
+    {
+        throw std::runtime_error("string too long to be sent");
+    }
+    return this->add(static_cast<RecordLength>(value.length())).add(value.data(), value.length());
+}
+
+RecordWriter& RecordWriter::finish()
+{
+    const RecordLength length = buffer_.size() - record_begin_ - sizeof(RecordLength);
+    std::memcpy(&buffer_[record_begin_], &length, sizeof(length));
+    record_begin_ = buffer_.size();
+    return *this;
+}
+
+RecordWriter& RecordWriter::flush()
+{
+    //an unfinished record stays in the buffer
+    const char* data = buffer_.data();
+    std::size_t length = record_begin_;
+    if (length == 0)
+    {
+        return *this;
+    }
+    std::unique_lock<std::mutex> descriptor_lock;
+    if (descriptor_lock_ != nullptr)
+    {
+        descriptor_lock = std::unique_lock<std::mutex>{*descriptor_lock_};
+    }
+    while (0 < length)
+    {
+        static constexpr ::ssize_t failure = -1;
+        const auto write_retval = ::write(descriptor_, data, length);
+        if (write_retval == failure)
+        {
+            const int c_errno = errno;
+            if (c_errno == EINTR)
+            {
+                continue;
+            }
+            buffer_.erase(0, data - buffer_.data());
+            record_begin_ = length;
+            struct WriteFailed : std::runtime_error
+            {
+                WriteFailed(int error_code) : std::runtime_error(std::string("write() failed: ") + std::strerror(error_code)) { }
+            };
+            throw WriteFailed(c_errno);
+        }
+        data += write_retval;
+        length -= write_retval;
+    }
+    buffer_.erase(0, record_begin_);
+    record_begin_ = 0;
+    return *this;
+}
+
+RecordWriter& RecordWriter::add(const void* data, std::size_t length)
+{
+    buffer_.append(static_cast<const char*>(data), length);
+    return *this;
+}
+
+Record::Record(const char* begin, const char* end)
+    : position_{begin + sizeof(RecordLength)},
+      end_{end},
+      type_{}
+{
+    type_ = this->get_uint8();
+}
+
+std::uint8_t Record::get_type() const noexcept
+{
+    return type_;
+}
+
+std::uint8_t Record::get_uint8()
+{
+    std::uint8_t value;
+    std::memcpy(&value, this->get(sizeof(value)), sizeof(value));
+    return value;
+}
+
+std::uint16_t Record::get_uint16()
+{
+    std::uint16_t value;
+    std::memcpy(&value, this->get(sizeof(value)), sizeof(value));
+    return value;
+}
+
+std::uint32_t Record::get_uint32()
+{
+    std::uint32_t value;
+    std::memcpy(&value, this->get(sizeof(value)), sizeof(value));
+    return value;
+}
+
+IpAddress Record::get_address()
+{
+    IpAddress::Bytes bytes;
+    std::memcpy(bytes.data(), this->get(bytes.size()), bytes.size());
+    const auto family = static_cast<IpAddress::Family>(this->get_uint8());
+    if ((family != IpAddress::Family::v4) && (family != IpAddress::Family::v6))
+    {
+        throw InvalidRecord{};
+    }
+    return IpAddress{bytes, family};
+}
+
+std::string Record::get_string()
+{
+    const std::size_t length = this->get_uint32();
+    const char* const data = this->get(length);
+    return std::string(data, length);
+}
+
+const char* Record::get(std::size_t length)
+{
+    if (static_cast<std::size_t>(end_ - position_) < length)
+    {
+        throw InvalidRecord{};
+    }
+    const char* const data = position_;
+    position_ += length;
+    return data;
+}
+
+RecordBuffer::RecordBuffer()
+    : content_{}
+{ }
+
+RecordBuffer& RecordBuffer::append(const char* data, std::size_t length)
+{
+    content_.append(data, length);
+    return *this;
+}
+
+bool RecordBuffer::empty() const noexcept
+{
+    return content_.empty();
+}
+
+const char* RecordBuffer::get_end_of_record(const char* begin) const
+{
+    const char* const end = content_.data() + content_.size();
+    if (static_cast<std::size_t>(end - begin) < sizeof(RecordLength))
+    {
+        return nullptr;
+    }
+    RecordLength length;
+    std::memcpy(&length, begin, sizeof(length));
+    if (length < sizeof(std::uint8_t))
+    {
+        throw InvalidRecord{};
+    }
+    if (static_cast<std::size_t>(end - begin - sizeof(RecordLength)) < length)
+    {
+        return nullptr;
+    }
+    return begin + sizeof(RecordLength) + length;
+}
+
+}//namespace Util
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RECORD_HH_6A899E924845B7D3A68C66955621A7E4//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define RECORD_HH_6A899E924845B7D3A68C66955621A7E4
+
+#include "src/util/ip_address.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace Util {
+
+//child processes report results to their parent by length prefixed binary records, both processes run
+//on the same machine so numbers are kept in native byte order; record layout:
+//  std::uint32_t length of the rest of the record, std::uint8_t type, fields
+//addresses are sent as their 16 bytes form
+class RecordWriter
+{
+public:
+    //records are collected in a buffer and written into the descriptor by flush()
+    explicit RecordWriter(int descriptor);
+    //writers of more threads share the descriptor, whole buffers are written under the lock
+    RecordWriter(int descriptor, std::mutex& descriptor_lock);
+    ~RecordWriter();
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+    RecordWriter& start(std::uint8_t type);
+    RecordWriter& add(std::uint8_t value);
+    RecordWriter& add(std::uint16_t value);
+    RecordWriter& add(std::uint32_t value);
+    RecordWriter& add(const IpAddress& value);
+    RecordWriter& add(const std::string& value);
+    RecordWriter& finish();
+    RecordWriter& flush();
+private:
+    RecordWriter& add(const void* data, std::size_t length);
+    int descriptor_;
+    std::mutex* descriptor_lock_;
+    std::string buffer_;
+    std::size_t record_begin_;
+};
+
+//fields of one received record, they are read in the same order as they were written
+class Record
+{
+public:
+    Record(const char* begin, const char* end);
+    std::uint8_t get_type() const noexcept;
+    std::uint8_t get_uint8();
+    std::uint16_t get_uint16();
+    std::uint32_t get_uint32();
+    IpAddress get_address();
+    std::string get_string();
+private:
+    const char* get(std::size_t length);
+    const char* position_;
+    const char* const end_;
+    std::uint8_t type_;
+};
+
+//collects data received from a child process and hands out complete records
+class RecordBuffer
+{
+public:
+    RecordBuffer();
+    RecordBuffer& append(const char* data, std::size_t length);
+    //calls handle(Record&) for each complete record, an incomplete one stays in the buffer
+    template <typename Handler>
+    RecordBuffer& for_each_record(Handler handle);
+    bool empty() const noexcept;
+private:
+    const char* get_end_of_record(const char* begin) const;
+    std::string content_;
+};
+
+template <typename Handler>
+RecordBuffer& RecordBuffer::for_each_record(Handler handle)
+{
+    const char* record_begin = content_.data();
+    while (true)
+    {
+        const char* const record_end = this->get_end_of_record(record_begin);
+        if (record_end == nullptr)
+        {
+            break;
+        }
+        Record record{record_begin, record_end};
+        record_begin = record_end;
+        try
+        {
+            handle(record);
+        }
+        catch (...)
+        {
+            content_.erase(0, record_begin - content_.data());
+            throw;
+        }
+    }
+    content_.erase(0, record_begin - content_.data());
+    return *this;
+}
+
+}//namespace Util
+
+#endif//RECORD_HH_6A899E924845B7D3A68C66955621A7E4
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/resident_memory.hh"
+
+#include <unistd.h>
+
+#include <fstream>
+
+namespace Util {
+
+std::size_t get_resident_memory()
+{
+    //sizes in pages: total program size, resident set size, ...
+    std::ifstream statm{"/proc/self/statm"};
+    std::size_t program_pages = 0;
+    std::size_t resident_pages = 0;
+    if (!(statm >> program_pages >> resident_pages))
+    {
+        return 0;
+    }
+    const long page_size = ::sysconf(_SC_PAGESIZE);
+    return page_size <= 0 ? 0 : resident_pages * static_cast<std::size_t>(page_size);
+}
+
+}//namespace Util
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESIDENT_MEMORY_HH_7893808CFD2B2B7EC36A9420657EF0AE//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define RESIDENT_MEMORY_HH_7893808CFD2B2B7EC36A9420657EF0AE
+
+#include <cstddef>
+
+namespace Util {
+
+//bytes of memory of this process resident in RAM (shared pages inherited from the parent included),
+//0 if it can not be found out
+std::size_t get_resident_memory();
+
+}//namespace Util
+
+#endif//RESIDENT_MEMORY_HH_7893808CFD2B2B7EC36A9420657EF0AE
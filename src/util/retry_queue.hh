@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RETRY_QUEUE_HH_B98C7323D8198C40CD1B24773A6874D5//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define RETRY_QUEUE_HH_B98C7323D8198C40CD1B24773A6874D5
+
+#include "src/time_unit.hh"
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+struct RetrySettings
+{
+    //1 means no retries
+    std::size_t max_attempts;
+    std::chrono::nanoseconds initial_backoff;
+    std::chrono::nanoseconds max_backoff;
+};
+
+//items which failed for a transient reason wait here for their next attempt, the waiting time doubles with
+//every attempt and it is randomized by +-50% so that retries of items failed at once do not come at once
+template <typename Item>
+class RetryQueue
+{
+public:
+    struct Retry
+    {
+        Item item;
+        std::size_t attempt;
+    };
+    explicit RetryQueue(const RetrySettings& settings);
+    //false if the item is out of attempts or its backoff would not end within time_left
+    bool push(Item item, std::size_t failed_attempt, std::chrono::nanoseconds time_left);
+    //the step shared by generators of queries: a query which failed for a transient reason is asked again
+    //after a backoff if time_left allows, the retry is one more of remaining_queries of the generator;
+    //Query tells is_worth_retrying() and get_attempt()
+    template <typename Query>
+    bool retry_later(const Query& query, Item item, std::chrono::nanoseconds time_left, std::size_t& remaining_queries);
+    //the item waiting longest after its backoff, none if no backoff has elapsed yet
+    boost::optional<Retry> pop_ready();
+    //the retry handed out by pop_ready() was not sent, it is ready again
+    RetryQueue& give_back(Retry retry);
+    std::size_t size() const noexcept;
+private:
+    struct Waiting
+    {
+        TimeUnit::Uptime ready_at;
+        Retry retry;
+        friend bool operator>(const Waiting& lhs, const Waiting& rhs) { return rhs.ready_at < lhs.ready_at; }
+    };
+    RetrySettings settings_;
+    std::priority_queue<Waiting, std::vector<Waiting>, std::greater<Waiting>> waiting_;
+    std::mt19937 random_;
+};
+
+template <typename Item>
+RetryQueue<Item>::RetryQueue(const RetrySettings& settings)
+    : settings_{settings},
+      waiting_{},
+      random_{std::random_device{}()}
+{ }
+
+template <typename Item>
+bool RetryQueue<Item>::push(Item item, std::size_t failed_attempt, std::chrono::nanoseconds time_left)
+{
+    if (settings_.max_attempts <= failed_attempt)
+    {
+        return false;
+    }
+    auto backoff = settings_.initial_backoff;
+    for (std::size_t attempt = 1; (attempt < failed_attempt) && (backoff < settings_.max_backoff); ++attempt)
+    {
+        backoff *= 2;
+    }
+    backoff = std::min(backoff, settings_.max_backoff);
+    const auto jittered_backoff = std::chrono::nanoseconds{static_cast<std::chrono::nanoseconds::rep>(
+            backoff.count() * std::uniform_real_distribution<double>{0.5, 1.5}(random_))};
+    if (time_left <= jittered_backoff)
+    {
+        return false;
+    }
+    waiting_.push(Waiting{TimeUnit::Uptime{TimeUnit::get_uptime().get() + jittered_backoff},
+                          Retry{std::move(item), failed_attempt + 1}});
+    return true;
+}
+
+template <typename Item>
+template <typename Query>
+bool RetryQueue<Item>::retry_later(
+        const Query& query,
+        Item item,
+        std::chrono::nanoseconds time_left,
+        std::size_t& remaining_queries)
+{
+    if (!query.is_worth_retrying() || !this->push(std::move(item), query.get_attempt(), time_left))
+    {
+        return false;
+    }
+    ++remaining_queries;
+    return true;
+}
+
+template <typename Item>
+boost::optional<typename RetryQueue<Item>::Retry> RetryQueue<Item>::pop_ready()
+{
+    if (waiting_.empty() || (TimeUnit::get_uptime() < waiting_.top().ready_at))
+    {
+        return boost::none;
+    }
+    //priority_queue gives a const reference only
+    Retry retry = std::move(const_cast<Waiting&>(waiting_.top()).retry);
+    waiting_.pop();
+    return retry;
+}
+
+template <typename Item>
+RetryQueue<Item>& RetryQueue<Item>::give_back(Retry retry)
+{
+    waiting_.push(Waiting{TimeUnit::get_uptime(), std::move(retry)});
+    return *this;
+}
+
+template <typename Item>
+std::size_t RetryQueue<Item>::size() const noexcept
+{
+    return waiting_.size();
+}
+
+}//namespace Util
+
+#endif//RETRY_QUEUE_HH_B98C7323D8198C40CD1B24773A6874D5
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLE_GATE_HH_FC8A78F831A64BBAF05F4630E577AC08//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define SAMPLE_GATE_HH_FC8A78F831A64BBAF05F4630E577AC08
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+//the first sample_size items of each key (e.g. address of a server) are let through, the other ones wait
+//for the verdict of the sample: if all sampled items were rejected (e.g. refused by the server) the waiting
+//items are pruned, otherwise they are let through; sample_size 0 lets everything through
+template <typename Key, typename Item>
+class SampleGate
+{
+public:
+    enum class Admission
+    {
+        sample,
+        send,
+        hold,
+        prune
+    };
+    enum class Verdict
+    {
+        pass,
+        prune
+    };
+    struct Released
+    {
+        Verdict verdict;
+        std::vector<Item> items;
+    };
+    explicit SampleGate(std::size_t sample_size);
+    //sample: the item may be sent and it belongs to the sample, its final result has to be reported by
+    //on_result() however it ends, otherwise the held items never get a verdict; send: the item may be sent
+    Admission admit(const Key& key);
+    //the item admitted with hold waits for the verdict of its key
+    SampleGate& hold(const Key& key, Item item);
+    //final result of an item admitted with sample, the waiting items are released once the verdict is known
+    boost::optional<Released> on_result(const Key& key, bool rejected);
+    //number of held items
+    std::size_t size() const noexcept;
+private:
+    struct KeyState
+    {
+        std::size_t sent;
+        std::size_t rejected;
+        boost::optional<Verdict> verdict;
+        std::vector<Item> held;
+    };
+    std::size_t sample_size_;
+    std::map<Key, KeyState> keys_;
+    std::size_t size_;
+};
+
+template <typename Key, typename Item>
+SampleGate<Key, Item>::SampleGate(std::size_t sample_size)
+    : sample_size_{sample_size},
+      keys_{},
+      size_{0}
+{ }
+
+template <typename Key, typename Item>
+typename SampleGate<Key, Item>::Admission SampleGate<Key, Item>::admit(const Key& key)
+{
+    if (sample_size_ <= 0)
+    {
+        return Admission::send;
+    }
+    KeyState& state = keys_.emplace(key, KeyState{0, 0, boost::none, std::vector<Item>{}}).first->second;
+    if (state.verdict != boost::none)
+    {
+        return *state.verdict == Verdict::pass ? Admission::send : Admission::prune;
+    }
+    if (state.sent < sample_size_)
+    {
+        ++state.sent;
+        return Admission::sample;
+    }
+    return Admission::hold;
+}
+
+template <typename Key, typename Item>
+SampleGate<Key, Item>& SampleGate<Key, Item>::hold(const Key& key, Item item)
+{
+    keys_[key].held.push_back(std::move(item));
+    ++size_;
+    return *this;
+}
+
+template <typename Key, typename Item>
+boost::optional<typename SampleGate<Key, Item>::Released> SampleGate<Key, Item>::on_result(const Key& key, bool rejected)
+{
+    const auto key_itr = keys_.find(key);
+    if ((key_itr == keys_.end()) || (key_itr->second.verdict != boost::none))
+    {
+        return boost::none;
+    }
+    KeyState& state = key_itr->second;
+    if (!rejected)
+    {
+        state.verdict = Verdict::pass;
+    }
+    else if (++state.rejected < sample_size_)
+    {
+        return boost::none;
+    }
+    else
+    {
+        state.verdict = Verdict::prune;
+    }
+    size_ -= state.held.size();
+    Released released{*state.verdict, std::move(state.held)};
+    state.held.clear();
+    return released;
+}
+
+template <typename Key, typename Item>
+std::size_t SampleGate<Key, Item>::size() const noexcept
+{
+    return size_;
+}
+
+}//namespace Util
+
+#endif//SAMPLE_GATE_HH_FC8A78F831A64BBAF05F4630E577AC08
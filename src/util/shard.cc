@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/shard.hh"
+
+namespace Util {
+
+bool Shard::owns(std::size_t hash) const noexcept
+{
+    return (number_of_shards <= 1) || ((hash % number_of_shards) == index);
+}
+
+Bitmap Shard::mask(const Bitmap& done, const NameTable::Ids& names) const
+{
+    Bitmap result = done;
+    for (auto idx = done.find_next_unset(0); idx < done.size(); idx = done.find_next_unset(idx + 1))
+    {
+        if (!this->owns(names[idx]))
+        {
+            result.set(idx);
+        }
+    }
+    return result;
+}
+
+}//namespace Util
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SHARD_HH_164E68228190C2657AB043946E28312A//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define SHARD_HH_164E68228190C2657AB043946E28312A
+
+#include "src/util/bitmap.hh"
+#include "src/util/name_table.hh"
+
+#include <cstddef>
+
+namespace Util {
+
+//part of tasks processed by one worker, a task belongs to the shard selected by the hash of its key so that
+//tasks with the same key (nameserver address, name) always meet in one worker; ids of names are their hashes
+struct Shard
+{
+    std::size_t index;
+    std::size_t number_of_shards;
+    bool owns(std::size_t hash) const noexcept;
+    //tasks of other shards are marked done, names are indexed by tasks
+    Bitmap mask(const Bitmap& done, const NameTable::Ids& names) const;
+};
+
+}//namespace Util
+
+#endif//SHARD_HH_164E68228190C2657AB043946E28312A
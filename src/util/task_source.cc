@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/task_source.hh"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace Util {
+
+std::vector<TaskSource::AddressAndOrigin> TaskSource::get_unanswered_origins(
+        const NameserverStates& nameservers,
+        Shard shard)
+{
+    std::vector<AddressAndOrigin> origins;
+    for (std::uint32_t nameserver = 0; nameserver < nameservers.size(); ++nameserver)
+    {
+        const NameserverState& state = nameservers[nameserver];
+        const bool is_answered = state.answered.all();
+        for (std::uint32_t slot = 0; !is_answered && (slot < state.addresses.size()); ++slot)
+        {
+            if (shard.owns(state.addresses[slot].get_hash()))
+            {
+                origins.emplace_back(state.addresses[slot], Origin{nameserver, slot, &state.answered});
+            }
+        }
+    }
+    return origins;
+}
+
+std::vector<TaskSource::AddressAndOrigin> TaskSource::get_origins_of(const ResolvedNameservers& resolved)
+{
+    std::vector<AddressAndOrigin> origins;
+    for (auto&& nameserver : resolved)
+    {
+        for (std::uint32_t slot = 0; slot < nameserver.addresses.size(); ++slot)
+        {
+            origins.emplace_back(nameserver.addresses[slot], Origin{nameserver.nameserver, slot, nullptr});
+        }
+    }
+    return origins;
+}
+
+TaskSource::TaskSource(const NameserverStates& nameservers, Shard shard, const AddressClassifier& address_classifier)
+    : TaskSource{nameservers, get_unanswered_origins(nameservers, shard), address_classifier}
+{ }
+
+TaskSource::TaskSource(const ResolvedNameservers& resolved, const NameserverStates& nameservers, const AddressClassifier& address_classifier)
+    : TaskSource{nameservers, get_origins_of(resolved), address_classifier}
+{ }
+
+TaskSource::TaskSource(
+        const NameserverStates& nameservers,
+        std::vector<AddressAndOrigin> origins,
+        const AddressClassifier& address_classifier)
+    : nameservers_{nameservers},
+      addresses_{},
+      is_public_{},
+      origins_{},
+      first_origins_{},
+      order_{},
+      next_in_order_{0},
+      open_{},
+      number_of_queries_{0},
+      nameservers_of_task_{}
+{
+    //nameservers of a task come in the order of its origins
+    std::sort(begin(origins), end(origins), [](auto&& lhs, auto&& rhs)
+    {
+        return std::tie(lhs.first, lhs.second.nameserver) < std::tie(rhs.first, rhs.second.nameserver);
+    });
+    origins_.reserve(origins.size());
+    for (auto&& address_and_origin : origins)
+    {
+        if (addresses_.empty() || (addresses_.back() != address_and_origin.first))
+        {
+            addresses_.push_back(address_and_origin.first);
+            first_origins_.push_back(static_cast<std::uint32_t>(origins_.size()));
+        }
+        const Origin& origin = address_and_origin.second;
+        const auto& domains = nameservers_[origin.nameserver].domains;
+        for (auto position = this->get_unanswered_position(origin, 0);
+             position < domains.size();
+             position = this->get_unanswered_position(origin, position + 1))
+        {
+            ++number_of_queries_;
+        }
+        origins_.push_back(origin);
+    }
+    first_origins_.push_back(static_cast<std::uint32_t>(origins_.size()));
+    is_public_.reserve(addresses_.size());
+    for (auto&& address : addresses_)
+    {
+        is_public_.push_back(*address_classifier.find(address));
+    }
+    order_.resize(addresses_.size());
+    std::iota(begin(order_), end(order_), std::uint32_t{0});
+    std::shuffle(begin(order_), end(order_), std::mt19937{std::random_device{}()});
+}
+
+TaskSource& TaskSource::take(
+        std::size_t max_number_of_tasks,
+        std::size_t tasks_per_turn,
+        Tasks& tasks,
+        NameserverLists& nameserver_lists,
+        const OnNonPublic& on_non_public)
+{
+    std::size_t number_of_tasks = 0;
+    //each open address gets one turn, then new addresses come
+    std::size_t number_of_turns = open_.size();
+    while (number_of_tasks < max_number_of_tasks)
+    {
+        Cursor cursor;
+        if (0 < number_of_turns)
+        {
+            --number_of_turns;
+            cursor = std::move(open_.front());
+            open_.pop_front();
+        }
+        else if (next_in_order_ < order_.size())
+        {
+            cursor = this->open(order_[next_in_order_]);
+            ++next_in_order_;
+        }
+        else
+        {
+            break;
+        }
+        number_of_tasks += this->take_turn(cursor, tasks_per_turn, tasks, nameserver_lists, on_non_public);
+        if (!cursor.heads.empty())
+        {
+            open_.push_back(std::move(cursor));
+        }
+    }
+    return *this;
+}
+
+bool TaskSource::empty() const noexcept
+{
+    return open_.empty() && (order_.size() <= next_in_order_);
+}
+
+std::size_t TaskSource::get_number_of_queries() const noexcept
+{
+    return number_of_queries_;
+}
+
+std::uint32_t TaskSource::get_unanswered_position(const Origin& origin, std::uint32_t position) const
+{
+    const NameserverState& state = nameservers_[origin.nameserver];
+    if (origin.answered == nullptr)
+    {
+        return position;
+    }
+    while ((position < state.domains.size()) &&
+           origin.answered->is_set(position * state.addresses.size() + origin.address_slot))
+    {
+        ++position;
+    }
+    return position;
+}
+
+TaskSource::Cursor TaskSource::open(std::uint32_t address) const
+{
+    Cursor cursor{address, {}};
+    for (auto idx = first_origins_[address]; idx < first_origins_[address + 1]; ++idx)
+    {
+        const auto& domains = nameservers_[origins_[idx].nameserver].domains;
+        const auto position = this->get_unanswered_position(origins_[idx], 0);
+        if (position < domains.size())
+        {
+            cursor.heads.push_back(Head{domains[position], position, idx});
+        }
+    }
+    std::make_heap(begin(cursor.heads), end(cursor.heads), std::greater<Head>{});
+    return cursor;
+}
+
+std::size_t TaskSource::take_turn(
+        Cursor& cursor,
+        std::size_t tasks_per_turn,
+        Tasks& tasks,
+        NameserverLists& nameserver_lists,
+        const OnNonPublic& on_non_public)
+{
+    auto& heads = cursor.heads;
+    std::size_t number_of_tasks = 0;
+    while (!heads.empty() && (number_of_tasks < tasks_per_turn))
+    {
+        const auto domain = heads.front().domain;
+        nameservers_of_task_.clear();
+        while (!heads.empty() && (heads.front().domain == domain))
+        {
+            std::pop_heap(begin(heads), end(heads), std::greater<Head>{});
+            Head& head = heads.back();
+            const Origin& origin = origins_[head.origin];
+            nameservers_of_task_.push_back(origin.nameserver);
+            const auto& domains = nameservers_[origin.nameserver].domains;
+            head.position = this->get_unanswered_position(origin, head.position + 1);
+            if (head.position < domains.size())
+            {
+                head.domain = domains[head.position];
+                std::push_heap(begin(heads), end(heads), std::greater<Head>{});
+            }
+            else
+            {
+                heads.pop_back();
+            }
+        }
+        const auto task = Task{domain, nameserver_lists.add(nameservers_of_task_), addresses_[cursor.address], 1, false};
+        ++number_of_tasks;
+        if (!is_public_[cursor.address])
+        {
+            on_non_public(task);
+            continue;
+        }
+        tasks.push_back(task);
+    }
+    return number_of_tasks;
+}
+
+Tasks take_tasks(
+        TaskSources& sources,
+        std::size_t max_number_of_tasks,
+        std::size_t tasks_per_turn,
+        NameserverLists& nameserver_lists,
+        const TaskSource::OnNonPublic& on_non_public)
+{
+    Tasks tasks;
+    while ((tasks.size() < max_number_of_tasks) && !sources.empty())
+    {
+        sources.front().take(max_number_of_tasks - tasks.size(), tasks_per_turn, tasks, nameserver_lists, on_non_public);
+        if (sources.front().empty())
+        {
+            sources.pop_front();
+        }
+    }
+    return tasks;
+}
+
+}//namespace Util
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TASK_SOURCE_HH_7FC2DA11E0A11F498042B98ABCEA4A95//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define TASK_SOURCE_HH_7FC2DA11E0A11F498042B98ABCEA4A95
+
+#include "src/util/bitmap.hh"
+#include "src/util/ip_address.hh"
+#include "src/util/name_table.hh"
+#include "src/util/nameserver_lists.hh"
+#include "src/util/prefix_trie.hh"
+#include "src/util/shard.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+//CDNSKEY query of the domain on the address shared by the nameservers
+struct Task
+{
+    NameTable::Id domain;
+    NameserverLists::Id nameservers;
+    IpAddress address;
+    std::size_t attempt;//1 for the first query of the task
+    bool is_sample;//the task belongs to the sample of its address, retries included
+};
+
+using Tasks = std::vector<Task>;
+
+//query of domains[i] on addresses[j] is answered if bit i * addresses.size() + j is set
+struct NameserverState
+{
+    NameTable::Ids domains;//sorted
+    IpAddresses addresses;//known when is_resolved
+    bool is_resolved;
+    Bitmap answered;
+};
+
+//indexed by indices of nameservers
+using NameserverStates = std::vector<NameserverState>;
+
+struct ResolvedNameserver
+{
+    std::uint32_t nameserver;
+    IpAddresses addresses;
+};
+
+using ResolvedNameservers = std::vector<ResolvedNameserver>;
+
+//true for public addresses
+using AddressClassifier = PrefixTrie<bool>;
+
+//queries are turned into tasks when there is room for them instead of all at once, so the number of tasks
+//in memory does not grow with the number of domains; addresses come in random order (a permutation of their
+//indices) and take turns, queries of nameservers sharing an address are merged into one task per domain by
+//a heap of cursors into the sorted domains of the nameservers
+class TaskSource
+{
+public:
+    //gets tasks on addresses which are not public, they are not worth a query
+    using OnNonPublic = std::function<void(const Task&)>;
+    //unanswered queries of resolved nameservers on addresses owned by the shard
+    TaskSource(const NameserverStates& nameservers, Shard shard, const AddressClassifier& address_classifier);
+    //all queries of just resolved nameservers
+    TaskSource(const ResolvedNameservers& resolved, const NameserverStates& nameservers, const AddressClassifier& address_classifier);
+    //tasks on public addresses are appended to tasks, the others are passed to on_non_public; an address gives
+    //at most tasks_per_turn tasks in its turn and a turn is not cut, so more than max_number_of_tasks may come
+    TaskSource& take(
+            std::size_t max_number_of_tasks,
+            std::size_t tasks_per_turn,
+            Tasks& tasks,
+            NameserverLists& nameserver_lists,
+            const OnNonPublic& on_non_public);
+    bool empty() const noexcept;
+    //upper bound of the number of tasks, queries of nameservers sharing an address make one task
+    std::size_t get_number_of_queries() const noexcept;
+private:
+    //queries of one nameserver on one of its addresses
+    struct Origin
+    {
+        std::uint32_t nameserver;
+        std::uint32_t address_slot;//index into addresses of the nameserver
+        const Bitmap* answered;//nullptr if nothing is answered
+    };
+    struct Head
+    {
+        NameTable::Id domain;
+        std::uint32_t position;//index into domains of the nameserver
+        std::uint32_t origin;
+        friend bool operator>(const Head& lhs, const Head& rhs)
+        {
+            return std::tie(lhs.domain, lhs.origin) > std::tie(rhs.domain, rhs.origin);
+        }
+    };
+    //address with tasks left, heads of its origins make a min-heap
+    struct Cursor
+    {
+        std::uint32_t address;
+        std::vector<Head> heads;
+    };
+    using AddressAndOrigin = std::pair<IpAddress, Origin>;
+    static std::vector<AddressAndOrigin> get_unanswered_origins(const NameserverStates& nameservers, Shard shard);
+    static std::vector<AddressAndOrigin> get_origins_of(const ResolvedNameservers& resolved);
+    TaskSource(
+            const NameserverStates& nameservers,
+            std::vector<AddressAndOrigin> origins,
+            const AddressClassifier& address_classifier);
+    //first unanswered position of the origin starting at position
+    std::uint32_t get_unanswered_position(const Origin& origin, std::uint32_t position) const;
+    Cursor open(std::uint32_t address) const;
+    std::size_t take_turn(
+            Cursor& cursor,
+            std::size_t tasks_per_turn,
+            Tasks& tasks,
+            NameserverLists& nameserver_lists,
+            const OnNonPublic& on_non_public);
+    const NameserverStates& nameservers_;
+    IpAddresses addresses_;
+    //classified once per address
+    std::vector<bool> is_public_;
+    //origins of addresses_[i] are origins_[first_origins_[i]] .. origins_[first_origins_[i + 1] - 1]
+    std::vector<Origin> origins_;
+    std::vector<std::uint32_t> first_origins_;
+    std::vector<std::uint32_t> order_;
+    std::size_t next_in_order_;
+    std::deque<Cursor> open_;
+    std::size_t number_of_queries_;
+    std::vector<std::uint32_t> nameservers_of_task_;
+};
+
+using TaskSources = std::deque<TaskSource>;
+
+//tasks of earlier sources come first
+Tasks take_tasks(
+        TaskSources& sources,
+        std::size_t max_number_of_tasks,
+        std::size_t tasks_per_turn,
+        NameserverLists& nameserver_lists,
+        const TaskSource::OnNonPublic& on_non_public);
+
+}//namespace Util
+
+#endif//TASK_SOURCE_HH_7FC2DA11E0A11F498042B98ABCEA4A95
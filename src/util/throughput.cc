@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/util/throughput.hh"
+
+#include <chrono>
+#include <iostream>
+
+namespace Util {
+
+Throughput::Throughput()
+    : started_at_{TimeUnit::get_uptime()},
+      cpu_time_at_start_{TimeUnit::get_cpu_time()},
+      number_of_queries_{0}
+{ }
+
+Throughput& Throughput::query_finished() noexcept
+{
+    ++number_of_queries_;
+    return *this;
+}
+
+std::size_t Throughput::get_number_of_queries() const noexcept
+{
+    return number_of_queries_;
+}
+
+std::ostream& operator<<(std::ostream& out, const Throughput& throughput)
+{
+    const auto wall_time = TimeUnit::get_uptime().get() - throughput.started_at_.get();
+    const auto cpu_time = TimeUnit::get_cpu_time().get() - throughput.cpu_time_at_start_.get();
+    const double wall_time_sec = std::chrono::duration<double>{wall_time}.count();
+    out << throughput.number_of_queries_ << " queries in " << wall_time_sec << "s";
+    if (0 < throughput.number_of_queries_)
+    {
+        const double cpu_time_per_query_usec = std::chrono::duration<double, std::micro>{cpu_time}.count() / throughput.number_of_queries_;
+        out << " (" << (0.0 < wall_time_sec ? throughput.number_of_queries_ / wall_time_sec : 0.0) << " queries/s, "
+            << cpu_time_per_query_usec << "us cpu per query)";
+    }
+    return out;
+}
+
+}//namespace Util
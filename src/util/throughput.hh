@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef THROUGHPUT_HH_7B7355766C587758D0990CCA82B88CD3//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define THROUGHPUT_HH_7B7355766C587758D0990CCA82B88CD3
+
+#include "src/time_unit.hh"
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace Util {
+
+//measures wall clock and cpu time spent by finished queries
+class Throughput
+{
+public:
+    Throughput();
+    Throughput& query_finished() noexcept;
+    std::size_t get_number_of_queries() const noexcept;
+private:
+    TimeUnit::Uptime started_at_;
+    TimeUnit::CpuTime cpu_time_at_start_;
+    std::size_t number_of_queries_;
+    friend std::ostream& operator<<(std::ostream& out, const Throughput& throughput);
+};
+
+}//namespace Util
+
+#endif//THROUGHPUT_HH_7B7355766C587758D0990CCA82B88CD3
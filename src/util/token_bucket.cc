@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/token_bucket.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Util {
+
+namespace {
+
+double get_capacity(const TokenBucket::Settings& settings)
+{
+    return static_cast<double>(std::max<std::size_t>(1, settings.burst));
+}
+
+bool is_unlimited(const TokenBucket::Settings& settings)
+{
+    return settings.rate <= 0.0;
+}
+
+}//namespace Util::{anonymous}
+
+TokenBucket::TokenBucket(const Settings& settings)
+    : settings_{settings},
+      tokens_{get_capacity(settings)},
+      refilled_at_{TimeUnit::get_uptime()}
+{ }
+
+TokenBucket& TokenBucket::set_settings(const Settings& settings)
+{
+    this->refill();
+    settings_ = settings;
+    tokens_ = std::min(tokens_, get_capacity(settings_));
+    return *this;
+}
+
+std::size_t TokenBucket::take(std::size_t wanted)
+{
+    if (is_unlimited(settings_))
+    {
+        return wanted;
+    }
+    this->refill();
+    const auto taken = std::min(wanted, static_cast<std::size_t>(tokens_));
+    tokens_ -= taken;
+    return taken;
+}
+
+TokenBucket& TokenBucket::give_back(std::size_t unused)
+{
+    if (!is_unlimited(settings_))
+    {
+        tokens_ = std::min(tokens_ + unused, get_capacity(settings_));
+    }
+    return *this;
+}
+
+std::chrono::nanoseconds TokenBucket::get_time_to_next_token()
+{
+    if (is_unlimited(settings_))
+    {
+        return std::chrono::nanoseconds::zero();
+    }
+    this->refill();
+    if (1.0 <= tokens_)
+    {
+        return std::chrono::nanoseconds::zero();
+    }
+    return std::chrono::nanoseconds{static_cast<std::int64_t>(std::ceil(1.0e+9 * (1.0 - tokens_) / settings_.rate))};
+}
+
+bool TokenBucket::is_full()
+{
+    if (is_unlimited(settings_))
+    {
+        return true;
+    }
+    this->refill();
+    return get_capacity(settings_) <= tokens_;
+}
+
+TokenBucket& TokenBucket::refill()
+{
+    const auto now = TimeUnit::get_uptime();
+    if (!is_unlimited(settings_))
+    {
+        const double elapsed_sec = std::chrono::duration<double>{now.get() - refilled_at_.get()}.count();
+        tokens_ = std::min(tokens_ + elapsed_sec * settings_.rate, get_capacity(settings_));
+    }
+    refilled_at_ = now;
+    return *this;
+}
+
+}//namespace Util
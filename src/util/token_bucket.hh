@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TOKEN_BUCKET_HH_0883ADE2A90AF403758EB8750E3AC3CF//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define TOKEN_BUCKET_HH_0883ADE2A90AF403758EB8750E3AC3CF
+
+#include "src/time_unit.hh"
+
+#include <chrono>
+#include <cstddef>
+
+namespace Util {
+
+// Tokens are added at a constant rate up to the burst size, every query takes one token. The bucket
+// is refilled from the uptime elapsed since the previous use so it needs no timer of its own.
+class TokenBucket
+{
+public:
+    struct Settings
+    {
+        // tokens per second; 0 means no limit
+        double rate;
+        std::size_t burst;
+    };
+    // the bucket starts full
+    explicit TokenBucket(const Settings& settings);
+    TokenBucket& set_settings(const Settings& settings);
+    // takes at most wanted tokens, returns the number of tokens taken
+    std::size_t take(std::size_t wanted);
+    // returns tokens taken but not used
+    TokenBucket& give_back(std::size_t unused);
+    // zero if a token is available now
+    std::chrono::nanoseconds get_time_to_next_token();
+    // true if the bucket holds its whole burst again
+    bool is_full();
+private:
+    TokenBucket& refill();
+    Settings settings_;
+    double tokens_;
+    TimeUnit::Uptime refilled_at_;
+};
+
+}//namespace Util
+
+#endif//TOKEN_BUCKET_HH_0883ADE2A90AF403758EB8750E3AC3CF
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/util/upstream_timeouts.hh"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Util {
+
+namespace {
+
+//RFC 6298 weights
+constexpr int rtt_weight_divider = 8;
+constexpr int rtt_variation_weight_divider = 4;
+constexpr int rtt_variation_multiplier = 4;
+
+std::chrono::nanoseconds get_absolute(std::chrono::nanoseconds value)
+{
+    return value < std::chrono::nanoseconds::zero() ? -value : value;
+}
+
+}//namespace Util::{anonymous}
+
+UpstreamTimeouts::UpstreamTimeouts(const Settings& settings)
+    : settings_{settings},
+      estimates_{}
+{
+    settings_.max_timeout = std::max(settings_.max_timeout, std::chrono::nanoseconds{std::chrono::milliseconds{1}});
+    settings_.min_timeout = std::min(settings_.max_timeout, std::max(settings_.min_timeout, std::chrono::nanoseconds{std::chrono::milliseconds{1}}));
+    settings_.initial_timeout = std::min(settings_.max_timeout, std::max(settings_.min_timeout, settings_.initial_timeout));
+}
+
+std::chrono::milliseconds UpstreamTimeouts::get_timeout(const IpAddress& upstream) const
+{
+    const auto estimate_itr = estimates_.find(upstream);
+    const auto timeout = estimate_itr == estimates_.end() ? settings_.initial_timeout
+                                                          : estimate_itr->second.timeout;
+    auto rounded_timeout = settings_.min_timeout;
+    while (rounded_timeout < timeout)
+    {
+        rounded_timeout *= 2;
+    }
+    rounded_timeout = std::min(rounded_timeout, settings_.max_timeout);
+    const auto result = std::chrono::duration_cast<std::chrono::milliseconds>(rounded_timeout);
+    return result < rounded_timeout ? result + std::chrono::milliseconds{1} : result;
+}
+
+UpstreamTimeouts& UpstreamTimeouts::on_answer(const IpAddress& upstream, std::chrono::nanoseconds rtt)
+{
+    Estimate& estimate = this->get_estimate(upstream);
+    if (estimate.has_samples)
+    {
+        estimate.rtt_variation += (get_absolute(estimate.smoothed_rtt - rtt) - estimate.rtt_variation) / rtt_variation_weight_divider;
+        estimate.smoothed_rtt += (rtt - estimate.smoothed_rtt) / rtt_weight_divider;
+    }
+    else
+    {
+        estimate.smoothed_rtt = rtt;
+        estimate.rtt_variation = rtt / 2;
+        estimate.has_samples = true;
+    }
+    estimate.timeout = std::min(settings_.max_timeout, std::max(settings_.min_timeout,
+            estimate.smoothed_rtt + rtt_variation_multiplier * estimate.rtt_variation));
+    return *this;
+}
+
+UpstreamTimeouts& UpstreamTimeouts::on_timeout(const IpAddress& upstream)
+{
+    Estimate& estimate = this->get_estimate(upstream);
+    //back off, the estimate is recomputed by the next answer
+    estimate.timeout = std::min(settings_.max_timeout, 2 * estimate.timeout);
+    return *this;
+}
+
+UpstreamTimeouts::Estimate& UpstreamTimeouts::get_estimate(const IpAddress& upstream)
+{
+    const auto estimate_itr = estimates_.find(upstream);
+    if (estimate_itr != estimates_.end())
+    {
+        return estimate_itr->second;
+    }
+    return estimates_.emplace(upstream, Estimate{
+            std::chrono::nanoseconds::zero(),
+            std::chrono::nanoseconds::zero(),
+            settings_.initial_timeout,
+            false}).first->second;
+}
+
+std::ostream& operator<<(std::ostream& out, const UpstreamTimeouts& timeouts)
+{
+    out << timeouts.estimates_.size() << " upstreams";
+    if (!timeouts.estimates_.empty())
+    {
+        std::chrono::duration<double, std::milli> sum_of_timeouts{0.0};
+        for (auto&& upstream_and_estimate : timeouts.estimates_)
+        {
+            sum_of_timeouts += upstream_and_estimate.second.timeout;
+        }
+        out << ", mean timeout " << (sum_of_timeouts.count() / timeouts.estimates_.size()) << "ms";
+    }
+    return out;
+}
+
+}//namespace Util
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPSTREAM_TIMEOUTS_HH_721C4378E2F40B489D2A52AD161D9D86//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define UPSTREAM_TIMEOUTS_HH_721C4378E2F40B489D2A52AD161D9D86
+
+#include "src/util/ip_address.hh"
+
+#include <chrono>
+#include <iosfwd>
+#include <map>
+
+namespace Util {
+
+// Timeouts of queries derived from round trip times of earlier queries of the same upstream the way TCP
+// computes its retransmission timeout (RFC 6298): srtt + 4 * rttvar clamped to <min_timeout, max_timeout>.
+// An upstream without answers starts at initial_timeout and every timed out query doubles its timeout,
+// so dead addresses do not hold queries in flight for the whole max_timeout.
+class UpstreamTimeouts
+{
+public:
+    struct Settings
+    {
+        std::chrono::nanoseconds min_timeout;
+        std::chrono::nanoseconds initial_timeout;
+        std::chrono::nanoseconds max_timeout;
+    };
+    explicit UpstreamTimeouts(const Settings& settings);
+    // rounded up to min_timeout * 2^n (or max_timeout) so that queries of similar upstreams share contexts
+    std::chrono::milliseconds get_timeout(const IpAddress& upstream) const;
+    UpstreamTimeouts& on_answer(const IpAddress& upstream, std::chrono::nanoseconds rtt);
+    UpstreamTimeouts& on_timeout(const IpAddress& upstream);
+private:
+    struct Estimate
+    {
+        std::chrono::nanoseconds smoothed_rtt;
+        std::chrono::nanoseconds rtt_variation;
+        std::chrono::nanoseconds timeout;
+        bool has_samples;
+    };
+    Estimate& get_estimate(const IpAddress& upstream);
+    Settings settings_;
+    std::map<IpAddress, Estimate> estimates_;
+    friend std::ostream& operator<<(std::ostream& out, const UpstreamTimeouts& timeouts);
+};
+
+}//namespace Util
+
+#endif//UPSTREAM_TIMEOUTS_HH_721C4378E2F40B489D2A52AD161D9D86
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WORK_STEALING_QUEUES_HH_EF6634174EBC3B0E726CCDB724346098//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define WORK_STEALING_QUEUES_HH_EF6634174EBC3B0E726CCDB724346098
+
+#include <boost/optional.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Util {
+
+//every worker thread owns one queue, it takes items from the front of its own queue and when the queue is
+//empty it steals from the back of the others, so that the items pushed last (least related to the items
+//the owner is working on) move between threads
+template <typename T>
+class WorkStealingQueues
+{
+public:
+    explicit WorkStealingQueues(std::size_t number_of_workers);
+    WorkStealingQueues(const WorkStealingQueues&) = delete;
+    WorkStealingQueues& operator=(const WorkStealingQueues&) = delete;
+    WorkStealingQueues& push(std::size_t worker, T item);
+    //no more items will be pushed, waiting workers are woken up
+    WorkStealingQueues& close();
+    //none if all queues are empty at the moment
+    boost::optional<T> try_take(std::size_t worker);
+    //waits for an item, none if all queues are empty and closed
+    boost::optional<T> take(std::size_t worker);
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<T> items;
+    };
+    boost::optional<T> take_from(Queue& queue, bool from_front);
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::mutex state_lock_;
+    std::condition_variable item_pushed_;
+    std::size_t number_of_items_;
+    bool closed_;
+};
+
+template <typename T>
+WorkStealingQueues<T>::WorkStealingQueues(std::size_t number_of_workers)
+    : queues_{},
+      number_of_items_{0},
+      closed_{false}
+{
+    for (std::size_t idx = 0; idx < number_of_workers; ++idx)
+    {
+        queues_.emplace_back(new Queue);
+    }
+}
+
+template <typename T>
+WorkStealingQueues<T>& WorkStealingQueues<T>::push(std::size_t worker, T item)
+{
+    Queue& queue = *queues_[worker % queues_.size()];
+    {
+        const std::lock_guard<std::mutex> queue_lock{queue.lock};
+        queue.items.push_back(std::move(item));
+    }
+    {
+        const std::lock_guard<std::mutex> state_lock{state_lock_};
+        ++number_of_items_;
+    }
+    item_pushed_.notify_one();
+    return *this;
+}
+
+template <typename T>
+WorkStealingQueues<T>& WorkStealingQueues<T>::close()
+{
+    {
+        const std::lock_guard<std::mutex> state_lock{state_lock_};
+        closed_ = true;
+    }
+    item_pushed_.notify_all();
+    return *this;
+}
+
+template <typename T>
+boost::optional<T> WorkStealingQueues<T>::try_take(std::size_t worker)
+{
+    auto item = this->take_from(*queues_[worker % queues_.size()], true);
+    for (std::size_t distance = 1; (item == boost::none) && (distance < queues_.size()); ++distance)
+    {
+        item = this->take_from(*queues_[(worker + distance) % queues_.size()], false);
+    }
+    return item;
+}
+
+template <typename T>
+boost::optional<T> WorkStealingQueues<T>::take(std::size_t worker)
+{
+    while (true)
+    {
+        auto item = this->try_take(worker);
+        if (item != boost::none)
+        {
+            return item;
+        }
+        std::unique_lock<std::mutex> state_lock{state_lock_};
+        if ((number_of_items_ == 0) && closed_)
+        {
+            return boost::none;
+        }
+        item_pushed_.wait(state_lock, [&]() { return (0 < number_of_items_) || closed_; });
+    }
+}
+
+template <typename T>
+boost::optional<T> WorkStealingQueues<T>::take_from(Queue& queue, bool from_front)
+{
+    boost::optional<T> item;
+    {
+        const std::lock_guard<std::mutex> queue_lock{queue.lock};
+        if (queue.items.empty())
+        {
+            return item;
+        }
+        if (from_front)
+        {
+            item = std::move(queue.items.front());
+            queue.items.pop_front();
+        }
+        else
+        {
+            item = std::move(queue.items.back());
+            queue.items.pop_back();
+        }
+    }
+    const std::lock_guard<std::mutex> state_lock{state_lock_};
+    --number_of_items_;
+    return item;
+}
+
+}//namespace Util
+
+#endif//WORK_STEALING_QUEUES_HH_EF6634174EBC3B0E726CCDB724346098
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/workers.hh"
+
+#include "src/event/base.hh"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace Util {
+
+Workers::Worker::Worker(Workers& workers)
+    : workers{workers},
+      pipe{},
+      process{},
+      reader{},
+      event_ptr{nullptr},
+      records{},
+      closed{false}
+{ }
+
+Workers::Workers(std::chrono::seconds max_idle)
+    : max_idle_{max_idle},
+      workers_{},
+      number_of_open_workers_{0}
+{ }
+
+Workers::~Workers()
+{
+    for (auto&& worker : workers_)
+    {
+        if (worker.event_ptr != nullptr)
+        {
+            ::event_del(worker.event_ptr);
+            ::event_free(worker.event_ptr);
+            worker.event_ptr = nullptr;
+        }
+        if (worker.process != nullptr)
+        {
+            try
+            {
+                worker.process->kill_child();
+            }
+            catch (...) { }
+        }
+    }
+}
+
+bool Workers::wait(const RecordHandler& handle_record)
+{
+    //the event base is made after all forks, children have nothing to do with it
+    Event::Base loop;
+    for (auto&& worker : workers_)
+    {
+        if (worker.reader == nullptr)
+        {
+            continue;
+        }
+        worker.event_ptr = ::event_new(loop, worker.reader->get_descriptor(), EV_READ | EV_PERSIST, callback_routine, &worker);
+        struct ::timeval timeout;
+        timeout.tv_sec = max_idle_.count();
+        timeout.tv_usec = 0;
+        static constexpr int success = 0;
+        if ((worker.event_ptr == nullptr) || (::event_add(worker.event_ptr, &timeout) != success))
+        {
+            struct EventAddFailure : std::runtime_error
+            {
+                EventAddFailure() : std::runtime_error("event_add failed") { }
+            };
+            throw EventAddFailure();
+        }
+        ++number_of_open_workers_;
+    }
+    while (0 < number_of_open_workers_)
+    {
+        loop(Event::Loop::Once{});
+        for (auto&& worker : workers_)
+        {
+            worker.records.for_each_record([&](Record& record) { handle_record(record); });
+            if (worker.closed && !worker.records.empty())
+            {
+                std::cerr << "incomplete record received" << std::endl;
+                worker.records = RecordBuffer{};
+            }
+        }
+        std::cout.flush();
+    }
+    bool all_succeeded = true;
+    for (auto&& worker : workers_)
+    {
+        if (worker.event_ptr != nullptr)
+        {
+            ::event_free(worker.event_ptr);
+            worker.event_ptr = nullptr;
+        }
+        if (!get_result_of(worker))
+        {
+            all_succeeded = false;
+        }
+    }
+    return all_succeeded;
+}
+
+void Workers::callback_routine(evutil_socket_t fd, short events, void* user_data_ptr)
+{
+    auto* const worker_ptr = static_cast<Worker*>(user_data_ptr);
+    if ((worker_ptr == nullptr) || (worker_ptr->reader->get_descriptor() != fd))
+    {
+        return;
+    }
+    try
+    {
+        const bool timed_out = (events & EV_TIMEOUT) == EV_TIMEOUT;
+        if (timed_out)
+        {
+            worker_ptr->workers.close(*worker_ptr);
+            //a blocked child is killed at once, it keeps its sockets and memory until then
+            const std::unique_ptr<Fork> process = std::move(worker_ptr->process);
+            if ((process != nullptr) && process->kill_child().signaled())
+            {
+                std::cerr << "child process was terminated because of blocking" << std::endl;
+            }
+            return;
+        }
+        const bool ready_for_reading = (events & EV_READ) == EV_READ;
+        if (ready_for_reading)
+        {
+            worker_ptr->workers.on_read(*worker_ptr);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Workers::on_read failed: " << e.what() << std::endl;
+        worker_ptr->workers.close(*worker_ptr);
+    }
+    catch (...)
+    {
+        std::cerr << "Workers::on_read caught an unexpected exception" << std::endl;
+        worker_ptr->workers.close(*worker_ptr);
+    }
+}
+
+Workers& Workers::on_read(Worker& worker)
+{
+    char buffer[0x10000];
+    while (true)
+    {
+        static constexpr ::ssize_t failure = -1;
+        const auto read_retval = ::read(worker.reader->get_descriptor(), buffer, sizeof(buffer));
+        if (read_retval == failure)
+        {
+            const int c_errno = errno;
+            const bool data_unavailable = (c_errno == EAGAIN) || (c_errno == EWOULDBLOCK) || (c_errno == EINTR);
+            if (data_unavailable)
+            {
+                return *this;
+            }
+            struct ReadFailed : std::runtime_error
+            {
+                ReadFailed(int error_code) : std::runtime_error(std::string("read() failed: ") + std::strerror(error_code)) { }
+            };
+            throw ReadFailed(c_errno);
+        }
+        const bool end_reached = (read_retval == 0);
+        if (end_reached)
+        {
+            return this->close(worker);
+        }
+        const auto data_length = static_cast<std::size_t>(read_retval);
+        worker.records.append(buffer, data_length);
+        const bool all_available_data_already_read = data_length < sizeof(buffer);
+        if (all_available_data_already_read)
+        {
+            return *this;
+        }
+    }
+}
+
+Workers& Workers::close(Worker& worker)
+{
+    if (!worker.closed)
+    {
+        ::event_del(worker.event_ptr);
+        worker.closed = true;
+        --number_of_open_workers_;
+    }
+    return *this;
+}
+
+bool Workers::get_result_of(Worker& worker)
+{
+    if (worker.process == nullptr)
+    {
+        return false;
+    }
+    const std::unique_ptr<Fork> process = std::move(worker.process);
+    //the pipe is closed when the child exits
+    const Fork::ChildResultStatus child_result_status = process->wait_for_child_result_status();
+    if (child_result_status.exited())
+    {
+        if (child_result_status.get_exit_status() == EXIT_SUCCESS)
+        {
+            return true;
+        }
+        std::cerr << "child process failed" << std::endl;
+    }
+    else if (child_result_status.signaled())
+    {
+        std::cerr << "child process terminated by signal " << child_result_status.get_signal_number() << std::endl;
+    }
+    else
+    {
+        std::cerr << "child process done" << std::endl;
+    }
+    return false;
+}
+
+}//namespace Util
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WORKERS_HH_5D36E12C311E5C2E4707E77B5F52C70D//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define WORKERS_HH_5D36E12C311E5C2E4707E77B5F52C70D
+
+#include "src/util/fork.hh"
+#include "src/util/pipe.hh"
+#include "src/util/record.hh"
+#include "src/util/shard.hh"
+
+#include <event2/event.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace Util {
+
+//child processes working in parallel, each of them sends records through its own pipe; a child silent for
+//longer than max_idle is considered blocked and it is killed
+class Workers
+{
+public:
+    explicit Workers(std::chrono::seconds max_idle);
+    ~Workers();
+    Workers(const Workers&) = delete;
+    Workers& operator=(const Workers&) = delete;
+    //make_child(Pipe& pipe_to_parent) returns the callable run by the new child process
+    template <typename F>
+    Workers& start(F make_child);
+    using RecordHandler = std::function<void(Record&)>;
+    //passes records to handle_record until all children finish, returns true if all of them succeeded
+    bool wait(const RecordHandler& handle_record);
+private:
+    struct Worker
+    {
+        Worker(Workers& workers);
+        Workers& workers;
+        Pipe pipe;
+        std::unique_ptr<Fork> process;
+        std::unique_ptr<ImReader> reader;
+        struct ::event* event_ptr;
+        RecordBuffer records;
+        bool closed;
+    };
+    static void callback_routine(evutil_socket_t fd, short events, void* user_data_ptr);
+    Workers& on_read(Worker& worker);
+    Workers& close(Worker& worker);
+    static bool get_result_of(Worker& worker);
+    std::chrono::seconds max_idle_;
+    std::list<Worker> workers_;
+    std::size_t number_of_open_workers_;
+};
+
+template <typename F>
+Workers& Workers::start(F make_child)
+{
+    workers_.emplace_back(*this);
+    Worker& worker = workers_.back();
+    worker.process.reset(new Fork{make_child(worker.pipe)});
+    //siblings forked later must not inherit the write end, its reader would never see the end of data
+    worker.reader.reset(new ImReader{worker.pipe});
+    worker.reader->set_nonblocking();
+    return *this;
+}
+
+}//namespace Util
+
+#endif//WORKERS_HH_5D36E12C311E5C2E4707E77B5F52C70D
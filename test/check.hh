@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CHECK_HH_BDDD903B0FBCEFCED66445B36687F9DB//date "+%s"|md5sum|tr "[a-f]" "[A-F]"
+#define CHECK_HH_BDDD903B0FBCEFCED66445B36687F9DB
+
+#include <cstdlib>
+#include <iostream>
+
+namespace Test {
+
+inline int& get_number_of_failures()
+{
+    static int number_of_failures = 0;
+    return number_of_failures;
+}
+
+//a failed check is reported and counted, the test goes on
+inline void check(bool condition, const char* description)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++get_number_of_failures();
+    }
+}
+
+//exit status of the test, EXIT_FAILURE if any check failed
+inline int get_exit_status()
+{
+    if (0 < get_number_of_failures())
+    {
+        std::cerr << get_number_of_failures() << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+}//namespace Test
+
+#endif//CHECK_HH_BDDD903B0FBCEFCED66445B36687F9DB
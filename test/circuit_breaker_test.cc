@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/circuit_breaker.hh"
+
+#include "src/time_unit.hh"
+
+#include "test/check.hh"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+using Breaker = Util::CircuitBreaker<std::string>;
+
+using Test::check;
+
+//events of the breaker are ordered by their times
+TimeUnit::Uptime later()
+{
+    std::this_thread::sleep_for(std::chrono::microseconds{10});
+    return TimeUnit::get_uptime();
+}
+
+constexpr auto probe_after = std::chrono::milliseconds{1};
+
+//opens the circuit of key by timeouts of queries sent one after another
+void open(Breaker& breaker, const std::string& key, std::size_t max_consecutive_timeouts)
+{
+    for (std::size_t idx = 0; idx < max_consecutive_timeouts; ++idx)
+    {
+        breaker.on_timeout(key, later());
+        later();
+    }
+}
+
+void test_disabled()
+{
+    Breaker breaker{Util::CircuitBreakerSettings{0, probe_after}};
+    open(breaker, "a", 10);
+    check(breaker.allow("a"), "disabled: timeouts do not open");
+    check(breaker.get_number_of_opened_circuits() == 0, "disabled: nothing opened");
+}
+
+void test_consecutive_timeouts()
+{
+    Breaker breaker{Util::CircuitBreakerSettings{3, std::chrono::nanoseconds::zero()}};
+    open(breaker, "a", 2);
+    breaker.on_answer("a");
+    open(breaker, "a", 2);
+    check(breaker.allow("a"), "consecutive: an answer resets the count");
+    check(breaker.on_timeout("a", later()) == Breaker::Transition::opened, "consecutive: opened");
+    check(!breaker.allow("a"), "consecutive: open circuit rejects");
+    check(breaker.allow("b"), "consecutive: keys are independent");
+    check(breaker.get_number_of_opened_circuits() == 1, "consecutive: one circuit opened");
+    later();
+    check(breaker.on_answer("a") == Breaker::Transition::closed, "consecutive: an answer closes");
+    check(breaker.allow("a"), "consecutive: closed circuit lets through");
+}
+
+//queries pipelined over a stalled connection time out at once, they make one timeout
+void test_pipelined_timeouts()
+{
+    Breaker breaker{Util::CircuitBreakerSettings{3, std::chrono::nanoseconds::zero()}};
+    const auto sent_at = later();
+    for (int idx = 0; idx < 10; ++idx)
+    {
+        breaker.on_timeout("a", sent_at);
+    }
+    check(breaker.allow("a"), "pipelined: queries sent at once count once");
+    const auto sent_before_answer = later();
+    breaker.on_answer("a");
+    open(breaker, "a", 2);
+    breaker.on_timeout("a", sent_before_answer);
+    check(breaker.allow("a"), "pipelined: queries sent before the last answer do not count");
+    breaker.on_timeout("a", later());
+    check(!breaker.allow("a"), "pipelined: queries sent one after another count");
+}
+
+void test_probe()
+{
+    Breaker breaker{Util::CircuitBreakerSettings{2, probe_after}};
+    const auto sent_before_opening = later();
+    open(breaker, "a", 2);
+    check(!breaker.allow("a"), "probe: not before probe_after");
+    std::this_thread::sleep_for(2 * probe_after);
+    check(breaker.allow("a"), "probe: let through");
+    check(!breaker.allow("a"), "probe: one at a time");
+    check(breaker.on_timeout("a", sent_before_opening) == Breaker::Transition::none,
+          "probe: queries sent before opening ignored");
+    const auto probe_sent_at = later();
+    check(breaker.on_timeout("a", probe_sent_at) == Breaker::Transition::probe_failed, "probe: timed out");
+    check(!breaker.allow("a"), "probe: open again");
+    std::this_thread::sleep_for(2 * probe_after);
+    check(breaker.allow("a"), "probe: second probe");
+    check(breaker.on_failure("a", sent_before_opening) == Breaker::Transition::none,
+          "probe: failures of queries sent before opening ignored");
+    check(breaker.on_failure("a", probe_sent_at) == Breaker::Transition::none,
+          "probe: failures of queries sent before opening again ignored");
+    check(!breaker.allow("a"), "probe: still in flight after stale failures");
+    check(breaker.on_failure("a", later()) == Breaker::Transition::probe_failed, "probe: failed");
+    check(!breaker.allow("a"), "probe: failure opens again");
+    std::this_thread::sleep_for(2 * probe_after);
+    check(breaker.allow("a"), "probe: third probe");
+    breaker.cancel("a");
+    check(breaker.allow("a"), "probe: not sent probe is let through again");
+    check(breaker.on_answer("a") == Breaker::Transition::closed, "probe: answered");
+    check(breaker.allow("a"), "probe: closed");
+    check(breaker.on_failure("a", later()) == Breaker::Transition::none, "probe: failures of closed circuit ignored");
+    check(breaker.allow("a"), "probe: still closed");
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_disabled();
+    test_consecutive_timeouts();
+    test_pipelined_timeouts();
+    test_probe();
+    return Test::get_exit_status();
+}
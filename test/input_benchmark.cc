@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/domains_to_scan.hh"
+
+#include "src/util/input_buffer.hh"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+
+namespace {
+
+// like a TLD: a fifth of domains is signed, every insecure domain has two nameservers of its hosting
+constexpr std::size_t secure_domains_per_line = 100;
+constexpr std::size_t domains_per_hosting = 1000;
+
+void generate_input(std::size_t number_of_domains, std::ostream& out)
+{
+    const std::size_t number_of_secure_domains = number_of_domains / 5;
+    out << "[secure]\n";
+    for (std::size_t domain = 0; domain < number_of_secure_domains; ++domain)
+    {
+        const bool line_is_full = ((domain + 1) % secure_domains_per_line) == 0;
+        const bool is_last = (domain + 1) == number_of_secure_domains;
+        out << "signed-domain-" << domain << ".cz" << ((line_is_full || is_last) ? '\n' : ' ');
+    }
+    out << "[insecure]\n";
+    for (std::size_t first = number_of_secure_domains; first < number_of_domains; first += domains_per_hosting)
+    {
+        const std::size_t hosting = first / domains_per_hosting;
+        for (const char* nameserver : {"ns1", "ns2"})
+        {
+            out << nameserver << ".hosting-" << hosting << ".cz";
+            for (std::size_t domain = first; (domain < number_of_domains) && (domain < first + domains_per_hosting); ++domain)
+            {
+                out << " domain-" << domain << ".cz";
+            }
+            out << '\n';
+        }
+    }
+}
+
+// the way input was parsed before: 64 KiB chunks of a stream, a temporary string and a set node for each item
+std::size_t parse_as_before(const char* path)
+{
+    std::set<std::string> secure_domains;
+    std::map<std::string, std::set<std::string>> insecure_domains_of_nameserver;
+    std::ifstream in{path};
+    bool is_secure = false;
+    bool at_line_start = true;
+    std::string nameserver;
+    std::set<std::string> domains;
+    std::string rest_of_data;
+    char chunk[0x10000];
+    while (in)
+    {
+        in.read(chunk, sizeof(chunk));
+        const char* const chunk_end = chunk + in.gcount();
+        const char* item_begin = chunk;
+        for (const char* pos = chunk; pos < chunk_end; ++pos)
+        {
+            if ((*pos != ' ') && (*pos != '\n'))
+            {
+                continue;
+            }
+            const std::string item = rest_of_data + std::string(item_begin, pos - item_begin);
+            rest_of_data.clear();
+            item_begin = pos + 1;
+            if ((item == "[secure]") || (item == "[insecure]"))
+            {
+                is_secure = item == "[secure]";
+                continue;
+            }
+            if (is_secure)
+            {
+                if (!item.empty())
+                {
+                    secure_domains.insert(item);
+                }
+            }
+            else if (at_line_start)
+            {
+                nameserver = item;
+                at_line_start = false;
+            }
+            else
+            {
+                domains.insert(item);
+            }
+            if (*pos == '\n')
+            {
+                if (!nameserver.empty() && !domains.empty())
+                {
+                    insecure_domains_of_nameserver.insert(std::make_pair(nameserver, domains));
+                }
+                nameserver.clear();
+                domains.clear();
+                at_line_start = true;
+            }
+        }
+        rest_of_data.append(item_begin, chunk_end - item_begin);
+    }
+    std::size_t number_of_domains = secure_domains.size();
+    for (auto&& nameserver_and_domains : insecure_domains_of_nameserver)
+    {
+        number_of_domains += nameserver_and_domains.second.size();
+    }
+    return number_of_domains;
+}
+
+std::size_t parse_mapped(const char* path)
+{
+    const auto input = Util::InputBuffer::map_file(path);
+    const DomainsToScan domains_to_scan{input.data(), input.size()};
+    return domains_to_scan.get_number_of_domains();
+}
+
+using Clock = std::chrono::steady_clock;
+
+long get_peak_rss_mib()
+{
+    struct ::rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+}
+
+template <typename Parser>
+double get_seconds(Parser parse, const char* path, std::size_t expected_number_of_domains)
+{
+    const auto started = Clock::now();
+    const std::size_t number_of_domains = parse(path);
+    const auto duration = Clock::now() - started;
+    if (number_of_domains != expected_number_of_domains)
+    {
+        std::cerr << "only " << number_of_domains << " of " << expected_number_of_domains << " domains parsed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return std::chrono::duration<double>(duration).count();
+}
+
+}//namespace {anonymous}
+
+// usage: input-benchmark [number_of_domains]
+int main(int argc, char* argv[])
+{
+    const std::size_t number_of_domains = 1 < argc ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+    if (number_of_domains == 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [number_of_domains]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    char path[] = "/tmp/input-benchmark-XXXXXX";
+    const int fd = ::mkstemp(path);
+    if (fd < 0)
+    {
+        std::cerr << "mkstemp failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    ::close(fd);
+    {
+        std::ofstream out{path};
+        generate_input(number_of_domains, out);
+    }
+    // insecure domains are counted once for each of their two nameservers
+    const std::size_t number_of_secure_domains = number_of_domains / 5;
+    const std::size_t expected_number_of_domains = number_of_secure_domains + 2 * (number_of_domains - number_of_secure_domains);
+    // the peak grows only, so the lighter parser goes first
+    const auto seconds_mapped = get_seconds(parse_mapped, path, expected_number_of_domains);
+    const auto peak_rss_mapped = get_peak_rss_mib();
+    const auto seconds_before = get_seconds(parse_as_before, path, expected_number_of_domains);
+    const auto peak_rss_before = get_peak_rss_mib();
+    std::remove(path);
+    std::cout << "input: " << number_of_domains << " domains, "
+              << seconds_mapped << "s mapped and interned (peak " << peak_rss_mapped << " MiB), "
+              << seconds_before << "s by stream into sets (peak " << peak_rss_before << " MiB)" << std::endl;
+    return EXIT_SUCCESS;
+}
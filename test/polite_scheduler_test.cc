@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/polite_scheduler.hh"
+
+#include "test/check.hh"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+//items are named by their key and a number, e.g. "a1"
+using Scheduler = Util::PoliteScheduler<char, std::string>;
+
+using Test::check;
+
+Scheduler make_scheduler(double max_rate_per_key)
+{
+    return Scheduler{Scheduler::Settings{2, 0, max_rate_per_key}, [](const std::string& item) { return item.front(); }};
+}
+
+//pushes the item, pops items until none is given like generators of queries do and finishes the item,
+//returns false if it was not handed out
+bool send(Scheduler& scheduler, const std::string& item)
+{
+    scheduler.push(item);
+    const auto popped = scheduler.pop();
+    if (popped == boost::none)
+    {
+        return false;
+    }
+    const bool nothing_else = scheduler.pop() == boost::none;
+    scheduler.on_finished(*popped);
+    return nothing_else && (*popped == item);
+}
+
+void test_rate_kept_by_idle_key()
+{
+    //the burst of 2 items is refilled in 2 seconds
+    auto scheduler = make_scheduler(1.0);
+    check(send(scheduler, "a1"), "rate kept: first item of the burst");
+    check(send(scheduler, "a2"), "rate kept: second item of the burst");
+    check(!send(scheduler, "a3"), "rate kept: no new burst for an idle key");
+    check(scheduler.size() == 1, "rate kept: item stays queued");
+    check(send(scheduler, "b1"), "rate kept: other keys have their own rate");
+}
+
+void test_idle_key_refilled()
+{
+    //the burst of 2 items is refilled in 20 milliseconds
+    auto scheduler = make_scheduler(100.0);
+    check(send(scheduler, "a1"), "refilled: first item of the burst");
+    check(send(scheduler, "a2"), "refilled: second item of the burst");
+    std::this_thread::sleep_for(std::chrono::milliseconds{30});
+    check(send(scheduler, "a3"), "refilled: first item of the next burst");
+    check(send(scheduler, "a4"), "refilled: second item of the next burst");
+    check(!send(scheduler, "a5"), "refilled: burst not exceeded");
+}
+
+void test_unlimited()
+{
+    auto scheduler = make_scheduler(0.0);
+    bool all_sent = true;
+    for (int idx = 0; idx < 10; ++idx)
+    {
+        all_sent = all_sent && send(scheduler, "a" + std::to_string(idx));
+    }
+    check(all_sent, "unlimited: no rate");
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_rate_kept_by_idle_key();
+    test_idle_key_refilled();
+    test_unlimited();
+    return Test::get_exit_status();
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/queued_tasks.hh"
+
+#include "test/check.hh"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+using Test::check;
+
+void test_room()
+{
+    Util::QueuedTasks queued_tasks{10};
+    check(queued_tasks.get_room() == 10, "room: empty queue");
+    queued_tasks.add(4);
+    check((queued_tasks.size() == 4) && (queued_tasks.get_room() == 6), "room: added tasks");
+    queued_tasks.add(8);
+    check((queued_tasks.size() == 12) && (queued_tasks.get_room() == 0), "room: more tasks than the limit");
+    queued_tasks.remove(12);
+    check((queued_tasks.size() == 0) && (queued_tasks.get_room() == 10), "room: removed tasks");
+}
+
+void test_wait_for_room()
+{
+    Util::QueuedTasks queued_tasks{10};
+    queued_tasks.add(10);
+    const auto timed_out_at = std::chrono::steady_clock::now() + std::chrono::milliseconds{20};
+    queued_tasks.wait_for_room(std::chrono::milliseconds{20});
+    check(timed_out_at <= std::chrono::steady_clock::now(), "wait for room: time is up");
+    std::thread consumer{[&]()
+    {
+        for (int idx = 0; idx < 5; ++idx)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            queued_tasks.remove(1);
+        }
+    }};
+    queued_tasks.wait_for_room(std::chrono::seconds{10});
+    check(queued_tasks.size() <= 5, "wait for room: a half of the tasks taken");
+    consumer.join();
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_room();
+    test_wait_for_room();
+    return Test::get_exit_status();
+}
@@ -0,0 +1,141 @@
+binary=$1
+runtime=${2:-10}
+number_of_secure_domains=${3:-20000}
+number_of_nameservers=${4:-2000}
+domains_per_nameserver=10
+
+anchor=". 257 3 8 \
+AwEAAdAjHYjqJ6ovPqU+mVFrrvIaqPiQfmNRbv4LX/A0xqcgL\
+ZjVC4Mw1bNgU+yvE4J3ICiYk2nKRdYY+9OmKdkb1o7Pl6K7uC\
+q2PiIBFOtj610B+eS7xvhOp9JnXXKcCg/tgkMCAPZ89RczNmQ\
+BJtFzjgytjNPNgl2a2ApOKXOVE5xFL6YcWW0p8rPdCnNE2HUQ\
+wIJTnxkWf/cLY4gY21TWKIfsE024qXE+8jxbHIFpDzAG5VrnN\
+E0yS2p24ad45IlhHHJI1K076lKOAXRpv7S7HE0JbTx3SxFcNr\
+wRdX3WM/pkFxgBzrTk1bpcWWUbLX3mb5nZPv9v0RQ4qYoo11a\
+xAU8="
+
+workdir="$(mktemp -d)"
+responder=
+trap '[ -n "${responder}" ] && kill ${responder} 2> /dev/null; rm -rf "${workdir}"' EXIT
+
+# hostname resolver on 127.0.0.2, it gives every even nameserver ns-N.test its own loopback address
+# and leaves the odd ones without any address
+cat > "${workdir}/responder.py" << 'END_OF_RESPONDER'
+import re, socket, struct, sys
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+try:
+    sock.bind(("127.0.0.2", 53))
+except OSError:
+    sys.exit(77)
+open(sys.argv[1], "w").close()
+while True:
+    query, peer = sock.recvfrom(4096)
+    labels = []
+    pos = 12
+    while (pos < len(query)) and (query[pos] != 0):
+        labels.append(query[pos + 1:pos + 1 + query[pos]].decode("ascii", "replace"))
+        pos += 1 + query[pos]
+    if len(query) < pos + 5:
+        continue
+    qtype = struct.unpack("!H", query[pos + 1:pos + 3])[0]
+    nameserver = re.fullmatch(r"ns-(\d+)\.test", ".".join(labels).lower())
+    answer = b""
+    if (qtype == 1) and (nameserver is not None) and (int(nameserver.group(1)) % 2 == 0):
+        number = int(nameserver.group(1))
+        answer = struct.pack("!HHHIH", 0xc00c, 1, 1, 300, 4) + bytes([127, 1, (number >> 8) & 0xff, number & 0xff])
+    header = query[:2] + struct.pack("!HHHHH", 0x8180, 1, 1 if answer else 0, 0, 0)
+    sock.sendto(header + query[12:pos + 5] + answer, peer)
+END_OF_RESPONDER
+python3 "${workdir}/responder.py" "${workdir}/responder.ready" &
+responder=$!
+while [ ! -e "${workdir}/responder.ready" ]
+do
+    if ! kill -0 ${responder} 2> /dev/null
+    then
+        wait ${responder}
+        status=$?
+        responder=
+        [ ${status} -eq 77 ] && { echo "restart test skipped: can not listen on 127.0.0.2:53"; exit 77; }
+        echo "restart test failed: hostname resolver exited with status ${status}"
+        exit 1
+    fi
+    sleep 0.1
+done
+
+# no CDNSKEY resolver is listening on the loopback, every query ends with a failure or a timeout
+make_input()
+{
+    echo "[secure]"
+    [ $1 -gt 0 ] && seq -f "secure-%g.test" 1 $1 | paste -sd ' '
+    echo "[insecure]"
+    for ns in $(seq 1 ${number_of_nameservers})
+    do
+        echo "ns-${ns}.test $(seq -f "insecure-${ns}-%g.test" 1 ${domains_per_nameserver} | paste -sd ' ')"
+    done
+}
+
+fail() { echo "restart test failed (${run}): $*"; tail -n 20 "${workdir}/${run}.errors"; exit 1; }
+
+# resolvers run in grandchildren of the scanner, phases restart them with the unfinished part of the work;
+# a kill after the insecure phase has counted its queries hits a child resolving insecure CDNSKEY records
+# unless the secure phase runs at the same time
+scan()
+{
+    run=$1
+    make_input $2 > "${workdir}/${run}.input"
+    ${binary} ${runtime} \
+    --hostname_resolvers "127.0.0.2" \
+    --cdnskey_resolvers "127.0.0.1" \
+    --insecure_allowed_ranges "127.0.0.0/8" \
+    --dnssec_trust_anchors "${anchor}" < "${workdir}/${run}.input" > "${workdir}/${run}.output" 2> "${workdir}/${run}.errors" &
+    local scanner=$!
+    kills=0
+    insecure_kills=0
+    while kill -0 ${scanner} 2> /dev/null
+    do
+        sleep 0.3
+        for phase in $(pgrep -P ${scanner})
+        do
+            for resolver in $(pgrep -P ${phase})
+            do
+                if kill -KILL ${resolver} 2> /dev/null
+                then
+                    kills=$((kills + 1))
+                    grep -q "^number_of_insecure_queries = " "${workdir}/${run}.errors" && insecure_kills=$((insecure_kills + 1))
+                fi
+            done
+        done
+    done
+    wait ${scanner}
+    local status=$?
+    [ ${status} -eq 0 ] || fail "scanner exited with status ${status}"
+    [ ${kills} -ge 3 ] || fail "only ${kills} child processes killed"
+    [ -z "$(sort "${workdir}/${run}.output" | uniq -d | head -n 1)" ] || fail "duplicate lines in output"
+}
+
+# every insecure task (nameserver, address, domain) of a resolved nameserver is reported exactly once
+check_insecure()
+{
+    local output="${workdir}/${run}.output"
+    local odd_nameservers=$(((number_of_nameservers + 1) / 2))
+    local expected_tasks=$(((number_of_nameservers / 2) * domains_per_nameserver))
+    local nameservers=$(grep "^unresolved-ip " "${output}" | cut -d ' ' -f 2 | sort -u | wc -l)
+    [ ${nameservers} -eq ${odd_nameservers} ] || fail "${nameservers} of ${odd_nameservers} nameservers without address reported"
+    [ -z "$(grep -E "^unresolved-ip ns-[0-9]*[02468]\.test$" "${output}" | head -n 1)" ] || fail "resolved nameserver reported without address"
+    grep -E "^(unresolved|insecure-empty|insecure) " "${output}" | cut -d ' ' -f 2-4 > "${workdir}/${run}.tasks"
+    [ -z "$(sort "${workdir}/${run}.tasks" | uniq -d | head -n 1)" ] || fail "insecure task reported more than once"
+    local tasks=$(sort -u "${workdir}/${run}.tasks" | wc -l)
+    [ ${tasks} -eq ${expected_tasks} ] || fail "${tasks} of ${expected_tasks} insecure tasks reported"
+}
+
+scan mixed ${number_of_secure_domains}
+secure_domains=$(grep -E "^(secure|secure-empty|untrustworthy|unknown) " "${workdir}/${run}.output" | cut -d ' ' -f 2 | sort -u | wc -l)
+[ ${secure_domains} -eq ${number_of_secure_domains} ] || fail "${secure_domains} of ${number_of_secure_domains} secure domains answered"
+check_insecure
+mixed_kills=${kills}
+
+# without secure domains every kill after the hostname phase lands on insecure CDNSKEY work
+scan insecure 0
+[ ${insecure_kills} -ge 3 ] || fail "only ${insecure_kills} child processes killed while resolving insecure CDNSKEY records"
+check_insecure
+echo "restart test passed, $((mixed_kills + kills)) child processes killed, ${insecure_kills} of them resolving insecure CDNSKEY records"
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/circuit_breaker.hh"
+#include "src/util/sample_gate.hh"
+
+#include "src/time_unit.hh"
+
+#include "test/check.hh"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Gate = Util::SampleGate<std::string, int>;
+
+using Test::check;
+
+void test_pass()
+{
+    Gate gate{2};
+    check(gate.admit("a") == Gate::Admission::sample, "pass: first sample");
+    check(gate.admit("a") == Gate::Admission::sample, "pass: second sample");
+    check(gate.admit("a") == Gate::Admission::hold, "pass: held");
+    gate.hold("a", 3);
+    check(gate.admit("b") == Gate::Admission::sample, "pass: keys are independent");
+    check(gate.size() == 1, "pass: size");
+    check(gate.on_result("a", true) == boost::none, "pass: one refusal is not a verdict");
+    const auto released = gate.on_result("a", false);
+    check((released != boost::none) && (released->verdict == Gate::Verdict::pass), "pass: verdict");
+    check((released != boost::none) && (released->items == std::vector<int>{3}), "pass: held items released");
+    check(gate.size() == 0, "pass: nothing held");
+    check(gate.admit("a") == Gate::Admission::send, "pass: sent after verdict");
+    check(gate.on_result("a", true) == boost::none, "pass: verdict is final");
+}
+
+void test_prune()
+{
+    Gate gate{2};
+    gate.admit("a");
+    gate.admit("a");
+    gate.admit("a");
+    gate.hold("a", 3);
+    gate.admit("a");
+    gate.hold("a", 4);
+    check(gate.on_result("a", true) == boost::none, "prune: first refusal");
+    const auto released = gate.on_result("a", true);
+    check((released != boost::none) && (released->verdict == Gate::Verdict::prune), "prune: verdict");
+    check((released != boost::none) && (released->items == std::vector<int>{3, 4}), "prune: held items released");
+    check(gate.admit("a") == Gate::Admission::prune, "prune: pruned after verdict");
+}
+
+void test_disabled()
+{
+    Gate gate{0};
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        check(gate.admit("a") == Gate::Admission::send, "disabled: everything sent");
+    }
+    check(gate.on_result("a", true) == boost::none, "disabled: no verdict");
+}
+
+//sampled queries time out and they are retried until the breaker opens and rejects the retries; the rejected
+//samples report their results, so the held items get a verdict
+void test_samples_rejected_by_breaker()
+{
+    Gate gate{2};
+    Util::CircuitBreaker<std::string> breaker{Util::CircuitBreakerSettings{3, std::chrono::nanoseconds::zero()}};
+    std::vector<int> sampled;
+    for (int item = 0; item < 5; ++item)
+    {
+        if (gate.admit("a") == Gate::Admission::sample)
+        {
+            sampled.push_back(item);
+        }
+        else
+        {
+            gate.hold("a", item);
+        }
+    }
+    check(sampled.size() == 2, "breaker: samples");
+    std::size_t number_of_rounds = 0;
+    while (breaker.allow("a") && (number_of_rounds < 10))
+    {
+        const auto sent_at = TimeUnit::get_uptime();
+        std::this_thread::sleep_for(std::chrono::microseconds{10});
+        for (std::size_t idx = 0; idx < sampled.size(); ++idx)
+        {
+            breaker.on_timeout("a", sent_at);
+        }
+        ++number_of_rounds;
+    }
+    check(breaker.get_number_of_opened_circuits() == 1, "breaker: opened by timeouts of samples");
+    std::vector<int> released_items;
+    for (std::size_t idx = 0; idx < sampled.size(); ++idx)
+    {
+        check(!breaker.allow("a"), "breaker: retry of sample rejected");
+        const auto released = gate.on_result("a", false);
+        if (released != boost::none)
+        {
+            check(released->verdict == Gate::Verdict::pass, "breaker: timeouts are no refusals");
+            released_items = released->items;
+        }
+    }
+    check(released_items == std::vector<int>{2, 3, 4}, "breaker: held items released");
+    check(gate.size() == 0, "breaker: nothing held");
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_pass();
+    test_prune();
+    test_disabled();
+    test_samples_rejected_by_breaker();
+    return Test::get_exit_status();
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/getdns/solver.hh"
+
+#include "src/event/base.hh"
+
+#include <getdns/getdns.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+// stands in for getdns: remembers callbacks of started transactions and fires them on request
+struct Transaction
+{
+    ::getdns_callback_t callback;
+    void* user_data;
+    ::getdns_transaction_t transaction_id;
+};
+
+std::vector<Transaction> pending_transactions;
+::getdns_transaction_t last_transaction_id = 0;
+
+class Query
+{
+public:
+    Query() : status_{Status::none} { }
+    ::getdns_transaction_t start_transaction(Event::Base&, ::getdns_callback_t callback_fnc, void* user_data)
+    {
+        pending_transactions.push_back(Transaction{callback_fnc, user_data, ++last_transaction_id});
+        status_ = Status::in_progress;
+        return last_transaction_id;
+    }
+    enum class Status
+    {
+        none,
+        in_progress,
+        completed,
+        cancelled,
+        timed_out,
+        failed
+    };
+    Status get_status() const noexcept { return status_; }
+    void on_complete(const GetDns::Data::DictRef&, ::getdns_transaction_t) { status_ = Status::completed; }
+    void on_cancel(::getdns_transaction_t) { status_ = Status::cancelled; }
+    void on_timeout(::getdns_transaction_t) { status_ = Status::timed_out; }
+    void on_error(::getdns_transaction_t) { status_ = Status::failed; }
+private:
+    Status status_;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double get_ns_per_item(Clock::duration duration, std::size_t items)
+{
+    return std::chrono::duration<double, std::nano>(duration).count() / items;
+}
+
+}//namespace {anonymous}
+
+// usage: solver-benchmark [number_of_queries_in_flight [number_of_rounds]]
+int main(int argc, char* argv[])
+{
+    const std::size_t in_flight = 1 < argc ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    const std::size_t rounds = 2 < argc ? std::strtoul(argv[2], nullptr, 10) : 100;
+    if ((in_flight == 0) || (rounds == 0))
+    {
+        std::cerr << "usage: " << argv[0] << " [number_of_queries_in_flight [number_of_rounds]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    GetDns::Solver<Query> solver{0};
+    pending_transactions.reserve(in_flight);
+    std::mt19937 generator{0};
+    Clock::duration time_of_adding{0};
+    Clock::duration time_of_completing{0};
+    std::size_t number_of_finished = 0;
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        const auto adding_started = Clock::now();
+        for (std::size_t idx = 0; idx < in_flight; ++idx)
+        {
+            solver.add_request(Query{});
+        }
+        time_of_adding += Clock::now() - adding_started;
+        // answers arrive in arbitrary order
+        std::shuffle(pending_transactions.begin(), pending_transactions.end(), generator);
+        const auto completing_started = Clock::now();
+        for (const auto& transaction : pending_transactions)
+        {
+            transaction.callback(nullptr, ::GETDNS_CALLBACK_COMPLETE, nullptr, transaction.user_data, transaction.transaction_id);
+        }
+        solver.for_each_finished_request([&](Query& query)
+        {
+            if (query.get_status() == Query::Status::completed)
+            {
+                ++number_of_finished;
+            }
+        });
+        time_of_completing += Clock::now() - completing_started;
+        pending_transactions.clear();
+    }
+    if ((number_of_finished != (in_flight * rounds)) || (solver.get_number_of_unresolved_requests() != 0))
+    {
+        std::cerr << "only " << number_of_finished << " of " << (in_flight * rounds) << " queries finished" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "solver: " << in_flight << " queries in flight, " << rounds << " rounds, "
+              << get_ns_per_item(time_of_adding, number_of_finished) << "ns per add_request, "
+              << get_ns_per_item(time_of_completing, number_of_finished) << "ns per completion" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "src/util/task_source.hh"
+
+#include "test/check.hh"
+
+#include <boost/asio/ip/address.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Nameservers = std::vector<std::uint32_t>;
+//nameservers of tasks by their addresses and domains
+using TasksByKey = std::map<std::pair<Util::IpAddress, Util::NameTable::Id>, Nameservers>;
+
+using Test::check;
+
+Util::IpAddress make_address(const char* text)
+{
+    return Util::IpAddress{boost::asio::ip::make_address(text)};
+}
+
+Util::NameserverState make_nameserver(Util::NameTable::Ids domains, Util::IpAddresses addresses)
+{
+    Util::Bitmap answered{domains.size() * addresses.size()};
+    return Util::NameserverState{std::move(domains), std::move(addresses), true, std::move(answered)};
+}
+
+Util::AddressClassifier make_classifier()
+{
+    Util::AddressClassifier classifier;
+    classifier.add(Util::IpPrefix{Util::IpAddress{}, 0}, true);
+    classifier.add(Util::parse_ip_prefix("10.0.0.0/8"), false);
+    return classifier;
+}
+
+Nameservers get_nameservers(const Util::NameserverLists& nameserver_lists, const Util::Task& task)
+{
+    const auto list = nameserver_lists.get(task.nameservers);
+    return Nameservers(list.begin(), list.end());
+}
+
+TasksByKey get_tasks_by_key(const Util::NameserverLists& nameserver_lists, const Util::Tasks& tasks)
+{
+    TasksByKey result;
+    for (auto&& task : tasks)
+    {
+        result[std::make_pair(task.address, task.domain)] = get_nameservers(nameserver_lists, task);
+    }
+    return result;
+}
+
+const Util::TaskSource::OnNonPublic ignore_non_public = [](const Util::Task&) { };
+
+void test_nameserver_lists()
+{
+    Util::NameserverLists nameserver_lists;
+    const auto id = nameserver_lists.add(Nameservers{1, 2});
+    check(nameserver_lists.add(Nameservers{1, 2}) == id, "nameserver lists: equal lists share the id");
+    check(nameserver_lists.add(Nameservers{2, 1}) != id, "nameserver lists: order matters");
+    const auto list = nameserver_lists.get(id);
+    check(Nameservers(list.begin(), list.end()) == Nameservers({1, 2}), "nameserver lists: list kept");
+    //more lists than the first table of buckets and the first chunk hold
+    Nameservers ids;
+    for (std::uint32_t nameserver = 0; nameserver < 0x10000; ++nameserver)
+    {
+        ids.push_back(nameserver_lists.add(Nameservers{nameserver, nameserver}));
+    }
+    bool all_found = true;
+    for (std::uint32_t nameserver = 0; nameserver < 0x10000; ++nameserver)
+    {
+        const auto found = nameserver_lists.get(ids[nameserver]);
+        all_found = all_found &&
+                    (nameserver_lists.add(Nameservers{nameserver, nameserver}) == ids[nameserver]) &&
+                    (found.size() == 2) && (*found.begin() == nameserver);
+    }
+    check(all_found, "nameserver lists: lists survive growing");
+    check(Nameservers(list.begin(), list.end()) == Nameservers({1, 2}), "nameserver lists: list never moves");
+}
+
+void test_merge()
+{
+    const auto a = make_address("192.0.2.1");
+    const auto b = make_address("2001:db8::1");
+    const Util::NameserverStates nameservers = {
+            make_nameserver({1, 2, 3}, {a}),
+            make_nameserver({2, 3, 4}, {a, b})};
+    const auto classifier = make_classifier();
+    Util::TaskSource source{nameservers, Util::Shard{0, 1}, classifier};
+    check(source.get_number_of_queries() == 9, "merge: queries counted");
+    Util::NameserverLists nameserver_lists;
+    Util::Tasks tasks;
+    source.take(100, 100, tasks, nameserver_lists, ignore_non_public);
+    check(source.empty(), "merge: all taken");
+    const TasksByKey expected = {
+            {{a, 1}, {0}},
+            {{a, 2}, {0, 1}},
+            {{a, 3}, {0, 1}},
+            {{a, 4}, {1}},
+            {{b, 2}, {1}},
+            {{b, 3}, {1}},
+            {{b, 4}, {1}}};
+    check(tasks.size() == expected.size(), "merge: one task per address and domain");
+    check(get_tasks_by_key(nameserver_lists, tasks) == expected, "merge: nameservers sharing an address");
+}
+
+void test_answered()
+{
+    const auto a = make_address("192.0.2.1");
+    const auto b = make_address("192.0.2.2");
+    Util::NameserverStates nameservers = {
+            make_nameserver({1, 2}, {a}),
+            make_nameserver({2, 3}, {a, b})};
+    //domain 2 answered on the address a of the nameserver 1
+    nameservers[1].answered.set(0 * 2 + 0);
+    //all queries of the nameserver 0 answered
+    nameservers[0].answered.set(0);
+    nameservers[0].answered.set(1);
+    const auto classifier = make_classifier();
+    Util::TaskSource source{nameservers, Util::Shard{0, 1}, classifier};
+    check(source.get_number_of_queries() == 3, "answered: only unanswered queries counted");
+    Util::NameserverLists nameserver_lists;
+    Util::Tasks tasks;
+    source.take(100, 100, tasks, nameserver_lists, ignore_non_public);
+    const TasksByKey expected = {
+            {{a, 3}, {1}},
+            {{b, 2}, {1}},
+            {{b, 3}, {1}}};
+    check(get_tasks_by_key(nameserver_lists, tasks) == expected, "answered: answered queries skipped");
+}
+
+void test_non_public()
+{
+    const auto a = make_address("10.1.2.3");
+    const auto b = make_address("192.0.2.1");
+    const Util::NameserverStates nameservers = {make_nameserver({1, 2}, {a, b})};
+    const auto classifier = make_classifier();
+    Util::TaskSource source{nameservers, Util::Shard{0, 1}, classifier};
+    Util::NameserverLists nameserver_lists;
+    Util::Tasks tasks;
+    Util::Tasks non_public;
+    source.take(100, 100, tasks, nameserver_lists, [&](const Util::Task& task) { non_public.push_back(task); });
+    check((tasks.size() == 2) && (tasks[0].address == b) && (tasks[1].address == b), "non public: public tasks");
+    check((non_public.size() == 2) && (non_public[0].address == a) && (non_public[1].address == a), "non public: reported");
+}
+
+void test_turns()
+{
+    const auto a = make_address("192.0.2.1");
+    const auto b = make_address("192.0.2.2");
+    const Util::NameserverStates nameservers = {
+            make_nameserver({1, 2, 3}, {a}),
+            make_nameserver({4, 5, 6}, {b})};
+    const auto classifier = make_classifier();
+    Util::TaskSource source{nameservers, Util::Shard{0, 1}, classifier};
+    Util::NameserverLists nameserver_lists;
+    std::size_t number_of_tasks = 0;
+    bool addresses_take_turns = true;
+    while (!source.empty())
+    {
+        Util::Tasks tasks;
+        source.take(4, 1, tasks, nameserver_lists, ignore_non_public);
+        addresses_take_turns = addresses_take_turns && (tasks.size() == 2) && (tasks[0].address != tasks[1].address);
+        number_of_tasks += tasks.size();
+    }
+    check(addresses_take_turns, "turns: each address gives one task in its turn");
+    check(number_of_tasks == 6, "turns: all tasks taken");
+}
+
+void test_shard()
+{
+    const auto a = make_address("192.0.2.1");
+    const auto b = make_address("192.0.2.2");
+    const Util::NameserverStates nameservers = {make_nameserver({1}, {a, b})};
+    const auto classifier = make_classifier();
+    std::size_t number_of_tasks = 0;
+    bool owned = true;
+    for (std::size_t idx = 0; idx < 2; ++idx)
+    {
+        const auto shard = Util::Shard{idx, 2};
+        Util::TaskSource source{nameservers, shard, classifier};
+        Util::NameserverLists nameserver_lists;
+        Util::Tasks tasks;
+        source.take(100, 100, tasks, nameserver_lists, ignore_non_public);
+        for (auto&& task : tasks)
+        {
+            owned = owned && shard.owns(task.address.get_hash());
+        }
+        number_of_tasks += tasks.size();
+    }
+    check(owned, "shard: addresses owned by the shard");
+    check(number_of_tasks == 2, "shard: each task in one shard");
+}
+
+void test_take_tasks()
+{
+    const auto a = make_address("192.0.2.1");
+    const auto b = make_address("192.0.2.2");
+    const Util::NameserverStates nameservers = {
+            make_nameserver({1, 2}, {a}),
+            make_nameserver({3}, {b})};
+    const auto classifier = make_classifier();
+    Util::TaskSources sources;
+    sources.emplace_back(Util::ResolvedNameservers{Util::ResolvedNameserver{1, {b}}}, nameservers, classifier);
+    sources.emplace_back(Util::ResolvedNameservers{Util::ResolvedNameserver{0, {a}}}, nameservers, classifier);
+    Util::NameserverLists nameserver_lists;
+    const auto first = Util::take_tasks(sources, 2, 1, nameserver_lists, ignore_non_public);
+    check((first.size() == 2) && (first[0].address == b) && (first[1].address == a), "take tasks: earlier sources first");
+    check(sources.size() == 1, "take tasks: exhausted source dropped");
+    const auto second = Util::take_tasks(sources, 2, 1, nameserver_lists, ignore_non_public);
+    check((second.size() == 1) && (second[0].domain == 2), "take tasks: rest of the source");
+    check(sources.empty(), "take tasks: all sources exhausted");
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_nameserver_lists();
+    test_merge();
+    test_answered();
+    test_non_public();
+    test_turns();
+    test_shard();
+    test_take_tasks();
+    return Test::get_exit_status();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/dns/wire.hh"
+#include "src/getdns/data.hh"
+#include "src/getdns/exception.hh"
+
+#include <getdns/getdns.h>
+#include <getdns/getdns_extra.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// CDNSKEY answer of nic.cz with a KSK and a ZSK (algorithm 13) as it came from the wire
+constexpr std::uint8_t cdnskey_answer[] = {
+    0x1a, 0x2b, 0x84, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x03, 0x6e, 0x69, 0x63,
+    0x02, 0x63, 0x7a, 0x00, 0x00, 0x3c, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x3c, 0x00, 0x01, 0x00, 0x00,
+    0x0e, 0x10, 0x00, 0x44, 0x01, 0x01, 0x03, 0x0d,
+    0x03, 0x0a, 0x11, 0x18, 0x1f, 0x26, 0x2d, 0x34, 0x3b, 0x42, 0x49, 0x50, 0x57, 0x5e, 0x65, 0x6c,
+    0x73, 0x7a, 0x81, 0x88, 0x8f, 0x96, 0x9d, 0xa4, 0xab, 0xb2, 0xb9, 0xc0, 0xc7, 0xce, 0xd5, 0xdc,
+    0xe3, 0xea, 0xf1, 0xf8, 0xff, 0x06, 0x0d, 0x14, 0x1b, 0x22, 0x29, 0x30, 0x37, 0x3e, 0x45, 0x4c,
+    0x53, 0x5a, 0x61, 0x68, 0x6f, 0x76, 0x7d, 0x84, 0x8b, 0x92, 0x99, 0xa0, 0xa7, 0xae, 0xb5, 0xbc,
+    0xc0, 0x0c, 0x00, 0x3c, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x44, 0x01, 0x00, 0x03, 0x0d,
+    0x65, 0x72, 0x7f, 0x8c, 0x99, 0xa6, 0xb3, 0xc0, 0xcd, 0xda, 0xe7, 0xf4, 0x01, 0x0e, 0x1b, 0x28,
+    0x35, 0x42, 0x4f, 0x5c, 0x69, 0x76, 0x83, 0x90, 0x9d, 0xaa, 0xb7, 0xc4, 0xd1, 0xde, 0xeb, 0xf8,
+    0x05, 0x12, 0x1f, 0x2c, 0x39, 0x46, 0x53, 0x60, 0x6d, 0x7a, 0x87, 0x94, 0xa1, 0xae, 0xbb, 0xc8,
+    0xd5, 0xe2, 0xef, 0xfc, 0x09, 0x16, 0x23, 0x30, 0x3d, 0x4a, 0x57, 0x64, 0x71, 0x7e, 0x8b, 0x98,
+    0x00, 0x00, 0x29, 0x04, 0xd0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+struct Cdnskey
+{
+    std::uint16_t flags;
+    std::uint8_t protocol;
+    std::uint8_t algorithm;
+    std::string public_key;
+};
+
+// the way answers were parsed before: the message converted to getdns dictionaries and walked by names
+std::size_t parse_by_dict(std::vector<Cdnskey>& result)
+{
+    const GetDns::Data::Dict message{[](::getdns_dict** dict)
+    {
+        MUST_BE_GOOD(::getdns_wire2msg_dict(cdnskey_answer, sizeof(cdnskey_answer), dict));
+    }};
+    const auto answers = (*message).get<GetDns::Data::ListRef>("answer");
+    for (std::size_t answer_idx = 0; answer_idx < answers.length(); ++answer_idx)
+    {
+        const auto answer = answers.get<GetDns::Data::DictRef>(answer_idx);
+        if ((static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("type")) == GETDNS_RRTYPE_CDNSKEY) &&
+            (static_cast<std::uint32_t>(answer.get<GetDns::Data::IntegerRef>("class")) == GETDNS_RRCLASS_IN))
+        {
+            const auto rdata = answer.get<GetDns::Data::DictRef>("rdata");
+            Cdnskey cdnskey;
+            cdnskey.algorithm = rdata.get<GetDns::Data::IntegerRef>("algorithm");
+            cdnskey.flags = rdata.get<GetDns::Data::IntegerRef>("flags");
+            cdnskey.protocol = rdata.get<GetDns::Data::IntegerRef>("protocol");
+            cdnskey.public_key = GetDns::base64_encode(rdata.get<GetDns::Data::BinDataRef>("public_key"));
+            result.push_back(std::move(cdnskey));
+        }
+    }
+    return result.size();
+}
+
+std::size_t parse_by_codec(std::vector<Cdnskey>& result)
+{
+    Dns::Message{cdnskey_answer, sizeof(cdnskey_answer)}.for_each_answer([&](const Dns::ResourceRecord& record)
+    {
+        if ((record.type == Dns::RrType::cdnskey) && (record.rr_class == Dns::RrClass::in))
+        {
+            const auto dnskey = Dns::parse_dnskey(record);
+            result.push_back(Cdnskey{
+                    dnskey.flags,
+                    dnskey.protocol,
+                    dnskey.algorithm,
+                    Dns::base64_encode(dnskey.public_key, dnskey.public_key_length)});
+        }
+    });
+    return result.size();
+}
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Parser>
+double get_ns_per_message(Parser parse, std::size_t rounds)
+{
+    std::vector<Cdnskey> result;
+    std::size_t number_of_keys = 0;
+    const auto started = Clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        result.clear();
+        number_of_keys += parse(result);
+    }
+    const auto duration = Clock::now() - started;
+    if (number_of_keys != 2 * rounds)
+    {
+        std::cerr << "only " << number_of_keys << " of " << (2 * rounds) << " keys parsed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return std::chrono::duration<double, std::nano>(duration).count() / rounds;
+}
+
+}//namespace {anonymous}
+
+// usage: wire-benchmark [number_of_messages]
+int main(int argc, char* argv[])
+{
+    const std::size_t rounds = 1 < argc ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    if (rounds == 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [number_of_messages]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::vector<std::uint8_t> query;
+    query.reserve(512);
+    const auto encoding_started = Clock::now();
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        query.clear();
+        Dns::append_query(query, round, "nic.cz", Dns::RrType::cdnskey, Dns::QueryOptions{true, 1232, true});
+    }
+    const auto time_of_encoding = Clock::now() - encoding_started;
+    std::cout << "wire: " << rounds << " messages, "
+              << get_ns_per_message(parse_by_dict, rounds) << "ns per CDNSKEY answer by dict, "
+              << get_ns_per_message(parse_by_codec, rounds) << "ns per CDNSKEY answer by codec, "
+              << (std::chrono::duration<double, std::nano>(time_of_encoding).count() / rounds) << "ns per query" << std::endl;
+    return EXIT_SUCCESS;
+}
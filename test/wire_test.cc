@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2021  CZ.NIC, z. s. p. o.
+ *
+ * This file is part of FRED.
+ *
+ * FRED is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FRED is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRED.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/dns/wire.hh"
+
+#include "test/check.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// answers as they came from the wire, in hex
+constexpr char cdnskey_answer[] =
+        "1a2b84000001000200000001036e696302637a00003c0001c00c003c000100000e1000440101030d030a11181f262d343b4249"
+        "50575e656c737a81888f969da4abb2b9c0c7ced5dce3eaf1f8ff060d141b222930373e454c535a61686f767d848b9299a0a7ae"
+        "b5bcc00c003c000100000e1000440100030d65727f8c99a6b3c0cddae7f4010e1b2835424f5c697683909daab7c4d1deebf805"
+        "121f2c394653606d7a8794a1aebbc8d5e2effc091623303d4a5764717e8b9800002904d0000000000000";
+constexpr char cname_and_a_answer[] =
+        "00428180000100020000000003777777036e696302637a0000010001c00c000500010000012c0006036e7331c010c02c0001"
+        "00010000012c0004d91fcd32";
+constexpr char aaaa_answer[] =
+        "0043818000010001000000000161026e73036e696302637a00001c0001c00c001c00010000012c001020011488ac15ff8000"
+        "00000000000053";
+constexpr char refused_answer[] =
+        "004480050001000000000000036e696302637a00003c0001";
+constexpr char cdnskey_query[] =
+        "beef01000001000000000001036e696302637a00003c000100002904d0000080000000";
+
+std::vector<std::uint8_t> from_hex(const std::string& hex)
+{
+    std::vector<std::uint8_t> result;
+    for (std::size_t idx = 0; idx + 1 < hex.size(); idx += 2)
+    {
+        result.push_back(std::stoul(hex.substr(idx, 2), nullptr, 16));
+    }
+    return result;
+}
+
+using Test::check;
+
+template <typename Fnc>
+bool is_malformed(Fnc&& fnc)
+{
+    try
+    {
+        fnc();
+    }
+    catch (const Dns::MalformedMessage&)
+    {
+        return true;
+    }
+    return false;
+}
+
+std::vector<Dns::ResourceRecord> get_answers(const std::vector<std::uint8_t>& packet)
+{
+    std::vector<Dns::ResourceRecord> result;
+    Dns::Message{packet.data(), packet.size()}.for_each_answer([&](const Dns::ResourceRecord& record)
+    {
+        result.push_back(record);
+    });
+    return result;
+}
+
+void test_cdnskey_answer()
+{
+    const auto packet = from_hex(cdnskey_answer);
+    const Dns::Message message{packet.data(), packet.size()};
+    check(message.get_header().id == 0x1a2b, "cdnskey: id");
+    check(message.get_header().is_response(), "cdnskey: response");
+    check(message.get_header().get_rcode() == Dns::Rcode::no_error, "cdnskey: rcode");
+    const auto answers = get_answers(packet);
+    check(answers.size() == 2, "cdnskey: number of answers");
+    if (answers.size() != 2)
+    {
+        return;
+    }
+    check((answers[0].type == Dns::RrType::cdnskey) && (answers[0].rr_class == Dns::RrClass::in), "cdnskey: type");
+    check(answers[0].ttl == 3600, "cdnskey: ttl");
+    const auto ksk = Dns::parse_dnskey(answers[0]);
+    check((ksk.flags == 257) && (ksk.protocol == 3) && (ksk.algorithm == 13), "cdnskey: ksk rdata");
+    check(Dns::base64_encode(ksk.public_key, ksk.public_key_length) ==
+          "AwoRGB8mLTQ7QklQV15lbHN6gYiPlp2kq7K5wMfO1dzj6vH4/wYNFBsiKTA3PkVMU1phaG92fYSLkpmgp661vA==",
+          "cdnskey: ksk public key");
+    const auto zsk = Dns::parse_dnskey(answers[1]);
+    check((zsk.flags == 256) && (zsk.protocol == 3) && (zsk.algorithm == 13), "cdnskey: zsk rdata");
+    check(Dns::base64_encode(zsk.public_key, zsk.public_key_length) ==
+          "ZXJ/jJmms8DN2uf0AQ4bKDVCT1xpdoOQnaq3xNHe6/gFEh8sOUZTYG16h5ShrrvI1eLv/AkWIzA9SldkcX6LmA==",
+          "cdnskey: zsk public key");
+}
+
+void test_address_answers()
+{
+    const auto a_packet = from_hex(cname_and_a_answer);
+    const auto a_answers = get_answers(a_packet);
+    check(a_answers.size() == 2, "a: number of answers");
+    if (a_answers.size() == 2)
+    {
+        check(a_answers[0].type == Dns::RrType::cname, "a: cname first");
+        check(is_malformed([&]() { Dns::parse_address(a_answers[0]); }), "a: cname is not an address");
+        check(Dns::parse_address(a_answers[1]) == boost::asio::ip::make_address("217.31.205.50"), "a: address");
+    }
+    const auto aaaa_packet = from_hex(aaaa_answer);
+    const auto aaaa_answers = get_answers(aaaa_packet);
+    check(aaaa_answers.size() == 1, "aaaa: number of answers");
+    if (aaaa_answers.size() == 1)
+    {
+        check(Dns::parse_address(aaaa_answers[0]) == boost::asio::ip::make_address("2001:1488:ac15:ff80::53"), "aaaa: address");
+    }
+}
+
+void test_refused_answer()
+{
+    const auto packet = from_hex(refused_answer);
+    const Dns::Message message{packet.data(), packet.size()};
+    check(message.get_header().get_rcode() == Dns::Rcode::refused, "refused: rcode");
+    check(get_answers(packet).empty(), "refused: no answers");
+}
+
+void test_malformed_answers()
+{
+    const auto packet = from_hex(cdnskey_answer);
+    check(is_malformed([&]() { Dns::Message{packet.data(), 11}; }), "malformed: short header");
+    check(is_malformed([&]() { Dns::Message{packet.data(), 20}; }), "malformed: cut question");
+    check(is_malformed([&]() { get_answers(std::vector<std::uint8_t>(packet.begin(), packet.begin() + 100)); }),
+          "malformed: cut rdata");
+    auto more_answers = packet;
+    more_answers[7] = 4;
+    check(is_malformed([&]() { get_answers(more_answers); }), "malformed: missing answers");
+    auto bad_label = packet;
+    bad_label[12] = 0x43;
+    check(is_malformed([&]() { Dns::Message{bad_label.data(), bad_label.size()}; }), "malformed: bad label type");
+    const auto short_dnskey = Dns::ResourceRecord{Dns::RrType::cdnskey, Dns::RrClass::in, 0, packet.data() + 41, 3};
+    check(is_malformed([&]() { Dns::parse_dnskey(short_dnskey); }), "malformed: short dnskey");
+}
+
+void test_query()
+{
+    std::vector<std::uint8_t> packet;
+    Dns::append_query(packet, 0xbeef, "nic.cz.", Dns::RrType::cdnskey, Dns::QueryOptions{true, 1232, true});
+    check(packet == from_hex(cdnskey_query), "query: wire format");
+    std::vector<std::uint8_t> without_dot;
+    Dns::append_query(without_dot, 0xbeef, "nic.cz", Dns::RrType::cdnskey, Dns::QueryOptions{true, 1232, true});
+    check(without_dot == packet, "query: trailing dot is optional");
+    const auto is_bad_name = [](const std::string& name)
+    {
+        try
+        {
+            std::vector<std::uint8_t> packet;
+            Dns::append_query(packet, 0, name.c_str(), Dns::RrType::a, Dns::QueryOptions{true, 0, false});
+        }
+        catch (const Dns::BadDomainName&)
+        {
+            return true;
+        }
+        return false;
+    };
+    check(is_bad_name("nic..cz"), "query: empty label");
+    check(is_bad_name(std::string(64, 'a') + ".cz"), "query: long label");
+    const auto label = std::string(63, 'a');
+    check(is_bad_name(label + "." + label + "." + label + "." + label + ".cz"), "query: long name");
+    check(!is_bad_name(label + ".cz"), "query: longest label");
+}
+
+}//namespace {anonymous}
+
+int main()
+{
+    test_cdnskey_answer();
+    test_address_answers();
+    test_refused_answer();
+    test_malformed_answers();
+    test_query();
+    return Test::get_exit_status();
+}